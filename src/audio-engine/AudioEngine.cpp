@@ -9,14 +9,67 @@
 
 namespace UndergroundBeats {
 
+/**
+ * @brief Graph node that plays the engine's renderer
+ */
+class AudioEngine::RenderProcessor : public juce::AudioProcessor {
+public:
+    explicit RenderProcessor(AudioEngine& owner)
+        : juce::AudioProcessor(BusesProperties().withOutput("Output", juce::AudioChannelSet::stereo(), true))
+        , engine(owner)
+    {
+    }
+    
+    const juce::String getName() const override { return "Renderer"; }
+    
+    void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) override
+    {
+        if (Renderer* current = engine.renderer.load(std::memory_order_acquire))
+            current->prepareToRender(sampleRate, maximumExpectedSamplesPerBlock);
+    }
+    
+    void releaseResources() override {}
+    
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override
+    {
+        buffer.clear();
+        
+        if (Renderer* current = engine.renderer.load(std::memory_order_acquire))
+            current->render(buffer, midiMessages);
+    }
+    
+    double getTailLengthSeconds() const override { return 0.0; }
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return false; }
+    
+    juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+    bool hasEditor() const override { return false; }
+    
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const juce::String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const juce::String&) override {}
+    
+    void getStateInformation(juce::MemoryBlock&) override {}
+    void setStateInformation(const void*, int) override {}
+    
+private:
+    AudioEngine& engine;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderProcessor)
+};
+
 AudioEngine::AudioEngine()
-    : running(false)
+    : renderer(nullptr)
+    , running(false)
     , currentSampleRate(0.0)
     , currentBufferSize(0)
 {
     audioDeviceManager = std::make_unique<juce::AudioDeviceManager>();
     processorGraph = std::make_unique<juce::AudioProcessorGraph>();
     audioProcessorPlayer = std::make_unique<juce::AudioProcessorPlayer>();
+    workerPool = std::make_unique<AudioWorkerPool>();
 }
 
 AudioEngine::~AudioEngine()
@@ -24,6 +77,7 @@ AudioEngine::~AudioEngine()
     stop();
     audioProcessorPlayer.reset();
     processorGraph.reset();
+    workerPool.reset();
     audioDeviceManager.reset();
 }
 
@@ -44,6 +98,24 @@ bool AudioEngine::initialize(double sampleRate, int bufferSize)
         return false;
     }
     
+    // Play the renderer to the device output, feeding it any MIDI the player receives
+    if (renderNode == nullptr)
+    {
+        using IOProcessor = juce::AudioProcessorGraph::AudioGraphIOProcessor;
+        
+        auto midiInputNode = processorGraph->addNode(std::make_unique<IOProcessor>(IOProcessor::midiInputNode));
+        auto audioOutputNode = processorGraph->addNode(std::make_unique<IOProcessor>(IOProcessor::audioOutputNode));
+        renderNode = processorGraph->addNode(std::make_unique<RenderProcessor>(*this));
+        
+        processorGraph->addConnection({ { midiInputNode->nodeID, juce::AudioProcessorGraph::midiChannelIndex },
+                                        { renderNode->nodeID, juce::AudioProcessorGraph::midiChannelIndex } });
+        
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            processorGraph->addConnection({ { renderNode->nodeID, channel }, { audioOutputNode->nodeID, channel } });
+        }
+    }
+    
     // Set up the processor graph with the correct sample rate and block size
     processorGraph->setPlayConfigDetails(2, 2, sampleRate, bufferSize);
     processorGraph->prepareToPlay(sampleRate, bufferSize);
@@ -80,6 +152,13 @@ void AudioEngine::stop()
     }
 }
 
+void AudioEngine::setRenderer(Renderer* newRenderer)
+{
+    // The player prepares the graph, and with it the renderer, when the engine starts
+    jassert(!running);
+    renderer.store(newRenderer, std::memory_order_release);
+}
+
 bool AudioEngine::isRunning() const
 {
     return running;
@@ -100,4 +179,9 @@ juce::AudioProcessorGraph& AudioEngine::getProcessorGraph()
     return *processorGraph;
 }
 
+AudioWorkerPool& AudioEngine::getWorkerPool()
+{
+    return *workerPool;
+}
+
 } // namespace UndergroundBeats
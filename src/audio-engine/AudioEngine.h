@@ -8,6 +8,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "AudioWorkerPool.h"
+#include <atomic>
 
 namespace UndergroundBeats {
 
@@ -21,6 +23,37 @@ namespace UndergroundBeats {
  */
 class AudioEngine {
 public:
+    /**
+     * @class Renderer
+     * @brief Produces the audio the engine plays
+     * 
+     * The engine's processor graph has a node that calls the renderer and
+     * sends its output to the audio device.
+     */
+    class Renderer {
+    public:
+        virtual ~Renderer() = default;
+        
+        /**
+         * @brief Prepare to render at the device's settings
+         * 
+         * Called when the engine starts and whenever the device settings change,
+         * never while render() is running.
+         * 
+         * @param sampleRate The sample rate in Hz
+         * @param blockSize The largest block size expected
+         */
+        virtual void prepareToRender(double sampleRate, int blockSize) = 0;
+        
+        /**
+         * @brief Render one block (audio thread)
+         * 
+         * @param buffer Stereo buffer to write the output to, cleared beforehand
+         * @param midiMessages MIDI received for the block
+         */
+        virtual void render(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) = 0;
+    };
+    
     AudioEngine();
     ~AudioEngine();
     
@@ -45,6 +78,16 @@ public:
      */
     void stop();
     
+    /**
+     * @brief Set what the engine plays
+     * 
+     * Call while the engine is stopped; the renderer is prepared when the
+     * engine starts, and must stay alive until the engine is stopped again.
+     * 
+     * @param newRenderer The renderer, or nullptr to play silence
+     */
+    void setRenderer(Renderer* newRenderer);
+    
     /**
      * @brief Check if the audio engine is currently running
      * 
@@ -73,10 +116,26 @@ public:
      */
     juce::AudioProcessorGraph& getProcessorGraph();
     
+    /**
+     * @brief Get access to the worker thread pool
+     * 
+     * Processors can use the pool to split heavy audio-thread work across cores.
+     * 
+     * @return Reference to the worker pool
+     */
+    AudioWorkerPool& getWorkerPool();
+    
 private:
+    // Graph node that plays the renderer
+    class RenderProcessor;
+    
     std::unique_ptr<juce::AudioDeviceManager> audioDeviceManager;
     std::unique_ptr<juce::AudioProcessorGraph> processorGraph;
     std::unique_ptr<juce::AudioProcessorPlayer> audioProcessorPlayer;
+    std::unique_ptr<AudioWorkerPool> workerPool;
+    
+    std::atomic<Renderer*> renderer;
+    juce::AudioProcessorGraph::Node::Ptr renderNode;
     
     bool running;
     double currentSampleRate;
@@ -0,0 +1,132 @@
+/*
+ * Underground Beats
+ * AudioWorkerPool.cpp
+ * 
+ * Implementation of the audio worker thread pool
+ */
+
+#include "AudioWorkerPool.h"
+#include <thread>
+
+namespace UndergroundBeats {
+
+//==============================================================================
+// Worker thread
+//==============================================================================
+
+class AudioWorkerPool::Worker : public juce::Thread {
+public:
+    Worker(AudioWorkerPool& ownerPool, int index)
+        : juce::Thread("Audio Worker " + juce::String(index))
+        , owner(ownerPool)
+    {
+    }
+    
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            // Sleep until the pool hands out a batch (or asks us to exit)
+            wait(-1);
+            
+            if (threadShouldExit())
+                break;
+            
+            owner.runTasks();
+            
+            // Tell the caller this worker no longer touches the batch
+            owner.busyWorkers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+    
+private:
+    AudioWorkerPool& owner;
+};
+
+//==============================================================================
+// AudioWorkerPool Implementation
+//==============================================================================
+
+AudioWorkerPool::AudioWorkerPool(int numWorkers)
+    : taskFunction(nullptr)
+    , taskContext(nullptr)
+    , numTasksInBatch(0)
+    , nextTask(0)
+    , busyWorkers(0)
+{
+    if (numWorkers < 0)
+    {
+        numWorkers = juce::jmax(0, juce::SystemStats::getNumCpus() - 1);
+    }
+    
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+        workers.back()->startThread(juce::Thread::Priority::highest);
+    }
+}
+
+AudioWorkerPool::~AudioWorkerPool()
+{
+    for (auto& worker : workers)
+    {
+        worker->signalThreadShouldExit();
+        worker->notify();
+    }
+    
+    for (auto& worker : workers)
+    {
+        worker->stopThread(1000);
+    }
+}
+
+int AudioWorkerPool::getNumWorkers() const
+{
+    return static_cast<int>(workers.size());
+}
+
+void AudioWorkerPool::run(int numTasks, TaskFunction function, void* context)
+{
+    if (numTasks <= 0 || function == nullptr)
+    {
+        return;
+    }
+    
+    taskFunction = function;
+    taskContext = context;
+    numTasksInBatch = numTasks;
+    nextTask.store(0, std::memory_order_relaxed);
+    
+    // Wake only as many workers as there are tasks beyond our own
+    const int numHelpers = juce::jmin(getNumWorkers(), numTasks - 1);
+    busyWorkers.store(numHelpers, std::memory_order_release);
+    
+    for (int i = 0; i < numHelpers; ++i)
+    {
+        workers[static_cast<size_t>(i)]->notify();
+    }
+    
+    // The calling thread works too
+    runTasks();
+    
+    // The batch state must stay valid until every woken worker has let go of it
+    while (busyWorkers.load(std::memory_order_acquire) > 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void AudioWorkerPool::runTasks()
+{
+    for (;;)
+    {
+        const int taskIndex = nextTask.fetch_add(1, std::memory_order_acq_rel);
+        
+        if (taskIndex >= numTasksInBatch)
+            break;
+        
+        taskFunction(taskContext, taskIndex);
+    }
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,81 @@
+/*
+ * Underground Beats
+ * AudioWorkerPool.h
+ * 
+ * Pool of worker threads for splitting audio-thread work into parallel tasks
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class AudioWorkerPool
+ * @brief Fixed set of high-priority threads that help the audio thread
+ * 
+ * The AudioWorkerPool runs a batch of independent tasks in parallel and returns
+ * once all of them have finished. The calling thread (normally the audio thread)
+ * takes part in the work, so a batch of N tasks only needs N - 1 workers.
+ * Tasks are passed as a plain function pointer and context, and no memory is
+ * allocated while dispatching.
+ */
+class AudioWorkerPool {
+public:
+    /**
+     * @brief Function type for a parallel task
+     * 
+     * @param context Caller-supplied context pointer
+     * @param taskIndex Index of the task to run (0 to numTasks - 1)
+     */
+    using TaskFunction = void (*)(void* context, int taskIndex);
+    
+    /**
+     * @brief Create the pool
+     * 
+     * @param numWorkers Number of worker threads, or -1 to use one fewer than the number of CPU cores
+     */
+    AudioWorkerPool(int numWorkers = -1);
+    ~AudioWorkerPool();
+    
+    /**
+     * @brief Get the number of worker threads
+     * 
+     * @return The number of worker threads (not counting the calling thread)
+     */
+    int getNumWorkers() const;
+    
+    /**
+     * @brief Run tasks in parallel and wait for all of them to finish
+     * 
+     * Only one batch may run at a time.
+     * 
+     * @param numTasks Number of tasks to run
+     * @param function Function called once per task index
+     * @param context Context pointer passed to the function
+     */
+    void run(int numTasks, TaskFunction function, void* context);
+    
+private:
+    class Worker;
+    
+    std::vector<std::unique_ptr<Worker>> workers;
+    
+    // Current batch
+    TaskFunction taskFunction;
+    void* taskContext;
+    int numTasksInBatch;
+    std::atomic<int> nextTask;
+    std::atomic<int> busyWorkers;
+    
+    // Claim and run tasks from the current batch until none are left
+    void runTasks();
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioWorkerPool)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,96 @@
+/*
+ * Underground Beats
+ * DeferredRelease.cpp
+ * 
+ * Implementation of deferred release of replaced objects
+ */
+
+#include "DeferredRelease.h"
+#include <algorithm>
+#include <iterator>
+
+namespace UndergroundBeats {
+
+DeferredRelease::DeferredRelease()
+    : publishedVersion(0)
+    , acknowledgedVersion(0)
+{
+    ReclaimThread::getInstance().addClient(this);
+}
+
+DeferredRelease::~DeferredRelease()
+{
+    ReclaimThread::getInstance().removeClient(this);
+}
+
+void DeferredRelease::retire(std::shared_ptr<const void> object)
+{
+    if (object == nullptr)
+        return;
+    
+    const juce::ScopedLock sl(lock);
+    retired.push_back({ publishedVersion.load(std::memory_order_relaxed) + 1, std::move(object) });
+}
+
+void DeferredRelease::publish()
+{
+    publishedVersion.fetch_add(1, std::memory_order_release);
+}
+
+juce::uint32 DeferredRelease::getPublishedVersion() const
+{
+    return publishedVersion.load(std::memory_order_acquire);
+}
+
+void DeferredRelease::acknowledge()
+{
+    acknowledge(publishedVersion.load(std::memory_order_acquire));
+}
+
+void DeferredRelease::acknowledge(juce::uint32 version)
+{
+    acknowledgedVersion.store(version, std::memory_order_release);
+}
+
+bool DeferredRelease::serve()
+{
+    std::vector<Retired> released;
+    
+    {
+        const juce::ScopedLock sl(lock);
+        
+        const juce::uint32 acknowledged = acknowledgedVersion.load(std::memory_order_acquire);
+        
+        // Anything retired at a version the audio thread has acknowledged is no longer in use
+        auto firstInUse = std::partition(retired.begin(), retired.end(),
+                                         [acknowledged](const Retired& entry)
+                                         {
+                                             return static_cast<juce::int32>(acknowledged - entry.version) >= 0;
+                                         });
+        
+        if (firstInUse == retired.begin())
+            return false;
+        
+        std::move(retired.begin(), firstInUse, std::back_inserter(released));
+        retired.erase(retired.begin(), firstInUse);
+    }
+    
+    // Destroy outside the lock, so publishing never waits on it
+    released.clear();
+    
+    return false;
+}
+
+//==============================================================================
+ReclaimThread::ReclaimThread()
+    : ServiceThread("Reclaim", juce::Thread::Priority::low, pollIntervalMs)
+{
+}
+
+ReclaimThread& ReclaimThread::getInstance()
+{
+    static ReclaimThread instance;
+    return instance;
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,123 @@
+/*
+ * Underground Beats
+ * DeferredRelease.h
+ * 
+ * Holds objects replaced under the audio thread until it has moved past them
+ */
+
+#pragma once
+
+#include "ServiceThread.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class DeferredRelease
+ * @brief Releases replaced objects once the audio thread can no longer be using them
+ * 
+ * Objects the audio thread reads through an atomic pointer are replaced by
+ * storing the new pointer, retiring the old owner with retire(), and then
+ * calling publish(). The audio thread calls acknowledge() at the start of each
+ * block, before loading any of the pointers, which tells the releaser that
+ * nothing retired before the latest publish is still in use.
+ * 
+ * Acknowledged objects are destroyed by the ReclaimThread, so neither the
+ * audio thread nor the thread publishing pays for it, and nothing waits for
+ * the next publish to be freed. Anything still retired when the releaser is
+ * destroyed is destroyed with it.
+ */
+class DeferredRelease : private ServiceThread::Client {
+public:
+    DeferredRelease();
+    ~DeferredRelease() override;
+    
+    /**
+     * @brief Hold an object until the audio thread acknowledges the next publish
+     * 
+     * @param object The owner of the replaced object; nullptr is ignored
+     */
+    void retire(std::shared_ptr<const void> object);
+    
+    /**
+     * @brief Make the objects retired so far releasable once acknowledged
+     * 
+     * Call after storing the new pointers. Calls to retire() and publish()
+     * must not run concurrently with each other.
+     */
+    void publish();
+    
+    /**
+     * @brief Get the number of publishes so far
+     * 
+     * @return The latest published version
+     */
+    juce::uint32 getPublishedVersion() const;
+    
+    /**
+     * @brief Mark the start of an audio block (audio thread)
+     * 
+     * Tells the releaser that no object retired before the latest publish is
+     * still in use. Call before loading the published pointers.
+     */
+    void acknowledge();
+    
+    /**
+     * @brief Acknowledge a version read earlier (audio thread)
+     * 
+     * For when the audio thread has to let go of retired objects first: read
+     * getPublishedVersion(), stop using everything retired up to that
+     * version, then acknowledge it.
+     * 
+     * @param version The version the audio thread has moved past
+     */
+    void acknowledge(juce::uint32 version);
+    
+private:
+    // An object the audio thread may still be using, and the version after which it is not
+    struct Retired {
+        juce::uint32 version;
+        std::shared_ptr<const void> object;
+    };
+    
+    std::vector<Retired> retired;
+    std::atomic<juce::uint32> publishedVersion;
+    std::atomic<juce::uint32> acknowledgedVersion;
+    
+    // Guards the retired objects against the reclaim thread
+    juce::CriticalSection lock;
+    
+    // Destroy what the audio thread has acknowledged (reclaim thread)
+    bool serve() override;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeferredRelease)
+};
+
+/**
+ * @class ReclaimThread
+ * @brief Low-priority thread that destroys what the audio thread has moved past
+ * 
+ * Serves every DeferredRelease, and other clean-up that must wait for the
+ * audio thread, such as ending an EffectsChain's finished crossfades.
+ */
+class ReclaimThread : public ServiceThread {
+public:
+    ReclaimThread();
+    
+    /**
+     * @brief Get the application-wide reclaim thread
+     * 
+     * @return The shared instance
+     */
+    static ReclaimThread& getInstance();
+    
+private:
+    // Interval at which the thread checks for acknowledged objects
+    static constexpr int pollIntervalMs = 50;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReclaimThread)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,65 @@
+/*
+ * Underground Beats
+ * ServiceThread.cpp
+ * 
+ * Implementation of the background service thread
+ */
+
+#include "ServiceThread.h"
+#include <algorithm>
+
+namespace UndergroundBeats {
+
+ServiceThread::ServiceThread(const juce::String& threadName, juce::Thread::Priority priority, int interval)
+    : juce::Thread(threadName)
+    , threadPriority(priority)
+    , pollIntervalMs(interval)
+{
+}
+
+ServiceThread::~ServiceThread()
+{
+    stopThread(2000);
+}
+
+void ServiceThread::addClient(Client* client)
+{
+    {
+        const juce::ScopedLock sl(clientLock);
+        clients.push_back(client);
+    }
+    
+    if (!isThreadRunning())
+        startThread(threadPriority);
+}
+
+void ServiceThread::removeClient(Client* client)
+{
+    // The thread holds the lock while it serves, so this waits for it to let go of the client
+    const juce::ScopedLock sl(clientLock);
+    clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+}
+
+void ServiceThread::run()
+{
+    while (!threadShouldExit())
+    {
+        bool servedAnything = false;
+        
+        {
+            const juce::ScopedLock sl(clientLock);
+            
+            // By index, as serving one client may destroy another, which removes it from the list
+            for (size_t index = 0; index < clients.size(); ++index)
+            {
+                servedAnything = clients[index]->serve() || servedAnything;
+            }
+        }
+        
+        // Keep going while there is work, otherwise sleep until woken or polled
+        if (!servedAnything)
+            wait(pollIntervalMs);
+    }
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,81 @@
+/*
+ * Underground Beats
+ * ServiceThread.h
+ * 
+ * Background thread that serves registered clients for the audio thread
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class ServiceThread
+ * @brief Background thread that does work handed off by the audio thread
+ * 
+ * Clients register themselves when created and unregister when destroyed.
+ * The thread serves every client in turn, keeps going while any of them had
+ * work, and otherwise sleeps until woken with notify() or until the poll
+ * interval has passed. Each kind of work has one application-wide instance,
+ * such as the ConvolutionTailThread and the ReclaimThread.
+ */
+class ServiceThread : public juce::Thread {
+public:
+    /**
+     * @class Client
+     * @brief Something the thread serves
+     */
+    class Client {
+    public:
+        virtual ~Client() = default;
+        
+        /**
+         * @brief Do any work that is ready (service thread)
+         * 
+         * @return true if work was done and more may be ready at once
+         */
+        virtual bool serve() = 0;
+    };
+    
+    /**
+     * @brief Create the thread, which starts when the first client is added
+     * 
+     * @param threadName Name of the thread
+     * @param priority Priority to start the thread with
+     * @param pollIntervalMs Interval at which idle clients are checked without being woken
+     */
+    ServiceThread(const juce::String& threadName, juce::Thread::Priority priority, int pollIntervalMs);
+    ~ServiceThread() override;
+    
+    /**
+     * @brief Start serving a client, starting the thread if needed
+     * 
+     * @param client The client to serve
+     */
+    void addClient(Client* client);
+    
+    /**
+     * @brief Stop serving a client
+     * 
+     * Waits for the thread to finish any work it is doing for the client.
+     * Clients may be removed from within another client's serve().
+     * 
+     * @param client The client to remove
+     */
+    void removeClient(Client* client);
+    
+    void run() override;
+    
+private:
+    std::vector<Client*> clients;
+    juce::CriticalSection clientLock;
+    juce::Thread::Priority threadPriority;
+    int pollIntervalMs;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ServiceThread)
+};
+
+} // namespace UndergroundBeats
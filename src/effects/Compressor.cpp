@@ -0,0 +1,524 @@
+/*
+ * Underground Beats
+ * Compressor.cpp
+ * 
+ * Implementation of the lookahead compressor and limiter
+ */
+
+#include "Compressor.h"
+#include "RingBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Decibels in one doubling of level, for converting to the log2 domain
+constexpr float decibelsPerOctave = 6.0206f;
+
+// Headroom the limiter keeps below its ceiling to cover the error of the approximations
+constexpr float limiterMarginDb = 0.05f;
+
+// Largest gain reduction, which keeps the gain within range of fastExp2()
+constexpr float maxReductionDb = 120.0f;
+
+// Release time constants after which the gain counts as recovered
+constexpr double releaseTimeConstants = 5.0;
+
+// Log2 from the float's exponent and a quadratic fit to its mantissa (error under 0.005)
+inline float fastLog2(float value)
+{
+    juce::int32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    
+    const float exponent = static_cast<float>(((bits >> 23) & 0xff) - 128);
+    const juce::int32 mantissaBits = (bits & 0x007fffff) | 0x3f800000;
+    float mantissa;
+    std::memcpy(&mantissa, &mantissaBits, sizeof(mantissa));
+    
+    return exponent + (-0.34484843f * mantissa + 2.02466578f) * mantissa - 0.67487759f;
+}
+
+// Exp2 from a power of two built in the exponent bits and a cubic fit to the fraction (error under 0.02%)
+inline float fastExp2(float value)
+{
+    // Biased by the exponent offset, so for values above -127 truncating rounds down without calling floor()
+    const float biased = value + 127.0f;
+    const juce::int32 whole = static_cast<juce::int32>(biased);
+    const float fraction = biased - static_cast<float>(whole);
+    const juce::int32 bits = whole << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    
+    return scale * (1.0f + fraction * (0.69606564f + fraction * (0.22449434f + fraction * 0.07944024f)));
+}
+
+} // namespace
+
+Compressor::Compressor()
+    : Effect("Compressor")
+    , mode(CompressorMode::Compressor)
+    , threshold(-18.0f)
+    , ratio(4.0f)
+    , knee(6.0f)
+    , attack(10.0f)
+    , release(100.0f)
+    , makeupGain(0.0f)
+    , lookahead(5.0f)
+    , stereoLink(true)
+    , lookaheadSamples(0)
+    , dequeMask(0)
+    , averagePosition(0)
+    , sampleTime(0)
+    , delayMask(0)
+    , writePosition(0)
+    , sidechainChannels(0)
+    , sidechainSamples(0)
+    , sidechainPosition(0)
+    , gainReduction(0.0f)
+{
+    // Detector and delay buffers are allocated in prepare()
+}
+
+Compressor::~Compressor()
+{
+}
+
+void Compressor::setMode(CompressorMode mode)
+{
+    this->mode = mode;
+}
+
+CompressorMode Compressor::getMode() const
+{
+    return mode;
+}
+
+void Compressor::setThreshold(float thresholdDb)
+{
+    threshold = juce::jlimit(-60.0f, 0.0f, thresholdDb);
+}
+
+float Compressor::getThreshold() const
+{
+    return threshold;
+}
+
+void Compressor::setRatio(float ratio)
+{
+    this->ratio = juce::jlimit(1.0f, 20.0f, ratio);
+}
+
+float Compressor::getRatio() const
+{
+    return ratio;
+}
+
+void Compressor::setKnee(float kneeDb)
+{
+    knee = juce::jlimit(0.0f, 24.0f, kneeDb);
+}
+
+float Compressor::getKnee() const
+{
+    return knee;
+}
+
+void Compressor::setAttack(float attackMs)
+{
+    attack = juce::jlimit(0.1f, 500.0f, attackMs);
+}
+
+float Compressor::getAttack() const
+{
+    return attack;
+}
+
+void Compressor::setRelease(float releaseMs)
+{
+    release = juce::jlimit(1.0f, 5000.0f, releaseMs);
+}
+
+float Compressor::getRelease() const
+{
+    return release;
+}
+
+void Compressor::setMakeupGain(float gainDb)
+{
+    makeupGain = juce::jlimit(0.0f, 24.0f, gainDb);
+}
+
+float Compressor::getMakeupGain() const
+{
+    return makeupGain;
+}
+
+void Compressor::setLookahead(float lookaheadMs)
+{
+    lookahead = juce::jlimit(0.0f, maxLookaheadMs, lookaheadMs);
+}
+
+float Compressor::getLookahead() const
+{
+    return lookahead;
+}
+
+void Compressor::setStereoLink(bool linked)
+{
+    stereoLink = linked;
+}
+
+bool Compressor::getStereoLink() const
+{
+    return stereoLink;
+}
+
+void Compressor::setSidechain(const juce::dsp::AudioBlock<const float>& sidechain)
+{
+    sidechainChannels = juce::jmin(static_cast<int>(sidechain.getNumChannels()), sidechainBuffer.getNumChannels());
+    sidechainSamples = juce::jmin(static_cast<int>(sidechain.getNumSamples()), sidechainBuffer.getNumSamples());
+    sidechainPosition = 0;
+    
+    for (int channel = 0; channel < sidechainChannels; ++channel)
+    {
+        juce::FloatVectorOperations::copy(sidechainBuffer.getWritePointer(channel),
+                                          sidechain.getChannelPointer(static_cast<size_t>(channel)), sidechainSamples);
+    }
+    
+    if (sidechainChannels == 0)
+    {
+        sidechainSamples = 0;
+    }
+}
+
+float Compressor::getGainReduction() const
+{
+    return gainReduction.load(std::memory_order_relaxed);
+}
+
+int Compressor::getLatencySamples() const
+{
+    return lookaheadSamples;
+}
+
+void Compressor::prepare(double sampleRate, int blockSize)
+{
+    // Size the buffers first, as the base class resets the effect
+    lookaheadSamples = juce::roundToInt(lookahead * sampleRate / 1000.0);
+    const int window = lookaheadSamples + 1;
+    const int dequeLength = juce::nextPowerOfTwo(window);
+    dequeMask = dequeLength - 1;
+    
+    // A detector per channel, so stereo link can change at any time
+    detectors.resize(static_cast<size_t>(maxChannels));
+    
+    for (auto& detector : detectors)
+    {
+        detector.peakValues.assign(static_cast<size_t>(dequeLength), 0.0f);
+        detector.peakTimes.assign(static_cast<size_t>(dequeLength), 0);
+        detector.averageHistory.assign(static_cast<size_t>(window), 0.0f);
+    }
+    
+    // Long enough to write a whole block before reading its delayed copy
+    const int delayLength = juce::nextPowerOfTwo(lookaheadSamples + juce::jmax(1, blockSize));
+    delayBuffer.setSize(maxChannels, delayLength, false, true, true);
+    delayMask = delayLength - 1;
+    
+    gainBuffer.setSize(maxChannels, juce::jmax(1, blockSize), false, true, true);
+    sourceChannels.assign(static_cast<size_t>(maxChannels), nullptr);
+    sidechainBuffer.setSize(maxChannels, juce::jmax(1, blockSize), false, true, true);
+    sidechainChannels = 0;
+    sidechainSamples = 0;
+    
+    Effect::prepare(sampleRate, blockSize);
+}
+
+void Compressor::reset()
+{
+    Effect::reset();
+    
+    for (auto& detector : detectors)
+    {
+        detector.front = 0;
+        detector.size = 0;
+        std::fill(detector.averageHistory.begin(), detector.averageHistory.end(), 0.0f);
+        detector.averageSum = 0.0;
+        detector.reduction = 0.0f;
+    }
+    
+    delayBuffer.clear();
+    averagePosition = 0;
+    sampleTime = 0;
+    writePosition = 0;
+    gainReduction.store(0.0f, std::memory_order_relaxed);
+}
+
+double Compressor::getTailLengthSeconds() const
+{
+    // The output is silent once the delay has emptied, but sleeping early would freeze the gain part way through its release
+    return lookaheadSamples / currentSampleRate + releaseTimeConstants * release / 1000.0;
+}
+
+std::unique_ptr<juce::XmlElement> Compressor::createStateXml() const
+{
+    auto xml = Effect::createStateXml();
+    
+    // Add compressor-specific attributes
+    xml->setAttribute("mode", static_cast<int>(mode));
+    xml->setAttribute("threshold", threshold);
+    xml->setAttribute("ratio", ratio);
+    xml->setAttribute("knee", knee);
+    xml->setAttribute("attack", attack);
+    xml->setAttribute("release", release);
+    xml->setAttribute("makeupGain", makeupGain);
+    xml->setAttribute("lookahead", lookahead);
+    xml->setAttribute("stereoLink", stereoLink);
+    
+    return xml;
+}
+
+bool Compressor::restoreStateFromXml(const juce::XmlElement* xml)
+{
+    if (!Effect::restoreStateFromXml(xml))
+    {
+        return false;
+    }
+    
+    // Restore compressor-specific attributes
+    if (xml->hasAttribute("mode"))
+    {
+        setMode(static_cast<CompressorMode>(xml->getIntAttribute("mode", 0)));
+    }
+    
+    if (xml->hasAttribute("threshold"))
+    {
+        setThreshold(xml->getDoubleAttribute("threshold", -18.0f));
+    }
+    
+    if (xml->hasAttribute("ratio"))
+    {
+        setRatio(xml->getDoubleAttribute("ratio", 4.0f));
+    }
+    
+    if (xml->hasAttribute("knee"))
+    {
+        setKnee(xml->getDoubleAttribute("knee", 6.0f));
+    }
+    
+    if (xml->hasAttribute("attack"))
+    {
+        setAttack(xml->getDoubleAttribute("attack", 10.0f));
+    }
+    
+    if (xml->hasAttribute("release"))
+    {
+        setRelease(xml->getDoubleAttribute("release", 100.0f));
+    }
+    
+    if (xml->hasAttribute("makeupGain"))
+    {
+        setMakeupGain(xml->getDoubleAttribute("makeupGain", 0.0f));
+    }
+    
+    if (xml->hasAttribute("lookahead"))
+    {
+        setLookahead(xml->getDoubleAttribute("lookahead", 5.0f));
+    }
+    
+    if (xml->hasAttribute("stereoLink"))
+    {
+        setStereoLink(xml->getBoolAttribute("stereoLink", true));
+    }
+    
+    return true;
+}
+
+void Compressor::processBlock(const juce::dsp::AudioBlock<float>& block)
+{
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    
+    // Detect from the sidechain if it covers this block, otherwise from the input
+    int numSourceChannels = numChannels;
+    
+    if (sidechainSamples - sidechainPosition >= numSamples)
+    {
+        numSourceChannels = sidechainChannels;
+        
+        for (int channel = 0; channel < numSourceChannels; ++channel)
+        {
+            sourceChannels[channel] = sidechainBuffer.getReadPointer(channel, sidechainPosition);
+        }
+        
+        sidechainPosition += numSamples;
+    }
+    else
+    {
+        sidechainSamples = 0;
+        
+        for (int channel = 0; channel < numSourceChannels; ++channel)
+        {
+            sourceChannels[channel] = block.getChannelPointer(static_cast<size_t>(channel));
+        }
+    }
+    
+    // Find each gain: one from every source channel when linked, otherwise one per channel
+    const int numGains = stereoLink ? 1 : numChannels;
+    float maxReduction = 0.0f;
+    
+    for (int gain = 0; gain < numGains; ++gain)
+    {
+        Detector& detector = detectors[static_cast<size_t>(gain)];
+        float* gains = gainBuffer.getWritePointer(gain);
+        
+        if (stereoLink)
+        {
+            detectPeaks(detector, gains, sourceChannels.data(), numSourceChannels, numSamples);
+        }
+        else
+        {
+            detectPeaks(detector, gains, sourceChannels.data() + juce::jmin(gain, numSourceChannels - 1), 1, numSamples);
+        }
+        
+        maxReduction = juce::jmax(maxReduction, computeGain(detector, gains, numSamples));
+    }
+    
+    sampleTime += numSamples;
+    averagePosition = static_cast<int>(sampleTime % (lookaheadSamples + 1));
+    gainReduction.store(maxReduction * decibelsPerOctave, std::memory_order_relaxed);
+    
+    // Delay the input by the lookahead and apply the gain
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* data = block.getChannelPointer(static_cast<size_t>(channel));
+        float* line = delayBuffer.getWritePointer(channel);
+        
+        writeWrapped(line, delayMask, writePosition, data, numSamples);
+        readWrapped(line, delayMask, (writePosition - lookaheadSamples) & delayMask, data, numSamples);
+        juce::FloatVectorOperations::multiply(data, gainBuffer.getReadPointer(stereoLink ? 0 : channel), numSamples);
+    }
+    
+    writePosition = (writePosition + numSamples) & delayMask;
+}
+
+void Compressor::detectPeaks(Detector& detector, float* peaks, const float* const* channels, int numChannels,
+                             int numSamples)
+{
+    // Rectify and take the loudest channel, as plain loops the compiler vectorizes
+    juce::FloatVectorOperations::abs(peaks, channels[0], numSamples);
+    
+    for (int channel = 1; channel < numChannels; ++channel)
+    {
+        const float* source = channels[channel];
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            peaks[i] = juce::jmax(peaks[i], std::abs(source[i]));
+        }
+    }
+    
+    // Hold the largest peak of the window: the deque keeps only peaks no later peak is louder than
+    const juce::int64 window = lookaheadSamples + 1;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const juce::int64 time = sampleTime + i;
+        const float peak = peaks[i];
+        
+        // Drop peaks that have left the window, before the new one can overfill the deque
+        while (detector.size > 0 && detector.peakTimes[static_cast<size_t>(detector.front)] <= time - window)
+        {
+            detector.front = (detector.front + 1) & dequeMask;
+            --detector.size;
+        }
+        
+        while (detector.size > 0 && detector.peakValues[static_cast<size_t>((detector.front + detector.size - 1) & dequeMask)] <= peak)
+        {
+            --detector.size;
+        }
+        
+        const size_t back = static_cast<size_t>((detector.front + detector.size) & dequeMask);
+        detector.peakValues[back] = peak;
+        detector.peakTimes[back] = time;
+        ++detector.size;
+        
+        peaks[i] = detector.peakValues[static_cast<size_t>(detector.front)];
+    }
+}
+
+float Compressor::computeGain(Detector& detector, float* gains, int numSamples)
+{
+    const bool limiter = mode == CompressorMode::Limiter;
+    
+    // Gain computer in log2 units: no reduction below the knee, a quadratic curve across it, then the ratio's slope
+    // The limiter's makeup gain drives the input into the ceiling rather than raising the ceiling
+    const float makeupLog = makeupGain / decibelsPerOctave;
+    const float thresholdLog = limiter ? (threshold - limiterMarginDb) / decibelsPerOctave - makeupLog
+                                       : threshold / decibelsPerOctave;
+    const float slope = limiter ? 1.0f : 1.0f - 1.0f / ratio;
+    const float halfKnee = limiter ? 0.0f : 0.5f * knee / decibelsPerOctave;
+    const float kneeScale = halfKnee > 0.0f ? slope / (4.0f * halfKnee) : 0.0f;
+    const float maxReductionLog = maxReductionDb / decibelsPerOctave;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Written with min and max rather than branches, so the compiler vectorizes the loop
+        const float over = fastLog2(gains[i]) - thresholdLog;
+        const float intoKnee = std::max(-halfKnee, std::min(over, halfKnee)) + halfKnee;
+        const float reduction = kneeScale * intoKnee * intoKnee + slope * std::max(0.0f, over - halfKnee);
+        gains[i] = std::min(maxReductionLog, reduction);
+    }
+    
+    // Smooth the reduction: a one-pole attack and release, or for the limiter a moving average over the lookahead
+    const double samplesPerMs = currentSampleRate / 1000.0;
+    const float attackCoefficient = static_cast<float>(std::exp(-1.0 / (attack * samplesPerMs)));
+    const float releaseCoefficient = static_cast<float>(std::exp(-1.0 / (release * samplesPerMs)));
+    const int window = lookaheadSamples + 1;
+    float reduction = detector.reduction;
+    float maxReduction = 0.0f;
+    
+    if (limiter)
+    {
+        // Every held peak reaches the average before it leaves the delay, so the gain never falls too late
+        float* history = detector.averageHistory.data();
+        int position = averagePosition;
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            detector.averageSum += gains[i] - history[position];
+            history[position] = gains[i];
+            position = position + 1 < window ? position + 1 : 0;
+            
+            const float target = juce::jmax(0.0f, static_cast<float>(detector.averageSum / window));
+            reduction = target >= reduction ? target : target + releaseCoefficient * (reduction - target);
+            maxReduction = juce::jmax(maxReduction, reduction);
+            gains[i] = reduction;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float target = gains[i];
+            const float coefficient = target > reduction ? attackCoefficient : releaseCoefficient;
+            reduction = target + coefficient * (reduction - target);
+            maxReduction = juce::jmax(maxReduction, reduction);
+            gains[i] = reduction;
+        }
+    }
+    
+    detector.reduction = reduction;
+    
+    // Back to a linear gain, with the makeup gain folded in
+    for (int i = 0; i < numSamples; ++i)
+    {
+        gains[i] = fastExp2(makeupLog - gains[i]);
+    }
+    
+    return maxReduction;
+}
+
+} // namespace UndergroundBeats
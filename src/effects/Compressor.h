@@ -0,0 +1,316 @@
+/*
+ * Underground Beats
+ * Compressor.h
+ * 
+ * Lookahead compressor and brickwall limiter
+ */
+
+#pragma once
+
+#include "Effect.h"
+#include <atomic>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of compressor modes
+ */
+enum class CompressorMode {
+    Compressor, // Ratio and knee above the threshold, with attack and release
+    Limiter     // Output never exceeds the threshold
+};
+
+/**
+ * @class Compressor
+ * @brief Lookahead compressor and brickwall limiter
+ * 
+ * The input is delayed by the lookahead time, so the gain can start falling
+ * before a peak arrives. The detector takes the peak of the input, or of a
+ * sidechain input, over a sliding window as long as the lookahead, kept in a
+ * monotonic deque so each sample costs constant time on average. The gain is
+ * computed and smoothed in the log2 domain with fast log2 and exp2
+ * approximations, and every stage except the deque and the smoothing runs as a
+ * plain loop over the block that the compiler vectorizes.
+ * 
+ * In limiter mode the held peak is also averaged over the lookahead window, so
+ * the gain has fully fallen by the time a peak leaves the delay and the output
+ * never exceeds the threshold.
+ * 
+ * With stereo link on, one gain from the loudest channel is applied to every
+ * channel, which keeps the stereo image steady. The lookahead delays the
+ * output, which getLatencySamples() reports for compensation.
+ */
+class Compressor : public Effect {
+public:
+    /** Longest lookahead time in milliseconds */
+    static constexpr float maxLookaheadMs = 20.0f;
+    
+    Compressor();
+    ~Compressor() override;
+    
+    /**
+     * @brief Set the compressor mode
+     * 
+     * @param mode The mode to use
+     */
+    void setMode(CompressorMode mode);
+    
+    /**
+     * @brief Get the current compressor mode
+     * 
+     * @return The current mode
+     */
+    CompressorMode getMode() const;
+    
+    /**
+     * @brief Set the threshold
+     * 
+     * In limiter mode this is the output ceiling.
+     * 
+     * @param thresholdDb Threshold in decibels (-60 to 0)
+     */
+    void setThreshold(float thresholdDb);
+    
+    /**
+     * @brief Get the current threshold
+     * 
+     * @return Threshold in decibels
+     */
+    float getThreshold() const;
+    
+    /**
+     * @brief Set the compression ratio (compressor mode)
+     * 
+     * @param ratio Ratio of input to output level above the threshold (1 to 20)
+     */
+    void setRatio(float ratio);
+    
+    /**
+     * @brief Get the current compression ratio
+     * 
+     * @return The current ratio
+     */
+    float getRatio() const;
+    
+    /**
+     * @brief Set the width of the soft knee (compressor mode)
+     * 
+     * @param kneeDb Knee width in decibels (0 for a hard knee, up to 24)
+     */
+    void setKnee(float kneeDb);
+    
+    /**
+     * @brief Get the current knee width
+     * 
+     * @return Knee width in decibels
+     */
+    float getKnee() const;
+    
+    /**
+     * @brief Set the attack time (compressor mode)
+     * 
+     * In limiter mode the gain falls across the lookahead time instead.
+     * 
+     * @param attackMs Attack time in milliseconds (0.1 to 500)
+     */
+    void setAttack(float attackMs);
+    
+    /**
+     * @brief Get the current attack time
+     * 
+     * @return Attack time in milliseconds
+     */
+    float getAttack() const;
+    
+    /**
+     * @brief Set the release time
+     * 
+     * @param releaseMs Release time in milliseconds (1 to 5000)
+     */
+    void setRelease(float releaseMs);
+    
+    /**
+     * @brief Get the current release time
+     * 
+     * @return Release time in milliseconds
+     */
+    float getRelease() const;
+    
+    /**
+     * @brief Set the makeup gain applied after compression
+     * 
+     * In limiter mode the gain drives the input into the ceiling, which the
+     * output still never exceeds.
+     * 
+     * @param gainDb Makeup gain in decibels (0 to 24)
+     */
+    void setMakeupGain(float gainDb);
+    
+    /**
+     * @brief Get the current makeup gain
+     * 
+     * @return Makeup gain in decibels
+     */
+    float getMakeupGain() const;
+    
+    /**
+     * @brief Set the lookahead time
+     * 
+     * Changes the latency, so it takes effect at the next call to prepare().
+     * 
+     * @param lookaheadMs Lookahead time in milliseconds (0 to maxLookaheadMs)
+     */
+    void setLookahead(float lookaheadMs);
+    
+    /**
+     * @brief Get the lookahead time
+     * 
+     * @return Lookahead time in milliseconds
+     */
+    float getLookahead() const;
+    
+    /**
+     * @brief Set whether the channels share one gain
+     * 
+     * @param linked true to apply the loudest channel's gain to every channel
+     */
+    void setStereoLink(bool linked);
+    
+    /**
+     * @brief Check whether the channels share one gain
+     * 
+     * @return true if stereo link is on
+     */
+    bool getStereoLink() const;
+    
+    /**
+     * @brief Set the sidechain input for the next call to process() (audio thread)
+     * 
+     * The detector listens to the sidechain instead of the input. Up to the
+     * prepared block size is copied, so the audio need not outlive the call; a
+     * part of the block the sidechain does not cover is detected from the
+     * input. Channels beyond those the sidechain has use its last channel.
+     * 
+     * @param sidechain The sidechain audio, as long as the block to process
+     */
+    void setSidechain(const juce::dsp::AudioBlock<const float>& sidechain);
+    
+    /**
+     * @brief Get the gain reduction of the last processed block
+     * 
+     * @return The largest gain reduction in decibels, as a positive number
+     */
+    float getGainReduction() const;
+    
+    /**
+     * @brief Get the delay the lookahead adds to the output
+     * 
+     * @return Latency in samples at the prepared sample rate
+     */
+    int getLatencySamples() const override;
+    
+    /**
+     * @brief Prepare the effect for processing
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param blockSize The maximum block size in samples
+     */
+    void prepare(double sampleRate, int blockSize) override;
+    
+    /**
+     * @brief Reset the effect state
+     */
+    void reset() override;
+    
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * @return The lookahead delay plus the time for the gain to recover
+     */
+    double getTailLengthSeconds() const override;
+    
+    /**
+     * @brief Create an XML element containing the effect's state
+     * 
+     * @return XML element containing effect state
+     */
+    std::unique_ptr<juce::XmlElement> createStateXml() const override;
+    
+    /**
+     * @brief Restore effect state from an XML element
+     * 
+     * @param xml XML element containing effect state
+     * @return true if state was successfully restored
+     */
+    bool restoreStateFromXml(const juce::XmlElement* xml) override;
+    
+protected:
+    /**
+     * @brief Process a block of audio
+     * 
+     * @param block The audio to process in place
+     */
+    void processBlock(const juce::dsp::AudioBlock<float>& block) override;
+    
+private:
+    // Detector state for one gain: the sliding peak and the smoothed reduction
+    struct Detector {
+        std::vector<float> peakValues;          // Monotonic deque of peaks, largest at the front
+        std::vector<juce::int64> peakTimes;     // Sample time of each peak in the deque
+        int front;
+        int size;
+        std::vector<float> averageHistory;      // Held reductions over the lookahead window, for the limiter's average
+        double averageSum;
+        float reduction;                        // Smoothed gain reduction in log2 units
+    };
+    
+    // Compressor parameters
+    CompressorMode mode;
+    float threshold;
+    float ratio;
+    float knee;
+    float attack;
+    float release;
+    float makeupGain;
+    float lookahead;
+    bool stereoLink;
+    
+    // Lookahead window in samples, fixed by prepare()
+    int lookaheadSamples;
+    
+    // One detector when linked, otherwise one per channel
+    std::vector<Detector> detectors;
+    int dequeMask;      // Wraps a deque index within its storage
+    int averagePosition; // Oldest entry of every detector's average history
+    juce::int64 sampleTime;
+    
+    // Delayed input, one power-of-two line per channel
+    juce::AudioBuffer<float> delayBuffer;
+    int delayMask;
+    int writePosition;
+    
+    // Detector signal, then gain, for each detector
+    juce::AudioBuffer<float> gainBuffer;
+    
+    // Channels the detectors listen to in the current block
+    std::vector<const float*> sourceChannels;
+    
+    // Sidechain for the next process() call, and how much of it has been used
+    juce::AudioBuffer<float> sidechainBuffer;
+    int sidechainChannels;
+    int sidechainSamples;
+    int sidechainPosition;
+    
+    std::atomic<float> gainReduction;
+    
+    // Fill a buffer with the peak of some source channels, then hold it over the lookahead window
+    void detectPeaks(Detector& detector, float* peaks, const float* const* channels, int numChannels, int numSamples);
+    
+    // Turn held peaks into a smoothed gain (in place) and return the largest reduction in log2 units
+    float computeGain(Detector& detector, float* gains, int numSamples);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Compressor)
+};
+
+} // namespace UndergroundBeats
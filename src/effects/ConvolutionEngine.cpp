@@ -0,0 +1,535 @@
+/*
+ * Underground Beats
+ * ConvolutionEngine.cpp
+ * 
+ * Implementation of partitioned FFT convolution
+ */
+
+#include "ConvolutionEngine.h"
+#include <algorithm>
+#include <cmath>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Number of partial sums in the direct-form dot product, so it vectorizes
+constexpr int laneWidth = 8;
+
+static_assert(ConvolutionImpulseResponse::directLength % laneWidth == 0, "Direct taps must fill whole lanes");
+
+// Order of the FFT used for partitions of a given size (transforms are twice the partition size)
+int getFFTOrder(int partitionSize)
+{
+    int order = 1;
+    
+    while ((1 << order) < 2 * partitionSize)
+        ++order;
+    
+    return order;
+}
+
+// Transform consecutive partitions of a response into split real and imaginary spectra
+void transformPartitions(const float* response, int length, int start, int partitionSize, int numPartitions, float* destination)
+{
+    const int numBins = partitionSize + 1;
+    juce::dsp::FFT fft(getFFTOrder(partitionSize));
+    std::vector<float> fftData(static_cast<size_t>(4 * partitionSize));
+    
+    for (int partition = 0; partition < numPartitions; ++partition)
+    {
+        // Partition taps, zero-padded to the transform size
+        const int first = start + partition * partitionSize;
+        const int numTaps = juce::jlimit(0, partitionSize, length - first);
+        
+        std::fill(fftData.begin(), fftData.end(), 0.0f);
+        juce::FloatVectorOperations::copy(fftData.data(), response + first, numTaps);
+        fft.performRealOnlyForwardTransform(fftData.data(), true);
+        
+        float* real = destination + static_cast<size_t>(partition) * static_cast<size_t>(2 * numBins);
+        float* imaginary = real + numBins;
+        
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            real[bin] = fftData[static_cast<size_t>(2 * bin)];
+            imaginary[bin] = fftData[static_cast<size_t>(2 * bin + 1)];
+        }
+    }
+}
+
+} // namespace
+
+//==============================================================================
+// ConvolutionImpulseResponse Implementation
+//==============================================================================
+
+ConvolutionImpulseResponse::ConvolutionImpulseResponse(const juce::AudioBuffer<float>& impulse, double impulseSampleRate, double sampleRate)
+    : numChannels(juce::jlimit(1, 2, impulse.getNumChannels()))
+    , length(1)
+    , sampleRate(sampleRate)
+    , numHeadPartitions(0)
+    , numTailPartitions(0)
+{
+    // Resample to the convolution rate, truncating very long responses
+    const double ratio = impulseSampleRate > 0.0 ? impulseSampleRate / sampleRate : 1.0;
+    const int sourceLength = impulse.getNumSamples();
+    const int maxLength = static_cast<int>(maxLengthSeconds * sampleRate);
+    
+    length = juce::jlimit(1, juce::jmax(1, maxLength), static_cast<int>(std::ceil(sourceLength / ratio)));
+    
+    juce::AudioBuffer<float> response(numChannels, length);
+    response.clear();
+    
+    for (int channel = 0; channel < juce::jmin(numChannels, impulse.getNumChannels()); ++channel)
+    {
+        if (ratio == 1.0)
+        {
+            response.copyFrom(channel, 0, impulse, channel, 0, juce::jmin(length, sourceLength));
+            continue;
+        }
+        
+        // Zero padding so the interpolator never reads past the end of the source
+        std::vector<float> padded(static_cast<size_t>(sourceLength + static_cast<int>(std::ceil(ratio)) + 8), 0.0f);
+        juce::FloatVectorOperations::copy(padded.data(), impulse.getReadPointer(channel), sourceLength);
+        
+        juce::LagrangeInterpolator interpolator;
+        interpolator.process(ratio, padded.data(), response.getWritePointer(channel), length);
+    }
+    
+    // Normalize so the loudest channel has unit energy
+    double maxEnergy = 0.0;
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const float* data = response.getReadPointer(channel);
+        double energy = 0.0;
+        
+        for (int i = 0; i < length; ++i)
+        {
+            energy += static_cast<double>(data[i]) * data[i];
+        }
+        
+        maxEnergy = juce::jmax(maxEnergy, energy);
+    }
+    
+    if (maxEnergy > 0.0)
+    {
+        response.applyGain(static_cast<float>(1.0 / std::sqrt(maxEnergy)));
+    }
+    
+    // Split into the direct taps, head partitions, and tail partitions
+    constexpr int headEnd = 2 * tailPartitionSize;
+    
+    if (length > directLength)
+    {
+        const int headLength = juce::jmin(length, headEnd) - directLength;
+        numHeadPartitions = (headLength + directLength - 1) / directLength;
+    }
+    
+    if (length > headEnd)
+        numTailPartitions = (length - headEnd + tailPartitionSize - 1) / tailPartitionSize;
+    
+    directTaps.assign(static_cast<size_t>(numChannels * directLength), 0.0f);
+    headSpectra.resize(static_cast<size_t>(numChannels * numHeadPartitions * 2 * (directLength + 1)));
+    tailSpectra.resize(static_cast<size_t>(numChannels * numTailPartitions * 2 * (tailPartitionSize + 1)));
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const float* data = response.getReadPointer(channel);
+        float* taps = directTaps.data() + channel * directLength;
+        
+        for (int tap = 0; tap < juce::jmin(length, directLength); ++tap)
+        {
+            taps[directLength - 1 - tap] = data[tap];
+        }
+        
+        transformPartitions(data, length, directLength, directLength, numHeadPartitions,
+                            headSpectra.data() + static_cast<size_t>(channel * numHeadPartitions * 2 * (directLength + 1)));
+        transformPartitions(data, length, headEnd, tailPartitionSize, numTailPartitions,
+                            tailSpectra.data() + static_cast<size_t>(channel * numTailPartitions * 2 * (tailPartitionSize + 1)));
+    }
+}
+
+ConvolutionImpulseResponse::~ConvolutionImpulseResponse()
+{
+}
+
+int ConvolutionImpulseResponse::getNumChannels() const
+{
+    return numChannels;
+}
+
+int ConvolutionImpulseResponse::getLength() const
+{
+    return length;
+}
+
+double ConvolutionImpulseResponse::getSampleRate() const
+{
+    return sampleRate;
+}
+
+int ConvolutionImpulseResponse::getNumHeadPartitions() const
+{
+    return numHeadPartitions;
+}
+
+int ConvolutionImpulseResponse::getNumTailPartitions() const
+{
+    return numTailPartitions;
+}
+
+const float* ConvolutionImpulseResponse::getDirectTaps(int channel) const
+{
+    return directTaps.data() + channel * directLength;
+}
+
+const float* ConvolutionImpulseResponse::getHeadSpectra(int channel) const
+{
+    return headSpectra.data() + static_cast<size_t>(channel * numHeadPartitions * 2 * (directLength + 1));
+}
+
+const float* ConvolutionImpulseResponse::getTailSpectra(int channel) const
+{
+    return tailSpectra.data() + static_cast<size_t>(channel * numTailPartitions * 2 * (tailPartitionSize + 1));
+}
+
+//==============================================================================
+// PartitionedConvolver Implementation
+//==============================================================================
+
+PartitionedConvolver::PartitionedConvolver()
+    : partitionSize(0)
+    , numPartitions(0)
+    , numBins(0)
+    , position(0)
+{
+}
+
+PartitionedConvolver::~PartitionedConvolver()
+{
+}
+
+void PartitionedConvolver::prepare(int newPartitionSize, int newNumPartitions)
+{
+    partitionSize = newPartitionSize;
+    numPartitions = juce::jmax(1, newNumPartitions);
+    numBins = partitionSize + 1;
+    
+    fft = std::make_unique<juce::dsp::FFT>(getFFTOrder(partitionSize));
+    fftData.assign(static_cast<size_t>(4 * partitionSize), 0.0f);
+    inputSpectra.assign(static_cast<size_t>(numPartitions * 2 * numBins), 0.0f);
+    accumulator.assign(static_cast<size_t>(2 * numBins), 0.0f);
+    position = 0;
+}
+
+void PartitionedConvolver::reset()
+{
+    std::fill(inputSpectra.begin(), inputSpectra.end(), 0.0f);
+    position = 0;
+}
+
+void PartitionedConvolver::process(const float* input, const float* spectra, float* output)
+{
+    // Transform the two newest blocks and store the spectrum in the delay line
+    juce::FloatVectorOperations::copy(fftData.data(), input, 2 * partitionSize);
+    fft->performRealOnlyForwardTransform(fftData.data(), true);
+    
+    float* newestReal = inputSpectra.data() + static_cast<size_t>(position * 2 * numBins);
+    float* newestImaginary = newestReal + numBins;
+    
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        newestReal[bin] = fftData[static_cast<size_t>(2 * bin)];
+        newestImaginary[bin] = fftData[static_cast<size_t>(2 * bin + 1)];
+    }
+    
+    // Multiply each partition with the block that arrived that many blocks ago
+    float* sumReal = accumulator.data();
+    float* sumImaginary = sumReal + numBins;
+    std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+    
+    for (int partition = 0; partition < numPartitions; ++partition)
+    {
+        int slot = position - partition;
+        
+        if (slot < 0)
+            slot += numPartitions;
+        
+        const float* inputReal = inputSpectra.data() + static_cast<size_t>(slot * 2 * numBins);
+        const float* inputImaginary = inputReal + numBins;
+        const float* responseReal = spectra + static_cast<size_t>(partition * 2 * numBins);
+        const float* responseImaginary = responseReal + numBins;
+        
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            sumReal[bin] += inputReal[bin] * responseReal[bin] - inputImaginary[bin] * responseImaginary[bin];
+            sumImaginary[bin] += inputReal[bin] * responseImaginary[bin] + inputImaginary[bin] * responseReal[bin];
+        }
+    }
+    
+    // Back to the time domain; the second half holds the valid output
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        fftData[static_cast<size_t>(2 * bin)] = sumReal[bin];
+        fftData[static_cast<size_t>(2 * bin + 1)] = sumImaginary[bin];
+    }
+    
+    fft->performRealOnlyInverseTransform(fftData.data());
+    juce::FloatVectorOperations::copy(output, fftData.data() + partitionSize, partitionSize);
+    
+    if (++position == numPartitions)
+        position = 0;
+}
+
+//==============================================================================
+// ConvolutionEngine Implementation
+//==============================================================================
+
+ConvolutionEngine::ConvolutionEngine(std::shared_ptr<const ConvolutionImpulseResponse> impulseResponse, int channels)
+    : impulse(std::move(impulseResponse))
+    , numChannels(juce::jmax(1, channels))
+    , headPosition(0)
+    , tailPosition(0)
+    , tailBlock(0)
+    , tailOutputSlot(-1)
+    , submittedBlocks(0)
+    , tailUnderruns(0)
+    , nextTailBlock(0)
+{
+    constexpr int directLength = ConvolutionImpulseResponse::directLength;
+    constexpr int tailPartitionSize = ConvolutionImpulseResponse::tailPartitionSize;
+    
+    directInput.setSize(numChannels, 2 * directLength);
+    directInput.clear();
+    headOutput.setSize(numChannels, directLength);
+    headOutput.clear();
+    
+    tailInput.setSize(numChannels, numTailSlots * tailPartitionSize);
+    tailInput.clear();
+    tailOutput.setSize(numChannels, numTailSlots * tailPartitionSize);
+    tailOutput.clear();
+    tailHistory.setSize(numChannels, 2 * tailPartitionSize);
+    tailHistory.clear();
+    
+    for (auto& block : tailOutputBlock)
+    {
+        block.store(-1, std::memory_order_relaxed);
+    }
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        headConvolvers.push_back(std::make_unique<PartitionedConvolver>());
+        headConvolvers.back()->prepare(directLength, impulse->getNumHeadPartitions());
+        
+        tailConvolvers.push_back(std::make_unique<PartitionedConvolver>());
+        tailConvolvers.back()->prepare(tailPartitionSize, impulse->getNumTailPartitions());
+    }
+    
+    if (impulse->getNumTailPartitions() > 0)
+        ConvolutionTailThread::getInstance().addClient(this);
+}
+
+ConvolutionEngine::~ConvolutionEngine()
+{
+    if (impulse->getNumTailPartitions() > 0)
+        ConvolutionTailThread::getInstance().removeClient(this);
+}
+
+void ConvolutionEngine::process(const juce::dsp::AudioBlock<float>& block)
+{
+    constexpr int directLength = ConvolutionImpulseResponse::directLength;
+    constexpr int tailPartitionSize = ConvolutionImpulseResponse::tailPartitionSize;
+    
+    const int numBlockChannels = juce::jmin(static_cast<int>(block.getNumChannels()), numChannels);
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    const bool hasHead = impulse->getNumHeadPartitions() > 0;
+    const bool hasTail = impulse->getNumTailPartitions() > 0;
+    
+    int offset = 0;
+    
+    while (offset < numSamples)
+    {
+        // Segments never cross a head block boundary
+        const int segmentLength = juce::jmin(numSamples - offset, directLength - headPosition);
+        const int tailInputStart = static_cast<int>(tailBlock % numTailSlots) * tailPartitionSize + tailPosition;
+        
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* history = directInput.getWritePointer(channel);
+            
+            // Channels missing from this block convolve silence
+            if (channel >= numBlockChannels)
+            {
+                juce::FloatVectorOperations::clear(history + directLength + headPosition, segmentLength);
+                
+                if (hasTail)
+                    juce::FloatVectorOperations::clear(tailInput.getWritePointer(channel, tailInputStart), segmentLength);
+                
+                continue;
+            }
+            
+            float* data = block.getChannelPointer(static_cast<size_t>(channel)) + offset;
+            juce::FloatVectorOperations::copy(history + directLength + headPosition, data, segmentLength);
+            
+            if (hasTail)
+                juce::FloatVectorOperations::copy(tailInput.getWritePointer(channel, tailInputStart), data, segmentLength);
+            
+            // Direct-form taps, with a partial sum per lane so the dot product vectorizes
+            const float* taps = impulse->getDirectTaps(getResponseChannel(channel));
+            
+            for (int i = 0; i < segmentLength; ++i)
+            {
+                const float* input = history + headPosition + i + 1;
+                float sums[laneWidth] = {};
+                
+                for (int tap = 0; tap < directLength; tap += laneWidth)
+                {
+                    for (int lane = 0; lane < laneWidth; ++lane)
+                    {
+                        sums[lane] += taps[tap + lane] * input[tap + lane];
+                    }
+                }
+                
+                float sum = 0.0f;
+                
+                for (int lane = 0; lane < laneWidth; ++lane)
+                {
+                    sum += sums[lane];
+                }
+                
+                data[i] = sum;
+            }
+            
+            // Head and tail output computed at earlier block boundaries
+            juce::FloatVectorOperations::add(data, headOutput.getReadPointer(channel, headPosition), segmentLength);
+            
+            if (tailOutputSlot >= 0)
+                juce::FloatVectorOperations::add(data, tailOutput.getReadPointer(channel, tailOutputSlot * tailPartitionSize + tailPosition), segmentLength);
+        }
+        
+        headPosition += segmentLength;
+        tailPosition += segmentLength;
+        offset += segmentLength;
+        
+        if (headPosition < directLength)
+            continue;
+        
+        // A head block is complete: compute the head output for the next one
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* history = directInput.getWritePointer(channel);
+            
+            if (hasHead)
+                headConvolvers[static_cast<size_t>(channel)]->process(history, impulse->getHeadSpectra(getResponseChannel(channel)),
+                                                                      headOutput.getWritePointer(channel));
+            
+            juce::FloatVectorOperations::copy(history, history + directLength, directLength);
+        }
+        
+        headPosition = 0;
+        
+        if (tailPosition == tailPartitionSize)
+        {
+            if (hasTail)
+                finishTailBlock();
+            
+            tailPosition = 0;
+        }
+    }
+}
+
+const ConvolutionImpulseResponse& ConvolutionEngine::getImpulseResponse() const
+{
+    return *impulse;
+}
+
+int ConvolutionEngine::getNumTailUnderruns() const
+{
+    return tailUnderruns.load(std::memory_order_relaxed);
+}
+
+int ConvolutionEngine::getResponseChannel(int channel) const
+{
+    return juce::jmin(channel, impulse->getNumChannels() - 1);
+}
+
+void ConvolutionEngine::finishTailBlock()
+{
+    submittedBlocks.store(tailBlock + 1, std::memory_order_release);
+    ConvolutionTailThread::getInstance().notify();
+    
+    ++tailBlock;
+    
+    // The tail starts two blocks into the response, so the output for this block comes from the block two before it
+    const juce::int64 sourceBlock = tailBlock - 2;
+    tailOutputSlot = -1;
+    
+    if (sourceBlock < 0)
+        return;
+    
+    const int slot = static_cast<int>(sourceBlock % numTailSlots);
+    
+    tailOutputSlot = slot;
+    
+    if (tailOutputBlock[static_cast<size_t>(slot)].load(std::memory_order_acquire) == sourceBlock)
+        return;
+    
+    // The tail thread is late (blocks longer than a tail partition, or rendering faster than real time): catch up here
+    const juce::SpinLock::ScopedLockType lock(tailLock);
+    
+    while (nextTailBlock <= sourceBlock)
+    {
+        convolveNextTailBlock();
+    }
+    
+    tailUnderruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool ConvolutionEngine::serve()
+{
+    const juce::SpinLock::ScopedLockType lock(tailLock);
+    
+    if (nextTailBlock >= submittedBlocks.load(std::memory_order_acquire))
+        return false;
+    
+    convolveNextTailBlock();
+    return true;
+}
+
+void ConvolutionEngine::convolveNextTailBlock()
+{
+    constexpr int tailPartitionSize = ConvolutionImpulseResponse::tailPartitionSize;
+    
+    const int slot = static_cast<int>(nextTailBlock % numTailSlots);
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* history = tailHistory.getWritePointer(channel);
+        juce::FloatVectorOperations::copy(history, history + tailPartitionSize, tailPartitionSize);
+        juce::FloatVectorOperations::copy(history + tailPartitionSize, tailInput.getReadPointer(channel, slot * tailPartitionSize), tailPartitionSize);
+        
+        tailConvolvers[static_cast<size_t>(channel)]->process(history, impulse->getTailSpectra(getResponseChannel(channel)),
+                                                              tailOutput.getWritePointer(channel, slot * tailPartitionSize));
+    }
+    
+    tailOutputBlock[static_cast<size_t>(slot)].store(nextTailBlock, std::memory_order_release);
+    ++nextTailBlock;
+}
+
+//==============================================================================
+// ConvolutionTailThread Implementation
+//==============================================================================
+
+ConvolutionTailThread::ConvolutionTailThread()
+    : ServiceThread("Convolution Tail", juce::Thread::Priority::high, pollIntervalMs)
+{
+}
+
+ConvolutionTailThread& ConvolutionTailThread::getInstance()
+{
+    static ConvolutionTailThread instance;
+    return instance;
+}
+
+} // namespace UndergroundBeats
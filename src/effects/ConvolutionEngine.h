@@ -0,0 +1,302 @@
+/*
+ * Underground Beats
+ * ConvolutionEngine.h
+ * 
+ * Non-uniformly partitioned FFT convolution with a background tail
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ServiceThread.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class ConvolutionImpulseResponse
+ * @brief An impulse response split into partitions and transformed once
+ * 
+ * The response is split into three stages. The first directLength taps are
+ * kept as plain coefficients for direct-form convolution. Taps from
+ * directLength up to twice tailPartitionSize are split into head partitions of
+ * directLength samples, and the rest into tail partitions of tailPartitionSize
+ * samples. The spectrum of every partition is computed here, so instances
+ * playing the same response share one copy and never transform it again.
+ * 
+ * Spectra are stored with the real parts of a partition's bins followed by the
+ * imaginary parts, so the complex multiply-accumulate over bins vectorizes.
+ */
+class ConvolutionImpulseResponse {
+public:
+    /** Number of taps convolved directly, also the size of the head partitions */
+    static constexpr int directLength = 128;
+    
+    /** Size of the tail partitions, convolved on the background thread */
+    static constexpr int tailPartitionSize = 2048;
+    
+    /** Longest response kept; anything longer is truncated */
+    static constexpr double maxLengthSeconds = 10.0;
+    
+    /**
+     * @brief Resample, normalize, and partition an impulse response
+     * 
+     * Allocates and runs FFTs, so never call this from the audio thread. The
+     * response is scaled so its loudest channel has unit energy.
+     * 
+     * @param impulse The impulse response, one or two channels
+     * @param impulseSampleRate The sample rate of the impulse response in Hz
+     * @param sampleRate The sample rate to convolve at in Hz
+     */
+    ConvolutionImpulseResponse(const juce::AudioBuffer<float>& impulse, double impulseSampleRate, double sampleRate);
+    ~ConvolutionImpulseResponse();
+    
+    /**
+     * @brief Get the number of channels
+     * 
+     * @return 1 or 2
+     */
+    int getNumChannels() const;
+    
+    /**
+     * @brief Get the length after resampling and truncation
+     * 
+     * @return The length in samples
+     */
+    int getLength() const;
+    
+    /**
+     * @brief Get the sample rate the response was prepared for
+     * 
+     * @return The sample rate in Hz
+     */
+    double getSampleRate() const;
+    
+    /**
+     * @brief Get the number of head partitions
+     * 
+     * @return The number of partitions, each directLength samples long
+     */
+    int getNumHeadPartitions() const;
+    
+    /**
+     * @brief Get the number of tail partitions
+     * 
+     * @return The number of partitions, each tailPartitionSize samples long
+     */
+    int getNumTailPartitions() const;
+    
+    /**
+     * @brief Get the direct-form taps of a channel in reverse order
+     * 
+     * @param channel The channel
+     * @return directLength taps, last tap first
+     */
+    const float* getDirectTaps(int channel) const;
+    
+    /**
+     * @brief Get the head partition spectra of a channel
+     * 
+     * @param channel The channel
+     * @return The spectra of all head partitions, one after the other
+     */
+    const float* getHeadSpectra(int channel) const;
+    
+    /**
+     * @brief Get the tail partition spectra of a channel
+     * 
+     * @param channel The channel
+     * @return The spectra of all tail partitions, one after the other
+     */
+    const float* getTailSpectra(int channel) const;
+    
+private:
+    int numChannels;
+    int length;
+    double sampleRate;
+    
+    int numHeadPartitions;
+    int numTailPartitions;
+    
+    std::vector<float> directTaps;   // [channel][tap]
+    std::vector<float> headSpectra;  // [channel][partition][real bins, imaginary bins]
+    std::vector<float> tailSpectra;  // [channel][partition][real bins, imaginary bins]
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConvolutionImpulseResponse)
+};
+
+/**
+ * @class PartitionedConvolver
+ * @brief Uniformly partitioned overlap-save convolution of one channel
+ * 
+ * Keeps a frequency-domain delay line of the spectra of past input blocks.
+ * Each step transforms one new block, multiplies the delay line with the
+ * partition spectra, and transforms the sum back, so a step costs one FFT pair
+ * plus one complex multiply-accumulate per partition.
+ */
+class PartitionedConvolver {
+public:
+    PartitionedConvolver();
+    ~PartitionedConvolver();
+    
+    /**
+     * @brief Allocate the delay line and FFT
+     * 
+     * @param partitionSize Samples per block and per partition (a power of two)
+     * @param numPartitions Number of partitions of the response
+     */
+    void prepare(int partitionSize, int numPartitions);
+    
+    /**
+     * @brief Clear the delay line
+     */
+    void reset();
+    
+    /**
+     * @brief Convolve the newest input block
+     * 
+     * @param input The previous input block followed by the newest one (2 * partitionSize samples)
+     * @param spectra The partition spectra, in the layout of ConvolutionImpulseResponse
+     * @param output Receives partitionSize samples of output
+     */
+    void process(const float* input, const float* spectra, float* output);
+    
+private:
+    int partitionSize;
+    int numPartitions;
+    int numBins;
+    int position;  // Delay line slot of the newest block
+    
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> fftData;
+    std::vector<float> inputSpectra;  // [partition][real bins, imaginary bins]
+    std::vector<float> accumulator;   // [real bins, imaginary bins]
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PartitionedConvolver)
+};
+
+/**
+ * @class ConvolutionEngine
+ * @brief Zero-latency convolution with one impulse response
+ * 
+ * The audio thread convolves the direct-form taps sample by sample and the
+ * head partitions at every head block boundary, so its cost does not depend on
+ * the length of the response. The tail starts two tail blocks into the
+ * response, so each completed input block is handed to the
+ * ConvolutionTailThread, which has a whole block period to compute the output
+ * before it is needed. If the tail is late, the audio thread convolves the
+ * outstanding blocks itself and counts an underrun, so blocks longer than a
+ * tail partition and offline rendering still get the whole response.
+ * 
+ * Everything is allocated when the engine is created; replace the engine to
+ * change the response or the channel count.
+ */
+class ConvolutionEngine : private ServiceThread::Client {
+public:
+    /**
+     * @brief Create an engine
+     * 
+     * @param impulseResponse The prepared response
+     * @param numChannels Number of channels to convolve
+     */
+    ConvolutionEngine(std::shared_ptr<const ConvolutionImpulseResponse> impulseResponse, int numChannels);
+    ~ConvolutionEngine() override;
+    
+    /**
+     * @brief Replace a block with its convolution (audio thread)
+     * 
+     * Channels beyond the engine's channel count are left unchanged. A mono
+     * response is applied to every channel.
+     * 
+     * @param block The audio to process in place
+     */
+    void process(const juce::dsp::AudioBlock<float>& block);
+    
+    /**
+     * @brief Get the response being convolved
+     * 
+     * @return The impulse response
+     */
+    const ConvolutionImpulseResponse& getImpulseResponse() const;
+    
+    /**
+     * @brief Get the number of blocks whose tail was computed on the audio thread
+     * 
+     * @return The number of times the tail thread was late since the engine was created
+     */
+    int getNumTailUnderruns() const;
+    
+private:
+    std::shared_ptr<const ConvolutionImpulseResponse> impulse;
+    int numChannels;
+    
+    // Number of tail blocks in flight between the audio thread and the tail thread
+    static constexpr int numTailSlots = 4;
+    
+    // Audio thread state
+    juce::AudioBuffer<float> directInput;  // Previous and current head block of each channel
+    juce::AudioBuffer<float> headOutput;   // Head output for the current head block
+    std::vector<std::unique_ptr<PartitionedConvolver>> headConvolvers;
+    int headPosition;          // Samples of the current head block processed
+    int tailPosition;          // Samples of the current tail block processed
+    juce::int64 tailBlock;     // Index of the current tail block
+    int tailOutputSlot;        // Slot holding the tail output for the current block, or -1
+    
+    // Blocks shared with the tail thread, one slot per block in flight
+    juce::AudioBuffer<float> tailInput;
+    juce::AudioBuffer<float> tailOutput;
+    std::array<std::atomic<juce::int64>, numTailSlots> tailOutputBlock;  // Block whose output each slot holds
+    std::atomic<juce::int64> submittedBlocks;
+    std::atomic<int> tailUnderruns;
+    
+    // Tail state, owned by whichever thread holds the lock (normally the tail thread)
+    juce::SpinLock tailLock;
+    juce::int64 nextTailBlock;             // Next submitted block to convolve
+    juce::AudioBuffer<float> tailHistory;  // Previous and current tail block of each channel
+    std::vector<std::unique_ptr<PartitionedConvolver>> tailConvolvers;
+    
+    // Channel of the response used for a channel of audio
+    int getResponseChannel(int channel) const;
+    
+    // Hand the completed tail block to the tail thread and pick up the output for the next one
+    void finishTailBlock();
+    
+    // Convolve the next submitted tail block (tail thread), returning false if there was none
+    bool serve() override;
+    
+    // Convolve block nextTailBlock into its output slot (tailLock held)
+    void convolveNextTailBlock();
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConvolutionEngine)
+};
+
+/**
+ * @class ConvolutionTailThread
+ * @brief Background thread that convolves the tails of every ConvolutionEngine
+ * 
+ * Engines with a tail register themselves when created and unregister when
+ * destroyed. The thread is woken when an engine submits a block and works
+ * through the submitted blocks of all engines in turn.
+ */
+class ConvolutionTailThread : public ServiceThread {
+public:
+    ConvolutionTailThread();
+    
+    /**
+     * @brief Get the application-wide tail thread
+     * 
+     * @return The shared instance
+     */
+    static ConvolutionTailThread& getInstance();
+    
+private:
+    // Interval at which the thread checks the engines without being woken
+    static constexpr int pollIntervalMs = 10;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConvolutionTailThread)
+};
+
+} // namespace UndergroundBeats
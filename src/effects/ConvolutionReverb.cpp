@@ -0,0 +1,264 @@
+/*
+ * Underground Beats
+ * ConvolutionReverb.cpp
+ * 
+ * Implementation of the convolution reverb effect
+ */
+
+#include "ConvolutionReverb.h"
+#include <map>
+#include <utility>
+
+namespace UndergroundBeats {
+
+namespace {
+
+/**
+ * Prepared responses shared by every instance, keyed by file and sample rate.
+ * Entries are weak, so a response is freed when no engine uses it any more.
+ */
+class ImpulseResponseCache {
+public:
+    ImpulseResponseCache()
+    {
+        formatManager.registerBasicFormats();
+    }
+    
+    static ImpulseResponseCache& getInstance()
+    {
+        static ImpulseResponseCache instance;
+        return instance;
+    }
+    
+    // Read and prepare a response, or reuse a prepared one (never on the audio thread)
+    std::shared_ptr<const ConvolutionImpulseResponse> load(const juce::File& file, double sampleRate)
+    {
+        const juce::String key = file.getFullPathName() + "|" + juce::String(file.getLastModificationTime().toMilliseconds())
+                                 + "|" + juce::String(sampleRate);
+        
+        {
+            const juce::ScopedLock sl(lock);
+            
+            if (auto cached = entries[key].lock())
+                return cached;
+        }
+        
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+        
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0)
+            return nullptr;
+        
+        // Only read what survives truncation to the maximum length
+        const juce::int64 maxFrames = static_cast<juce::int64>(ConvolutionImpulseResponse::maxLengthSeconds * reader->sampleRate) + 1;
+        const int numFrames = static_cast<int>(juce::jmin(reader->lengthInSamples, maxFrames));
+        
+        juce::AudioBuffer<float> buffer(juce::jlimit(1, 2, static_cast<int>(reader->numChannels)), numFrames);
+        reader->read(&buffer, 0, numFrames, 0, true, true);
+        
+        auto response = std::make_shared<const ConvolutionImpulseResponse>(buffer, reader->sampleRate, sampleRate);
+        
+        const juce::ScopedLock sl(lock);
+        
+        // Another instance may have prepared the same response in the meantime
+        if (auto cached = entries[key].lock())
+            return cached;
+        
+        entries[key] = response;
+        return response;
+    }
+    
+private:
+    std::map<juce::String, std::weak_ptr<const ConvolutionImpulseResponse>> entries;
+    juce::CriticalSection lock;
+    juce::AudioFormatManager formatManager;
+};
+
+} // namespace
+
+ConvolutionReverb::ConvolutionReverb()
+    : Effect("ConvolutionReverb")
+    , impulseSampleRate(0.0)
+    , responseSampleRate(44100.0)
+    , tailLengthSeconds(0.0)
+    , engine(nullptr)
+    , loadPool(1)
+{
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    loadPool.removeAllJobs(true, 5000);
+}
+
+void ConvolutionReverb::loadImpulseResponse(const juce::File& file)
+{
+    double sampleRate;
+    
+    {
+        const juce::ScopedLock sl(lock);
+        sampleRate = responseSampleRate;
+    }
+    
+    loadPool.addJob([this, file, sampleRate]
+    {
+        double targetRate = sampleRate;
+        
+        for (;;)
+        {
+            // Read and prepare the file without holding up reset() or the other setters
+            auto response = ImpulseResponseCache::getInstance().load(file, targetRate);
+            
+            if (response == nullptr)
+                return;
+            
+            const juce::ScopedLock sl(lock);
+            
+            // The effect may have been prepared at another sample rate while the file was loading
+            if (responseSampleRate != targetRate)
+            {
+                targetRate = responseSampleRate;
+                continue;
+            }
+            
+            impulseFile = file;
+            impulseBuffer.setSize(0, 0);
+            impulseSampleRate = 0.0;
+            impulse = response;
+            
+            publishEngine(response);
+            return;
+        }
+    });
+}
+
+bool ConvolutionReverb::setImpulseResponse(const juce::AudioBuffer<float>& newImpulse, double newSampleRate)
+{
+    if (newImpulse.getNumChannels() == 0 || newImpulse.getNumSamples() == 0 || newSampleRate <= 0.0)
+        return false;
+    
+    auto response = std::make_shared<const ConvolutionImpulseResponse>(newImpulse, newSampleRate, currentSampleRate);
+    
+    const juce::ScopedLock sl(lock);
+    
+    impulseFile = juce::File();
+    impulseBuffer.makeCopyOf(newImpulse);
+    impulseSampleRate = newSampleRate;
+    impulse = response;
+    
+    publishEngine(response);
+    return true;
+}
+
+void ConvolutionReverb::clearImpulseResponse()
+{
+    const juce::ScopedLock sl(lock);
+    
+    impulseFile = juce::File();
+    impulseBuffer.setSize(0, 0);
+    impulseSampleRate = 0.0;
+    impulse.reset();
+    
+    publishEngine(nullptr);
+}
+
+juce::File ConvolutionReverb::getImpulseResponseFile() const
+{
+    const juce::ScopedLock sl(lock);
+    return impulseFile;
+}
+
+bool ConvolutionReverb::hasImpulseResponse() const
+{
+    const juce::ScopedLock sl(lock);
+    return impulse != nullptr;
+}
+
+int ConvolutionReverb::getNumTailUnderruns() const
+{
+    const juce::ScopedLock sl(lock);
+    return engineOwner != nullptr ? engineOwner->getNumTailUnderruns() : 0;
+}
+
+double ConvolutionReverb::getTailLengthSeconds() const
+{
+    return tailLengthSeconds.load(std::memory_order_relaxed);
+}
+
+void ConvolutionReverb::reset()
+{
+    Effect::reset();
+    
+    const juce::ScopedLock sl(lock);
+    responseSampleRate = currentSampleRate;
+    
+    // Prepare the response again if the sample rate has changed since it was loaded
+    if (impulse != nullptr && impulse->getSampleRate() != currentSampleRate)
+    {
+        if (impulseFile != juce::File())
+            impulse = ImpulseResponseCache::getInstance().load(impulseFile, currentSampleRate);
+        else
+            impulse = std::make_shared<const ConvolutionImpulseResponse>(impulseBuffer, impulseSampleRate, currentSampleRate);
+    }
+    
+    // A fresh engine starts with empty convolution state
+    publishEngine(impulse);
+}
+
+std::unique_ptr<juce::XmlElement> ConvolutionReverb::createStateXml() const
+{
+    auto xml = Effect::createStateXml();
+    
+    // Responses loaded from memory are not saved
+    xml->setAttribute("impulseFile", getImpulseResponseFile().getFullPathName());
+    
+    return xml;
+}
+
+bool ConvolutionReverb::restoreStateFromXml(const juce::XmlElement* xml)
+{
+    if (!Effect::restoreStateFromXml(xml))
+    {
+        return false;
+    }
+    
+    const juce::String path = xml->getStringAttribute("impulseFile");
+    
+    if (path.isNotEmpty())
+    {
+        loadImpulseResponse(juce::File(path));
+    }
+    
+    return true;
+}
+
+void ConvolutionReverb::beginBlock()
+{
+    // Tell the reclaim thread no engine read before this point is still in use
+    retiredEngines.acknowledge();
+}
+
+void ConvolutionReverb::processBlock(const juce::dsp::AudioBlock<float>& block)
+{
+    if (auto* current = engine.load(std::memory_order_acquire))
+    {
+        current->process(block);
+    }
+}
+
+void ConvolutionReverb::publishEngine(std::shared_ptr<const ConvolutionImpulseResponse> response)
+{
+    std::unique_ptr<ConvolutionEngine> newEngine;
+    
+    tailLengthSeconds.store(response != nullptr ? response->getLength() / response->getSampleRate() : 0.0, std::memory_order_relaxed);
+    
+    if (response != nullptr)
+        newEngine = std::make_unique<ConvolutionEngine>(std::move(response), maxChannels);
+    
+    engine.store(newEngine.get(), std::memory_order_release);
+    retiredEngines.retire(std::move(engineOwner));
+    engineOwner = std::move(newEngine);
+    
+    retiredEngines.publish();
+}
+
+} // namespace UndergroundBeats
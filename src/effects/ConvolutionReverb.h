@@ -0,0 +1,162 @@
+/*
+ * Underground Beats
+ * ConvolutionReverb.h
+ * 
+ * Reverb effect that convolves with recorded impulse responses
+ */
+
+#pragma once
+
+#include "Effect.h"
+#include "ConvolutionEngine.h"
+#include "DeferredRelease.h"
+#include <atomic>
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @class ConvolutionReverb
+ * @brief Reverb effect that convolves with recorded impulse responses
+ * 
+ * Impulse responses of up to ten seconds are read, resampled, and partitioned
+ * on a loading thread. Prepared responses are cached per file and sample rate,
+ * so every instance using the same file shares one copy of the spectra. The
+ * convolution itself runs in a ConvolutionEngine, which keeps the audio
+ * thread's cost independent of the response length.
+ * 
+ * A new engine is published to the audio thread atomically and takes over at
+ * the start of the next block; the replaced engine is destroyed by the
+ * ReclaimThread once the audio thread has moved past it, which it
+ * acknowledges every block even while the effect is bypassed, asleep, or
+ * fully dry. Without a loaded response the effect passes audio through
+ * unchanged.
+ */
+class ConvolutionReverb : public Effect {
+public:
+    ConvolutionReverb();
+    ~ConvolutionReverb() override;
+    
+    /**
+     * @brief Load an impulse response file in the background
+     * 
+     * The current response keeps playing until the new one is ready. If the
+     * file cannot be read, the current response is kept.
+     * 
+     * @param file The audio file to load
+     */
+    void loadImpulseResponse(const juce::File& file);
+    
+    /**
+     * @brief Use an impulse response from memory (message thread)
+     * 
+     * Resamples and partitions the response before returning.
+     * 
+     * @param impulse The impulse response, one or two channels
+     * @param impulseSampleRate The sample rate of the impulse response in Hz
+     * @return true if the response was accepted
+     */
+    bool setImpulseResponse(const juce::AudioBuffer<float>& impulse, double impulseSampleRate);
+    
+    /**
+     * @brief Remove the impulse response
+     */
+    void clearImpulseResponse();
+    
+    /**
+     * @brief Get the file the current response was loaded from
+     * 
+     * @return The file, or a default File if the response came from memory or none is loaded
+     */
+    juce::File getImpulseResponseFile() const;
+    
+    /**
+     * @brief Check whether a response is loaded
+     * 
+     * @return true if a response is loaded
+     */
+    bool hasImpulseResponse() const;
+    
+    /**
+     * @brief Get the number of blocks whose tail was not convolved in time
+     * 
+     * @return The underrun count of the current engine
+     */
+    int getNumTailUnderruns() const;
+    
+    /**
+     * @brief Reset the effect state (message thread)
+     * 
+     * Replaces the engine, preparing the response again if the sample rate has
+     * changed.
+     */
+    void reset() override;
+    
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * @return The length of the impulse response in seconds, or 0 without one
+     */
+    double getTailLengthSeconds() const override;
+    
+    /**
+     * @brief Create an XML element containing the effect's state
+     * 
+     * @return XML element containing effect state
+     */
+    std::unique_ptr<juce::XmlElement> createStateXml() const override;
+    
+    /**
+     * @brief Restore effect state from an XML element
+     * 
+     * @param xml XML element containing effect state
+     * @return true if state was successfully restored
+     */
+    bool restoreStateFromXml(const juce::XmlElement* xml) override;
+    
+protected:
+    /**
+     * @brief Acknowledge the latest engine at the start of every block
+     */
+    void beginBlock() override;
+    
+    /**
+     * @brief Process a block of audio
+     * 
+     * @param block The audio to process in place
+     */
+    void processBlock(const juce::dsp::AudioBlock<float>& block) override;
+    
+private:
+    // Source of the current response, to prepare it again at a new sample rate
+    juce::File impulseFile;
+    juce::AudioBuffer<float> impulseBuffer;
+    double impulseSampleRate;
+    std::shared_ptr<const ConvolutionImpulseResponse> impulse;
+    
+    // Sample rate responses are prepared for, as of the last reset()
+    double responseSampleRate;
+    
+    // Length of the published response, readable from any thread
+    std::atomic<double> tailLengthSeconds;
+    
+    // Engine read by the audio thread, and the owner that keeps it alive
+    std::atomic<ConvolutionEngine*> engine;
+    std::unique_ptr<ConvolutionEngine> engineOwner;
+    
+    // Replaced engines, held until the audio thread has moved past them
+    DeferredRelease retiredEngines;
+    
+    // Guards the response source and engine ownership against the loading thread
+    juce::CriticalSection lock;
+    
+    // Background loading (destroyed first so no job outlives the effect)
+    juce::ThreadPool loadPool;
+    
+    // Replace the engine with one for a response, or remove it for nullptr (lock must be held)
+    void publishEngine(std::shared_ptr<const ConvolutionImpulseResponse> response);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConvolutionReverb)
+};
+
+} // namespace UndergroundBeats
@@ -6,6 +6,8 @@
  */
 
 #include "Delay.h"
+#include <cmath>
+#include <limits>
 
 namespace UndergroundBeats {
 
@@ -16,14 +18,16 @@ Delay::Delay()
     , feedback({0.5f, 0.5f})
     , crossFeedback({0.0f, 0.0f})
     , tempo(120.0f)
-    , writePosition({0, 0})
-    , delayLength({0, 0})
+    , delayMask(0)
+    , writePosition(0)
+    , delayLength({1, 1})
+    , fadeDelayLength({0, 0})
+    , fadePosition({0, 0})
+    , crossfadeLength(1)
 {
-    // Initialize delay buffers (will be properly sized in prepare())
-    for (auto& buffer : delayBuffer)
-    {
-        buffer = std::make_unique<juce::AudioBuffer<float>>();
-    }
+    // Delay lines are allocated in prepare()
+    updateDelayTimes();
+    snapDelayTimes();
 }
 
 Delay::~Delay()
@@ -36,22 +40,8 @@ void Delay::setDelayTime(int channel, float timeMs)
     {
         delayTimeMs[channel] = timeMs;
         
-        // If not in synced mode, update the delay length
-        if (delayTimeSync[channel] == DelayTimeSync::Free)
-        {
-            delayLength[channel] = static_cast<int>((timeMs / 1000.0f) * currentSampleRate);
-            
-            // Ensure delay length is at least 1 sample
-            delayLength[channel] = std::max(1, delayLength[channel]);
-            
-            // Ensure delay buffer is large enough
-            if (delayBuffer[channel]->getNumSamples() < delayLength[channel])
-            {
-                // Double buffer size for future flexibility
-                int newSize = std::max(delayLength[channel] * 2, delayBuffer[channel]->getNumSamples());
-                delayBuffer[channel]->setSize(1, newSize, false, true, true);
-            }
-        }
+        // Only changes the delay length in free mode
+        updateDelayTimes();
     }
 }
 
@@ -122,6 +112,11 @@ float Delay::getCrossFeedback(int channel) const
 
 void Delay::setTempo(float bpm)
 {
+    if (bpm <= 0.0f)
+    {
+        return;
+    }
+    
     tempo = bpm;
     updateDelayTimes();
 }
@@ -135,31 +130,55 @@ void Delay::prepare(double sampleRate, int blockSize)
 {
     Effect::prepare(sampleRate, blockSize);
     
-    // Calculate maximum delay length (2 seconds)
-    int maxDelaySamples = static_cast<int>(2.0 * sampleRate);
+    // Allocate the delay lines once, rounded up to a power of two so indices wrap with a mask
+    const int maxDelaySamples = static_cast<int>(std::ceil(maxDelayMs / 1000.0 * sampleRate));
+    const int lineLength = juce::nextPowerOfTwo(maxDelaySamples + 1);
     
-    // Initialize delay buffers
-    for (int channel = 0; channel < 2; ++channel)
-    {
-        delayBuffer[channel]->setSize(1, maxDelaySamples, false, true, true);
-        delayBuffer[channel]->clear();
-        writePosition[channel] = 0;
-    }
+    delayBuffer.setSize(2, lineLength, false, true, false);
+    delayBuffer.clear();
+    delayMask = lineLength - 1;
+    writePosition = 0;
+    
+    scratchBuffer.setSize(6, juce::jmax(1, blockSize), false, true, false);
+    crossfadeLength = juce::jmax(1, static_cast<int>(crossfadeSeconds * sampleRate));
     
     // Update delay times based on current tempo and sync settings
     updateDelayTimes();
+    snapDelayTimes();
 }
 
-void Delay::reset()
+double Delay::getTailLengthSeconds() const
 {
-    Effect::reset();
+    // Each trip round the lines scales the echoes by at most the largest loop gain
+    const float loopGain = juce::jmax(feedback[0] + crossFeedback[0], feedback[1] + crossFeedback[1]);
+    
+    if (loopGain >= 1.0f)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    
+    int longestDelay = 0;
     
-    // Clear delay buffers
     for (int channel = 0; channel < 2; ++channel)
     {
-        delayBuffer[channel]->clear();
-        writePosition[channel] = 0;
+        longestDelay = juce::jmax(longestDelay, delayLength[channel], fadeDelayLength[channel],
+                                  targetDelayLength[channel].load(std::memory_order_relaxed));
     }
+    
+    // The first echo, then as many repeats as it takes to decay to silence
+    const double numRepeats = loopGain > 0.0f ? std::ceil(tailDecayDecibels / (-20.0 * std::log10(loopGain))) : 0.0;
+    
+    return (1.0 + numRepeats) * longestDelay / currentSampleRate;
+}
+
+void Delay::reset()
+{
+    Effect::reset();
+    
+    // Clear delay lines
+    delayBuffer.clear();
+    writePosition = 0;
+    snapDelayTimes();
 }
 
 std::unique_ptr<juce::XmlElement> Delay::createStateXml() const
@@ -236,58 +255,75 @@ bool Delay::restoreStateFromXml(const juce::XmlElement* xml)
     return true;
 }
 
-float Delay::processSample(float sample)
+void Delay::processBlock(const juce::dsp::AudioBlock<float>& block)
 {
-    // For mono processing, just use the left channel settings
-    float delayedSample = getSampleFromDelayBuffer(0, delayLength[0]);
-    float output = sample + delayedSample;
-    
-    // Write to delay buffer with feedback
-    float* channelData = delayBuffer[0]->getWritePointer(0);
-    channelData[writePosition[0]] = sample + delayedSample * feedback[0];
-    
-    // Increment write position
-    writePosition[0] = (writePosition[0] + 1) % delayBuffer[0]->getNumSamples();
-    
-    return output;
-}
-
-void Delay::processSampleStereo(float leftSample, float rightSample, float* leftOutput, float* rightOutput)
-{
-    // Get delayed samples from both channels
-    float delayedLeft = getSampleFromDelayBuffer(0, delayLength[0]);
-    float delayedRight = getSampleFromDelayBuffer(1, delayLength[1]);
-    
-    // Calculate outputs
-    *leftOutput = leftSample + delayedLeft;
-    *rightOutput = rightSample + delayedRight;
+    const int numChannels = block.getNumChannels() > 1 ? 2 : 1;
+    const int numSamples = static_cast<int>(block.getNumSamples());
     
-    // Write to delay buffers with feedback and cross-feedback
-    float* leftChannelData = delayBuffer[0]->getWritePointer(0);
-    float* rightChannelData = delayBuffer[1]->getWritePointer(0);
+    if (delayBuffer.getNumSamples() == 0)
+    {
+        return;
+    }
     
-    leftChannelData[writePosition[0]] = leftSample + 
-                                       delayedLeft * feedback[0] + 
-                                       delayedRight * crossFeedback[0];
+    // Start a crossfade for each channel whose delay time has changed
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const int target = targetDelayLength[channel].load(std::memory_order_relaxed);
+        
+        if (fadeDelayLength[channel] == 0 && target != delayLength[channel])
+        {
+            fadeDelayLength[channel] = target;
+            fadePosition[channel] = 0;
+        }
+    }
     
-    rightChannelData[writePosition[1]] = rightSample + 
-                                        delayedRight * feedback[1] + 
-                                        delayedLeft * crossFeedback[1];
+    int position = 0;
     
-    // Increment write positions
-    writePosition[0] = (writePosition[0] + 1) % delayBuffer[0]->getNumSamples();
-    writePosition[1] = (writePosition[1] + 1) % delayBuffer[1]->getNumSamples();
-}
-
-void Delay::processBufferStereo(float* leftBuffer, float* rightBuffer, int numSamples)
-{
-    // Process samples one by one
-    for (int i = 0; i < numSamples; ++i)
+    while (position < numSamples)
     {
-        float leftOut, rightOut;
-        processSampleStereo(leftBuffer[i], rightBuffer[i], &leftOut, &rightOut);
-        leftBuffer[i] = leftOut;
-        rightBuffer[i] = rightOut;
+        // Keep segments shorter than every delay, so they only read samples written before they started,
+        // and end them where a crossfade ends
+        int segmentLength = numSamples - position;
+        
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            segmentLength = juce::jmin(segmentLength, delayLength[channel]);
+            
+            if (fadeDelayLength[channel] > 0)
+            {
+                segmentLength = juce::jmin(segmentLength, fadeDelayLength[channel], crossfadeLength - fadePosition[channel]);
+            }
+        }
+        
+        float* delayed[2] = { scratchBuffer.getWritePointer(0), scratchBuffer.getWritePointer(1) };
+        
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            readDelayTap(channel, delayed[channel], segmentLength);
+        }
+        
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* data = block.getChannelPointer(static_cast<size_t>(channel)) + position;
+            float* feed = scratchBuffer.getWritePointer(2 + channel);
+            
+            // Feed the input, feedback, and cross-feedback back into the line
+            juce::FloatVectorOperations::copy(feed, data, segmentLength);
+            juce::FloatVectorOperations::addWithMultiply(feed, delayed[channel], feedback[channel], segmentLength);
+            
+            if (numChannels == 2)
+            {
+                juce::FloatVectorOperations::addWithMultiply(feed, delayed[1 - channel], crossFeedback[channel], segmentLength);
+            }
+            
+            writeDelayLine(channel, feed, segmentLength);
+            
+            // Output the input plus the delayed signal
+            juce::FloatVectorOperations::add(data, delayed[channel], segmentLength);
+        }
+        
+        writePosition = (writePosition + segmentLength) & delayMask;
+        position += segmentLength;
     }
 }
 
@@ -302,44 +338,22 @@ void Delay::updateDelayTimes()
             delayTimeMs[channel] = timeMs;
         }
         
-        // Update delay length in samples
-        delayLength[channel] = static_cast<int>((delayTimeMs[channel] / 1000.0f) * currentSampleRate);
+        // Update delay length in samples, limited to what the delay line holds
+        const float clampedTimeMs = juce::jlimit(0.0f, maxDelayMs, delayTimeMs[channel]);
+        const int length = juce::roundToInt(clampedTimeMs / 1000.0 * currentSampleRate);
         
         // Ensure delay length is at least 1 sample
-        delayLength[channel] = std::max(1, delayLength[channel]);
-        
-        // Ensure delay buffer is large enough
-        if (delayBuffer[channel]->getNumSamples() < delayLength[channel])
-        {
-            // Double buffer size for future flexibility
-            int newSize = std::max(delayLength[channel] * 2, delayBuffer[channel]->getNumSamples());
-            juce::AudioBuffer<float> newBuffer(1, newSize);
-            
-            // Copy existing data if there is any
-            if (delayBuffer[channel]->getNumSamples() > 0)
-            {
-                newBuffer.clear();
-                
-                // Copy in two parts to handle wrap-around
-                int numSamplesToCopy = delayBuffer[channel]->getNumSamples();
-                int firstPart = std::min(numSamplesToCopy - writePosition[channel], numSamplesToCopy);
-                int secondPart = numSamplesToCopy - firstPart;
-                
-                newBuffer.copyFrom(0, 0, *delayBuffer[channel], 0, writePosition[channel], firstPart);
-                
-                if (secondPart > 0)
-                {
-                    newBuffer.copyFrom(0, firstPart, *delayBuffer[channel], 0, 0, secondPart);
-                }
-                
-                // Reset write position to the beginning of the buffer
-                writePosition[channel] = 0;
-            }
-            
-            // Replace the old buffer with the new one
-            delayBuffer[channel]->setSize(1, newSize, true, true, true);
-            delayBuffer[channel]->copyFrom(0, 0, newBuffer, 0, 0, newBuffer.getNumSamples());
-        }
+        targetDelayLength[channel].store(std::max(1, length), std::memory_order_relaxed);
+    }
+}
+
+void Delay::snapDelayTimes()
+{
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        delayLength[channel] = targetDelayLength[channel].load(std::memory_order_relaxed);
+        fadeDelayLength[channel] = 0;
+        fadePosition[channel] = 0;
     }
 }
 
@@ -378,37 +392,65 @@ float Delay::syncModeToMs(DelayTimeSync mode, float bpm) const
     }
 }
 
-float Delay::getSampleFromDelayBuffer(int channel, float delaySamples)
+void Delay::readDelayLine(int channel, int delaySamples, float* destination, int numSamples) const
 {
-    if (delayBuffer[channel]->getNumSamples() == 0)
+    const float* line = delayBuffer.getReadPointer(channel);
+    const int readPosition = (writePosition - delaySamples) & delayMask;
+    
+    // Copy up to the end of the line, then the rest from its start
+    const int firstPart = juce::jmin(numSamples, delayMask + 1 - readPosition);
+    juce::FloatVectorOperations::copy(destination, line + readPosition, firstPart);
+    
+    if (firstPart < numSamples)
     {
-        return 0.0f;
+        juce::FloatVectorOperations::copy(destination + firstPart, line, numSamples - firstPart);
     }
+}
+
+void Delay::writeDelayLine(int channel, const float* source, int numSamples)
+{
+    float* line = delayBuffer.getWritePointer(channel);
     
-    // Calculate read position
-    int bufferLength = delayBuffer[channel]->getNumSamples();
-    float readPosition = static_cast<float>(writePosition[channel]) - delaySamples;
+    // Copy up to the end of the line, then the rest to its start
+    const int firstPart = juce::jmin(numSamples, delayMask + 1 - writePosition);
+    juce::FloatVectorOperations::copy(line + writePosition, source, firstPart);
     
-    // Wrap around if necessary
-    while (readPosition < 0.0f)
+    if (firstPart < numSamples)
     {
-        readPosition += static_cast<float>(bufferLength);
+        juce::FloatVectorOperations::copy(line, source + firstPart, numSamples - firstPart);
+    }
+}
+
+void Delay::readDelayTap(int channel, float* destination, int numSamples)
+{
+    readDelayLine(channel, delayLength[channel], destination, numSamples);
+    
+    if (fadeDelayLength[channel] == 0)
+    {
+        return;
     }
     
-    // Calculate indices for interpolation
-    int index1 = static_cast<int>(readPosition);
-    int index2 = (index1 + 1) % bufferLength;
+    // Crossfade linearly from the old tap to the new one
+    float* faded = scratchBuffer.getWritePointer(4 + channel);
+    readDelayLine(channel, fadeDelayLength[channel], faded, numSamples);
     
-    // Get the fractional part for interpolation
-    float fraction = readPosition - static_cast<float>(index1);
+    const float fadeStep = 1.0f / static_cast<float>(crossfadeLength);
+    const float fadeStart = static_cast<float>(fadePosition[channel]) * fadeStep;
     
-    // Get the samples
-    float* data = delayBuffer[channel]->getWritePointer(0);
-    float sample1 = data[index1];
-    float sample2 = data[index2];
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float fade = fadeStart + static_cast<float>(i + 1) * fadeStep;
+        destination[i] += fade * (faded[i] - destination[i]);
+    }
     
-    // Linear interpolation
-    return sample1 * (1.0f - fraction) + sample2 * fraction;
+    fadePosition[channel] += numSamples;
+    
+    if (fadePosition[channel] >= crossfadeLength)
+    {
+        delayLength[channel] = fadeDelayLength[channel];
+        fadeDelayLength[channel] = 0;
+        fadePosition[channel] = 0;
+    }
 }
 
 } // namespace UndergroundBeats
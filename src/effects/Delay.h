@@ -9,6 +9,7 @@
 
 #include "Effect.h"
 #include <array>
+#include <atomic>
 
 namespace UndergroundBeats {
 
@@ -37,6 +38,13 @@ enum class DelayTimeSync {
  * The Delay class implements a stereo delay effect with adjustable delay time,
  * feedback, and cross-feedback between channels. It supports both free time
  * and tempo-synced delay times.
+ * 
+ * Each channel's delay line is a power-of-two buffer allocated once in
+ * prepare(), long enough for maxDelayMs, and indexed with a mask. Blocks are
+ * processed in segments no longer than the shortest delay, so every sample a
+ * segment reads was written before it started and the reads and writes are
+ * contiguous copies. Changing the delay time or tempo never allocates: the
+ * output crossfades from the old delay tap to the new one instead.
  */
 class Delay : public Effect {
 public:
@@ -129,6 +137,13 @@ public:
      */
     void prepare(double sampleRate, int blockSize) override;
     
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * @return Tail length in seconds, or infinity if the feedback never lets the echoes die away
+     */
+    double getTailLengthSeconds() const override;
+    
     /**
      * @brief Reset the effect state
      */
@@ -149,33 +164,19 @@ public:
      */
     bool restoreStateFromXml(const juce::XmlElement* xml) override;
     
+    /** Longest delay time the delay lines can hold, in milliseconds */
+    static constexpr float maxDelayMs = 4000.0f;
+    
 protected:
     /**
-     * @brief Process a single sample (mono)
+     * @brief Process a block of audio
      * 
-     * @param sample The input sample
-     * @return The processed sample
-     */
-    float processSample(float sample) override;
-    
-    /**
-     * @brief Process a single sample (stereo)
+     * A mono block uses the left channel settings. Channels beyond the second
+     * pass through unchanged.
      * 
-     * @param leftSample The left channel input sample
-     * @param rightSample The right channel input sample
-     * @param leftOutput Pointer to store left channel output
-     * @param rightOutput Pointer to store right channel output
+     * @param block The audio to process in place
      */
-    void processSampleStereo(float leftSample, float rightSample, float* leftOutput, float* rightOutput) override;
-    
-    /**
-     * @brief Process a stereo buffer
-     * 
-     * @param leftBuffer Left channel buffer
-     * @param rightBuffer Right channel buffer
-     * @param numSamples Number of samples to process
-     */
-    void processBufferStereo(float* leftBuffer, float* rightBuffer, int numSamples) override;
+    void processBlock(const juce::dsp::AudioBlock<float>& block) override;
     
 private:
     // Delay parameters
@@ -185,19 +186,41 @@ private:
     std::array<float, 2> crossFeedback; // Cross-feedback amount (0-1)
     float tempo; // Tempo in BPM
     
-    // Delay line
-    std::array<std::unique_ptr<juce::AudioBuffer<float>>, 2> delayBuffer;
-    std::array<int, 2> writePosition;
-    std::array<int, 2> delayLength; // Delay length in samples
+    // Delay lines, one power-of-two channel per delay channel
+    juce::AudioBuffer<float> delayBuffer;
+    int delayMask;
+    int writePosition; // Shared by both lines
+    
+    // Delay lengths in samples
+    std::array<std::atomic<int>, 2> targetDelayLength; // Set by the parameters
+    std::array<int, 2> delayLength;     // Tap being played
+    std::array<int, 2> fadeDelayLength; // Tap being faded in, or 0 when not crossfading
+    std::array<int, 2> fadePosition;    // Samples of the crossfade done so far
+    int crossfadeLength;
+    
+    // Delayed, crossfade, and feedback signals for one segment, allocated in prepare()
+    juce::AudioBuffer<float> scratchBuffer;
+    
+    // Length of the crossfade when the delay time changes
+    static constexpr double crossfadeSeconds = 0.05;
     
     // Update delay times based on sync mode and tempo
     void updateDelayTimes();
     
+    // Jump to the target delay times without crossfading
+    void snapDelayTimes();
+    
     // Convert a sync mode to a delay time in milliseconds
     float syncModeToMs(DelayTimeSync mode, float bpm) const;
     
-    // Get a sample from the delay buffer with linear interpolation
-    float getSampleFromDelayBuffer(int channel, float delaySamples);
+    // Copy samples from a delay line, starting a number of samples before the write position
+    void readDelayLine(int channel, int delaySamples, float* destination, int numSamples) const;
+    
+    // Copy samples into a delay line at the write position
+    void writeDelayLine(int channel, const float* source, int numSamples);
+    
+    // Read the delayed signal of a channel, crossfading towards a new delay time if one is pending
+    void readDelayTap(int channel, float* destination, int numSamples);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Delay)
 };
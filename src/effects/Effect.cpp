@@ -6,6 +6,7 @@
  */
 
 #include "Effect.h"
+#include "RingBuffer.h"
 
 namespace UndergroundBeats {
 
@@ -15,9 +16,15 @@ Effect::Effect(const std::string& name)
     , mixLevel(1.0f)
     , currentSampleRate(44100.0)
     , currentBlockSize(512)
+    , maxChannels(2)
+    , currentMix(1.0f)
+    , silentSamples(0)
+    , dryDelaySamples(0)
+    , dryDelayMask(0)
+    , dryWritePosition(0)
 {
     // Initialize temporary buffer for wet/dry mixing
-    tempBuffer.setSize(2, currentBlockSize);
+    tempBuffer.setSize(maxChannels, currentBlockSize);
 }
 
 Effect::~Effect()
@@ -50,77 +57,59 @@ float Effect::getMix() const
     return mixLevel;
 }
 
-void Effect::process(float* buffer, int numSamples)
+double Effect::getTailLengthSeconds() const
 {
-    if (!enabled || mixLevel <= 0.0f)
-    {
-        // Effect is disabled or fully dry, do nothing
-        return;
-    }
+    return 0.0;
+}
+
+int Effect::getLatencySamples() const
+{
+    return 0;
+}
+
+void Effect::process(const juce::dsp::AudioBlock<float>& block)
+{
+    beginBlock();
     
-    if (mixLevel >= 1.0f)
+    if (!enabled)
     {
-        // Effect is fully wet, process in-place
-        processBuffer(buffer, numSamples);
+        // Effect is bypassed, do nothing
         return;
     }
     
-    // Ensure temp buffer is large enough
-    if (tempBuffer.getNumSamples() < numSamples)
+    const size_t numChannels = juce::jmin(block.getNumChannels(), static_cast<size_t>(tempBuffer.getNumChannels()));
+    const size_t numSamples = block.getNumSamples();
+    const size_t chunkSize = static_cast<size_t>(juce::jmax(1, tempBuffer.getNumSamples()));
+    
+    if (numChannels == 0)
     {
-        tempBuffer.setSize(2, numSamples, false, true, true);
+        return;
     }
     
-    // Copy input to temp buffer for wet processing
-    float* tempData = tempBuffer.getWritePointer(0);
-    std::copy(buffer, buffer + numSamples, tempData);
-    
-    // Process the wet signal
-    processBuffer(tempData, numSamples);
+    // Process in pieces no longer than the wet buffer, so it never has to grow
+    const auto channels = block.getSubsetChannelBlock(0, numChannels);
     
-    // Mix wet and dry signals
-    for (int i = 0; i < numSamples; ++i)
+    for (size_t start = 0; start < numSamples; start += chunkSize)
     {
-        buffer[i] = buffer[i] * (1.0f - mixLevel) + tempData[i] * mixLevel;
+        processChunk(channels.getSubBlock(start, juce::jmin(chunkSize, numSamples - start)));
     }
 }
 
+void Effect::process(float* buffer, int numSamples)
+{
+    float* channels[] = { buffer };
+    process(juce::dsp::AudioBlock<float>(channels, 1, static_cast<size_t>(numSamples)));
+}
+
 void Effect::processStereo(float* leftBuffer, float* rightBuffer, int numSamples)
 {
-    if (!enabled || mixLevel <= 0.0f)
-    {
-        // Effect is disabled or fully dry, do nothing
-        return;
-    }
-    
-    if (mixLevel >= 1.0f)
-    {
-        // Effect is fully wet, process in-place
-        processBufferStereo(leftBuffer, rightBuffer, numSamples);
-        return;
-    }
-    
-    // Ensure temp buffer is large enough
-    if (tempBuffer.getNumSamples() < numSamples)
-    {
-        tempBuffer.setSize(2, numSamples, false, true, true);
-    }
-    
-    // Copy input to temp buffer for wet processing
-    float* tempLeft = tempBuffer.getWritePointer(0);
-    float* tempRight = tempBuffer.getWritePointer(1);
-    std::copy(leftBuffer, leftBuffer + numSamples, tempLeft);
-    std::copy(rightBuffer, rightBuffer + numSamples, tempRight);
-    
-    // Process the wet signal
-    processBufferStereo(tempLeft, tempRight, numSamples);
-    
-    // Mix wet and dry signals
-    for (int i = 0; i < numSamples; ++i)
-    {
-        leftBuffer[i] = leftBuffer[i] * (1.0f - mixLevel) + tempLeft[i] * mixLevel;
-        rightBuffer[i] = rightBuffer[i] * (1.0f - mixLevel) + tempRight[i] * mixLevel;
-    }
+    float* channels[] = { leftBuffer, rightBuffer };
+    process(juce::dsp::AudioBlock<float>(channels, 2, static_cast<size_t>(numSamples)));
+}
+
+void Effect::setMaxChannels(int numChannels)
+{
+    maxChannels = juce::jmax(1, numChannels);
 }
 
 void Effect::prepare(double sampleRate, int blockSize)
@@ -129,7 +118,23 @@ void Effect::prepare(double sampleRate, int blockSize)
     currentBlockSize = blockSize;
     
     // Resize temporary buffer
-    tempBuffer.setSize(2, blockSize, false, true, true);
+    tempBuffer.setSize(maxChannels, juce::jmax(1, blockSize), false, true, true);
+    currentMix = mixLevel;
+    
+    // Long enough to write a whole block before reading its delayed copy
+    dryDelaySamples = juce::jmax(0, getLatencySamples());
+    
+    if (dryDelaySamples > 0)
+    {
+        const int delayLength = juce::nextPowerOfTwo(dryDelaySamples + juce::jmax(1, blockSize));
+        dryDelayBuffer.setSize(maxChannels, delayLength, false, true, true);
+        dryDelayMask = delayLength - 1;
+    }
+    else
+    {
+        dryDelayBuffer.setSize(0, 0);
+        dryDelayMask = 0;
+    }
     
     reset();
 }
@@ -138,6 +143,8 @@ void Effect::reset()
 {
     // Clear the temporary buffer
     tempBuffer.clear();
+    dryDelayBuffer.clear();
+    dryWritePosition = 0;
 }
 
 std::unique_ptr<juce::XmlElement> Effect::createStateXml() const
@@ -171,18 +178,30 @@ bool Effect::restoreStateFromXml(const juce::XmlElement* xml)
     return true;
 }
 
-void Effect::processBuffer(float* buffer, int numSamples)
+void Effect::beginBlock()
 {
-    // Default implementation processes samples one by one
-    for (int i = 0; i < numSamples; ++i)
-    {
-        buffer[i] = processSample(buffer[i]);
-    }
+    // Nothing to acknowledge by default
 }
 
-void Effect::processBufferStereo(float* leftBuffer, float* rightBuffer, int numSamples)
+void Effect::processBlock(const juce::dsp::AudioBlock<float>& block)
 {
-    // Default implementation processes samples one by one
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    
+    if (block.getNumChannels() == 1)
+    {
+        float* buffer = block.getChannelPointer(0);
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            buffer[i] = processSample(buffer[i]);
+        }
+        
+        return;
+    }
+    
+    float* leftBuffer = block.getChannelPointer(0);
+    float* rightBuffer = block.getChannelPointer(1);
+    
     for (int i = 0; i < numSamples; ++i)
     {
         float leftOut, rightOut;
@@ -192,4 +211,101 @@ void Effect::processBufferStereo(float* leftBuffer, float* rightBuffer, int numS
     }
 }
 
+float Effect::processSample(float sample)
+{
+    return sample;
+}
+
+void Effect::processSampleStereo(float leftSample, float rightSample, float* leftOutput, float* rightOutput)
+{
+    *leftOutput = leftSample;
+    *rightOutput = rightSample;
+}
+
+void Effect::processChunk(const juce::dsp::AudioBlock<float>& block)
+{
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    
+    // Move the mix towards its target at a fixed rate, linearly across the block
+    const float startMix = currentMix;
+    const float maxChange = static_cast<float>(numSamples / (mixSmoothingSeconds * currentSampleRate));
+    const float endMix = startMix + juce::jlimit(-maxChange, maxChange, mixLevel - startMix);
+    currentMix = endMix;
+    
+    if (startMix == endMix)
+    {
+        if (endMix <= 0.0f)
+        {
+            // Effect is fully dry, do nothing but keep the dry signal in line with the latency
+            delayDry(block, true);
+            return;
+        }
+        
+        if (endMix >= 1.0f)
+        {
+            // Effect is fully wet, process in-place
+            delayDry(block, false);
+            processBlock(block);
+            return;
+        }
+    }
+    
+    // Process a copy of the input to get the wet signal
+    juce::dsp::AudioBlock<float> wet(tempBuffer.getArrayOfWritePointers(), static_cast<size_t>(numChannels),
+                                     static_cast<size_t>(numSamples));
+    wet.copyFrom(block);
+    processBlock(wet);
+    delayDry(block, true);
+    
+    // Mix wet and dry signals
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* dry = block.getChannelPointer(static_cast<size_t>(channel));
+        const float* wetData = wet.getChannelPointer(static_cast<size_t>(channel));
+        
+        if (startMix == endMix)
+        {
+            juce::FloatVectorOperations::multiply(dry, 1.0f - endMix, numSamples);
+            juce::FloatVectorOperations::addWithMultiply(dry, wetData, endMix, numSamples);
+        }
+        else
+        {
+            // No dependency between samples, so the compiler vectorizes the ramp
+            const float mixStep = (endMix - startMix) / static_cast<float>(numSamples);
+            
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float mix = startMix + static_cast<float>(i + 1) * mixStep;
+                dry[i] += mix * (wetData[i] - dry[i]);
+            }
+        }
+    }
+}
+
+void Effect::delayDry(const juce::dsp::AudioBlock<float>& block, bool replace)
+{
+    if (dryDelaySamples == 0)
+    {
+        return;
+    }
+    
+    const int numChannels = juce::jmin(static_cast<int>(block.getNumChannels()), dryDelayBuffer.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* data = block.getChannelPointer(static_cast<size_t>(channel));
+        float* line = dryDelayBuffer.getWritePointer(channel);
+        writeWrapped(line, dryDelayMask, dryWritePosition, data, numSamples);
+        
+        if (replace)
+        {
+            readWrapped(line, dryDelayMask, (dryWritePosition - dryDelaySamples) & dryDelayMask, data, numSamples);
+        }
+    }
+    
+    dryWritePosition = (dryWritePosition + numSamples) & dryDelayMask;
+}
+
 } // namespace UndergroundBeats
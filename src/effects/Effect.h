@@ -20,6 +20,15 @@ namespace UndergroundBeats {
  * The Effect class provides a common interface for all audio effects
  * in the Underground Beats application. It defines methods for processing
  * audio, parameter control, and state management.
+ * 
+ * Audio is processed a block at a time: derived classes override
+ * processBlock(), which receives every channel of a block at once. The
+ * per-sample processSample() and processSampleStereo() methods remain as an
+ * optional adapter for simple effects and are only called by the default
+ * processBlock(). The base class handles the wet/dry mix, which is smoothed
+ * to avoid zipper noise and mixed with vector operations, using a wet buffer
+ * allocated in prepare(). The dry signal of an effect with latency is delayed
+ * to line up with the wet.
  */
 class Effect {
 public:
@@ -61,6 +70,41 @@ public:
      */
     float getMix() const;
     
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * The tail ends once the output has decayed by tailDecayDecibels, below
+     * which an EffectsChain treats audio as silent. The chain stops processing
+     * an effect whose input has been silent for longer than its tail. The
+     * default is no tail.
+     * 
+     * @return Tail length in seconds, or infinity if the tail never ends
+     */
+    virtual double getTailLengthSeconds() const;
+    
+    /**
+     * @brief Get how far the effect delays its output
+     * 
+     * Effects that look ahead or oversample report their delay here so it can
+     * be compensated. The base class delays the dry signal by the latency
+     * reported when the effect was prepared, so derived classes must know it
+     * before calling Effect::prepare(). The default is no delay.
+     * 
+     * @return Latency in samples at the prepared sample rate
+     */
+    virtual int getLatencySamples() const;
+    
+    /**
+     * @brief Process a block of audio in place
+     * 
+     * Channels beyond the number the effect was prepared for pass through
+     * unchanged. Blocks longer than the prepared block size are processed in
+     * pieces, so nothing is allocated.
+     * 
+     * @param block The audio to process
+     */
+    void process(const juce::dsp::AudioBlock<float>& block);
+    
     /**
      * @brief Process a mono buffer of samples
      * 
@@ -78,6 +122,15 @@ public:
      */
     void processStereo(float* leftBuffer, float* rightBuffer, int numSamples);
     
+    /**
+     * @brief Set the number of channels the effect processes
+     * 
+     * Takes effect at the next call to prepare().
+     * 
+     * @param numChannels Number of channels (at least 1, 2 by default)
+     */
+    void setMaxChannels(int numChannels);
+    
     /**
      * @brief Prepare the effect for processing
      * 
@@ -108,62 +161,89 @@ public:
     
 protected:
     /**
-     * @brief Process a single sample (mono)
-     * 
-     * Derived classes must implement this method to process
-     * a single sample.
+     * @brief Mark the start of an audio block (audio thread)
      * 
-     * @param sample The input sample
-     * @return The processed sample
+     * Called before every block, including blocks the effect does not
+     * process because it is bypassed, fully dry, or asleep in a chain, and
+     * possibly more than once per block. Effects that swap state under the
+     * audio thread acknowledge it here. The default does nothing.
      */
-    virtual float processSample(float sample) = 0;
+    virtual void beginBlock();
     
     /**
-     * @brief Process a single sample (stereo)
+     * @brief Process a block of audio to produce the wet signal
      * 
-     * Derived classes must implement this method to process
-     * a single stereo sample.
+     * Derived classes should override this method. The block holds between
+     * one channel and the prepared number of channels, and no more samples
+     * than the prepared block size. The default implementation calls
+     * processSample() for a mono block and processSampleStereo() for the first
+     * two channels of a wider one, once per sample.
      * 
-     * @param leftSample The left channel input sample
-     * @param rightSample The right channel input sample
-     * @param leftOutput Pointer to store left channel output
-     * @param rightOutput Pointer to store right channel output
+     * @param block The audio to process in place
      */
-    virtual void processSampleStereo(float leftSample, float rightSample, float* leftOutput, float* rightOutput) = 0;
+    virtual void processBlock(const juce::dsp::AudioBlock<float>& block);
     
     /**
-     * @brief Process a buffer of samples with custom implementation
+     * @brief Process a single sample (mono)
      * 
-     * Derived classes can optionally override this method to
-     * implement more efficient buffer processing.
+     * Optional adapter for effects that do not override processBlock().
+     * The default returns the sample unchanged.
      * 
-     * @param buffer Buffer containing samples to process
-     * @param numSamples Number of samples to process
+     * @param sample The input sample
+     * @return The processed sample
      */
-    virtual void processBuffer(float* buffer, int numSamples);
+    virtual float processSample(float sample);
     
     /**
-     * @brief Process a stereo buffer with custom implementation
+     * @brief Process a single sample (stereo)
      * 
-     * Derived classes can optionally override this method to
-     * implement more efficient stereo buffer processing.
+     * Optional adapter for effects that do not override processBlock().
+     * The default passes both samples through unchanged.
      * 
-     * @param leftBuffer Left channel buffer
-     * @param rightBuffer Right channel buffer
-     * @param numSamples Number of samples to process
+     * @param leftSample The left channel input sample
+     * @param rightSample The right channel input sample
+     * @param leftOutput Pointer to store left channel output
+     * @param rightOutput Pointer to store right channel output
      */
-    virtual void processBufferStereo(float* leftBuffer, float* rightBuffer, int numSamples);
+    virtual void processSampleStereo(float leftSample, float rightSample, float* leftOutput, float* rightOutput);
     
     std::string effectName;
     bool enabled;
-    float mixLevel;
+    float mixLevel;             // Target wet/dry mix
     double currentSampleRate;
     int currentBlockSize;
+    int maxChannels;
     
-    // Temporary buffer for wet/dry mixing
+    // Wet signal for wet/dry mixing, one channel per processed channel
     juce::AudioBuffer<float> tempBuffer;
     
+    // Decay after which a tail counts as silent
+    static constexpr double tailDecayDecibels = 90.0;
+    
 private:
+    friend class EffectsChain;
+    
+    // Mix reached by the smoothing, updated on the audio thread
+    float currentMix;
+    
+    // Consecutive samples of silent input, counted by the chain on the audio thread
+    juce::int64 silentSamples;
+    
+    // Dry signal delayed by the latency, one power-of-two line per channel
+    juce::AudioBuffer<float> dryDelayBuffer;
+    int dryDelaySamples;
+    int dryDelayMask;
+    int dryWritePosition;
+    
+    // Time for the mix to sweep its whole range
+    static constexpr double mixSmoothingSeconds = 0.02;
+    
+    // Process and mix a block no longer than the prepared block size
+    void processChunk(const juce::dsp::AudioBlock<float>& block);
+    
+    // Write a block into the dry delay, replacing it with the delayed copy if asked
+    void delayDry(const juce::dsp::AudioBlock<float>& block, bool replace);
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Effect)
 };
 
@@ -8,17 +8,39 @@
 #include "EffectsChain.h"
 #include "Delay.h"
 #include "Reverb.h"
+#include "ConvolutionReverb.h"
+#include "FDNReverb.h"
+#include "Compressor.h"
+#include "ParametricEQ.h"
+#include "Saturation.h"
+#include <algorithm>
 
 namespace UndergroundBeats {
 
 EffectsChain::EffectsChain()
     : currentSampleRate(44100.0)
     , currentBlockSize(512)
+    , crossfadeSeconds(defaultCrossfadeSeconds)
+    , autoBypass(true)
+    , snapshot(nullptr)
+    , settledVersion(0)
+    , activeSnapshot(nullptr)
+    , fadePosition(0)
 {
+    // Start with an empty snapshot, so the audio thread always has one
+    snapshotOwner = std::make_unique<Snapshot>();
+    snapshotOwner->version = 0;
+    snapshotOwner->fadeLength = 0;
+    snapshot.store(snapshotOwner.get(), std::memory_order_release);
+    
+    dryBuffer.setSize(2, currentBlockSize);
+    
+    ReclaimThread::getInstance().addClient(this);
 }
 
 EffectsChain::~EffectsChain()
 {
+    ReclaimThread::getInstance().removeClient(this);
 }
 
 int EffectsChain::addEffect(std::unique_ptr<Effect> effect)
@@ -31,8 +53,11 @@ int EffectsChain::addEffect(std::unique_ptr<Effect> effect)
     // Prepare the effect with the current sample rate and block size
     effect->prepare(currentSampleRate, currentBlockSize);
     
+    const juce::ScopedLock sl(lock);
+    
     // Add the effect to the chain
     effects.push_back(std::move(effect));
+    publishSnapshot({});
     
     // Return the index of the added effect
     return static_cast<int>(effects.size() - 1);
@@ -40,19 +65,26 @@ int EffectsChain::addEffect(std::unique_ptr<Effect> effect)
 
 bool EffectsChain::removeEffect(int index)
 {
+    const juce::ScopedLock sl(lock);
+    
     if (index < 0 || index >= static_cast<int>(effects.size()))
     {
         return false;
     }
     
-    // Remove the effect from the chain
+    // Remove the effect from the chain, leaving it to fade out where it was
+    std::vector<RemovedEffect> removed;
+    removed.push_back({ index, std::move(effects[static_cast<size_t>(index)]) });
     effects.erase(effects.begin() + index);
+    publishSnapshot(std::move(removed));
     
     return true;
 }
 
 Effect* EffectsChain::getEffect(int index)
 {
+    const juce::ScopedLock sl(lock);
+    
     if (index < 0 || index >= static_cast<int>(effects.size()))
     {
         return nullptr;
@@ -63,6 +95,8 @@ Effect* EffectsChain::getEffect(int index)
 
 Effect* EffectsChain::getEffectByName(const std::string& name)
 {
+    const juce::ScopedLock sl(lock);
+    
     // Search for an effect with the specified name
     for (auto& effect : effects)
     {
@@ -77,6 +111,8 @@ Effect* EffectsChain::getEffectByName(const std::string& name)
 
 bool EffectsChain::moveEffect(int currentIndex, int newIndex)
 {
+    const juce::ScopedLock sl(lock);
+    
     if (currentIndex < 0 || currentIndex >= static_cast<int>(effects.size()) ||
         newIndex < 0 || newIndex >= static_cast<int>(effects.size()) ||
         currentIndex == newIndex)
@@ -84,10 +120,12 @@ bool EffectsChain::moveEffect(int currentIndex, int newIndex)
         return false;
     }
     
-    // Move the effect to the new position
+    // Move the effect to the new position, crossfading it from the old one
     auto effect = std::move(effects[currentIndex]);
+    Effect* moved = effect.get();
     effects.erase(effects.begin() + currentIndex);
     effects.insert(effects.begin() + newIndex, std::move(effect));
+    publishSnapshot({}, moved, currentIndex);
     
     return true;
 }
@@ -97,40 +135,256 @@ int EffectsChain::getNumEffects() const
     return static_cast<int>(effects.size());
 }
 
-void EffectsChain::process(float* buffer, int numSamples)
+bool EffectsChain::isEmpty() const
 {
-    // Process the buffer through each effect in the chain
-    for (auto& effect : effects)
+    return activeSnapshot == nullptr || activeSnapshot->slots.empty();
+}
+
+int EffectsChain::getLatencySamples() const
+{
+    int latency = 0;
+    
+    for (const auto& effect : effects)
     {
         if (effect->isEnabled())
         {
-            effect->process(buffer, numSamples);
+            latency += effect->getLatencySamples();
         }
     }
+    
+    return latency;
+}
+
+void EffectsChain::setCrossfadeTime(double seconds)
+{
+    const juce::ScopedLock sl(lock);
+    crossfadeSeconds = juce::jmax(0.0, seconds);
+}
+
+double EffectsChain::getCrossfadeTime() const
+{
+    const juce::ScopedLock sl(lock);
+    return crossfadeSeconds;
+}
+
+void EffectsChain::setAutoBypass(bool enabled)
+{
+    autoBypass.store(enabled, std::memory_order_relaxed);
+}
+
+bool EffectsChain::getAutoBypass() const
+{
+    return autoBypass.load(std::memory_order_relaxed);
+}
+
+void EffectsChain::process(const juce::dsp::AudioBlock<float>& block)
+{
+    // Tell the reclaim thread no snapshot older than the one about to be taken up is still in use
+    retired.acknowledge();
+    
+    // Take up the latest snapshot at the block boundary
+    Snapshot* latest = snapshot.load(std::memory_order_acquire);
+    
+    if (latest != activeSnapshot)
+    {
+        activeSnapshot = latest;
+        fadePosition = 0;
+    }
+    
+    const bool fading = fadePosition < activeSnapshot->fadeLength;
+    const bool bypassSilence = autoBypass.load(std::memory_order_relaxed);
+    
+    // Whether the block is silent, checked only when an effect asks and the audio has changed since
+    bool silenceChecked = false;
+    bool inputSilent = false;
+    
+    // Process the block through each effect in the chain
+    for (const auto& slot : activeSnapshot->slots)
+    {
+        if (!slot.effect->isEnabled())
+        {
+            slot.effect->beginBlock();
+            continue;
+        }
+        
+        if (fading && slot.fade != SlotFade::None)
+        {
+            processFading(slot, block);
+            silenceChecked = false;
+        }
+        else if (slot.fade != SlotFade::Out && slot.fade != SlotFade::MoveOut)
+        {
+            if (bypassSilence)
+            {
+                if (!silenceChecked)
+                {
+                    inputSilent = isSilent(block);
+                    silenceChecked = true;
+                }
+                
+                // A sleeping effect leaves the silent block as it is
+                if (isAsleep(*slot.effect, block, inputSilent))
+                {
+                    slot.effect->beginBlock();
+                    continue;
+                }
+            }
+            
+            slot.effect->process(block);
+            silenceChecked = false;
+        }
+    }
+    
+    if (fading)
+    {
+        fadePosition = juce::jmin(activeSnapshot->fadeLength, fadePosition + static_cast<int>(block.getNumSamples()));
+        
+        if (fadePosition >= activeSnapshot->fadeLength)
+        {
+            settledVersion.store(activeSnapshot->version, std::memory_order_release);
+        }
+    }
+}
+
+void EffectsChain::process(float* buffer, int numSamples)
+{
+    float* channels[] = { buffer };
+    process(juce::dsp::AudioBlock<float>(channels, 1, static_cast<size_t>(numSamples)));
 }
 
 void EffectsChain::processStereo(float* leftBuffer, float* rightBuffer, int numSamples)
 {
-    // Process the buffer through each effect in the chain
-    for (auto& effect : effects)
+    float* channels[] = { leftBuffer, rightBuffer };
+    process(juce::dsp::AudioBlock<float>(channels, 2, static_cast<size_t>(numSamples)));
+}
+
+bool EffectsChain::isSilent(const juce::dsp::AudioBlock<float>& block)
+{
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    
+    for (size_t channel = 0; channel < block.getNumChannels(); ++channel)
     {
-        if (effect->isEnabled())
+        const auto range = juce::FloatVectorOperations::findMinAndMax(block.getChannelPointer(channel), numSamples);
+        
+        if (range.getEnd() > silenceThreshold || range.getStart() < -silenceThreshold)
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool EffectsChain::isAsleep(Effect& effect, const juce::dsp::AudioBlock<float>& block, bool inputSilent) const
+{
+    // Any sound wakes the effect at once
+    if (!inputSilent)
+    {
+        effect.silentSamples = 0;
+        return false;
+    }
+    
+    // The effect sleeps once the silence has outlasted its tail, which may never end
+    const double tailSamples = effect.getTailLengthSeconds() * currentSampleRate;
+    const bool asleep = static_cast<double>(effect.silentSamples) >= tailSamples;
+    
+    if (!asleep)
+    {
+        effect.silentSamples += static_cast<juce::int64>(block.getNumSamples());
+    }
+    
+    return asleep;
+}
+
+float EffectsChain::getFadeGain(SlotFade fade, float progress)
+{
+    switch (fade)
+    {
+        case SlotFade::In:
+            return progress;
+            
+        case SlotFade::Out:
+            return 1.0f - progress;
+            
+        case SlotFade::MoveIn:
+            return juce::jmax(0.0f, 2.0f * progress - 1.0f);
+            
+        case SlotFade::MoveOut:
+            return juce::jmax(0.0f, 1.0f - 2.0f * progress);
+            
+        case SlotFade::None:
+            break;
+    }
+    
+    return 1.0f;
+}
+
+void EffectsChain::processFading(const Slot& slot, const juce::dsp::AudioBlock<float>& block)
+{
+    const size_t numChannels = juce::jmin(block.getNumChannels(), static_cast<size_t>(dryBuffer.getNumChannels()));
+    const size_t numSamples = block.getNumSamples();
+    const size_t chunkSize = static_cast<size_t>(juce::jmax(1, dryBuffer.getNumSamples()));
+    const float fadeScale = 1.0f / static_cast<float>(activeSnapshot->fadeLength);
+    const auto channels = block.getSubsetChannelBlock(0, numChannels);
+    
+    // A moved effect processes at its old place until halfway through the fade, and at its new place after
+    const int halfway = activeSnapshot->fadeLength / 2 - fadePosition;
+    const size_t split = static_cast<size_t>(juce::jlimit(0, static_cast<int>(numSamples), halfway));
+    const size_t first = slot.fade == SlotFade::MoveIn ? split : 0;
+    const size_t last = slot.fade == SlotFade::MoveOut ? split : numSamples;
+    
+    // Work in pieces no longer than the dry buffer, so it never has to grow
+    for (size_t start = first; start < last; start += chunkSize)
+    {
+        const size_t length = juce::jmin(chunkSize, last - start);
+        const auto chunk = channels.getSubBlock(start, length);
+        
+        for (size_t channel = 0; channel < numChannels; ++channel)
         {
-            effect->processStereo(leftBuffer, rightBuffer, numSamples);
+            juce::FloatVectorOperations::copy(dryBuffer.getWritePointer(static_cast<int>(channel)),
+                                              chunk.getChannelPointer(channel), static_cast<int>(length));
+        }
+        
+        slot.effect->process(chunk);
+        
+        // Blend from the signal without the effect to the signal with it, or back
+        const int fadeStart = fadePosition + static_cast<int>(start);
+        
+        for (size_t channel = 0; channel < numChannels; ++channel)
+        {
+            const float* dry = dryBuffer.getReadPointer(static_cast<int>(channel));
+            float* wet = chunk.getChannelPointer(channel);
+            
+            for (size_t i = 0; i < length; ++i)
+            {
+                const float progress = juce::jmin(1.0f, static_cast<float>(fadeStart + static_cast<int>(i)) * fadeScale);
+                wet[i] = dry[i] + getFadeGain(slot.fade, progress) * (wet[i] - dry[i]);
+            }
         }
     }
 }
 
 void EffectsChain::prepare(double sampleRate, int blockSize)
 {
+    const juce::ScopedLock sl(lock);
+    
     currentSampleRate = sampleRate;
     currentBlockSize = blockSize;
+    dryBuffer.setSize(2, blockSize);
     
-    // Prepare all effects in the chain
+    // Prepare all effects in the chain, including any still fading out
     for (auto& effect : effects)
     {
         effect->prepare(sampleRate, blockSize);
     }
+    
+    for (auto& effect : fadingEffects)
+    {
+        effect->prepare(sampleRate, blockSize);
+    }
+    
+    // Fade lengths are in samples, so publish them again for the new rate
+    publishSnapshot({});
 }
 
 void EffectsChain::reset()
@@ -164,15 +418,9 @@ bool EffectsChain::restoreStateFromXml(const juce::XmlElement* xml)
         return false;
     }
     
-    // Clear the current effects chain
-    effects.clear();
-    
     // Get the number of effects to restore
     int numEffects = xml->getNumChildElements();
     
-    // Resize the effects vector
-    effects.reserve(numEffects);
-    
     // Temporary vector to hold effects before sorting
     std::vector<std::pair<int, std::unique_ptr<Effect>>> tempEffects;
     tempEffects.reserve(numEffects);
@@ -211,6 +459,26 @@ bool EffectsChain::restoreStateFromXml(const juce::XmlElement* xml)
             {
                 effect = std::make_unique<Reverb>();
             }
+            else if (name == "ConvolutionReverb")
+            {
+                effect = std::make_unique<ConvolutionReverb>();
+            }
+            else if (name == "FDNReverb")
+            {
+                effect = std::make_unique<FDNReverb>();
+            }
+            else if (name == "Compressor")
+            {
+                effect = std::make_unique<Compressor>();
+            }
+            else if (name == "ParametricEQ")
+            {
+                effect = std::make_unique<ParametricEQ>();
+            }
+            else if (name == "Saturation")
+            {
+                effect = std::make_unique<Saturation>();
+            }
             // Add other effect types here
         }
         
@@ -231,13 +499,117 @@ bool EffectsChain::restoreStateFromXml(const juce::XmlElement* xml)
     std::sort(tempEffects.begin(), tempEffects.end(),
               [](const auto& a, const auto& b) { return a.first < b.first; });
     
+    // The restored effects are ready, so only now replace the current ones
+    const juce::ScopedLock sl(lock);
+    
+    std::vector<RemovedEffect> removed;
+    removed.reserve(effects.size());
+    
+    for (size_t i = 0; i < effects.size(); ++i)
+    {
+        removed.push_back({ static_cast<int>(i), std::move(effects[i]) });
+    }
+    
+    effects.clear();
+    effects.reserve(tempEffects.size());
+    
     // Add sorted effects to the chain
     for (auto& [index, effect] : tempEffects)
     {
         effects.push_back(std::move(effect));
     }
     
+    publishSnapshot(std::move(removed));
+    
     return true;
 }
 
+void EffectsChain::publishSnapshot(std::vector<RemovedEffect> removed, Effect* moved, int movedFrom)
+{
+    const bool crossfade = crossfadeSeconds > 0.0;
+    
+    auto newSnapshot = std::make_unique<Snapshot>();
+    newSnapshot->fadeLength = crossfade ? juce::jmax(1, juce::roundToInt(crossfadeSeconds * currentSampleRate)) : 0;
+    newSnapshot->slots.reserve(effects.size() + removed.size());
+    
+    // Effects missing from the current snapshot are new, and fade in
+    for (auto& effect : effects)
+    {
+        const auto& currentSlots = snapshotOwner->slots;
+        const bool isNew = std::none_of(currentSlots.begin(), currentSlots.end(),
+                                        [&effect](const Slot& slot)
+                                        {
+                                            return slot.effect == effect.get() && slot.fade != SlotFade::Out;
+                                        });
+        
+        if (crossfade && effect.get() == moved)
+            newSnapshot->slots.push_back({ effect.get(), SlotFade::MoveIn });
+        else
+            newSnapshot->slots.push_back({ effect.get(), crossfade && isNew ? SlotFade::In : SlotFade::None });
+    }
+    
+    // A moved effect also stays where it was until halfway through the crossfade
+    if (crossfade && moved != nullptr)
+    {
+        const auto to = std::find_if(newSnapshot->slots.begin(), newSnapshot->slots.end(),
+                                     [moved](const Slot& slot) { return slot.effect == moved; });
+        
+        // Past its new place, the old place is one further along
+        const int index = movedFrom > static_cast<int>(to - newSnapshot->slots.begin()) ? movedFrom + 1 : movedFrom;
+        newSnapshot->slots.insert(newSnapshot->slots.begin() + index, { moved, SlotFade::MoveOut });
+    }
+    
+    // Effects still fading out from an earlier edit are cut off here
+    std::vector<std::unique_ptr<Effect>> released = std::move(fadingEffects);
+    fadingEffects.clear();
+    
+    for (auto& entry : removed)
+    {
+        if (crossfade)
+        {
+            const int index = juce::jlimit(0, static_cast<int>(newSnapshot->slots.size()), entry.index);
+            newSnapshot->slots.insert(newSnapshot->slots.begin() + index, { entry.effect.get(), SlotFade::Out });
+            fadingEffects.push_back(std::move(entry.effect));
+        }
+        else
+        {
+            released.push_back(std::move(entry.effect));
+        }
+    }
+    
+    newSnapshot->version = retired.getPublishedVersion() + 1;
+    
+    // The replaced snapshot and released effects stay alive until the audio thread takes up this version
+    snapshot.store(newSnapshot.get(), std::memory_order_release);
+    retired.retire(std::move(snapshotOwner));
+    
+    for (auto& effect : released)
+    {
+        retired.retire(std::move(effect));
+    }
+    
+    snapshotOwner = std::move(newSnapshot);
+    retired.publish();
+}
+
+bool EffectsChain::serve()
+{
+    const juce::ScopedLock sl(lock);
+    
+    // Once the crossfade has finished, drop the faded-out effects and old places of moved effects from the chain
+    const auto& slots = snapshotOwner->slots;
+    const bool hasFadedOut = std::any_of(slots.begin(), slots.end(),
+                                         [](const Slot& slot)
+                                         {
+                                             return slot.fade == SlotFade::Out || slot.fade == SlotFade::MoveOut;
+                                         });
+    
+    if (hasFadedOut && settledVersion.load(std::memory_order_acquire) == retired.getPublishedVersion())
+    {
+        publishSnapshot({});
+    }
+    
+    return false;
+}
+
 } // namespace UndergroundBeats
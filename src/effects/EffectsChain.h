@@ -8,6 +8,8 @@
 #pragma once
 
 #include "Effect.h"
+#include "DeferredRelease.h"
+#include <atomic>
 #include <vector>
 #include <memory>
 #include <string>
@@ -21,14 +23,34 @@ namespace UndergroundBeats {
  * The EffectsChain class manages a chain of audio effects, handling the
  * routing of audio through each effect in sequence and providing methods
  * to add, remove, and reorder effects.
+ * 
+ * The chain is edited on the message thread and read by the audio thread
+ * through immutable snapshots. Every edit builds a new snapshot and publishes
+ * it with an atomic pointer; the audio thread picks it up at the start of its
+ * next block, so it never waits on a lock or sees a half-edited chain. Effects
+ * are prepared before they are published, and replaced snapshots and removed
+ * effects are destroyed by the ReclaimThread once the audio thread has moved
+ * past them.
+ * 
+ * With a crossfade time set, added effects fade in and removed effects fade
+ * out across their place in the chain. A moved effect fades out of its old
+ * place over the first half of the crossfade and into its new place over the
+ * second, so it only ever processes the audio at one of them.
+ * 
+ * With auto-bypass on, an effect whose input has been silent for longer than
+ * its tail is put to sleep and skipped, and woken as soon as its input is not
+ * silent. Silence is checked with a vectorized peak search, at most once
+ * between effects that change the audio.
  */
-class EffectsChain {
+class EffectsChain : private ServiceThread::Client {
 public:
     EffectsChain();
-    ~EffectsChain();
+    ~EffectsChain() override;
     
     /**
-     * @brief Add an effect to the chain
+     * @brief Add an effect to the chain (message thread)
+     * 
+     * The effect is prepared before the audio thread can see it.
      * 
      * @param effect The effect to add
      * @return The index of the added effect
@@ -36,7 +58,10 @@ public:
     int addEffect(std::unique_ptr<Effect> effect);
     
     /**
-     * @brief Remove an effect from the chain
+     * @brief Remove an effect from the chain (message thread)
+     * 
+     * The effect is destroyed in the background once the audio thread has
+     * finished with it.
      * 
      * @param index The index of the effect to remove
      * @return true if the effect was removed
@@ -60,7 +85,7 @@ public:
     Effect* getEffectByName(const std::string& name);
     
     /**
-     * @brief Move an effect to a new position in the chain
+     * @brief Move an effect to a new position in the chain (message thread)
      * 
      * @param currentIndex The current index of the effect
      * @param newIndex The new index for the effect
@@ -75,6 +100,57 @@ public:
      */
     int getNumEffects() const;
     
+    /**
+     * @brief Check whether the last processed block went through no effects (audio thread)
+     * 
+     * @return true if the chain held no effects, not even ones fading out, when it last processed
+     */
+    bool isEmpty() const;
+    
+    /**
+     * @brief Get how far the chain delays its output
+     * 
+     * The sum of the latencies of the enabled effects (message thread).
+     * 
+     * @return Latency in samples
+     */
+    int getLatencySamples() const;
+    
+    /**
+     * @brief Set the crossfade time for added and removed effects
+     * 
+     * @param seconds Crossfade time in seconds, or 0 to switch at the next block
+     */
+    void setCrossfadeTime(double seconds);
+    
+    /**
+     * @brief Get the crossfade time for added and removed effects
+     * 
+     * @return Crossfade time in seconds
+     */
+    double getCrossfadeTime() const;
+    
+    /**
+     * @brief Set whether effects sleep once their input and tail are silent
+     * 
+     * @param enabled true to skip sleeping effects (the default)
+     */
+    void setAutoBypass(bool enabled);
+    
+    /**
+     * @brief Check whether effects sleep once their input and tail are silent
+     * 
+     * @return true if auto-bypass is enabled
+     */
+    bool getAutoBypass() const;
+    
+    /**
+     * @brief Process a block of audio through the effect chain in place
+     * 
+     * @param block The audio to process
+     */
+    void process(const juce::dsp::AudioBlock<float>& block);
+    
     /**
      * @brief Process a mono buffer of samples through the effect chain
      * 
@@ -95,6 +171,8 @@ public:
     /**
      * @brief Prepare the effect chain for processing
      * 
+     * Prepares every effect, so it must not run alongside processing.
+     * 
      * @param sampleRate The sample rate in Hz
      * @param blockSize The maximum block size in samples
      */
@@ -113,7 +191,10 @@ public:
     std::unique_ptr<juce::XmlElement> createStateXml() const;
     
     /**
-     * @brief Restore effect chain state from an XML element
+     * @brief Restore effect chain state from an XML element (message thread)
+     * 
+     * The restored effects are created and prepared before they replace the
+     * current ones, which fade out while the new ones fade in.
      * 
      * @param xml XML element containing effect chain state
      * @return true if state was successfully restored
@@ -121,9 +202,83 @@ public:
     bool restoreStateFromXml(const juce::XmlElement* xml);
     
 private:
+    // How an effect in a snapshot is faded when the snapshot takes over
+    enum class SlotFade {
+        None,
+        In,
+        Out,
+        MoveIn,     // Second half of a move: fades in at the new place
+        MoveOut     // First half of a move: fades out of the old place
+    };
+    
+    struct Slot {
+        Effect* effect;
+        SlotFade fade;
+    };
+    
+    // Immutable chain order read by the audio thread
+    struct Snapshot {
+        juce::uint32 version;
+        std::vector<Slot> slots;
+        int fadeLength;     // Crossfade length in samples
+    };
+    
+    // An effect taken out of the chain, and where it was
+    struct RemovedEffect {
+        int index;
+        std::unique_ptr<Effect> effect;
+    };
+    
+    // Effects in chain order, edited on the message thread
     std::vector<std::unique_ptr<Effect>> effects;
+    
+    // Removed effects still fading out in the published snapshot
+    std::vector<std::unique_ptr<Effect>> fadingEffects;
+    
     double currentSampleRate;
     int currentBlockSize;
+    double crossfadeSeconds;
+    std::atomic<bool> autoBypass;
+    
+    // Snapshot read by the audio thread, and the owner that keeps it alive
+    std::atomic<Snapshot*> snapshot;
+    std::unique_ptr<Snapshot> snapshotOwner;
+    
+    // Replaced snapshots and removed effects, held until the audio thread has moved past them
+    DeferredRelease retired;
+    std::atomic<juce::uint32> settledVersion;   // Latest version whose crossfade has finished
+    
+    // Guards the published state against the reclaim thread
+    juce::CriticalSection lock;
+    
+    // Audio thread state
+    Snapshot* activeSnapshot;
+    int fadePosition;
+    juce::AudioBuffer<float> dryBuffer;
+    
+    static constexpr double defaultCrossfadeSeconds = 0.02;
+    
+    // Peak level below which audio counts as silent (-90 dBFS, matching Effect::tailDecayDecibels)
+    static constexpr float silenceThreshold = 3.1622777e-5f;
+    
+    // Publish a snapshot of the current chain, fading removed effects out where they were
+    // and a moved effect from its old place to its new one (lock must be held)
+    void publishSnapshot(std::vector<RemovedEffect> removed, Effect* moved = nullptr, int movedFrom = -1);
+    
+    // Drop the faded-out effects once their crossfade has finished (reclaim thread)
+    bool serve() override;
+    
+    // Check whether every channel of a block peaks below the silence threshold
+    static bool isSilent(const juce::dsp::AudioBlock<float>& block);
+    
+    // Count the effect's silent input and check whether its tail has finished (audio thread)
+    bool isAsleep(Effect& effect, const juce::dsp::AudioBlock<float>& block, bool inputSilent) const;
+    
+    // Gain of an effect's output against its input at a point through the crossfade
+    static float getFadeGain(SlotFade fade, float progress);
+    
+    // Process an effect that is fading in or out of the chain
+    void processFading(const Slot& slot, const juce::dsp::AudioBlock<float>& block);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EffectsChain)
 };
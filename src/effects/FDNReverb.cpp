@@ -0,0 +1,373 @@
+/*
+ * Underground Beats
+ * FDNReverb.cpp
+ * 
+ * Implementation of the feedback delay network reverb
+ */
+
+#include "FDNReverb.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Delay of each line, spread so their echoes rarely line up
+constexpr float lineDelaysMs[FDNReverb::numLines] = { 31.7f, 37.3f, 41.9f, 47.1f, 53.9f, 59.3f, 66.1f, 72.7f };
+
+// Modulation of each line's read position
+constexpr float modulationRatesHz[FDNReverb::numLines] = { 0.31f, 0.43f, 0.53f, 0.61f, 0.73f, 0.83f, 0.97f, 1.07f };
+constexpr float modulationDepthMs = 0.25f;
+
+// Decay time range covered by the room size
+constexpr float minDecaySeconds = 0.2f;
+constexpr float maxDecaySeconds = 10.0f;
+
+// Cutoff of the damping filter at no damping and full damping
+constexpr float brightCutoffHz = 20000.0f;
+constexpr float darkCutoffHz = 1000.0f;
+
+// Orthogonal mixing: an unnormalized Hadamard transform as butterflies, unrolled by the compiler
+void applyHadamard(std::array<float, FDNReverb::numLines>& values)
+{
+    for (int stride = 1; stride < FDNReverb::numLines; stride *= 2)
+    {
+        for (int start = 0; start < FDNReverb::numLines; start += 2 * stride)
+        {
+            for (int i = start; i < start + stride; ++i)
+            {
+                const float sum = values[static_cast<size_t>(i)] + values[static_cast<size_t>(i + stride)];
+                const float difference = values[static_cast<size_t>(i)] - values[static_cast<size_t>(i + stride)];
+                values[static_cast<size_t>(i)] = sum;
+                values[static_cast<size_t>(i + stride)] = difference;
+            }
+        }
+    }
+}
+
+} // namespace
+
+FDNReverb::FDNReverb()
+    : Effect("FDNReverb")
+    , roomSize(0.5f)
+    , damping(0.5f)
+    , width(1.0f)
+    , freeze(false)
+    , delayMask(0)
+    , writePosition(0)
+{
+    baseDelays.fill(1.0f);
+    modulationDepths.fill(0.0f);
+    gains.fill(0.0f);
+    dampingCoefficients.fill(0.0f);
+    lowpassStates.fill(0.0f);
+    sines.fill(0.0f);
+    cosines.fill(1.0f);
+    rotationSines.fill(0.0f);
+    rotationCosines.fill(1.0f);
+}
+
+FDNReverb::~FDNReverb()
+{
+}
+
+void FDNReverb::setRoomSize(float size)
+{
+    roomSize = juce::jlimit(0.0f, 1.0f, size);
+}
+
+float FDNReverb::getRoomSize() const
+{
+    return roomSize;
+}
+
+void FDNReverb::setDamping(float amount)
+{
+    damping = juce::jlimit(0.0f, 1.0f, amount);
+}
+
+float FDNReverb::getDamping() const
+{
+    return damping;
+}
+
+void FDNReverb::setWidth(float width)
+{
+    this->width = juce::jlimit(0.0f, 1.0f, width);
+}
+
+float FDNReverb::getWidth() const
+{
+    return width;
+}
+
+void FDNReverb::setFreeze(bool freeze)
+{
+    this->freeze = freeze;
+}
+
+bool FDNReverb::getFreeze() const
+{
+    return freeze;
+}
+
+void FDNReverb::prepare(double sampleRate, int blockSize)
+{
+    Effect::prepare(sampleRate, blockSize);
+    
+    const float samplesPerMs = static_cast<float>(sampleRate / 1000.0);
+    int longestDelay = 0;
+    
+    for (int line = 0; line < numLines; ++line)
+    {
+        const size_t index = static_cast<size_t>(line);
+        // Whole-sample centres, so an unmodulated line reads without interpolation loss
+        baseDelays[index] = static_cast<float>(juce::roundToInt(lineDelaysMs[line] * samplesPerMs));
+        longestDelay = juce::jmax(longestDelay, static_cast<int>(std::ceil(baseDelays[index] + modulationDepthMs * samplesPerMs)) + 2);
+        
+        // Start the sines at staggered phases so the lines never move together
+        const double phase = juce::MathConstants<double>::twoPi * line / numLines;
+        const double rotation = juce::MathConstants<double>::twoPi * modulationRatesHz[line] / sampleRate;
+        sines[index] = static_cast<float>(std::sin(phase));
+        cosines[index] = static_cast<float>(std::cos(phase));
+        rotationSines[index] = static_cast<float>(std::sin(rotation));
+        rotationCosines[index] = static_cast<float>(std::cos(rotation));
+    }
+    
+    // Allocate the interleaved lines once, rounded up to a power of two so indices wrap with a mask
+    const int lineLength = juce::nextPowerOfTwo(longestDelay);
+    delayBuffer.assign(static_cast<size_t>(lineLength * numLines), 0.0f);
+    delayMask = lineLength - 1;
+    writePosition = 0;
+    
+    // Start at the current settings rather than ramping from silence
+    calculateTargets(gains, dampingCoefficients, modulationDepths);
+    lowpassStates.fill(0.0f);
+}
+
+void FDNReverb::reset()
+{
+    Effect::reset();
+    
+    std::fill(delayBuffer.begin(), delayBuffer.end(), 0.0f);
+    lowpassStates.fill(0.0f);
+    writePosition = 0;
+}
+
+double FDNReverb::getTailLengthSeconds() const
+{
+    if (freeze)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    
+    // The decay time covers 60 dB, scaled to the full tail, plus the longest line
+    return getDecaySeconds() * tailDecayDecibels / 60.0 + lineDelaysMs[numLines - 1] / 1000.0;
+}
+
+std::unique_ptr<juce::XmlElement> FDNReverb::createStateXml() const
+{
+    auto xml = Effect::createStateXml();
+    
+    // Add reverb-specific attributes
+    xml->setAttribute("roomSize", roomSize);
+    xml->setAttribute("damping", damping);
+    xml->setAttribute("width", width);
+    xml->setAttribute("freeze", freeze);
+    
+    return xml;
+}
+
+bool FDNReverb::restoreStateFromXml(const juce::XmlElement* xml)
+{
+    if (!Effect::restoreStateFromXml(xml))
+    {
+        return false;
+    }
+    
+    // Restore reverb-specific attributes
+    if (xml->hasAttribute("roomSize"))
+    {
+        setRoomSize(xml->getDoubleAttribute("roomSize", 0.5f));
+    }
+    
+    if (xml->hasAttribute("damping"))
+    {
+        setDamping(xml->getDoubleAttribute("damping", 0.5f));
+    }
+    
+    if (xml->hasAttribute("width"))
+    {
+        setWidth(xml->getDoubleAttribute("width", 1.0f));
+    }
+    
+    if (xml->hasAttribute("freeze"))
+    {
+        setFreeze(xml->getBoolAttribute("freeze", false));
+    }
+    
+    return true;
+}
+
+void FDNReverb::processBlock(const juce::dsp::AudioBlock<float>& block)
+{
+    if (delayBuffer.empty())
+    {
+        return;
+    }
+    
+    // The network decays towards zero, so keep it out of denormals
+    juce::ScopedNoDenormals noDenormals;
+    
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    const bool isStereo = block.getNumChannels() > 1;
+    float* left = block.getChannelPointer(0);
+    float* right = isStereo ? block.getChannelPointer(1) : left;
+    
+    // Ramp the gains, damping, and modulation to the current settings across the block
+    alignas(32) LineArray targetGains;
+    alignas(32) LineArray targetDamping;
+    alignas(32) LineArray targetDepths;
+    alignas(32) LineArray gainSteps;
+    alignas(32) LineArray dampingSteps;
+    alignas(32) LineArray depthSteps;
+    calculateTargets(targetGains, targetDamping, targetDepths);
+    
+    const float rampScale = 1.0f / static_cast<float>(juce::jmax(1, numSamples));
+    
+    for (int line = 0; line < numLines; ++line)
+    {
+        const size_t index = static_cast<size_t>(line);
+        gainSteps[index] = (targetGains[index] - gains[index]) * rampScale;
+        dampingSteps[index] = (targetDamping[index] - dampingCoefficients[index]) * rampScale;
+        depthSteps[index] = (targetDepths[index] - modulationDepths[index]) * rampScale;
+    }
+    
+    // A frozen network takes no input
+    const float inputGain = freeze ? 0.0f : 1.0f;
+    
+    // Even lines feed the left output and odd lines the right; width blends the two
+    const float outputScale = 1.0f / std::sqrt(static_cast<float>(numLines / 2));
+    const float directGain = outputScale * (0.5f + 0.5f * width);
+    const float crossGain = outputScale * (0.5f - 0.5f * width);
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Read every line at its modulated delay, with linear interpolation
+        alignas(32) LineArray delayed;
+        
+        for (int line = 0; line < numLines; ++line)
+        {
+            const size_t index = static_cast<size_t>(line);
+            const float delay = baseDelays[index] + modulationDepths[index] * sines[index];
+            const int whole = static_cast<int>(delay);
+            const float fraction = delay - static_cast<float>(whole);
+            
+            const float newer = delayBuffer[static_cast<size_t>(((writePosition - whole) & delayMask) * numLines + line)];
+            const float older = delayBuffer[static_cast<size_t>(((writePosition - whole - 1) & delayMask) * numLines + line)];
+            delayed[index] = newer + fraction * (older - newer);
+        }
+        
+        // Lane-wise updates of the modulation, ramps, and damping filters
+        for (int line = 0; line < numLines; ++line)
+        {
+            const size_t index = static_cast<size_t>(line);
+            const float sine = sines[index];
+            sines[index] = sine * rotationCosines[index] + cosines[index] * rotationSines[index];
+            cosines[index] = cosines[index] * rotationCosines[index] - sine * rotationSines[index];
+            
+            gains[index] += gainSteps[index];
+            dampingCoefficients[index] += dampingSteps[index];
+            modulationDepths[index] += depthSteps[index];
+            lowpassStates[index] = delayed[index] + dampingCoefficients[index] * (lowpassStates[index] - delayed[index]);
+        }
+        
+        float wetLeft = 0.0f;
+        float wetRight = 0.0f;
+        
+        for (int line = 0; line < numLines; line += 2)
+        {
+            wetLeft += lowpassStates[static_cast<size_t>(line)];
+            wetRight += lowpassStates[static_cast<size_t>(line + 1)];
+        }
+        
+        // Mix the lines and feed them back with the input
+        alignas(32) LineArray mixed = lowpassStates;
+        applyHadamard(mixed);
+        
+        const float inputLeft = left[i] * inputGain;
+        const float inputRight = right[i] * inputGain;
+        float* frame = delayBuffer.data() + static_cast<size_t>(writePosition * numLines);
+        
+        for (int line = 0; line < numLines; ++line)
+        {
+            const size_t index = static_cast<size_t>(line);
+            frame[line] = mixed[index] * gains[index] + ((line & 1) != 0 ? inputRight : inputLeft);
+        }
+        
+        writePosition = (writePosition + 1) & delayMask;
+        
+        if (isStereo)
+        {
+            left[i] = wetLeft * directGain + wetRight * crossGain;
+            right[i] = wetRight * directGain + wetLeft * crossGain;
+        }
+        else
+        {
+            left[i] = 0.5f * outputScale * (wetLeft + wetRight);
+        }
+    }
+    
+    // Snap the ramps to their targets and keep the sines from drifting off the unit circle
+    gains = targetGains;
+    dampingCoefficients = targetDamping;
+    modulationDepths = targetDepths;
+    
+    for (int line = 0; line < numLines; ++line)
+    {
+        const size_t index = static_cast<size_t>(line);
+        const float magnitude = 1.0f / std::sqrt(sines[index] * sines[index] + cosines[index] * cosines[index]);
+        sines[index] *= magnitude;
+        cosines[index] *= magnitude;
+    }
+}
+
+float FDNReverb::getDecaySeconds() const
+{
+    return minDecaySeconds * std::pow(maxDecaySeconds / minDecaySeconds, roomSize);
+}
+
+void FDNReverb::calculateTargets(LineArray& targetGains, LineArray& targetDamping, LineArray& targetDepths) const
+{
+    // The Hadamard transform is unnormalized, so its scale is folded into the gains
+    const float hadamardScale = 1.0f / std::sqrt(static_cast<float>(numLines));
+    
+    if (freeze)
+    {
+        // Lossless recirculation: interpolating a modulated read would slowly lowpass the sound
+        targetGains.fill(hadamardScale);
+        targetDamping.fill(0.0f);
+        targetDepths.fill(0.0f);
+        return;
+    }
+    
+    targetDepths.fill(modulationDepthMs * static_cast<float>(currentSampleRate / 1000.0));
+    
+    // Each line loses 60 dB over the decay time, in proportion to its delay
+    const float decaySeconds = getDecaySeconds();
+    const float cutoffHz = brightCutoffHz * std::pow(darkCutoffHz / brightCutoffHz, damping);
+    const float dampingCoefficient = std::exp(-juce::MathConstants<float>::twoPi
+                                              * juce::jmin(cutoffHz, 0.45f * static_cast<float>(currentSampleRate))
+                                              / static_cast<float>(currentSampleRate));
+    
+    for (int line = 0; line < numLines; ++line)
+    {
+        const float delaySeconds = baseDelays[static_cast<size_t>(line)] / static_cast<float>(currentSampleRate);
+        targetGains[static_cast<size_t>(line)] = hadamardScale * std::pow(10.0f, -3.0f * delaySeconds / decaySeconds);
+        targetDamping[static_cast<size_t>(line)] = dampingCoefficient;
+    }
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,184 @@
+/*
+ * Underground Beats
+ * FDNReverb.h
+ * 
+ * Feedback delay network reverb for running on many sends at low cost
+ */
+
+#pragma once
+
+#include "Effect.h"
+#include <array>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class FDNReverb
+ * @brief Algorithmic reverb built from an eight-line feedback delay network
+ * 
+ * Each sample, the outputs of eight delay lines are damped, mixed with an
+ * orthogonal Hadamard matrix, scaled for the decay time, and fed back with the
+ * input. All per-line state is kept in arrays of numLines floats, one lane per
+ * line, so the filtering, mixing, and gains run as vector operations on a
+ * single register. The lines are interleaved in one power-of-two buffer, so
+ * writing all eight lines is a single contiguous store.
+ * 
+ * The read position of every line is slowly modulated by its own sine, which
+ * breaks up the metallic resonances a static network has. The controls match
+ * Reverb, so the two can be swapped.
+ */
+class FDNReverb : public Effect {
+public:
+    /** Number of delay lines in the network */
+    static constexpr int numLines = 8;
+    
+    FDNReverb();
+    ~FDNReverb() override;
+    
+    /**
+     * @brief Set the room size
+     * 
+     * Sets the decay time, from 0.2 seconds at 0 to 10 seconds at 1.
+     * 
+     * @param size Room size (0 to 1)
+     */
+    void setRoomSize(float size);
+    
+    /**
+     * @brief Get the current room size
+     * 
+     * @return The current room size
+     */
+    float getRoomSize() const;
+    
+    /**
+     * @brief Set the damping amount
+     * 
+     * @param amount Damping amount (0 to 1)
+     */
+    void setDamping(float amount);
+    
+    /**
+     * @brief Get the current damping amount
+     * 
+     * @return The current damping amount
+     */
+    float getDamping() const;
+    
+    /**
+     * @brief Set the stereo width
+     * 
+     * @param width Stereo width (0 to 1)
+     */
+    void setWidth(float width);
+    
+    /**
+     * @brief Get the current stereo width
+     * 
+     * @return The current stereo width
+     */
+    float getWidth() const;
+    
+    /**
+     * @brief Set freeze mode
+     * 
+     * A frozen network stops taking input, stops its modulation, and
+     * recirculates without loss.
+     * 
+     * @param freeze true for freeze mode, false for normal mode
+     */
+    void setFreeze(bool freeze);
+    
+    /**
+     * @brief Check if freeze mode is enabled
+     * 
+     * @return true if freeze mode is enabled
+     */
+    bool getFreeze() const;
+    
+    /**
+     * @brief Prepare the effect for processing
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param blockSize The maximum block size in samples
+     */
+    void prepare(double sampleRate, int blockSize) override;
+    
+    /**
+     * @brief Reset the effect state
+     */
+    void reset() override;
+    
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * @return Tail length in seconds, or infinity in freeze mode
+     */
+    double getTailLengthSeconds() const override;
+    
+    /**
+     * @brief Create an XML element containing the effect's state
+     * 
+     * @return XML element containing effect state
+     */
+    std::unique_ptr<juce::XmlElement> createStateXml() const override;
+    
+    /**
+     * @brief Restore effect state from an XML element
+     * 
+     * @param xml XML element containing effect state
+     * @return true if state was successfully restored
+     */
+    bool restoreStateFromXml(const juce::XmlElement* xml) override;
+    
+protected:
+    /**
+     * @brief Process a block of audio
+     * 
+     * Mono blocks feed every line and return the average of both outputs;
+     * wider blocks process the first two channels as a stereo pair.
+     * 
+     * @param block The audio to process in place
+     */
+    void processBlock(const juce::dsp::AudioBlock<float>& block) override;
+    
+private:
+    using LineArray = std::array<float, numLines>;
+    
+    // Reverb parameters
+    float roomSize;
+    float damping;
+    float width;
+    bool freeze;
+    
+    // Delay lines, interleaved: sample n of line l is at n * numLines + l
+    std::vector<float> delayBuffer;
+    int delayMask;      // Wraps a sample index within the buffer
+    int writePosition;
+    
+    // Centre delay of each line in whole samples
+    alignas(32) LineArray baseDelays;
+    
+    // Per-line state, ramped towards the parameters once per block
+    alignas(32) LineArray gains;           // Feedback gain for the decay time
+    alignas(32) LineArray dampingCoefficients;
+    alignas(32) LineArray modulationDepths; // Modulation depth in samples
+    alignas(32) LineArray lowpassStates;
+    
+    // Modulation sines, as rotating unit vectors
+    alignas(32) LineArray sines;
+    alignas(32) LineArray cosines;
+    alignas(32) LineArray rotationSines;
+    alignas(32) LineArray rotationCosines;
+    
+    // Time for the network to decay by 60 dB at the current room size
+    float getDecaySeconds() const;
+    
+    // Calculate the per-line gains, damping, and modulation depths the parameters ask for
+    void calculateTargets(LineArray& targetGains, LineArray& targetDamping, LineArray& targetDepths) const;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FDNReverb)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,332 @@
+/*
+ * Underground Beats
+ * Oversampler.cpp
+ * 
+ * Implementation of polyphase half-band oversampling
+ */
+
+#include "Oversampler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Passband edge as a fraction of the original sample rate, and stopband rejection, for each quality
+constexpr double livePassband = 0.40;
+constexpr double liveRejectionDb = 80.0;
+constexpr double offlinePassband = 0.45;
+constexpr double offlineRejectionDb = 110.0;
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser window
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    
+    for (int k = 1; term > 1.0e-12 * sum; ++k)
+    {
+        const double factor = x / (2.0 * k);
+        term *= factor * factor;
+        sum += term;
+    }
+    
+    return sum;
+}
+
+// Nonzero taps of a Kaiser-windowed half-band lowpass, other than the centre tap.
+// passbandEdge is a fraction of the filter's sample rate; the taps sum to one.
+std::vector<float> designHalfBand(double passbandEdge, double rejectionDb)
+{
+    // Kaiser's estimate of the length, rounded up to the 4K + 3 taps of a half-band filter
+    const double transition = 0.5 - 2.0 * passbandEdge;
+    const double length = (rejectionDb - 7.95) / (14.36 * transition) + 1.0;
+    const int halfOrder = juce::jmax(0, static_cast<int>(std::ceil((length - 3.0) / 4.0)));
+    const int numTaps = 4 * halfOrder + 3;
+    const int centre = 2 * halfOrder + 1;
+    const double beta = 0.1102 * (rejectionDb - 8.7);
+    
+    // Only the even taps, an odd distance from the centre, are nonzero
+    std::vector<double> designed(static_cast<size_t>(2 * halfOrder + 2));
+    double sum = 0.0;
+    
+    for (size_t j = 0; j < designed.size(); ++j)
+    {
+        const int offset = 2 * static_cast<int>(j) - centre;
+        const double sinc = std::sin(juce::MathConstants<double>::halfPi * offset)
+                            / (juce::MathConstants<double>::pi * offset);
+        const double position = 2.0 * (2.0 * static_cast<double>(j)) / (numTaps - 1) - 1.0;
+        const double window = besselI0(beta * std::sqrt(juce::jmax(0.0, 1.0 - position * position))) / besselI0(beta);
+        designed[j] = sinc * window;
+        sum += designed[j];
+    }
+    
+    std::vector<float> taps(designed.size());
+    
+    for (size_t j = 0; j < taps.size(); ++j)
+    {
+        taps[j] = static_cast<float>(designed[j] / sum);
+    }
+    
+    return taps;
+}
+
+// output[i] = sum of taps[j] * input[i + j] for an even number of symmetric taps. Runs
+// across the block four tap pairs at a time, so the compiler vectorizes it and the
+// output is loaded and stored once per four pairs.
+void convolveSymmetric(const float* input, const float* taps, int numTaps, float* output, int numSamples)
+{
+    const int numPairs = numTaps / 2;
+    const float* last = input + numTaps - 1;
+    int pair = numPairs % 4;
+    
+    // Pairs left over from the groups of four start the sum
+    juce::FloatVectorOperations::clear(output, numSamples);
+    
+    for (int j = 0; j < pair; ++j)
+    {
+        const float tap = taps[j];
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            output[i] += tap * (input[i + j] + last[i - j]);
+        }
+    }
+    
+    for (; pair < numPairs; pair += 4)
+    {
+        const float tap0 = taps[pair];
+        const float tap1 = taps[pair + 1];
+        const float tap2 = taps[pair + 2];
+        const float tap3 = taps[pair + 3];
+        const float* first = input + pair;
+        const float* mirror = last - pair;
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            output[i] += tap0 * (first[i] + mirror[i]) + tap1 * (first[i + 1] + mirror[i - 1])
+                         + tap2 * (first[i + 2] + mirror[i - 2]) + tap3 * (first[i + 3] + mirror[i - 3]);
+        }
+    }
+}
+
+// Move the last historyLength samples of a history-prefixed buffer to its front
+void keepHistory(float* buffer, int historyLength, int numSamples)
+{
+    std::copy(buffer + numSamples, buffer + numSamples + historyLength, buffer);
+}
+
+} // namespace
+
+Oversampler::Oversampler()
+    : factor(1)
+    , numStages(0)
+    , latencySamples(0)
+    , paddingSamples(0)
+    , numChannels(0)
+    , maxBlockSize(0)
+    , blockChannels(0)
+    , blockSamples(0)
+{
+}
+
+Oversampler::~Oversampler()
+{
+}
+
+void Oversampler::prepare(int channels, int blockSize, int oversamplingFactor, OversamplingQuality quality)
+{
+    numChannels = juce::jmax(1, channels);
+    maxBlockSize = juce::jmax(1, blockSize);
+    
+    numStages = 0;
+    
+    while ((2 << numStages) <= juce::jlimit(1, maxFactor, oversamplingFactor))
+    {
+        ++numStages;
+    }
+    
+    factor = 1 << numStages;
+    
+    const bool offline = quality == OversamplingQuality::Offline;
+    const double passband = offline ? offlinePassband : livePassband;
+    const double rejectionDb = offline ? offlineRejectionDb : liveRejectionDb;
+    
+    stages.clear();
+    stages.resize(static_cast<size_t>(numStages));
+    int oversampledLatency = 0;
+    
+    for (int index = 0; index < numStages; ++index)
+    {
+        // Each stage only has to keep the original passband, which narrows as the rate rises
+        Stage& stage = stages[static_cast<size_t>(index)];
+        stage.taps = designHalfBand(passband / static_cast<double>(2 << index), rejectionDb);
+        
+        const int numTaps = static_cast<int>(stage.taps.size());
+        const int lowSamples = maxBlockSize << index;
+        stage.delay = numTaps / 2 - 1;
+        
+        stage.upInput.setSize(numChannels, numTaps - 1 + lowSamples);
+        stage.downEven.setSize(numChannels, numTaps - 1 + lowSamples);
+        stage.downOdd.setSize(numChannels, stage.delay + 1 + lowSamples);
+        stage.output.setSize(numChannels, 2 * lowSamples);
+        
+        // Both filters delay by their centre tap at the higher rate
+        oversampledLatency += (2 * stage.delay + 1) << (numStages - index);
+    }
+    
+    // Pad the oversampled block up to a whole number of original samples
+    paddingSamples = (factor - oversampledLatency % factor) % factor;
+    latencySamples = (oversampledLatency + paddingSamples) / factor;
+    paddingBuffer.setSize(paddingSamples > 0 ? numChannels : 0, paddingSamples > 0 ? paddingSamples + maxBlockSize * factor : 0);
+    branchBuffer.assign(static_cast<size_t>(maxBlockSize << juce::jmax(0, numStages - 1)), 0.0f);
+    
+    reset();
+}
+
+void Oversampler::reset()
+{
+    for (auto& stage : stages)
+    {
+        stage.upInput.clear();
+        stage.downEven.clear();
+        stage.downOdd.clear();
+        stage.output.clear();
+    }
+    
+    paddingBuffer.clear();
+}
+
+int Oversampler::getFactor() const
+{
+    return factor;
+}
+
+int Oversampler::getLatencySamples() const
+{
+    return latencySamples;
+}
+
+juce::dsp::AudioBlock<float> Oversampler::upsample(const juce::dsp::AudioBlock<float>& input)
+{
+    blockChannels = juce::jmin(static_cast<int>(input.getNumChannels()), numChannels);
+    blockSamples = juce::jmin(static_cast<int>(input.getNumSamples()), maxBlockSize);
+    
+    if (numStages == 0)
+    {
+        return input.getSubsetChannelBlock(0, static_cast<size_t>(blockChannels));
+    }
+    
+    float* branch = branchBuffer.data();
+    
+    for (int index = 0; index < numStages; ++index)
+    {
+        Stage& stage = stages[static_cast<size_t>(index)];
+        const int numTaps = static_cast<int>(stage.taps.size());
+        const int historyLength = numTaps - 1;
+        const int lowSamples = blockSamples << index;
+        
+        for (int channel = 0; channel < blockChannels; ++channel)
+        {
+            const float* source = index == 0 ? input.getChannelPointer(static_cast<size_t>(channel))
+                                             : stages[static_cast<size_t>(index - 1)].output.getReadPointer(channel);
+            float* history = stage.upInput.getWritePointer(channel);
+            juce::FloatVectorOperations::copy(history + historyLength, source, lowSamples);
+            
+            // Even outputs come from the filtered branch, odd outputs are the input delayed
+            convolveSymmetric(history, stage.taps.data(), numTaps, branch, lowSamples);
+            const float* delayed = history + historyLength - stage.delay;
+            float* output = stage.output.getWritePointer(channel);
+            
+            for (int i = 0; i < lowSamples; ++i)
+            {
+                output[2 * i] = branch[i];
+                output[2 * i + 1] = delayed[i];
+            }
+            
+            keepHistory(history, historyLength, lowSamples);
+        }
+    }
+    
+    juce::dsp::AudioBlock<float> oversampled(stages.back().output);
+    const int numOversampled = blockSamples * factor;
+    
+    if (paddingSamples > 0)
+    {
+        // Delay the block through the padding history, and process it there
+        for (int channel = 0; channel < blockChannels; ++channel)
+        {
+            float* padded = paddingBuffer.getWritePointer(channel);
+            juce::FloatVectorOperations::copy(padded + paddingSamples, stages.back().output.getReadPointer(channel),
+                                              numOversampled);
+        }
+        
+        oversampled = juce::dsp::AudioBlock<float>(paddingBuffer);
+    }
+    
+    return oversampled.getSubsetChannelBlock(0, static_cast<size_t>(blockChannels))
+        .getSubBlock(0, static_cast<size_t>(numOversampled));
+}
+
+void Oversampler::downsample(const juce::dsp::AudioBlock<float>& output)
+{
+    if (numStages == 0)
+    {
+        return;
+    }
+    
+    const int numOutputChannels = juce::jmin(static_cast<int>(output.getNumChannels()), blockChannels);
+    float* branch = branchBuffer.data();
+    
+    if (paddingSamples > 0)
+    {
+        // Take the processed block back from the padding history, keeping the samples still to come
+        for (int channel = 0; channel < blockChannels; ++channel)
+        {
+            float* padded = paddingBuffer.getWritePointer(channel);
+            juce::FloatVectorOperations::copy(stages.back().output.getWritePointer(channel), padded,
+                                              blockSamples * factor);
+            keepHistory(padded, paddingSamples, blockSamples * factor);
+        }
+    }
+    
+    // Each stage halves the rate, writing into the output of the stage below
+    for (int index = numStages - 1; index >= 0; --index)
+    {
+        Stage& stage = stages[static_cast<size_t>(index)];
+        const int numTaps = static_cast<int>(stage.taps.size());
+        const int historyLength = numTaps - 1;
+        const int lowSamples = blockSamples << index;
+        
+        for (int channel = 0; channel < numOutputChannels; ++channel)
+        {
+            const float* source = stage.output.getReadPointer(channel);
+            float* evenHistory = stage.downEven.getWritePointer(channel);
+            float* oddHistory = stage.downOdd.getWritePointer(channel);
+            float* even = evenHistory + historyLength;
+            float* odd = oddHistory + stage.delay + 1;
+            
+            for (int i = 0; i < lowSamples; ++i)
+            {
+                even[i] = source[2 * i];
+                odd[i] = source[2 * i + 1];
+            }
+            
+            // Even inputs are filtered; odd inputs meet only the centre tap, a plain delay
+            convolveSymmetric(evenHistory, stage.taps.data(), numTaps, branch, lowSamples);
+            float* destination = index == 0 ? output.getChannelPointer(static_cast<size_t>(channel))
+                                            : stages[static_cast<size_t>(index - 1)].output.getWritePointer(channel);
+            
+            for (int i = 0; i < lowSamples; ++i)
+            {
+                destination[i] = 0.5f * (branch[i] + oddHistory[i]);
+            }
+            
+            keepHistory(evenHistory, historyLength, lowSamples);
+            keepHistory(oddHistory, stage.delay + 1, lowSamples);
+        }
+    }
+}
+
+} // namespace UndergroundBeats
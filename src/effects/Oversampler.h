@@ -0,0 +1,134 @@
+/*
+ * Underground Beats
+ * Oversampler.h
+ * 
+ * Polyphase half-band up and down sampling for nonlinear effects
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of oversampling filter qualities
+ */
+enum class OversamplingQuality {
+    Live,   // Shorter filters: less latency and CPU, passband to 40% of the sample rate, 80 dB rejection
+    Offline // Longer filters for rendering: passband to 45% of the sample rate, 110 dB rejection
+};
+
+/**
+ * @class Oversampler
+ * @brief Raises audio to 2, 4, or 8 times its sample rate and brings it back
+ * 
+ * Each doubling is a stage with a linear-phase half-band FIR filter, designed
+ * in prepare() with a Kaiser window. Every other tap of a half-band filter is
+ * zero, so each stage runs as two polyphase branches at the lower rate: one
+ * branch is a short symmetric FIR and the other a plain delay. The FIR branch
+ * exploits the filter's symmetry and runs tap by tap across the whole block,
+ * a loop the compiler vectorizes.
+ * 
+ * Later stages only have to reject what lies above the first stage's
+ * passband, so their filters are much shorter. Going up and coming back down
+ * delays the audio by getLatencySamples(), which an effect reports as its own
+ * latency. The later stages' delays are fractions of an original sample, so
+ * the oversampled block is delayed a few samples more to make the latency a
+ * whole number of samples, keeping the wet signal in line with the dry.
+ * 
+ * An effect calls upsample(), runs its nonlinearity over the returned block,
+ * then calls downsample(). All buffers are allocated in prepare().
+ */
+class Oversampler {
+public:
+    /** Largest oversampling factor */
+    static constexpr int maxFactor = 8;
+    
+    Oversampler();
+    ~Oversampler();
+    
+    /**
+     * @brief Design the filters and allocate the buffers
+     * 
+     * Allocates, so never call this from the audio thread.
+     * 
+     * @param numChannels The largest number of channels to process
+     * @param maxBlockSize The largest block to process at the original rate
+     * @param factor The oversampling factor (1, 2, 4, or 8)
+     * @param quality The filter quality
+     */
+    void prepare(int numChannels, int maxBlockSize, int factor, OversamplingQuality quality);
+    
+    /**
+     * @brief Clear the filter state
+     */
+    void reset();
+    
+    /**
+     * @brief Get the prepared oversampling factor
+     * 
+     * @return 1, 2, 4, or 8
+     */
+    int getFactor() const;
+    
+    /**
+     * @brief Get the delay of going up and back down
+     * 
+     * @return Latency in whole samples at the original rate
+     */
+    int getLatencySamples() const;
+    
+    /**
+     * @brief Raise a block to the oversampled rate
+     * 
+     * With a factor of 1 the input block itself is returned, to be processed
+     * in place.
+     * 
+     * @param input The audio at the original rate, no longer than the prepared block size
+     * @return The oversampled audio, factor times as long, valid until the next call
+     */
+    juce::dsp::AudioBlock<float> upsample(const juce::dsp::AudioBlock<float>& input);
+    
+    /**
+     * @brief Bring the block returned by the last upsample() back to the original rate
+     * 
+     * @param output Receives the audio, as long as the block given to upsample()
+     */
+    void downsample(const juce::dsp::AudioBlock<float>& output);
+    
+private:
+    // One doubling: a half-band filter for each direction, run as two polyphase branches
+    struct Stage {
+        std::vector<float> taps;            // Taps of the filtered branch, symmetric
+        int delay;                          // Delay of the other branch at the lower rate
+        juce::AudioBuffer<float> upInput;   // Input history followed by the input, per channel
+        juce::AudioBuffer<float> downEven;  // Even input history followed by the even inputs
+        juce::AudioBuffer<float> downOdd;   // Odd input history followed by the odd inputs
+        juce::AudioBuffer<float> output;    // Upsampled output at the higher rate
+    };
+    
+    int factor;
+    int numStages;
+    int latencySamples;
+    int paddingSamples;  // Delay at the oversampled rate that rounds the latency to whole samples
+    int numChannels;
+    int maxBlockSize;
+    
+    std::vector<Stage> stages;
+    
+    // Filtered branch of a stage, at the lower rate
+    std::vector<float> branchBuffer;
+    
+    // Padding history followed by the oversampled block, per channel
+    juce::AudioBuffer<float> paddingBuffer;
+    
+    // Channels and length of the block being oversampled
+    int blockChannels;
+    int blockSamples;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Oversampler)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,515 @@
+/*
+ * Underground Beats
+ * ParametricEQ.cpp
+ * 
+ * Implementation of the eight-band parametric equalizer
+ */
+
+#include "ParametricEQ.h"
+#include <cmath>
+
+namespace UndergroundBeats {
+
+namespace {
+
+using Lanes = std::array<float, ParametricEQ::numBands>;
+using LaneFlags = std::array<int, ParametricEQ::numBands>;
+
+// Default frequency and type of each band, from the low cut up to the high cut
+constexpr float defaultFrequencies[ParametricEQ::numBands] = { 30.0f, 100.0f, 250.0f, 600.0f, 1500.0f, 3500.0f, 8000.0f, 18000.0f };
+constexpr FilterType defaultTypes[ParametricEQ::numBands] = {
+    FilterType::HighPass, FilterType::LowShelf, FilterType::Peak, FilterType::Peak,
+    FilterType::Peak, FilterType::Peak, FilterType::HighShelf, FilterType::LowPass
+};
+
+// Time for the running parameters to cover most of a change
+constexpr double parameterSmoothingSeconds = 0.02;
+
+// Running parameters closer than this to their targets snap to them
+constexpr float snapDistance = 0.001f;
+
+// Coefficients that pass the input through unchanged
+const FilterCoefficients identityCoefficients;
+
+bool isFlat(const FilterCoefficients& c)
+{
+    return c.a0 == 1.0f && c.a1 == 0.0f && c.a2 == 0.0f && c.b1 == 0.0f && c.b2 == 0.0f;
+}
+
+// The bands of one channel in lanes, in chain order
+struct Pipeline {
+    alignas(32) Lanes a0;
+    alignas(32) Lanes a1;
+    alignas(32) Lanes a2;
+    alignas(32) Lanes b1;
+    alignas(32) Lanes b2;
+    alignas(32) Lanes a0Steps;
+    alignas(32) Lanes a1Steps;
+    alignas(32) Lanes a2Steps;
+    alignas(32) Lanes b1Steps;
+    alignas(32) Lanes b2Steps;
+    alignas(32) Lanes firstStates;
+    alignas(32) Lanes secondStates;
+    alignas(32) Lanes outputs;
+};
+
+// Advance every lane by one sample: lane 0 takes the input and every other lane
+// the output of the lane before it. When masked, lanes without a sample to
+// filter at this step keep their state. Ramping moves the coefficients on.
+template <bool masked, bool ramping>
+inline void stepPipeline(Pipeline& pipeline, float input, const LaneFlags& active)
+{
+    alignas(32) Lanes inputs;
+    inputs[0] = input;
+    
+    for (size_t lane = 1; lane < inputs.size(); ++lane)
+    {
+        inputs[lane] = pipeline.outputs[lane - 1];
+    }
+    
+    for (size_t lane = 0; lane < inputs.size(); ++lane)
+    {
+        // Transposed direct form II
+        const float output = pipeline.a0[lane] * inputs[lane] + pipeline.firstStates[lane];
+        const float first = pipeline.a1[lane] * inputs[lane] - pipeline.b1[lane] * output + pipeline.secondStates[lane];
+        const float second = pipeline.a2[lane] * inputs[lane] - pipeline.b2[lane] * output;
+        pipeline.outputs[lane] = output;
+        
+        if (masked)
+        {
+            pipeline.firstStates[lane] = active[lane] != 0 ? first : pipeline.firstStates[lane];
+            pipeline.secondStates[lane] = active[lane] != 0 ? second : pipeline.secondStates[lane];
+        }
+        else
+        {
+            pipeline.firstStates[lane] = first;
+            pipeline.secondStates[lane] = second;
+        }
+    }
+    
+    if (ramping)
+    {
+        for (size_t lane = 0; lane < inputs.size(); ++lane)
+        {
+            const float scale = masked ? static_cast<float>(active[lane]) : 1.0f;
+            pipeline.a0[lane] += pipeline.a0Steps[lane] * scale;
+            pipeline.a1[lane] += pipeline.a1Steps[lane] * scale;
+            pipeline.a2[lane] += pipeline.a2Steps[lane] * scale;
+            pipeline.b1[lane] += pipeline.b1Steps[lane] * scale;
+            pipeline.b2[lane] += pipeline.b2Steps[lane] * scale;
+        }
+    }
+}
+
+// Run one interval through the pipeline: numLanes - 1 masked steps to fill it, then
+// full steps while the input lasts, then masked steps to drain it
+template <bool ramping>
+void runPipeline(Pipeline& pipeline, float* data, int numSamples, int numLanes)
+{
+    const int lastLane = numLanes - 1;
+    const int fillSteps = juce::jmin(lastLane, numSamples);
+    LaneFlags active;
+    
+    for (int step = 0; step < numSamples + lastLane; ++step)
+    {
+        const float input = step < numSamples ? data[step] : 0.0f;
+        
+        if (step >= fillSteps && step < numSamples)
+        {
+            stepPipeline<false, ramping>(pipeline, input, active);
+        }
+        else
+        {
+            for (int lane = 0; lane < ParametricEQ::numBands; ++lane)
+            {
+                const int sample = step - lane;
+                active[static_cast<size_t>(lane)] = lane < numLanes && sample >= 0 && sample < numSamples ? 1 : 0;
+            }
+            
+            stepPipeline<true, ramping>(pipeline, input, active);
+        }
+        
+        // The last lane finishes the sample it took
+        if (step >= lastLane)
+        {
+            data[step - lastLane] = pipeline.outputs[static_cast<size_t>(lastLane)];
+        }
+    }
+}
+
+} // namespace
+
+ParametricEQ::ParametricEQ()
+    : Effect("ParametricEQ")
+{
+    for (int band = 0; band < numBands; ++band)
+    {
+        const size_t index = static_cast<size_t>(band);
+        bandEnabled[index] = false;
+        bandTypes[index] = defaultTypes[band];
+        bandFrequencies[index] = defaultFrequencies[band];
+        bandGains[index] = 0.0f;
+        bandQs[index] = 0.7071f;
+    }
+    
+    // Running parameters and state are set up in prepare()
+    runningEnabled.fill(false);
+    runningTypes = bandTypes;
+    runningOctaves.fill(0.0f);
+    runningGains.fill(0.0f);
+    runningLogQs.fill(0.0f);
+    coefficients.fill(identityCoefficients);
+    targetCoefficients.fill(identityCoefficients);
+}
+
+ParametricEQ::~ParametricEQ()
+{
+}
+
+void ParametricEQ::setBandEnabled(int band, bool enabled)
+{
+    if (band >= 0 && band < numBands)
+    {
+        bandEnabled[static_cast<size_t>(band)] = enabled;
+    }
+}
+
+bool ParametricEQ::isBandEnabled(int band) const
+{
+    return band >= 0 && band < numBands && bandEnabled[static_cast<size_t>(band)];
+}
+
+void ParametricEQ::setBandType(int band, FilterType type)
+{
+    if (band >= 0 && band < numBands)
+    {
+        bandTypes[static_cast<size_t>(band)] = type;
+    }
+}
+
+FilterType ParametricEQ::getBandType(int band) const
+{
+    return band >= 0 && band < numBands ? bandTypes[static_cast<size_t>(band)] : FilterType::Peak;
+}
+
+void ParametricEQ::setBandFrequency(int band, float frequencyHz)
+{
+    if (band >= 0 && band < numBands)
+    {
+        bandFrequencies[static_cast<size_t>(band)] = juce::jlimit(20.0f, 20000.0f, frequencyHz);
+    }
+}
+
+float ParametricEQ::getBandFrequency(int band) const
+{
+    return band >= 0 && band < numBands ? bandFrequencies[static_cast<size_t>(band)] : 0.0f;
+}
+
+void ParametricEQ::setBandGain(int band, float gainDb)
+{
+    if (band >= 0 && band < numBands)
+    {
+        bandGains[static_cast<size_t>(band)] = juce::jlimit(-24.0f, 24.0f, gainDb);
+    }
+}
+
+float ParametricEQ::getBandGain(int band) const
+{
+    return band >= 0 && band < numBands ? bandGains[static_cast<size_t>(band)] : 0.0f;
+}
+
+void ParametricEQ::setBandQ(int band, float q)
+{
+    if (band >= 0 && band < numBands)
+    {
+        bandQs[static_cast<size_t>(band)] = juce::jlimit(0.1f, 18.0f, q);
+    }
+}
+
+float ParametricEQ::getBandQ(int band) const
+{
+    return band >= 0 && band < numBands ? bandQs[static_cast<size_t>(band)] : 0.0f;
+}
+
+void ParametricEQ::prepare(double sampleRate, int blockSize)
+{
+    Effect::prepare(sampleRate, blockSize);
+    
+    firstStates.assign(static_cast<size_t>(maxChannels), Lanes{});
+    secondStates.assign(static_cast<size_t>(maxChannels), Lanes{});
+    
+    // Start at the current settings rather than gliding to them
+    for (int band = 0; band < numBands; ++band)
+    {
+        const size_t index = static_cast<size_t>(band);
+        runningEnabled[index] = bandEnabled[index];
+        runningTypes[index] = bandTypes[index];
+        runningOctaves[index] = std::log2(bandFrequencies[index]);
+        runningGains[index] = bandGains[index];
+        runningLogQs[index] = std::log2(bandQs[index]);
+        
+        targetCoefficients[index] = runningEnabled[index]
+            ? Filter::calculateCoefficientsForQ(bandTypes[index], bandFrequencies[index], bandQs[index], bandGains[index], sampleRate)
+            : identityCoefficients;
+        coefficients[index] = targetCoefficients[index];
+    }
+}
+
+void ParametricEQ::reset()
+{
+    Effect::reset();
+    
+    for (auto& states : firstStates)
+    {
+        states.fill(0.0f);
+    }
+    
+    for (auto& states : secondStates)
+    {
+        states.fill(0.0f);
+    }
+}
+
+double ParametricEQ::getTailLengthSeconds() const
+{
+    // Poles at radius r decay by -20 log10(r) dB per sample, and b2 is the product of the two radii
+    double longestTail = 0.0;
+    
+    for (int band = 0; band < numBands; ++band)
+    {
+        const float b2 = coefficients[static_cast<size_t>(band)].b2;
+        
+        if (b2 > 0.0f && b2 < 1.0f)
+        {
+            const double decibelsPerSample = -10.0 * std::log10(static_cast<double>(b2));
+            longestTail = juce::jmax(longestTail, tailDecayDecibels / decibelsPerSample);
+        }
+    }
+    
+    return longestTail / currentSampleRate;
+}
+
+std::unique_ptr<juce::XmlElement> ParametricEQ::createStateXml() const
+{
+    auto xml = Effect::createStateXml();
+    
+    // Add one child element per band
+    for (int band = 0; band < numBands; ++band)
+    {
+        const size_t index = static_cast<size_t>(band);
+        auto bandXml = std::make_unique<juce::XmlElement>("Band");
+        bandXml->setAttribute("index", band);
+        bandXml->setAttribute("enabled", bandEnabled[index]);
+        bandXml->setAttribute("type", static_cast<int>(bandTypes[index]));
+        bandXml->setAttribute("frequency", bandFrequencies[index]);
+        bandXml->setAttribute("gain", bandGains[index]);
+        bandXml->setAttribute("q", bandQs[index]);
+        xml->addChildElement(bandXml.release());
+    }
+    
+    return xml;
+}
+
+bool ParametricEQ::restoreStateFromXml(const juce::XmlElement* xml)
+{
+    if (!Effect::restoreStateFromXml(xml))
+    {
+        return false;
+    }
+    
+    // Restore each band from its child element
+    for (int i = 0; i < xml->getNumChildElements(); ++i)
+    {
+        const juce::XmlElement* bandXml = xml->getChildElement(i);
+        
+        if (bandXml == nullptr || bandXml->getTagName() != "Band")
+        {
+            continue;
+        }
+        
+        const int band = bandXml->getIntAttribute("index", -1);
+        
+        if (band < 0 || band >= numBands)
+        {
+            continue;
+        }
+        
+        if (bandXml->hasAttribute("enabled"))
+        {
+            setBandEnabled(band, bandXml->getBoolAttribute("enabled", false));
+        }
+        
+        if (bandXml->hasAttribute("type"))
+        {
+            setBandType(band, static_cast<FilterType>(bandXml->getIntAttribute("type", static_cast<int>(defaultTypes[band]))));
+        }
+        
+        if (bandXml->hasAttribute("frequency"))
+        {
+            setBandFrequency(band, bandXml->getDoubleAttribute("frequency", defaultFrequencies[band]));
+        }
+        
+        if (bandXml->hasAttribute("gain"))
+        {
+            setBandGain(band, bandXml->getDoubleAttribute("gain", 0.0f));
+        }
+        
+        if (bandXml->hasAttribute("q"))
+        {
+            setBandQ(band, bandXml->getDoubleAttribute("q", 0.7071f));
+        }
+    }
+    
+    return true;
+}
+
+void ParametricEQ::processBlock(const juce::dsp::AudioBlock<float>& block)
+{
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    
+    for (int start = 0; start < numSamples; start += controlInterval)
+    {
+        const int intervalSamples = juce::jmin(controlInterval, numSamples - start);
+        updateTargets(intervalSamples);
+        
+        // Bands take lanes in chain order; disabled bands that have faded out take none
+        std::array<int, numBands> activeBands;
+        int numActive = 0;
+        
+        for (int band = 0; band < numBands; ++band)
+        {
+            const size_t index = static_cast<size_t>(band);
+            
+            if (runningEnabled[index] || !isFlat(coefficients[index]) || !isFlat(targetCoefficients[index]))
+            {
+                activeBands[static_cast<size_t>(numActive++)] = band;
+            }
+        }
+        
+        if (numActive > 0)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                processInterval(block.getChannelPointer(static_cast<size_t>(channel)) + start, intervalSamples, channel,
+                                activeBands, numActive);
+            }
+        }
+        
+        coefficients = targetCoefficients;
+    }
+}
+
+void ParametricEQ::updateTargets(int numSamples)
+{
+    const float smoothing = static_cast<float>(1.0 - std::exp(-numSamples / (parameterSmoothingSeconds * currentSampleRate)));
+    
+    for (int band = 0; band < numBands; ++band)
+    {
+        const size_t index = static_cast<size_t>(band);
+        
+        if (!bandEnabled[index])
+        {
+            // Fade out to a flat response, after which the band drops out of the lanes
+            runningEnabled[index] = false;
+            targetCoefficients[index] = identityCoefficients;
+            continue;
+        }
+        
+        const float octave = std::log2(bandFrequencies[index]);
+        const float gain = bandGains[index];
+        const float logQ = std::log2(bandQs[index]);
+        bool changed = false;
+        
+        if (!runningEnabled[index] || runningTypes[index] != bandTypes[index])
+        {
+            // A band that is switched on or changes type fades in from where its coefficients are, at its current settings
+            runningEnabled[index] = true;
+            runningTypes[index] = bandTypes[index];
+            runningOctaves[index] = octave;
+            runningGains[index] = gain;
+            runningLogQs[index] = logQ;
+            changed = true;
+        }
+        
+        // Glide each parameter towards its target, snapping once close
+        auto glide = [smoothing, &changed](float& running, float target)
+        {
+            const float distance = target - running;
+            
+            if (distance != 0.0f)
+            {
+                running = std::abs(distance) < snapDistance ? target : running + distance * smoothing;
+                changed = true;
+            }
+        };
+        
+        glide(runningOctaves[index], octave);
+        glide(runningGains[index], gain);
+        glide(runningLogQs[index], logQ);
+        
+        // Settled bands keep their coefficients, so only moving bands pay for the calculation
+        if (changed)
+        {
+            targetCoefficients[index] = Filter::calculateCoefficientsForQ(runningTypes[index], std::exp2(runningOctaves[index]),
+                                                                          std::exp2(runningLogQs[index]), runningGains[index],
+                                                                          currentSampleRate);
+        }
+    }
+}
+
+void ParametricEQ::processInterval(float* data, int numSamples, int channel, const std::array<int, numBands>& activeBands,
+                                   int numActive)
+{
+    // Coefficients, ramps, and state of the active bands in lanes; unused lanes stay silent
+    Pipeline pipeline = {};
+    const float rampScale = 1.0f / static_cast<float>(numSamples);
+    bool ramping = false;
+    Lanes& channelFirstStates = firstStates[static_cast<size_t>(channel)];
+    Lanes& channelSecondStates = secondStates[static_cast<size_t>(channel)];
+    
+    for (int lane = 0; lane < numActive; ++lane)
+    {
+        const size_t index = static_cast<size_t>(lane);
+        const size_t band = static_cast<size_t>(activeBands[index]);
+        const FilterCoefficients& current = coefficients[band];
+        const FilterCoefficients& target = targetCoefficients[band];
+        
+        pipeline.a0[index] = current.a0;
+        pipeline.a1[index] = current.a1;
+        pipeline.a2[index] = current.a2;
+        pipeline.b1[index] = current.b1;
+        pipeline.b2[index] = current.b2;
+        pipeline.a0Steps[index] = (target.a0 - current.a0) * rampScale;
+        pipeline.a1Steps[index] = (target.a1 - current.a1) * rampScale;
+        pipeline.a2Steps[index] = (target.a2 - current.a2) * rampScale;
+        pipeline.b1Steps[index] = (target.b1 - current.b1) * rampScale;
+        pipeline.b2Steps[index] = (target.b2 - current.b2) * rampScale;
+        ramping = ramping || pipeline.a0Steps[index] != 0.0f || pipeline.a1Steps[index] != 0.0f || pipeline.a2Steps[index] != 0.0f
+                  || pipeline.b1Steps[index] != 0.0f || pipeline.b2Steps[index] != 0.0f;
+        
+        // A band coming back from flat starts from silence
+        const bool wasFlat = isFlat(current);
+        pipeline.firstStates[index] = wasFlat ? 0.0f : channelFirstStates[band];
+        pipeline.secondStates[index] = wasFlat ? 0.0f : channelSecondStates[band];
+    }
+    
+    // Lane k filters sample (step - k), so every band advances at each step
+    if (ramping)
+    {
+        runPipeline<true>(pipeline, data, numSamples, numActive);
+    }
+    else
+    {
+        runPipeline<false>(pipeline, data, numSamples, numActive);
+    }
+    
+    for (int lane = 0; lane < numActive; ++lane)
+    {
+        const size_t band = static_cast<size_t>(activeBands[static_cast<size_t>(lane)]);
+        channelFirstStates[band] = pipeline.firstStates[static_cast<size_t>(lane)];
+        channelSecondStates[band] = pipeline.secondStates[static_cast<size_t>(lane)];
+    }
+}
+
+} // namespace UndergroundBeats
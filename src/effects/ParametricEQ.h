@@ -0,0 +1,205 @@
+/*
+ * Underground Beats
+ * ParametricEQ.h
+ * 
+ * Eight-band parametric equalizer with the bands processed side by side
+ */
+
+#pragma once
+
+#include "Effect.h"
+#include "Filter.h"
+#include <array>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class ParametricEQ
+ * @brief Eight-band parametric equalizer
+ * 
+ * Each band is a biquad of any FilterType, and the enabled bands of a channel
+ * run in series. Rather than filtering the bands one after another, every
+ * enabled band takes a lane of an array of numBands floats and the block flows
+ * through them as a pipeline: at each step band k filters the sample band k - 1
+ * filtered the step before, so all bands advance together as vector
+ * operations. The pipeline fills and drains within every block, so the EQ adds
+ * no latency. Disabled bands are left out of the lanes entirely, and a flat EQ
+ * costs nothing.
+ * 
+ * Parameters glide towards their targets, and the coefficients are
+ * recalculated at control rate, once every controlInterval samples, only for
+ * bands that are still moving. Within each interval the coefficients are
+ * interpolated linearly. Enabling, disabling, or changing the type of a band
+ * fades its coefficients over one interval, so nothing clicks.
+ */
+class ParametricEQ : public Effect {
+public:
+    /** Number of bands */
+    static constexpr int numBands = 8;
+    
+    /** Samples between coefficient updates */
+    static constexpr int controlInterval = 64;
+    
+    ParametricEQ();
+    ~ParametricEQ() override;
+    
+    /**
+     * @brief Set whether a band is enabled
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @param enabled true to filter with the band
+     */
+    void setBandEnabled(int band, bool enabled);
+    
+    /**
+     * @brief Check whether a band is enabled
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @return true if the band is enabled
+     */
+    bool isBandEnabled(int band) const;
+    
+    /**
+     * @brief Set a band's filter type
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @param type The filter type
+     */
+    void setBandType(int band, FilterType type);
+    
+    /**
+     * @brief Get a band's filter type
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @return The filter type
+     */
+    FilterType getBandType(int band) const;
+    
+    /**
+     * @brief Set a band's frequency
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @param frequencyHz Centre or cutoff frequency in Hertz (20 to 20000)
+     */
+    void setBandFrequency(int band, float frequencyHz);
+    
+    /**
+     * @brief Get a band's frequency
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @return Frequency in Hertz
+     */
+    float getBandFrequency(int band) const;
+    
+    /**
+     * @brief Set a band's gain (shelf and peak bands)
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @param gainDb Gain in decibels (-24 to 24)
+     */
+    void setBandGain(int band, float gainDb);
+    
+    /**
+     * @brief Get a band's gain
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @return Gain in decibels
+     */
+    float getBandGain(int band) const;
+    
+    /**
+     * @brief Set a band's quality factor
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @param q Quality factor (0.1 to 18)
+     */
+    void setBandQ(int band, float q);
+    
+    /**
+     * @brief Get a band's quality factor
+     * 
+     * @param band The band (0 to numBands - 1)
+     * @return Quality factor
+     */
+    float getBandQ(int band) const;
+    
+    /**
+     * @brief Prepare the effect for processing
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param blockSize The maximum block size in samples
+     */
+    void prepare(double sampleRate, int blockSize) override;
+    
+    /**
+     * @brief Reset the effect state
+     */
+    void reset() override;
+    
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * @return The time the slowest-decaying band takes to ring down
+     */
+    double getTailLengthSeconds() const override;
+    
+    /**
+     * @brief Create an XML element containing the effect's state
+     * 
+     * @return XML element containing effect state
+     */
+    std::unique_ptr<juce::XmlElement> createStateXml() const override;
+    
+    /**
+     * @brief Restore effect state from an XML element
+     * 
+     * @param xml XML element containing effect state
+     * @return true if state was successfully restored
+     */
+    bool restoreStateFromXml(const juce::XmlElement* xml) override;
+    
+protected:
+    /**
+     * @brief Process a block of audio
+     * 
+     * @param block The audio to process in place
+     */
+    void processBlock(const juce::dsp::AudioBlock<float>& block) override;
+    
+private:
+    using BandArray = std::array<float, numBands>;
+    
+    // Band parameters
+    std::array<bool, numBands> bandEnabled;
+    std::array<FilterType, numBands> bandTypes;
+    BandArray bandFrequencies;
+    BandArray bandGains;
+    BandArray bandQs;
+    
+    // Parameters the bands are filtering with, gliding towards the targets (audio thread)
+    std::array<bool, numBands> runningEnabled;
+    std::array<FilterType, numBands> runningTypes;
+    BandArray runningOctaves;   // Frequency as log2 of Hertz
+    BandArray runningGains;
+    BandArray runningLogQs;     // Quality factor as log2
+    
+    // Coefficients in use, and those reached at the end of the current interval
+    std::array<FilterCoefficients, numBands> coefficients;
+    std::array<FilterCoefficients, numBands> targetCoefficients;
+    
+    // Biquad state of every band, one array per channel
+    std::vector<BandArray> firstStates;
+    std::vector<BandArray> secondStates;
+    
+    // Move the running parameters on by one interval and set the coefficients to reach by its end
+    void updateTargets(int numSamples);
+    
+    // Filter one interval of a channel through the pipeline of active bands
+    void processInterval(float* data, int numSamples, int channel, const std::array<int, numBands>& activeBands,
+                         int numActive);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParametricEQ)
+};
+
+} // namespace UndergroundBeats
@@ -6,9 +6,23 @@
  */
 
 #include "Reverb.h"
+#include <cmath>
+#include <limits>
 
 namespace UndergroundBeats {
 
+namespace {
+
+// Feedback of juce::Reverb's combs: roomSize * scale + offset
+constexpr double combFeedbackScale = 0.28;
+constexpr double combFeedbackOffset = 0.7;
+
+// Loop time of its longest comb, and the delay through its allpasses (both independent of sample rate)
+constexpr double longestCombSeconds = (1617.0 + 23.0) / 44100.0;
+constexpr double allpassSeconds = (556.0 + 441.0 + 341.0 + 225.0 + 4.0 * 23.0) / 44100.0;
+
+} // namespace
+
 Reverb::Reverb()
     : Effect("Reverb")
     , roomSize(0.5f)
@@ -86,6 +100,20 @@ void Reverb::reset()
     jucereverb.reset();
 }
 
+double Reverb::getTailLengthSeconds() const
+{
+    if (freeze)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    
+    // The slowest comb sets the decay; its damping only shortens it
+    const double combFeedback = roomSize * combFeedbackScale + combFeedbackOffset;
+    const double numTrips = std::ceil(tailDecayDecibels / (-20.0 * std::log10(combFeedback)));
+    
+    return numTrips * longestCombSeconds + allpassSeconds;
+}
+
 std::unique_ptr<juce::XmlElement> Reverb::createStateXml() const
 {
     auto xml = Effect::createStateXml();
@@ -130,41 +158,18 @@ bool Reverb::restoreStateFromXml(const juce::XmlElement* xml)
     return true;
 }
 
-float Reverb::processSample(float sample)
+void Reverb::processBlock(const juce::dsp::AudioBlock<float>& block)
 {
-    // Process through the reverb
-    // Note: JUCE's reverb is inherently stereo, so we'll process mono as if it's both left and right
-    float left = sample;
-    float right = sample;
-    
-    jucereverb.processStereo(&left, &right, 1);
+    const int numSamples = static_cast<int>(block.getNumSamples());
     
-    // Return the average of left and right channels
-    return (left + right) * 0.5f;
-}
-
-void Reverb::processSampleStereo(float leftSample, float rightSample, float* leftOutput, float* rightOutput)
-{
-    // Process through the reverb
-    *leftOutput = leftSample;
-    *rightOutput = rightSample;
-    
-    jucereverb.processStereo(leftOutput, rightOutput, 1);
-}
-
-void Reverb::processBuffer(float* buffer, int numSamples)
-{
-    // Process each sample through the reverb
-    for (int i = 0; i < numSamples; ++i)
+    if (block.getNumChannels() == 1)
     {
-        buffer[i] = processSample(buffer[i]);
+        jucereverb.processMono(block.getChannelPointer(0), numSamples);
+        return;
     }
-}
-
-void Reverb::processBufferStereo(float* leftBuffer, float* rightBuffer, int numSamples)
-{
-    // Process the buffer through the JUCE reverb
-    jucereverb.processStereo(leftBuffer, rightBuffer, numSamples);
+    
+    // Process the block through the JUCE reverb
+    jucereverb.processStereo(block.getChannelPointer(0), block.getChannelPointer(1), numSamples);
 }
 
 void Reverb::updateParameters()
@@ -92,6 +92,13 @@ public:
      */
     void reset() override;
     
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * @return Tail length in seconds, or infinity in freeze mode
+     */
+    double getTailLengthSeconds() const override;
+    
     /**
      * @brief Create an XML element containing the effect's state
      * 
@@ -109,39 +116,14 @@ public:
     
 protected:
     /**
-     * @brief Process a single sample (mono)
-     * 
-     * @param sample The input sample
-     * @return The processed sample
-     */
-    float processSample(float sample) override;
-    
-    /**
-     * @brief Process a single sample (stereo)
+     * @brief Process a block of audio
      * 
-     * @param leftSample The left channel input sample
-     * @param rightSample The right channel input sample
-     * @param leftOutput Pointer to store left channel output
-     * @param rightOutput Pointer to store right channel output
-     */
-    void processSampleStereo(float leftSample, float rightSample, float* leftOutput, float* rightOutput) override;
-    
-    /**
-     * @brief Process a buffer of samples
-     * 
-     * @param buffer Buffer containing samples to process
-     * @param numSamples Number of samples to process
-     */
-    void processBuffer(float* buffer, int numSamples) override;
-    
-    /**
-     * @brief Process a stereo buffer
+     * Mono blocks use the reverb's mono path; wider blocks process the first
+     * two channels as a stereo pair.
      * 
-     * @param leftBuffer Left channel buffer
-     * @param rightBuffer Right channel buffer
-     * @param numSamples Number of samples to process
+     * @param block The audio to process in place
      */
-    void processBufferStereo(float* leftBuffer, float* rightBuffer, int numSamples) override;
+    void processBlock(const juce::dsp::AudioBlock<float>& block) override;
     
 private:
     // Reverb parameters
@@ -0,0 +1,46 @@
+/*
+ * Underground Beats
+ * RingBuffer.h
+ * 
+ * Block copies into and out of power-of-two ring buffers
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Copy samples into a power-of-two ring buffer, wrapping at its end
+ * 
+ * @param ring The ring buffer, mask + 1 samples long
+ * @param mask The ring length minus one
+ * @param position Where to start writing, within the ring
+ * @param source Samples to copy, no more than the ring length
+ * @param numSamples Number of samples to copy
+ */
+inline void writeWrapped(float* ring, int mask, int position, const float* source, int numSamples)
+{
+    const int firstPart = juce::jmin(numSamples, mask + 1 - position);
+    juce::FloatVectorOperations::copy(ring + position, source, firstPart);
+    juce::FloatVectorOperations::copy(ring, source + firstPart, numSamples - firstPart);
+}
+
+/**
+ * @brief Copy samples out of a power-of-two ring buffer, wrapping at its end
+ * 
+ * @param ring The ring buffer, mask + 1 samples long
+ * @param mask The ring length minus one
+ * @param position Where to start reading, within the ring
+ * @param destination Where to copy the samples to
+ * @param numSamples Number of samples to copy, no more than the ring length
+ */
+inline void readWrapped(const float* ring, int mask, int position, float* destination, int numSamples)
+{
+    const int firstPart = juce::jmin(numSamples, mask + 1 - position);
+    juce::FloatVectorOperations::copy(destination, ring + position, firstPart);
+    juce::FloatVectorOperations::copy(destination + firstPart, ring, numSamples - firstPart);
+}
+
+} // namespace UndergroundBeats
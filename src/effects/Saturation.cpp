@@ -0,0 +1,292 @@
+/*
+ * Underground Beats
+ * Saturation.cpp
+ * 
+ * Implementation of the oversampled saturation effect
+ */
+
+#include "Saturation.h"
+#include <algorithm>
+#include <cmath>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Offset of the Tube curve's operating point
+constexpr float tubeBias = 0.3f;
+
+// Keeps the Fold curve's phase positive, so truncation rounds down
+constexpr float foldOffset = 64.0f;
+constexpr float foldLimit = 200.0f;
+
+// Cutoff of the DC blocker after the curve
+constexpr double dcBlockerCutoffHz = 5.0;
+
+// Rational approximation of tanh: within 3% of it, and exactly +-1 beyond |x| = 3
+inline float softClip(float x)
+{
+    const float clamped = juce::jmax(-3.0f, juce::jmin(3.0f, x));
+    const float squared = clamped * clamped;
+    return clamped * (27.0f + squared) / (27.0f + 9.0f * squared);
+}
+
+} // namespace
+
+Saturation::Saturation()
+    : Effect("Saturation")
+    , curve(SaturationCurve::Soft)
+    , drive(12.0f)
+    , outputGain(0.0f)
+    , oversamplingFactor(2)
+    , oversamplingQuality(OversamplingQuality::Live)
+    , currentDriveGain(1.0f)
+    , currentOutputGain(1.0f)
+    , dcCoefficient(0.0f)
+{
+}
+
+Saturation::~Saturation()
+{
+}
+
+void Saturation::setCurve(SaturationCurve curve)
+{
+    this->curve = curve;
+}
+
+SaturationCurve Saturation::getCurve() const
+{
+    return curve;
+}
+
+void Saturation::setDrive(float driveDb)
+{
+    drive = juce::jlimit(0.0f, 36.0f, driveDb);
+}
+
+float Saturation::getDrive() const
+{
+    return drive;
+}
+
+void Saturation::setOutputGain(float gainDb)
+{
+    outputGain = juce::jlimit(-24.0f, 12.0f, gainDb);
+}
+
+float Saturation::getOutputGain() const
+{
+    return outputGain;
+}
+
+void Saturation::setOversamplingFactor(int factor)
+{
+    oversamplingFactor = factor >= 8 ? 8 : factor >= 4 ? 4 : factor >= 2 ? 2 : 1;
+}
+
+int Saturation::getOversamplingFactor() const
+{
+    return oversamplingFactor;
+}
+
+void Saturation::setOversamplingQuality(OversamplingQuality quality)
+{
+    oversamplingQuality = quality;
+}
+
+OversamplingQuality Saturation::getOversamplingQuality() const
+{
+    return oversamplingQuality;
+}
+
+int Saturation::getLatencySamples() const
+{
+    return oversampler.getLatencySamples();
+}
+
+void Saturation::prepare(double sampleRate, int blockSize)
+{
+    // Design the filters first, as the base class delays the dry signal by their latency
+    oversampler.prepare(maxChannels, juce::jmax(1, blockSize), oversamplingFactor, oversamplingQuality);
+    
+    dcCoefficient = static_cast<float>(std::exp(-juce::MathConstants<double>::twoPi * dcBlockerCutoffHz / sampleRate));
+    dcInputs.assign(static_cast<size_t>(maxChannels), 0.0f);
+    dcOutputs.assign(static_cast<size_t>(maxChannels), 0.0f);
+    
+    Effect::prepare(sampleRate, blockSize);
+}
+
+void Saturation::reset()
+{
+    Effect::reset();
+    
+    oversampler.reset();
+    std::fill(dcInputs.begin(), dcInputs.end(), 0.0f);
+    std::fill(dcOutputs.begin(), dcOutputs.end(), 0.0f);
+    
+    // Start at the current settings rather than ramping from unity
+    currentDriveGain = juce::Decibels::decibelsToGain(drive);
+    currentOutputGain = juce::Decibels::decibelsToGain(outputGain);
+}
+
+double Saturation::getTailLengthSeconds() const
+{
+    // Samples for the DC blocker's memory to fall by the tail decay
+    const double dcDecaySamples = tailDecayDecibels / (-20.0 * std::log10(juce::jmax(1.0e-6, static_cast<double>(dcCoefficient))));
+    
+    return (oversampler.getLatencySamples() + dcDecaySamples) / currentSampleRate;
+}
+
+std::unique_ptr<juce::XmlElement> Saturation::createStateXml() const
+{
+    auto xml = Effect::createStateXml();
+    
+    // Add saturation-specific attributes
+    xml->setAttribute("curve", static_cast<int>(curve));
+    xml->setAttribute("drive", drive);
+    xml->setAttribute("outputGain", outputGain);
+    xml->setAttribute("oversamplingFactor", oversamplingFactor);
+    xml->setAttribute("oversamplingQuality", static_cast<int>(oversamplingQuality));
+    
+    return xml;
+}
+
+bool Saturation::restoreStateFromXml(const juce::XmlElement* xml)
+{
+    if (!Effect::restoreStateFromXml(xml))
+    {
+        return false;
+    }
+    
+    // Restore saturation-specific attributes
+    if (xml->hasAttribute("curve"))
+    {
+        setCurve(static_cast<SaturationCurve>(juce::jlimit(0, 3, xml->getIntAttribute("curve", 0))));
+    }
+    
+    if (xml->hasAttribute("drive"))
+    {
+        setDrive(xml->getDoubleAttribute("drive", 12.0f));
+    }
+    
+    if (xml->hasAttribute("outputGain"))
+    {
+        setOutputGain(xml->getDoubleAttribute("outputGain", 0.0f));
+    }
+    
+    if (xml->hasAttribute("oversamplingFactor"))
+    {
+        setOversamplingFactor(xml->getIntAttribute("oversamplingFactor", 2));
+    }
+    
+    if (xml->hasAttribute("oversamplingQuality"))
+    {
+        setOversamplingQuality(static_cast<OversamplingQuality>(juce::jlimit(0, 1, xml->getIntAttribute("oversamplingQuality", 0))));
+    }
+    
+    return true;
+}
+
+void Saturation::processBlock(const juce::dsp::AudioBlock<float>& block)
+{
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    
+    // Ramp the gains linearly across the block, so automation does not click
+    const float startDrive = currentDriveGain;
+    const float endDrive = juce::Decibels::decibelsToGain(drive);
+    const float driveStep = (endDrive - startDrive) / static_cast<float>(numSamples);
+    const float startOutput = currentOutputGain;
+    const float endOutput = juce::Decibels::decibelsToGain(outputGain);
+    const float outputStep = (endOutput - startOutput) / static_cast<float>(numSamples);
+    currentDriveGain = endDrive;
+    currentOutputGain = endOutput;
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* data = block.getChannelPointer(static_cast<size_t>(channel));
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            data[i] *= startDrive + static_cast<float>(i + 1) * driveStep;
+        }
+    }
+    
+    // The curve runs at the oversampled rate
+    const auto oversampled = oversampler.upsample(block);
+    const int numOversampled = static_cast<int>(oversampled.getNumSamples());
+    
+    for (size_t channel = 0; channel < oversampled.getNumChannels(); ++channel)
+    {
+        applyCurve(oversampled.getChannelPointer(channel), numOversampled);
+    }
+    
+    oversampler.downsample(block);
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* data = block.getChannelPointer(static_cast<size_t>(channel));
+        const size_t index = static_cast<size_t>(channel);
+        float lastInput = dcInputs[index];
+        float lastOutput = dcOutputs[index];
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            // One-pole DC blocker, then the output gain
+            const float input = data[i];
+            lastOutput = input - lastInput + dcCoefficient * lastOutput;
+            lastInput = input;
+            data[i] = lastOutput * (startOutput + static_cast<float>(i + 1) * outputStep);
+        }
+        
+        dcInputs[index] = lastInput;
+        dcOutputs[index] = lastOutput;
+    }
+}
+
+void Saturation::applyCurve(float* data, int numSamples) const
+{
+    // One branch-free loop per curve, so each vectorizes
+    switch (curve)
+    {
+        case SaturationCurve::Soft:
+            for (int i = 0; i < numSamples; ++i)
+            {
+                data[i] = softClip(data[i]);
+            }
+            break;
+            
+        case SaturationCurve::Hard:
+            for (int i = 0; i < numSamples; ++i)
+            {
+                data[i] = juce::jmax(-1.0f, juce::jmin(1.0f, data[i]));
+            }
+            break;
+            
+        case SaturationCurve::Tube:
+        {
+            // Biased off centre for even harmonics, shifted so silence stays silent
+            const float restingLevel = softClip(tubeBias);
+            
+            for (int i = 0; i < numSamples; ++i)
+            {
+                data[i] = softClip(data[i] + tubeBias) - restingLevel;
+            }
+            break;
+        }
+        
+        case SaturationCurve::Fold:
+            for (int i = 0; i < numSamples; ++i)
+            {
+                // A triangle of the input: rises to +-1, then folds back towards 0
+                const float clamped = juce::jmax(-foldLimit, juce::jmin(foldLimit, data[i]));
+                const float phase = (clamped + 1.0f) * 0.25f + foldOffset;
+                const float fraction = phase - static_cast<float>(static_cast<int>(phase));
+                data[i] = 1.0f - 4.0f * std::abs(fraction - 0.5f);
+            }
+            break;
+    }
+}
+
+} // namespace UndergroundBeats
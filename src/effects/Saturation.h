@@ -0,0 +1,196 @@
+/*
+ * Underground Beats
+ * Saturation.h
+ * 
+ * Oversampled saturation and distortion
+ */
+
+#pragma once
+
+#include "Effect.h"
+#include "Oversampler.h"
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of saturation transfer curves
+ */
+enum class SaturationCurve {
+    Soft, // Smooth tanh-like curve, odd harmonics
+    Hard, // Clips flat at full scale
+    Tube, // Soft curve biased off centre, adding even harmonics
+    Fold  // Folds back from full scale, bright and metallic when driven
+};
+
+/**
+ * @class Saturation
+ * @brief Saturation and distortion with 1x to 8x oversampling
+ * 
+ * The driven input is raised to a higher sample rate by an Oversampler, passed
+ * through the transfer curve, and brought back down, so the harmonics the
+ * curve adds above the original Nyquist frequency are filtered out rather than
+ * folding back as aliasing. Each curve is a branch-free loop over the
+ * oversampled block that the compiler vectorizes.
+ * 
+ * The oversampling filters delay the output, which getLatencySamples()
+ * reports. The factor and the filter quality change the latency, so they take
+ * effect at the next call to prepare(): use Live quality while playing and
+ * Offline quality for rendering. A DC blocker after the curve removes the
+ * offset the Tube curve adds, and drive and output gain ramp across each block.
+ */
+class Saturation : public Effect {
+public:
+    Saturation();
+    ~Saturation() override;
+    
+    /**
+     * @brief Set the transfer curve
+     * 
+     * @param curve The curve to use
+     */
+    void setCurve(SaturationCurve curve);
+    
+    /**
+     * @brief Get the current transfer curve
+     * 
+     * @return The current curve
+     */
+    SaturationCurve getCurve() const;
+    
+    /**
+     * @brief Set the gain into the curve
+     * 
+     * @param driveDb Drive in decibels (0 to 36)
+     */
+    void setDrive(float driveDb);
+    
+    /**
+     * @brief Get the current drive
+     * 
+     * @return Drive in decibels
+     */
+    float getDrive() const;
+    
+    /**
+     * @brief Set the gain applied after the curve
+     * 
+     * @param gainDb Output gain in decibels (-24 to 12)
+     */
+    void setOutputGain(float gainDb);
+    
+    /**
+     * @brief Get the current output gain
+     * 
+     * @return Output gain in decibels
+     */
+    float getOutputGain() const;
+    
+    /**
+     * @brief Set the oversampling factor
+     * 
+     * Changes the latency, so it takes effect at the next call to prepare().
+     * 
+     * @param factor 1, 2, 4, or 8; other values round down to one of these
+     */
+    void setOversamplingFactor(int factor);
+    
+    /**
+     * @brief Get the oversampling factor
+     * 
+     * @return 1, 2, 4, or 8
+     */
+    int getOversamplingFactor() const;
+    
+    /**
+     * @brief Set the quality of the oversampling filters
+     * 
+     * Changes the latency, so it takes effect at the next call to prepare().
+     * 
+     * @param quality Live for lower latency and CPU, Offline for rendering
+     */
+    void setOversamplingQuality(OversamplingQuality quality);
+    
+    /**
+     * @brief Get the quality of the oversampling filters
+     * 
+     * @return The filter quality
+     */
+    OversamplingQuality getOversamplingQuality() const;
+    
+    /**
+     * @brief Get the delay the oversampling filters add to the output
+     * 
+     * @return Latency in samples at the prepared sample rate
+     */
+    int getLatencySamples() const override;
+    
+    /**
+     * @brief Prepare the effect for processing
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param blockSize The maximum block size in samples
+     */
+    void prepare(double sampleRate, int blockSize) override;
+    
+    /**
+     * @brief Reset the effect state
+     */
+    void reset() override;
+    
+    /**
+     * @brief Get how long the effect keeps sounding once its input falls silent
+     * 
+     * @return The oversampling latency plus the time the DC blocker takes to settle
+     */
+    double getTailLengthSeconds() const override;
+    
+    /**
+     * @brief Create an XML element containing the effect's state
+     * 
+     * @return XML element containing effect state
+     */
+    std::unique_ptr<juce::XmlElement> createStateXml() const override;
+    
+    /**
+     * @brief Restore effect state from an XML element
+     * 
+     * @param xml XML element containing effect state
+     * @return true if state was successfully restored
+     */
+    bool restoreStateFromXml(const juce::XmlElement* xml) override;
+    
+protected:
+    /**
+     * @brief Process a block of audio
+     * 
+     * @param block The audio to process in place
+     */
+    void processBlock(const juce::dsp::AudioBlock<float>& block) override;
+    
+private:
+    // Saturation parameters
+    SaturationCurve curve;
+    float drive;
+    float outputGain;
+    int oversamplingFactor;
+    OversamplingQuality oversamplingQuality;
+    
+    // Linear gains reached by the ramps (audio thread)
+    float currentDriveGain;
+    float currentOutputGain;
+    
+    Oversampler oversampler;
+    
+    // DC blocker state, one per channel
+    float dcCoefficient;
+    std::vector<float> dcInputs;
+    std::vector<float> dcOutputs;
+    
+    // Apply the transfer curve in place at the oversampled rate
+    void applyCurve(float* data, int numSamples) const;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Saturation)
+};
+
+} // namespace UndergroundBeats
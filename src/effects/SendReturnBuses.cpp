@@ -0,0 +1,236 @@
+/*
+ * Underground Beats
+ * SendReturnBuses.cpp
+ * 
+ * Implementation of the effect send buses
+ */
+
+#include "SendReturnBuses.h"
+
+namespace UndergroundBeats {
+
+SendReturnBuses::SendReturnBuses(int maxChannels, int maxSends)
+    : maxChannels(juce::jmax(1, maxChannels))
+    , maxSends(juce::jmax(1, maxSends))
+    , numSends(0)
+    , sendLevels(static_cast<size_t>(this->maxChannels * this->maxSends))
+    , currentLevels(static_cast<size_t>(this->maxChannels * this->maxSends), 0.0f)
+    , currentSampleRate(44100.0)
+    , currentBlockSize(512)
+    , workerPool(nullptr)
+    , blockSends(0)
+    , blockSamples(0)
+{
+    for (auto& level : sendLevels)
+    {
+        level.store(0.0f, std::memory_order_relaxed);
+    }
+    
+    for (int i = 0; i < this->maxSends; ++i)
+    {
+        returnChains.push_back(std::make_unique<EffectsChain>());
+    }
+    
+    busBuffers.setSize(2 * this->maxSends, currentBlockSize);
+}
+
+SendReturnBuses::~SendReturnBuses()
+{
+}
+
+void SendReturnBuses::setNumSends(int numSends)
+{
+    this->numSends.store(juce::jlimit(0, maxSends, numSends), std::memory_order_release);
+}
+
+int SendReturnBuses::getNumSends() const
+{
+    return numSends.load(std::memory_order_acquire);
+}
+
+int SendReturnBuses::getMaxSends() const
+{
+    return maxSends;
+}
+
+int SendReturnBuses::getMaxChannels() const
+{
+    return maxChannels;
+}
+
+EffectsChain* SendReturnBuses::getReturnChain(int sendIndex)
+{
+    if (sendIndex < 0 || sendIndex >= maxSends)
+    {
+        return nullptr;
+    }
+    
+    return returnChains[static_cast<size_t>(sendIndex)].get();
+}
+
+void SendReturnBuses::setSendLevel(int channel, int sendIndex, float level)
+{
+    if (channel < 0 || channel >= maxChannels || sendIndex < 0 || sendIndex >= maxSends)
+    {
+        return;
+    }
+    
+    sendLevels[static_cast<size_t>(channel * maxSends + sendIndex)].store(juce::jlimit(0.0f, 1.0f, level), std::memory_order_relaxed);
+}
+
+float SendReturnBuses::getSendLevel(int channel, int sendIndex) const
+{
+    if (channel < 0 || channel >= maxChannels || sendIndex < 0 || sendIndex >= maxSends)
+    {
+        return 0.0f;
+    }
+    
+    return sendLevels[static_cast<size_t>(channel * maxSends + sendIndex)].load(std::memory_order_relaxed);
+}
+
+void SendReturnBuses::setWorkerPool(AudioWorkerPool* pool)
+{
+    workerPool = pool;
+}
+
+void SendReturnBuses::prepare(double sampleRate, int blockSize)
+{
+    currentSampleRate = sampleRate;
+    currentBlockSize = blockSize;
+    
+    busBuffers.setSize(2 * maxSends, juce::jmax(1, blockSize), false, true, true);
+    busBuffers.clear();
+    
+    // Start at the target levels rather than ramping from silence
+    for (size_t i = 0; i < currentLevels.size(); ++i)
+    {
+        currentLevels[i] = sendLevels[i].load(std::memory_order_relaxed);
+    }
+    
+    for (auto& chain : returnChains)
+    {
+        chain->prepare(sampleRate, blockSize);
+    }
+}
+
+void SendReturnBuses::reset()
+{
+    busBuffers.clear();
+    
+    for (auto& chain : returnChains)
+    {
+        chain->reset();
+    }
+}
+
+void SendReturnBuses::beginBlock(int numSamples)
+{
+    jassert(numSamples <= busBuffers.getNumSamples());
+    
+    blockSends = numSends.load(std::memory_order_acquire);
+    blockSamples = juce::jlimit(0, busBuffers.getNumSamples(), numSamples);
+    
+    for (int channel = 0; channel < 2 * blockSends; ++channel)
+    {
+        juce::FloatVectorOperations::clear(busBuffers.getWritePointer(channel), blockSamples);
+    }
+}
+
+void SendReturnBuses::addToSends(int channel, const float* leftBuffer, const float* rightBuffer)
+{
+    if (channel < 0 || channel >= maxChannels || blockSamples == 0)
+    {
+        return;
+    }
+    
+    if (rightBuffer == nullptr)
+    {
+        rightBuffer = leftBuffer;
+    }
+    
+    const float maxChange = static_cast<float>(blockSamples / (levelSmoothingSeconds * currentSampleRate));
+    const float rampScale = 1.0f / static_cast<float>(blockSamples);
+    
+    for (int sendIndex = 0; sendIndex < blockSends; ++sendIndex)
+    {
+        const size_t levelIndex = static_cast<size_t>(channel * maxSends + sendIndex);
+        
+        // Move the level towards its target at a fixed rate, linearly across the block
+        const float startLevel = currentLevels[levelIndex];
+        const float targetLevel = sendLevels[levelIndex].load(std::memory_order_relaxed);
+        const float endLevel = startLevel + juce::jlimit(-maxChange, maxChange, targetLevel - startLevel);
+        currentLevels[levelIndex] = endLevel;
+        
+        float* busLeft = busBuffers.getWritePointer(2 * sendIndex);
+        float* busRight = busBuffers.getWritePointer(2 * sendIndex + 1);
+        
+        if (startLevel == endLevel)
+        {
+            if (endLevel <= 0.0f)
+            {
+                continue;
+            }
+            
+            juce::FloatVectorOperations::addWithMultiply(busLeft, leftBuffer, endLevel, blockSamples);
+            juce::FloatVectorOperations::addWithMultiply(busRight, rightBuffer, endLevel, blockSamples);
+            continue;
+        }
+        
+        // Ramped levels as plain loops the compiler can vectorize
+        const float step = (endLevel - startLevel) * rampScale;
+        
+        for (int i = 0; i < blockSamples; ++i)
+        {
+            const float level = startLevel + step * static_cast<float>(i + 1);
+            busLeft[i] += leftBuffer[i] * level;
+            busRight[i] += rightBuffer[i] * level;
+        }
+    }
+}
+
+void SendReturnBuses::renderReturns(float* leftBuffer, float* rightBuffer)
+{
+    if (blockSends == 0 || blockSamples == 0)
+    {
+        return;
+    }
+    
+    // The buses are independent, so they can be processed side by side
+    if (workerPool != nullptr && blockSends > 1)
+    {
+        workerPool->run(blockSends, &SendReturnBuses::renderReturn, this);
+    }
+    else
+    {
+        for (int sendIndex = 0; sendIndex < blockSends; ++sendIndex)
+        {
+            renderReturn(this, sendIndex);
+        }
+    }
+    
+    for (int sendIndex = 0; sendIndex < blockSends; ++sendIndex)
+    {
+        // A return without effects would only add the dry sends to the mix again
+        if (returnChains[static_cast<size_t>(sendIndex)]->isEmpty())
+        {
+            continue;
+        }
+        
+        juce::FloatVectorOperations::add(leftBuffer, busBuffers.getReadPointer(2 * sendIndex), blockSamples);
+        juce::FloatVectorOperations::add(rightBuffer, busBuffers.getReadPointer(2 * sendIndex + 1), blockSamples);
+    }
+}
+
+void SendReturnBuses::renderReturn(void* context, int sendIndex)
+{
+    // Worker threads have their own floating point mode
+    juce::ScopedNoDenormals noDenormals;
+    
+    SendReturnBuses& buses = *static_cast<SendReturnBuses*>(context);
+    
+    buses.returnChains[static_cast<size_t>(sendIndex)]->processStereo(buses.busBuffers.getWritePointer(2 * sendIndex),
+                                                                      buses.busBuffers.getWritePointer(2 * sendIndex + 1),
+                                                                      buses.blockSamples);
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,179 @@
+/*
+ * Underground Beats
+ * SendReturnBuses.h
+ * 
+ * Effect send buses feeding shared return chains
+ */
+
+#pragma once
+
+#include "EffectsChain.h"
+#include "AudioWorkerPool.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SendReturnBuses
+ * @brief Effect send buses feeding shared return chains
+ * 
+ * Mixer channels feed each send bus at their own level, and every bus is
+ * processed once per block by its own EffectsChain, so one reverb or delay
+ * serves any number of channels. The buses are independent, so with a
+ * worker pool set they are processed in parallel.
+ * 
+ * Storage for every channel and send is allocated up front, so the number of
+ * sends and the send levels can change at any time without locking. Send
+ * levels move towards their targets at a fixed rate, ramped across each block.
+ * 
+ * Each block, call beginBlock(), then addToSends() once per channel, then
+ * renderReturns() to add the returns to the mix. Returns whose chain has no
+ * effects are muted, so an unused send never doubles the dry signal.
+ */
+class SendReturnBuses {
+public:
+    /**
+     * @brief Create the buses
+     * 
+     * @param maxChannels The largest number of channels that can feed the sends
+     * @param maxSends The largest number of sends
+     */
+    SendReturnBuses(int maxChannels = 32, int maxSends = 8);
+    ~SendReturnBuses();
+    
+    /**
+     * @brief Set the number of active sends
+     * 
+     * Takes effect at the next block. Inactive sends are neither fed nor
+     * processed.
+     * 
+     * @param numSends Number of sends (0 to the maximum)
+     */
+    void setNumSends(int numSends);
+    
+    /**
+     * @brief Get the number of active sends
+     * 
+     * @return The number of active sends
+     */
+    int getNumSends() const;
+    
+    /**
+     * @brief Get the largest number of sends
+     * 
+     * @return The maximum number of sends
+     */
+    int getMaxSends() const;
+    
+    /**
+     * @brief Get the largest number of channels that can feed the sends
+     * 
+     * @return The maximum number of channels
+     */
+    int getMaxChannels() const;
+    
+    /**
+     * @brief Get the effect chain a send returns through
+     * 
+     * @param sendIndex The send
+     * @return The return chain, or nullptr if the index is out of range
+     */
+    EffectsChain* getReturnChain(int sendIndex);
+    
+    /**
+     * @brief Set how much of a channel feeds a send
+     * 
+     * @param channel The channel
+     * @param sendIndex The send
+     * @param level Send level (0 to 1)
+     */
+    void setSendLevel(int channel, int sendIndex, float level);
+    
+    /**
+     * @brief Get how much of a channel feeds a send
+     * 
+     * @param channel The channel
+     * @param sendIndex The send
+     * @return The target send level, or 0 if out of range
+     */
+    float getSendLevel(int channel, int sendIndex) const;
+    
+    /**
+     * @brief Set the worker pool used to process the returns in parallel
+     * 
+     * @param pool The worker pool, or nullptr to process on the calling thread
+     */
+    void setWorkerPool(AudioWorkerPool* pool);
+    
+    /**
+     * @brief Prepare the buses and return chains for processing
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param blockSize The maximum block size in samples
+     */
+    void prepare(double sampleRate, int blockSize);
+    
+    /**
+     * @brief Reset the return chains
+     */
+    void reset();
+    
+    /**
+     * @brief Start a block by clearing the buses
+     * 
+     * @param numSamples Number of samples in the block (no more than the prepared block size)
+     */
+    void beginBlock(int numSamples);
+    
+    /**
+     * @brief Feed a channel into every active send
+     * 
+     * @param channel The channel
+     * @param leftBuffer Left channel samples
+     * @param rightBuffer Right channel samples, or nullptr for a mono channel
+     */
+    void addToSends(int channel, const float* leftBuffer, const float* rightBuffer);
+    
+    /**
+     * @brief Process every active bus through its return chain and add it to the mix
+     * 
+     * @param leftBuffer Left mix to add the returns to
+     * @param rightBuffer Right mix to add the returns to
+     */
+    void renderReturns(float* leftBuffer, float* rightBuffer);
+    
+private:
+    int maxChannels;
+    int maxSends;
+    std::atomic<int> numSends;
+    
+    // Return chain of each send
+    std::vector<std::unique_ptr<EffectsChain>> returnChains;
+    
+    // Target and smoothed level of each channel's sends, at channel * maxSends + send
+    std::vector<std::atomic<float>> sendLevels;
+    std::vector<float> currentLevels;
+    
+    // Stereo sum feeding each send, on channels 2 * send and 2 * send + 1
+    juce::AudioBuffer<float> busBuffers;
+    
+    double currentSampleRate;
+    int currentBlockSize;
+    AudioWorkerPool* workerPool;
+    
+    // Current block, fixed by beginBlock()
+    int blockSends;
+    int blockSamples;
+    
+    // Time for a send level to sweep its whole range
+    static constexpr double levelSmoothingSeconds = 0.02;
+    
+    // Process one bus through its return chain (worker pool task)
+    static void renderReturn(void* context, int sendIndex);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SendReturnBuses)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,93 @@
+/*
+ * Underground Beats
+ * MidiEventIterator.cpp
+ * 
+ * Implementation of lightweight MIDI buffer decoding
+ */
+
+#include "MidiEventIterator.h"
+
+namespace UndergroundBeats {
+
+MidiEventIterator::MidiEventIterator(const juce::MidiBuffer& buffer)
+    : current(buffer.cbegin())
+    , end(buffer.cend())
+{
+}
+
+bool MidiEventIterator::next(MidiEvent& event)
+{
+    if (current == end)
+    {
+        return false;
+    }
+    
+    const auto metadata = *current;
+    ++current;
+    
+    event.samplePosition = metadata.samplePosition;
+    decode(metadata.data, metadata.numBytes, event);
+    
+    return true;
+}
+
+void MidiEventIterator::decode(const juce::uint8* data, int numBytes, MidiEvent& event)
+{
+    event.type = MidiEventType::Other;
+    event.channel = 1;
+    event.data1 = 0;
+    event.data2 = 0;
+    
+    if (data == nullptr || numBytes < 1)
+    {
+        return;
+    }
+    
+    const int status = data[0];
+    
+    // System messages carry no channel data we use
+    if (status < 0x80 || status >= 0xf0)
+    {
+        return;
+    }
+    
+    event.channel = (status & 0x0f) + 1;
+    event.data1 = numBytes > 1 ? (data[1] & 0x7f) : 0;
+    event.data2 = numBytes > 2 ? (data[2] & 0x7f) : 0;
+    
+    switch (status & 0xf0)
+    {
+        case 0x90:
+            // Note-on with zero velocity is a note-off
+            event.type = event.data2 > 0 ? MidiEventType::NoteOn : MidiEventType::NoteOff;
+            break;
+            
+        case 0x80:
+            event.type = MidiEventType::NoteOff;
+            break;
+            
+        case 0xa0:
+            event.type = MidiEventType::PolyAftertouch;
+            break;
+            
+        case 0xb0:
+            event.type = (event.data1 == 123) ? MidiEventType::AllNotesOff : MidiEventType::Controller;
+            break;
+            
+        case 0xd0:
+            // Channel pressure has a single data byte
+            event.type = MidiEventType::ChannelPressure;
+            event.data2 = event.data1;
+            event.data1 = 0;
+            break;
+            
+        case 0xe0:
+            event.type = MidiEventType::PitchBend;
+            break;
+            
+        default:
+            break;
+    }
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,125 @@
+/*
+ * Underground Beats
+ * MidiEventIterator.h
+ * 
+ * Lightweight decoding of MIDI buffer events for the audio thread
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of decoded MIDI event types
+ */
+enum class MidiEventType {
+    NoteOn,
+    NoteOff,
+    AllNotesOff,
+    Controller,
+    PolyAftertouch,
+    ChannelPressure,
+    PitchBend,
+    Other
+};
+
+/**
+ * @brief A MIDI channel event decoded straight from raw bytes
+ */
+struct MidiEvent {
+    MidiEventType type = MidiEventType::Other;
+    int samplePosition = 0; // Offset of the event within the block
+    int channel = 1;        // MIDI channel (1 to 16)
+    int data1 = 0;          // Note number, controller number, or pitch bend LSB
+    int data2 = 0;          // Velocity, controller value, or pressure
+    
+    /**
+     * @brief Get the velocity of a note event
+     * 
+     * @return The velocity (0 to 1)
+     */
+    float getVelocity() const { return static_cast<float>(data2) / 127.0f; }
+    
+    /**
+     * @brief Get the value of a pitch bend event
+     * 
+     * @return The 14-bit pitch wheel value (0 to 16383, centre 8192)
+     */
+    int getPitchBendValue() const { return data1 | (data2 << 7); }
+};
+
+/**
+ * @class MidiEventIterator
+ * @brief Walks a MidiBuffer without constructing juce::MidiMessage objects
+ * 
+ * Each event is decoded from its status and data bytes into a small MidiEvent.
+ * This keeps per-event work in the audio thread to a few byte reads.
+ * Events are returned in buffer order, which is ascending sample position.
+ */
+class MidiEventIterator {
+public:
+    /**
+     * @brief Create an iterator over a MIDI buffer
+     * 
+     * @param buffer The buffer to read (must outlive the iterator)
+     */
+    explicit MidiEventIterator(const juce::MidiBuffer& buffer);
+    
+    /**
+     * @brief Decode the next event
+     * 
+     * @param event Receives the decoded event
+     * @return true if an event was read, false at the end of the buffer
+     */
+    bool next(MidiEvent& event);
+    
+private:
+    juce::MidiBufferIterator current;
+    juce::MidiBufferIterator end;
+    
+    // Decode raw message bytes into an event
+    static void decode(const juce::uint8* data, int numBytes, MidiEvent& event);
+};
+
+/**
+ * @brief Render a block in spans that end at each MIDI event
+ * 
+ * The block is split at each event's sample position, so notes start and
+ * stop sample-accurately regardless of the buffer size. Spans and events
+ * alternate in order; events past the end of the block apply at its end.
+ * 
+ * @param midiMessages The events for the block
+ * @param numSamples Length of the block
+ * @param renderSpan Called as renderSpan(startSample, numSamples) for each non-empty span
+ * @param handleEvent Called as handleEvent(event) for each decoded event
+ */
+template <typename RenderSpan, typename HandleEvent>
+void renderSplitAtEvents(const juce::MidiBuffer& midiMessages, int numSamples, RenderSpan&& renderSpan, HandleEvent&& handleEvent)
+{
+    MidiEventIterator events(midiMessages);
+    MidiEvent event;
+    int position = 0;
+    
+    while (events.next(event))
+    {
+        const int eventPosition = juce::jlimit(position, numSamples, event.samplePosition);
+        
+        if (eventPosition > position)
+        {
+            renderSpan(position, eventPosition - position);
+            position = eventPosition;
+        }
+        
+        handleEvent(event);
+    }
+    
+    // Render the remainder of the block
+    if (numSamples > position)
+    {
+        renderSpan(position, numSamples - position);
+    }
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,128 @@
+/*
+ * Underground Beats
+ * BandLimitedWavetable.cpp
+ * 
+ * Implementation of the shared band-limited wavetables
+ */
+
+#include "BandLimitedWavetable.h"
+#include <complex>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Harmonics in the first (fullest) table; each following table has half as many
+constexpr int maxHarmonics = BandLimitedWavetable::tableSize / 4;
+
+int getNumHarmonics(int level)
+{
+    return maxHarmonics >> level;
+}
+
+// Fourier series of the naive Oscillator waveforms, as sine and cosine amplitudes
+void getHarmonic(WaveformType type, int harmonic, double& sineAmount, double& cosineAmount)
+{
+    const double h = static_cast<double>(harmonic);
+    const bool odd = (harmonic % 2) == 1;
+    sineAmount = 0.0;
+    cosineAmount = 0.0;
+    
+    switch (type)
+    {
+        case WaveformType::Sawtooth:
+            sineAmount = -2.0 / (juce::MathConstants<double>::pi * h);
+            break;
+            
+        case WaveformType::Square:
+            sineAmount = odd ? 4.0 / (juce::MathConstants<double>::pi * h) : 0.0;
+            break;
+            
+        case WaveformType::Triangle:
+            cosineAmount = odd ? -8.0 / (juce::MathConstants<double>::pi * juce::MathConstants<double>::pi * h * h) : 0.0;
+            break;
+            
+        default:
+            sineAmount = (harmonic == 1) ? 1.0 : 0.0;
+            break;
+    }
+}
+
+} // namespace
+
+const BandLimitedWavetable& BandLimitedWavetable::get(WaveformType type)
+{
+    static const BandLimitedWavetable sine(WaveformType::Sine);
+    static const BandLimitedWavetable triangle(WaveformType::Triangle);
+    static const BandLimitedWavetable sawtooth(WaveformType::Sawtooth);
+    static const BandLimitedWavetable square(WaveformType::Square);
+    
+    switch (type)
+    {
+        case WaveformType::Triangle:
+            return triangle;
+        case WaveformType::Sawtooth:
+            return sawtooth;
+        case WaveformType::Square:
+            return square;
+        default:
+            return sine;
+    }
+}
+
+BandLimitedWavetable::BandLimitedWavetable(WaveformType type)
+    : tables(static_cast<size_t>(numLevels * (tableSize + 1)))
+{
+    // Tables differ only in how many harmonics they hold, so build the sum once
+    // from the fundamental up and copy it out whenever a table's limit is reached
+    std::vector<double> sum(static_cast<size_t>(tableSize), 0.0);
+    
+    for (int harmonic = 1; harmonic <= maxHarmonics; ++harmonic)
+    {
+        double sineAmount, cosineAmount;
+        getHarmonic(type, harmonic, sineAmount, cosineAmount);
+        
+        if (sineAmount != 0.0 || cosineAmount != 0.0)
+        {
+            // Rotate a phasor instead of calling sin/cos per sample
+            const double step = juce::MathConstants<double>::twoPi * harmonic / tableSize;
+            const std::complex<double> rotation(std::cos(step), std::sin(step));
+            std::complex<double> phasor(1.0, 0.0);
+            
+            for (int i = 0; i < tableSize; ++i)
+            {
+                sum[static_cast<size_t>(i)] += cosineAmount * phasor.real() + sineAmount * phasor.imag();
+                phasor *= rotation;
+            }
+        }
+        
+        for (int level = 0; level < numLevels; ++level)
+        {
+            if (getNumHarmonics(level) == harmonic)
+            {
+                float* table = tables.data() + level * (tableSize + 1);
+                
+                for (int i = 0; i < tableSize; ++i)
+                {
+                    table[i] = static_cast<float>(sum[static_cast<size_t>(i)]);
+                }
+                
+                table[tableSize] = table[0];
+            }
+        }
+    }
+}
+
+const float* BandLimitedWavetable::getTable(float phaseIncrement) const
+{
+    // Use the fullest table whose highest harmonic stays below Nyquist
+    int level = 0;
+    while (level < numLevels - 1 && static_cast<float>(getNumHarmonics(level)) * std::abs(phaseIncrement) > 0.5f)
+    {
+        ++level;
+    }
+    
+    return tables.data() + level * (tableSize + 1);
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,80 @@
+/*
+ * Underground Beats
+ * BandLimitedWavetable.h
+ * 
+ * Shared mip-mapped wavetables for alias-free oscillators
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Oscillator.h"
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class BandLimitedWavetable
+ * @brief Read-only, band-limited single-cycle tables for one waveform
+ * 
+ * Each waveform is stored as a set of tables built by additive synthesis,
+ * one per octave, with the number of harmonics halved from one table to the
+ * next. Oscillators pick the table whose highest harmonic stays below Nyquist
+ * for their phase increment, so they need no per-sample anti-aliasing.
+ * 
+ * The tables do not depend on the sample rate. They are built once per
+ * process on first use and shared by every oscillator.
+ */
+class BandLimitedWavetable {
+public:
+    /** Samples per table (one extra guard sample is stored for interpolation) */
+    static constexpr int tableSize = 4096;
+    
+    /** Number of octave tables per waveform */
+    static constexpr int numLevels = 11;
+    
+    /**
+     * @brief Get the shared tables for a waveform
+     * 
+     * Sine, triangle, sawtooth, and square have their own tables. Noise and
+     * wavetable waveforms cannot be band-limited ahead of time and get the sine.
+     * 
+     * @param type The waveform
+     * @return The shared tables
+     */
+    static const BandLimitedWavetable& get(WaveformType type);
+    
+    /**
+     * @brief Get the table to use for a phase increment
+     * 
+     * @param phaseIncrement Phase increment in cycles per sample
+     * @return tableSize + 1 samples, the last equal to the first
+     */
+    const float* getTable(float phaseIncrement) const;
+    
+    /**
+     * @brief Read a table with linear interpolation
+     * 
+     * @param table A table returned by getTable
+     * @param phase Phase in cycles (0 to 1)
+     * @return The interpolated sample
+     */
+    static float lookup(const float* table, float phase)
+    {
+        const float position = phase * static_cast<float>(tableSize);
+        const int index = static_cast<int>(position);
+        const float fraction = position - static_cast<float>(index);
+        
+        return table[index] + fraction * (table[index + 1] - table[index]);
+    }
+    
+private:
+    explicit BandLimitedWavetable(WaveformType type);
+    
+    // All levels, each tableSize + 1 samples
+    std::vector<float> tables;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BandLimitedWavetable)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,224 @@
+/*
+ * Underground Beats
+ * DiskStreamer.cpp
+ * 
+ * Implementation of the disk streaming thread and per-voice streams
+ */
+
+#include "DiskStreamer.h"
+
+namespace UndergroundBeats {
+
+//==============================================================================
+// SampleStream Implementation
+//==============================================================================
+
+SampleStream::SampleStream(int ringFrames)
+    : fifo(ringFrames)
+    , requestedSample(nullptr)
+    , requestedFrame(0)
+    , requestedGeneration(0)
+    , readyGeneration(0)
+    , streamingSample(nullptr)
+    , nextFileFrame(0)
+    , framesBehind(0)
+    , underruns(0)
+{
+    ring.setSize(2, ringFrames);
+}
+
+SampleStream::~SampleStream()
+{
+}
+
+void SampleStream::start(SampleData* sample, juce::int64 startFrame)
+{
+    // Publish the request; the streaming thread resets the ring before serving it
+    framesBehind = 0;
+    requestedSample.store(sample, std::memory_order_relaxed);
+    requestedFrame.store(startFrame, std::memory_order_relaxed);
+    requestedGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void SampleStream::stop()
+{
+    start(nullptr, 0);
+}
+
+int SampleStream::read(float* left, float* right, int numFrames)
+{
+    int framesRead = 0;
+    
+    // The ring still holds data for an earlier request until the thread catches up
+    if (readyGeneration.load(std::memory_order_acquire) == requestedGeneration.load(std::memory_order_relaxed))
+    {
+        // Drop the frames that were played as silence, so the stream stays in step with the voice
+        const int framesToSkip = static_cast<int>(juce::jmin(framesBehind, static_cast<juce::int64>(fifo.getNumReady())));
+        fifo.finishedRead(framesToSkip);
+        framesBehind -= framesToSkip;
+        
+        if (framesBehind == 0)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToRead(numFrames, start1, size1, start2, size2);
+            
+            if (size1 > 0)
+            {
+                juce::FloatVectorOperations::copy(left, ring.getReadPointer(0, start1), size1);
+                juce::FloatVectorOperations::copy(right, ring.getReadPointer(1, start1), size1);
+            }
+            
+            if (size2 > 0)
+            {
+                juce::FloatVectorOperations::copy(left + size1, ring.getReadPointer(0, start2), size2);
+                juce::FloatVectorOperations::copy(right + size1, ring.getReadPointer(1, start2), size2);
+            }
+            
+            framesRead = size1 + size2;
+            fifo.finishedRead(framesRead);
+        }
+    }
+    
+    if (framesRead < numFrames)
+    {
+        // The disk fell behind: play silence rather than wait, and skip what was missed once it arrives
+        juce::FloatVectorOperations::clear(left + framesRead, numFrames - framesRead);
+        juce::FloatVectorOperations::clear(right + framesRead, numFrames - framesRead);
+        framesBehind += numFrames - framesRead;
+        underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    return framesRead;
+}
+
+int SampleStream::getNumUnderruns() const
+{
+    return underruns.load(std::memory_order_relaxed);
+}
+
+//==============================================================================
+// DiskStreamer Implementation
+//==============================================================================
+
+DiskStreamer::DiskStreamer()
+    : juce::Thread("Sample Disk Streamer")
+{
+}
+
+DiskStreamer::~DiskStreamer()
+{
+    stopThread(2000);
+}
+
+void DiskStreamer::prepare(int numStreams, int ringFrames)
+{
+    // The thread iterates the streams, so it must not run while they are replaced
+    stopThread(2000);
+    
+    streams.clear();
+    streams.reserve(static_cast<size_t>(numStreams));
+    
+    for (int i = 0; i < numStreams; ++i)
+    {
+        streams.push_back(std::make_unique<SampleStream>(ringFrames));
+    }
+    
+    startThread(juce::Thread::Priority::high);
+}
+
+SampleStream* DiskStreamer::getStream(int index)
+{
+    if (index < 0 || index >= static_cast<int>(streams.size()))
+        return nullptr;
+    
+    return streams[static_cast<size_t>(index)].get();
+}
+
+void DiskStreamer::requestFill()
+{
+    notify();
+}
+
+int DiskStreamer::getNumUnderruns() const
+{
+    int total = 0;
+    
+    for (const auto& stream : streams)
+    {
+        total += stream->getNumUnderruns();
+    }
+    
+    return total;
+}
+
+juce::CriticalSection& DiskStreamer::getReadLock()
+{
+    return readLock;
+}
+
+void DiskStreamer::run()
+{
+    while (!threadShouldExit())
+    {
+        bool readAnything = false;
+        
+        {
+            const juce::ScopedLock lock(readLock);
+            
+            for (auto& stream : streams)
+            {
+                readAnything = fillStream(*stream) || readAnything;
+            }
+        }
+        
+        // Keep reading while there is work, otherwise sleep until woken or polled
+        if (!readAnything)
+        {
+            wait(pollIntervalMs);
+        }
+    }
+}
+
+bool DiskStreamer::fillStream(SampleStream& stream)
+{
+    const juce::uint32 generation = stream.requestedGeneration.load(std::memory_order_acquire);
+    
+    if (generation != stream.readyGeneration.load(std::memory_order_relaxed))
+    {
+        // New request: the audio thread is not reading the ring until we mark it ready
+        stream.fifo.reset();
+        stream.streamingSample = stream.requestedSample.load(std::memory_order_relaxed);
+        stream.nextFileFrame = stream.requestedFrame.load(std::memory_order_relaxed);
+        stream.readyGeneration.store(generation, std::memory_order_release);
+    }
+    
+    SampleData* sample = stream.streamingSample;
+    
+    if (sample == nullptr)
+        return false;
+    
+    const juce::int64 framesLeft = sample->getNumFrames() - stream.nextFileFrame;
+    const int freeSpace = stream.fifo.getFreeSpace();
+    
+    // Read in whole chunks, except for the final piece of the file
+    if (framesLeft <= 0 || (freeSpace < readChunkFrames && framesLeft > freeSpace))
+        return false;
+    
+    const int framesToRead = static_cast<int>(juce::jmin(static_cast<juce::int64>(juce::jmin(freeSpace, readChunkFrames)), framesLeft));
+    
+    int start1, size1, start2, size2;
+    stream.fifo.prepareToWrite(framesToRead, start1, size1, start2, size2);
+    
+    if (size1 > 0)
+        sample->readFrames(stream.ring, start1, size1, stream.nextFileFrame);
+    
+    if (size2 > 0)
+        sample->readFrames(stream.ring, start2, size2, stream.nextFileFrame + size1);
+    
+    stream.fifo.finishedWrite(size1 + size2);
+    stream.nextFileFrame += size1 + size2;
+    
+    return size1 + size2 > 0;
+}
+
+} // namespace UndergroundBeats
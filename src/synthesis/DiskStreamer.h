@@ -0,0 +1,173 @@
+/*
+ * Underground Beats
+ * DiskStreamer.h
+ * 
+ * Background thread that streams sample data from disk into per-voice ring buffers
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleData.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SampleStream
+ * @brief Lock-free ring buffer feeding one voice from disk
+ * 
+ * The ring is a single-producer, single-consumer FIFO: the DiskStreamer thread
+ * writes frames and the audio thread reads them. Starting or stopping a stream
+ * never touches the ring from the audio thread; it publishes a request with a
+ * new generation number, and the streaming thread resets the ring before it
+ * serves that generation. The audio thread ignores the ring until the served
+ * generation matches its request.
+ */
+class SampleStream {
+public:
+    /**
+     * @brief Create a stream
+     * 
+     * @param ringFrames Capacity of the ring buffer in frames
+     */
+    SampleStream(int ringFrames);
+    ~SampleStream();
+    
+    /**
+     * @brief Request streaming of a sample from a frame onwards (audio thread)
+     * 
+     * @param sample The sample to stream
+     * @param startFrame The first frame the voice will read from the stream
+     */
+    void start(SampleData* sample, juce::int64 startFrame);
+    
+    /**
+     * @brief Stop streaming (audio thread)
+     */
+    void stop();
+    
+    /**
+     * @brief Read the next frames of the stream (audio thread)
+     * 
+     * Frames that have not arrived from disk yet are filled with silence and
+     * counted as an underrun. The stream skips those frames when they arrive,
+     * so after a dropout it carries on at the frame the voice expects.
+     * 
+     * @param left Left channel destination
+     * @param right Right channel destination
+     * @param numFrames Number of frames to read
+     * @return The number of frames that were available
+     */
+    int read(float* left, float* right, int numFrames);
+    
+    /**
+     * @brief Get the number of reads that ran out of streamed data
+     * 
+     * @return The underrun count since the stream was created
+     */
+    int getNumUnderruns() const;
+    
+private:
+    friend class DiskStreamer;
+    
+    juce::AbstractFifo fifo;
+    juce::AudioBuffer<float> ring;
+    
+    // Request published by the audio thread
+    std::atomic<SampleData*> requestedSample;
+    std::atomic<juce::int64> requestedFrame;
+    std::atomic<juce::uint32> requestedGeneration;
+    
+    // Generation whose data is in the ring
+    std::atomic<juce::uint32> readyGeneration;
+    
+    // Streaming thread state; the sample's owner keeps it alive until the stream is stopped
+    SampleData* streamingSample;
+    juce::int64 nextFileFrame;
+    
+    // Frames played as silence that the ring has not delivered yet (audio thread)
+    juce::int64 framesBehind;
+    
+    std::atomic<int> underruns;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleStream)
+};
+
+/**
+ * @class DiskStreamer
+ * @brief Prefetch thread that keeps every SampleStream topped up
+ * 
+ * The thread wakes when a stream is started and at a short interval otherwise,
+ * and reads from disk in large chunks into any stream whose ring has room.
+ * Voices only ever read from memory, so disk latency never reaches the audio
+ * thread as long as the rings are large enough.
+ */
+class DiskStreamer : public juce::Thread {
+public:
+    DiskStreamer();
+    ~DiskStreamer() override;
+    
+    /**
+     * @brief Allocate the streams and start the thread
+     * 
+     * Stops the thread while reallocating, so call this before playback.
+     * 
+     * @param numStreams Number of streams (one per voice)
+     * @param ringFrames Capacity of each stream's ring buffer in frames
+     */
+    void prepare(int numStreams, int ringFrames);
+    
+    /**
+     * @brief Get a stream
+     * 
+     * @param index The stream index
+     * @return The stream, or nullptr if the index is out of range
+     */
+    SampleStream* getStream(int index);
+    
+    /**
+     * @brief Wake the thread so newly started streams fill immediately
+     */
+    void requestFill();
+    
+    /**
+     * @brief Get the total number of underruns across all streams
+     * 
+     * @return The underrun count
+     */
+    int getNumUnderruns() const;
+    
+    /**
+     * @brief Get the lock held while the thread reads from samples
+     * 
+     * Hold this while releasing sample data, after stopping the streams
+     * playing it, so the thread never reads from data that is being
+     * destroyed. Once the lock is released, the thread serves the stop
+     * before it reads again.
+     * 
+     * @return The read lock
+     */
+    juce::CriticalSection& getReadLock();
+    
+    void run() override;
+    
+private:
+    std::vector<std::unique_ptr<SampleStream>> streams;
+    juce::CriticalSection readLock;
+    
+    // Frames read from disk in one go
+    static constexpr int readChunkFrames = 8192;
+    
+    // Interval at which the thread checks the streams without being woken
+    static constexpr int pollIntervalMs = 5;
+    
+    // Serve one stream, returning true if any frames were read
+    bool fillStream(SampleStream& stream);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiskStreamer)
+};
+
+} // namespace UndergroundBeats
@@ -9,19 +9,40 @@
 
 namespace UndergroundBeats {
 
+namespace {
+
+// Fraction of the distance to the target left when an exponential segment ends
+// (-60 dB). The remainder is snapped away at the segment boundary.
+constexpr float exponentialResidual = 0.001f;
+
+} // namespace
+
+void EnvelopeSettings::updateSampleCounts(double sampleRate)
+{
+    // Convert times from milliseconds to samples
+    attackSamples = static_cast<int>((attackTime / 1000.0f) * sampleRate);
+    decaySamples = static_cast<int>((decayTime / 1000.0f) * sampleRate);
+    releaseSamples = static_cast<int>((releaseTime / 1000.0f) * sampleRate);
+    
+    // Ensure at least 1 sample for each stage
+    attackSamples = std::max(1, attackSamples);
+    decaySamples = std::max(1, decaySamples);
+    releaseSamples = std::max(1, releaseSamples);
+}
+
 Envelope::Envelope()
-    : attackTime(10.0f)
-    , decayTime(100.0f)
-    , sustainLevel(0.7f)
-    , releaseTime(200.0f)
-    , currentStage(EnvelopeStage::Idle)
+    : currentStage(EnvelopeStage::Idle)
     , currentValue(0.0f)
     , currentSampleRate(44100.0)
-    , attackSamples(0)
-    , decaySamples(0)
-    , releaseSamples(0)
-    , currentSampleIndex(0)
-    , releaseStartValue(0.0f)
+    , segmentCurve(EnvelopeCurve::Linear)
+    , segmentTarget(0.0f)
+    , segmentSamplesRemaining(0)
+    , segmentValue(0.0)
+    , segmentStep(0.0)
+    , segmentStep2(0.0)
+    , segmentStep3(0.0)
+    , segmentCoefficient(0.0f)
+    , segmentOffset(0.0f)
 {
     updateSampleCounts();
 }
@@ -32,28 +53,53 @@ Envelope::~Envelope()
 
 void Envelope::setAttackTime(float timeMs)
 {
-    attackTime = timeMs;
+    settings.attackTime = timeMs;
     updateSampleCounts();
 }
 
 void Envelope::setDecayTime(float timeMs)
 {
-    decayTime = timeMs;
+    settings.decayTime = timeMs;
     updateSampleCounts();
 }
 
 void Envelope::setSustainLevel(float level)
 {
     // Clamp sustain level to 0-1 range
-    sustainLevel = juce::jlimit(0.0f, 1.0f, level);
+    settings.sustainLevel = juce::jlimit(0.0f, 1.0f, level);
 }
 
 void Envelope::setReleaseTime(float timeMs)
 {
-    releaseTime = timeMs;
+    settings.releaseTime = timeMs;
     updateSampleCounts();
 }
 
+void Envelope::setAttackCurve(EnvelopeCurve curve)
+{
+    settings.attackCurve = curve;
+}
+
+void Envelope::setDecayCurve(EnvelopeCurve curve)
+{
+    settings.decayCurve = curve;
+}
+
+void Envelope::setReleaseCurve(EnvelopeCurve curve)
+{
+    settings.releaseCurve = curve;
+}
+
+void Envelope::setSettings(const EnvelopeSettings& newSettings)
+{
+    settings = newSettings;
+}
+
+const EnvelopeSettings& Envelope::getSettings() const
+{
+    return settings;
+}
+
 EnvelopeStage Envelope::getCurrentStage() const
 {
     return currentStage;
@@ -69,11 +115,30 @@ bool Envelope::isActive() const
     return currentStage != EnvelopeStage::Idle;
 }
 
+int Envelope::getSamplesUntilIdle() const
+{
+    switch (currentStage)
+    {
+        case EnvelopeStage::Idle:
+            return 0;
+        case EnvelopeStage::Release:
+            return segmentSamplesRemaining;
+        default:
+            // Attack, decay and sustain last until noteOff is called
+            return -1;
+    }
+}
+
+bool Envelope::willBeIdleWithin(int numSamples) const
+{
+    const int samplesUntilIdle = getSamplesUntilIdle();
+    return samplesUntilIdle >= 0 && samplesUntilIdle <= numSamples;
+}
+
 void Envelope::noteOn()
 {
     // Start the attack phase
     currentStage = EnvelopeStage::Attack;
-    currentSampleIndex = 0;
     
     // If we're already in the middle of the envelope, start attack from current value
     // Otherwise start from 0
@@ -81,6 +146,8 @@ void Envelope::noteOn()
     {
         currentValue = 0.0f;
     }
+    
+    startSegment(1.0f, settings.attackSamples, settings.attackCurve);
 }
 
 void Envelope::noteOff()
@@ -89,77 +156,34 @@ void Envelope::noteOff()
     if (currentStage != EnvelopeStage::Idle)
     {
         currentStage = EnvelopeStage::Release;
-        currentSampleIndex = 0;
-        releaseStartValue = currentValue;
+        startSegment(0.0f, settings.releaseSamples, settings.releaseCurve);
     }
 }
 
-float Envelope::getNextSample()
+void Envelope::fastRelease(float timeMs)
 {
-    if (currentStage == EnvelopeStage::Idle)
-    {
-        return 0.0f;
-    }
-    
-    // Calculate the next value based on the current stage
-    currentValue = calculateNextValue();
-    currentSampleIndex++;
-    
-    // Check for stage transitions
-    switch (currentStage)
+    if (currentStage != EnvelopeStage::Idle)
     {
-        case EnvelopeStage::Attack:
-            if (currentSampleIndex >= attackSamples)
-            {
-                currentStage = EnvelopeStage::Decay;
-                currentSampleIndex = 0;
-            }
-            break;
-            
-        case EnvelopeStage::Decay:
-            if (currentSampleIndex >= decaySamples)
-            {
-                currentStage = EnvelopeStage::Sustain;
-                currentSampleIndex = 0;
-                currentValue = sustainLevel;
-            }
-            break;
-            
-        case EnvelopeStage::Sustain:
-            // Sustain stage holds the value until noteOff is called
-            currentValue = sustainLevel;
-            break;
-            
-        case EnvelopeStage::Release:
-            if (currentSampleIndex >= releaseSamples)
-            {
-                currentStage = EnvelopeStage::Idle;
-                currentSampleIndex = 0;
-                currentValue = 0.0f;
-            }
-            break;
-            
-        default:
-            break;
+        currentStage = EnvelopeStage::Release;
+        startSegment(0.0f, static_cast<int>((timeMs / 1000.0f) * currentSampleRate), EnvelopeCurve::Linear);
     }
-    
-    return currentValue;
+}
+
+float Envelope::getNextSample()
+{
+    float value = 0.0f;
+    renderBlock<false>(nullptr, &value, 1);
+    return value;
 }
 
 void Envelope::process(float* buffer, int numSamples)
 {
-    for (int i = 0; i < numSamples; ++i)
-    {
-        buffer[i] = getNextSample();
-    }
+    renderBlock<false>(nullptr, buffer, numSamples);
 }
 
 void Envelope::process(const float* inputBuffer, float* outputBuffer, int numSamples)
 {
-    for (int i = 0; i < numSamples; ++i)
-    {
-        outputBuffer[i] = inputBuffer[i] * getNextSample();
-    }
+    renderBlock<true>(inputBuffer, outputBuffer, numSamples);
 }
 
 void Envelope::prepare(double sampleRate)
@@ -172,82 +196,168 @@ void Envelope::reset()
 {
     currentStage = EnvelopeStage::Idle;
     currentValue = 0.0f;
-    currentSampleIndex = 0;
+    segmentSamplesRemaining = 0;
 }
 
 void Envelope::updateSampleCounts()
 {
-    // Convert times from milliseconds to samples
-    attackSamples = static_cast<int>((attackTime / 1000.0f) * currentSampleRate);
-    decaySamples = static_cast<int>((decayTime / 1000.0f) * currentSampleRate);
-    releaseSamples = static_cast<int>((releaseTime / 1000.0f) * currentSampleRate);
+    settings.updateSampleCounts(currentSampleRate);
+}
+
+void Envelope::startSegment(float target, int numSamples, EnvelopeCurve curve)
+{
+    segmentCurve = curve;
+    segmentTarget = target;
+    segmentSamplesRemaining = std::max(1, numSamples);
+    segmentValue = currentValue;
     
-    // Ensure at least 1 sample for each stage
-    attackSamples = std::max(1, attackSamples);
-    decaySamples = std::max(1, decaySamples);
-    releaseSamples = std::max(1, releaseSamples);
+    const double length = static_cast<double>(segmentSamplesRemaining);
+    const double delta = static_cast<double>(target) - static_cast<double>(currentValue);
+    
+    switch (curve)
+    {
+        case EnvelopeCurve::Linear:
+            segmentStep = delta / length;
+            break;
+            
+        case EnvelopeCurve::Exponential:
+            // One-pole recurrence: value = value * coefficient + offset,
+            // which lands within exponentialResidual of the target after numSamples
+            segmentCoefficient = static_cast<float>(std::exp(std::log(static_cast<double>(exponentialResidual)) / length));
+            segmentOffset = target * (1.0f - segmentCoefficient);
+            break;
+            
+        case EnvelopeCurve::Smooth:
+        {
+            // value(n) = start + delta * (3t^2 - 2t^3) with t = n / length,
+            // evaluated with forward differences of the cubic
+            const double a = -2.0 * delta / (length * length * length);
+            const double b = 3.0 * delta / (length * length);
+            segmentStep = a + b;
+            segmentStep2 = 6.0 * a + 2.0 * b;
+            segmentStep3 = 6.0 * a;
+            break;
+        }
+    }
 }
 
-float Envelope::calculateNextValue()
+void Envelope::advanceStage()
 {
-    float output = 0.0f;
+    // Snap to the exact target so rounding never accumulates across stages
+    currentValue = segmentTarget;
     
     switch (currentStage)
     {
         case EnvelopeStage::Attack:
-            // Linear attack from current value to 1.0
-            if (attackSamples <= 1)
-            {
-                output = 1.0f;
-            }
-            else
-            {
-                // Use a slight curve (cubic) for more natural attack
-                float progress = static_cast<float>(currentSampleIndex) / static_cast<float>(attackSamples);
-                float curvedProgress = progress * progress * (3.0f - 2.0f * progress); // Cubic interpolation
-                output = currentValue + (1.0f - currentValue) * curvedProgress;
-            }
+            currentStage = EnvelopeStage::Decay;
+            startSegment(settings.sustainLevel, settings.decaySamples, settings.decayCurve);
             break;
             
         case EnvelopeStage::Decay:
-            // Exponential decay from 1.0 to sustain level
-            if (decaySamples <= 1)
-            {
-                output = sustainLevel;
-            }
-            else
-            {
-                float progress = static_cast<float>(currentSampleIndex) / static_cast<float>(decaySamples);
-                // Exponential curve for more natural decay
-                output = 1.0f - (1.0f - sustainLevel) * progress;
-            }
-            break;
-            
-        case EnvelopeStage::Sustain:
-            // Just hold the sustain level
-            output = sustainLevel;
+            currentStage = EnvelopeStage::Sustain;
+            currentValue = settings.sustainLevel;
             break;
             
         case EnvelopeStage::Release:
-            // Exponential release from current value to 0
-            if (releaseSamples <= 1)
-            {
-                output = 0.0f;
-            }
-            else
-            {
-                float progress = static_cast<float>(currentSampleIndex) / static_cast<float>(releaseSamples);
-                // Exponential curve for more natural release
-                output = releaseStartValue * (1.0f - progress);
-            }
+            currentStage = EnvelopeStage::Idle;
+            currentValue = 0.0f;
             break;
             
         default:
-            output = 0.0f;
             break;
     }
+}
+
+template <bool applyToInput>
+void Envelope::renderBlock(const float* inputBuffer, float* outputBuffer, int numSamples)
+{
+    int position = 0;
     
-    return output;
+    while (position < numSamples)
+    {
+        const int remaining = numSamples - position;
+        float* output = outputBuffer + position;
+        const float* input = applyToInput ? inputBuffer + position : nullptr;
+        
+        if (currentStage == EnvelopeStage::Idle || currentStage == EnvelopeStage::Sustain)
+        {
+            // Constant level until the next noteOn/noteOff: fill the rest of the block
+            currentValue = (currentStage == EnvelopeStage::Sustain) ? settings.sustainLevel : 0.0f;
+            
+            if (applyToInput)
+                juce::FloatVectorOperations::copyWithMultiply(output, input, currentValue, remaining);
+            else
+                juce::FloatVectorOperations::fill(output, currentValue, remaining);
+            
+            return;
+        }
+        
+        const int count = std::min(remaining, segmentSamplesRemaining);
+        
+        switch (segmentCurve)
+        {
+            case EnvelopeCurve::Linear:
+            {
+                // Closed form, so the loop has no carried dependency and vectorizes
+                const float start = static_cast<float>(segmentValue);
+                const float step = static_cast<float>(segmentStep);
+                
+                for (int i = 0; i < count; ++i)
+                {
+                    const float value = start + step * static_cast<float>(i + 1);
+                    output[i] = applyToInput ? input[i] * value : value;
+                }
+                
+                segmentValue += segmentStep * count;
+                currentValue = static_cast<float>(segmentValue);
+                break;
+            }
+                
+            case EnvelopeCurve::Exponential:
+            {
+                float value = currentValue;
+                
+                for (int i = 0; i < count; ++i)
+                {
+                    value = value * segmentCoefficient + segmentOffset;
+                    output[i] = applyToInput ? input[i] * value : value;
+                }
+                
+                currentValue = value;
+                break;
+            }
+                
+            case EnvelopeCurve::Smooth:
+            {
+                double value = segmentValue;
+                double step = segmentStep;
+                double step2 = segmentStep2;
+                
+                for (int i = 0; i < count; ++i)
+                {
+                    value += step;
+                    step += step2;
+                    step2 += segmentStep3;
+                    output[i] = applyToInput ? input[i] * static_cast<float>(value) : static_cast<float>(value);
+                }
+                
+                segmentValue = value;
+                segmentStep = step;
+                segmentStep2 = step2;
+                currentValue = static_cast<float>(value);
+                break;
+            }
+        }
+        
+        segmentSamplesRemaining -= count;
+        position += count;
+        
+        // Stage logic only runs at segment boundaries
+        if (segmentSamplesRemaining <= 0)
+        {
+            advanceStage();
+        }
+    }
 }
 
 } // namespace UndergroundBeats
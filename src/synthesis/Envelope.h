@@ -22,6 +22,43 @@ enum class EnvelopeStage {
     Release
 };
 
+/**
+ * @brief Enumeration of envelope segment curve shapes
+ */
+enum class EnvelopeCurve {
+    Linear,      // Straight-line ramp
+    Exponential, // RC-style curve that settles on the target
+    Smooth       // Cubic S-curve (slow start and end)
+};
+
+/**
+ * @brief ADSR times, levels and curves together with their sample counts
+ * 
+ * Settings can be computed once and handed to any number of envelopes with
+ * Envelope::setSettings, which avoids recomputing the sample counts per envelope.
+ */
+struct EnvelopeSettings {
+    float attackTime = 10.0f;    // in milliseconds
+    float decayTime = 100.0f;    // in milliseconds
+    float sustainLevel = 0.7f;   // 0 to 1
+    float releaseTime = 200.0f;  // in milliseconds
+    
+    EnvelopeCurve attackCurve = EnvelopeCurve::Smooth;
+    EnvelopeCurve decayCurve = EnvelopeCurve::Linear;
+    EnvelopeCurve releaseCurve = EnvelopeCurve::Linear;
+    
+    int attackSamples = 1;
+    int decaySamples = 1;
+    int releaseSamples = 1;
+    
+    /**
+     * @brief Recalculate the sample counts from the time values
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void updateSampleCounts(double sampleRate);
+};
+
 /**
  * @class Envelope
  * @brief ADSR envelope generator for modulating amplitude
@@ -29,6 +66,10 @@ enum class EnvelopeStage {
  * The Envelope class implements an ADSR (Attack, Decay, Sustain, Release) envelope
  * for modulating the amplitude of a signal over time. It includes options for
  * different curve shapes for each stage and supports sample-accurate timing.
+ * 
+ * Buffers are rendered segment by segment: the number of samples left in the
+ * current stage is computed once, and that span is filled with a closed-form
+ * ramp or a recurrence loop. Stage logic only runs at segment boundaries.
  */
 class Envelope {
 public:
@@ -63,6 +104,50 @@ public:
      */
     void setReleaseTime(float timeMs);
     
+    /**
+     * @brief Set the curve shape of the attack stage
+     * 
+     * Takes effect the next time the attack stage starts.
+     * 
+     * @param curve The curve shape
+     */
+    void setAttackCurve(EnvelopeCurve curve);
+    
+    /**
+     * @brief Set the curve shape of the decay stage
+     * 
+     * Takes effect the next time the decay stage starts.
+     * 
+     * @param curve The curve shape
+     */
+    void setDecayCurve(EnvelopeCurve curve);
+    
+    /**
+     * @brief Set the curve shape of the release stage
+     * 
+     * Takes effect the next time the release stage starts.
+     * 
+     * @param curve The curve shape
+     */
+    void setReleaseCurve(EnvelopeCurve curve);
+    
+    /**
+     * @brief Replace all settings at once
+     * 
+     * The sample counts are taken as-is, so the settings must have been
+     * computed for the sample rate this envelope was prepared with.
+     * 
+     * @param newSettings The settings to use
+     */
+    void setSettings(const EnvelopeSettings& newSettings);
+    
+    /**
+     * @brief Get the current settings
+     * 
+     * @return The current settings
+     */
+    const EnvelopeSettings& getSettings() const;
+    
     /**
      * @brief Get the current envelope stage
      * 
@@ -84,6 +169,24 @@ public:
      */
     bool isActive() const;
     
+    /**
+     * @brief Get the number of samples until the envelope becomes idle
+     * 
+     * @return 0 if already idle, the remaining release length while releasing,
+     *         or -1 if the end is not yet known (attack, decay or sustain)
+     */
+    int getSamplesUntilIdle() const;
+    
+    /**
+     * @brief Check if the envelope will be idle within a number of samples
+     * 
+     * Lets voices stop rendering as soon as their amplitude envelope has finished.
+     * 
+     * @param numSamples Number of samples to look ahead
+     * @return true if the envelope reaches the Idle stage within numSamples
+     */
+    bool willBeIdleWithin(int numSamples) const;
+    
     /**
      * @brief Trigger the envelope (start attack phase)
      */
@@ -94,6 +197,16 @@ public:
      */
     void noteOff();
     
+    /**
+     * @brief Release the envelope over a fixed short time
+     * 
+     * Used to fade out stolen voices without a click, independent of the
+     * configured release time.
+     * 
+     * @param timeMs Release time in milliseconds
+     */
+    void fastRelease(float timeMs);
+    
     /**
      * @brief Get the next envelope sample
      * 
@@ -102,9 +215,9 @@ public:
     float getNextSample();
     
     /**
-     * @brief Process a buffer of samples with the envelope
+     * @brief Fill a buffer with the next envelope values
      * 
-     * @param buffer Buffer to process
+     * @param buffer Buffer to fill
      * @param numSamples Number of samples to process
      */
     void process(float* buffer, int numSamples);
@@ -131,33 +244,37 @@ public:
     void reset();
     
 private:
-    // ADSR parameters
-    float attackTime;   // in milliseconds
-    float decayTime;    // in milliseconds
-    float sustainLevel; // 0 to 1
-    float releaseTime;  // in milliseconds
+    // ADSR parameters, curves and sample counts
+    EnvelopeSettings settings;
     
     // Envelope state
     EnvelopeStage currentStage;
     float currentValue;
     float currentSampleRate;
     
-    // Sample counters for each stage
-    int attackSamples;
-    int decaySamples;
-    int releaseSamples;
-    
-    // Current position in the envelope
-    int currentSampleIndex;
-    
-    // Last output value (used for release)
-    float releaseStartValue;
+    // Current segment state (the ramp from currentValue to segmentTarget)
+    EnvelopeCurve segmentCurve;
+    float segmentTarget;
+    int segmentSamplesRemaining;
+    double segmentValue;      // Running value (linear and smooth curves)
+    double segmentStep;       // Per-sample increment (linear) or first difference (smooth)
+    double segmentStep2;      // Second difference (smooth)
+    double segmentStep3;      // Third difference (smooth)
+    float segmentCoefficient; // Feedback coefficient (exponential)
+    float segmentOffset;      // Feed-forward offset (exponential)
     
     // Recalculate internal sample counts based on time values
     void updateSampleCounts();
     
-    // Calculate the next value for the current stage
-    float calculateNextValue();
+    // Start a ramp from the current value to a target over a number of samples
+    void startSegment(float target, int numSamples, EnvelopeCurve curve);
+    
+    // Move to the next stage once the current segment has finished
+    void advanceStage();
+    
+    // Render envelope values, optionally multiplying an input signal
+    template <bool applyToInput>
+    void renderBlock(const float* inputBuffer, float* outputBuffer, int numSamples);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Envelope)
 };
@@ -0,0 +1,538 @@
+/*
+ * Underground Beats
+ * FMSynthModule.cpp
+ * 
+ * Implementation of the six-operator FM synthesizer module
+ */
+
+#include "FMSynthModule.h"
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Phase offset produced by a full-level modulator, in cycles (about 12.6 radians)
+constexpr float modulationDepth = 2.0f;
+
+// Phase offset per unit of averaged output at full feedback, in cycles
+constexpr float feedbackDepth = 0.25f;
+
+/**
+ * Operator connections for one algorithm. Modulators always have a higher index
+ * than the operators they modulate, so rendering from operator 6 down to 1 has
+ * every modulation input ready.
+ */
+struct AlgorithmLayout {
+    std::array<juce::uint8, FMParameters::numOperators> modulators; // Bit m set if operator m modulates this one
+    juce::uint8 carriers;                                           // Bit set for each operator that is heard
+};
+
+constexpr juce::uint8 op(int index)
+{
+    return static_cast<juce::uint8>(1 << index);
+}
+
+const AlgorithmLayout algorithmLayouts[] = {
+    { { op(1), op(2), op(3), op(4), op(5), 0 }, op(0) },                     // Stack
+    { { op(1), op(2), 0, op(4), op(5), 0 }, op(0) | op(3) },                  // TwoStacks
+    { { op(1), 0, op(3), 0, op(5), 0 }, op(0) | op(2) | op(4) },              // ThreePairs
+    { { op(1), 0, op(3), op(4), op(5), 0 }, op(0) | op(2) },                  // StackAndPair
+    { { op(1) | op(2), 0, 0, op(4) | op(5), 0, 0 }, op(0) | op(3) },          // TwoIntoOne
+    { { op(1), 0, op(5), op(5), op(5), 0 }, op(0) | op(2) | op(3) | op(4) },  // OneToThree
+    { { 0, 0, 0, 0, 0, 0 }, 0x3f }                                            // Additive
+};
+
+/**
+ * Sine of a phase in cycles, accurate to about 4e-6.
+ * 
+ * Uses only arithmetic and selects, so loops calling it can be vectorized.
+ */
+inline float fastSine(float cycles)
+{
+    // Reduce to [-0.5, 0.5), then fold to [-0.25, 0.25] where the series converges quickly
+    float x = cycles - std::floor(cycles + 0.5f);
+    x = x > 0.25f ? 0.5f - x : (x < -0.25f ? -0.5f - x : x);
+    
+    const float t = x * juce::MathConstants<float>::twoPi;
+    const float t2 = t * t;
+    
+    return t * (1.0f + t2 * (-1.0f / 6.0f + t2 * (1.0f / 120.0f + t2 * (-1.0f / 5040.0f + t2 * (1.0f / 362880.0f)))));
+}
+
+/**
+ * Render one operator for all lanes of a span. Buffers are interleaved as
+ * [sample * lanes + lane], and the lane loop is innermost.
+ */
+template <bool modulated, bool feedback>
+void renderOperatorLanes(float* output, const float* envelope, const float* modulation, float* phase,
+                         const float* increment, float* history1, float* history2, float feedbackAmount,
+                         int numSamples, int lanes)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const int frame = i * lanes;
+        
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            float modulatedPhase = phase[lane];
+            
+            if (modulated)
+                modulatedPhase += modulation[frame + lane] * modulationDepth;
+            
+            if (feedback)
+                modulatedPhase += feedbackAmount * (history1[lane] + history2[lane]);
+            
+            const float value = fastSine(modulatedPhase) * envelope[frame + lane];
+            output[frame + lane] = value;
+            
+            if (feedback)
+            {
+                history2[lane] = history1[lane];
+                history1[lane] = value;
+            }
+            
+            const float next = phase[lane] + increment[lane];
+            phase[lane] = next >= 1.0f ? next - 1.0f : next;
+        }
+    }
+}
+
+} // namespace
+
+FMSynthModule::FMSynthModule(int numVoicesToUse)
+    : numVoices(juce::jmax(1, numVoicesToUse))
+    , numLanes(((juce::jmax(1, numVoicesToUse) + laneBlock - 1) / laneBlock) * laneBlock)
+    , currentSampleRate(44100.0)
+    , currentBlockSize(512)
+    , voiceAllocator(juce::jmax(1, numVoicesToUse))
+    , pendingVersion(1)
+    , appliedVersion(0)
+{
+    // Default patch: one carrier with a decaying modulator at the same ratio
+    pendingParameters.operators[0].level = 1.0f;
+    pendingParameters.operators[1].level = 0.5f;
+    pendingParameters.operators[1].envelope.sustainLevel = 0.2f;
+    pendingParameters.operators[1].envelope.decayTime = 400.0f;
+    
+    operatorFrequencyRatios.fill(1.0f);
+    voiceNotes.assign(static_cast<size_t>(numVoices), -1);
+    
+    for (int i = 0; i < numVoices * numOperators; ++i)
+    {
+        envelopes.push_back(std::make_unique<Envelope>());
+    }
+    
+    const size_t operatorLanes = static_cast<size_t>(numOperators * numLanes);
+    phases.assign(operatorLanes, 0.0f);
+    phaseIncrements.assign(operatorLanes, 0.0f);
+    noteFrequencies.assign(static_cast<size_t>(numLanes), 440.0f);
+    laneGains.assign(static_cast<size_t>(numLanes), 0.0f);
+    
+    for (auto& history : feedbackHistory)
+    {
+        history.assign(static_cast<size_t>(numLanes), 0.0f);
+    }
+    
+    prepare(currentSampleRate, currentBlockSize);
+}
+
+FMSynthModule::~FMSynthModule()
+{
+}
+
+void FMSynthModule::processBlock(const juce::MidiBuffer& midiMessages, float* outputBuffer, int numSamples)
+{
+    // Clear the output buffer
+    std::fill(outputBuffer, outputBuffer + numSamples, 0.0f);
+    
+    refreshParameters();
+    tuning.beginBlock();
+    
+    renderSplitAtEvents(midiMessages, numSamples,
+                        [this, outputBuffer](int start, int length) { renderVoices(outputBuffer + start, length); },
+                        [this](const MidiEvent& event) { handleMidiEvent(event); });
+}
+
+void FMSynthModule::prepare(double sampleRate, int maximumBlockSize)
+{
+    currentSampleRate = sampleRate;
+    currentBlockSize = juce::jmax(1, maximumBlockSize);
+    
+    for (auto& envelope : envelopes)
+    {
+        envelope->prepare(sampleRate);
+    }
+    
+    envelopeValues.setSize(numOperators, currentBlockSize * numLanes);
+    operatorOutputs.setSize(numOperators, currentBlockSize * numLanes);
+    laneScratch.setSize(1, currentBlockSize * numLanes);
+    envelopeScratch.setSize(1, currentBlockSize);
+    
+    // Envelope sample counts and increments depend on the sample rate
+    pendingVersion.fetch_add(1, std::memory_order_release);
+    refreshParameters();
+}
+
+void FMSynthModule::setAlgorithm(FMAlgorithm algorithm)
+{
+    if (algorithm == FMAlgorithm::NumAlgorithms)
+        return;
+    
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.algorithm = algorithm;
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void FMSynthModule::setFeedback(float amount)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.feedback = juce::jlimit(0.0f, 1.0f, amount);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void FMSynthModule::setOperatorRatio(int operatorIndex, float ratio, float detuneCents)
+{
+    if (operatorIndex < 0 || operatorIndex >= numOperators)
+        return;
+    
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    auto& operatorParameters = pendingParameters.operators[static_cast<size_t>(operatorIndex)];
+    operatorParameters.ratio = juce::jmax(0.0f, ratio);
+    operatorParameters.detuneCents = detuneCents;
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void FMSynthModule::setOperatorLevel(int operatorIndex, float level)
+{
+    if (operatorIndex < 0 || operatorIndex >= numOperators)
+        return;
+    
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.operators[static_cast<size_t>(operatorIndex)].level = juce::jlimit(0.0f, 1.0f, level);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void FMSynthModule::setOperatorEnvelope(int operatorIndex, float attackMs, float decayMs, float sustainLevel, float releaseMs)
+{
+    if (operatorIndex < 0 || operatorIndex >= numOperators)
+        return;
+    
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    auto& envelope = pendingParameters.operators[static_cast<size_t>(operatorIndex)].envelope;
+    envelope.attackTime = attackMs;
+    envelope.decayTime = decayMs;
+    envelope.sustainLevel = juce::jlimit(0.0f, 1.0f, sustainLevel);
+    envelope.releaseTime = releaseMs;
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void FMSynthModule::setVelocitySensitivity(float sensitivity)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.velocitySensitivity = juce::jlimit(0.0f, 1.0f, sensitivity);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void FMSynthModule::setTuning(std::shared_ptr<const TuningTable> table, int channel)
+{
+    tuning.setTable(std::move(table), channel);
+}
+
+void FMSynthModule::refreshParameters()
+{
+    if (pendingVersion.load(std::memory_order_acquire) == appliedVersion)
+        return;
+    
+    {
+        const juce::SpinLock::ScopedTryLockType lock(parameterLock);
+        
+        // A setter holds the lock; try again next block
+        if (!lock.isLocked())
+            return;
+        
+        parameters = pendingParameters;
+        appliedVersion = pendingVersion.load(std::memory_order_relaxed);
+    }
+    
+    // Derived values are computed once per change and shared by all voices
+    for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+    {
+        const auto& operatorParameters = parameters.operators[static_cast<size_t>(operatorIndex)];
+        operatorFrequencyRatios[static_cast<size_t>(operatorIndex)] = operatorParameters.ratio * TuningTable::centsToRatio(operatorParameters.detuneCents);
+        
+        EnvelopeSettings settings = operatorParameters.envelope;
+        settings.updateSampleCounts(currentSampleRate);
+        
+        for (int voice = 0; voice < numVoices; ++voice)
+        {
+            envelopes[static_cast<size_t>(voice * numOperators + operatorIndex)]->setSettings(settings);
+        }
+    }
+    
+    for (int voice = 0; voice < numVoices; ++voice)
+    {
+        updatePhaseIncrements(voice);
+    }
+}
+
+void FMSynthModule::handleMidiEvent(const MidiEvent& event)
+{
+    switch (event.type)
+    {
+        case MidiEventType::NoteOn:
+            startVoice(event.data1, event.getVelocity(), event.channel);
+            break;
+            
+        case MidiEventType::NoteOff:
+            stopVoice(event.data1);
+            break;
+            
+        case MidiEventType::AllNotesOff:
+            voiceAllocator.releaseAllNotes();
+            
+            for (auto& envelope : envelopes)
+            {
+                envelope->noteOff();
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+void FMSynthModule::startVoice(int midiNoteNumber, float velocity, int channel)
+{
+    const float frequency = tuning.getFrequency(midiNoteNumber, channel);
+    
+    // Keys the tuning leaves unmapped do not sound
+    if (frequency <= 0.0f)
+        return;
+    
+    // A stolen voice retriggers its envelopes from their current values
+    const int voice = voiceAllocator.noteOn(midiNoteNumber).voiceIndex;
+    
+    if (voice < 0)
+        return;
+    
+    const size_t lane = static_cast<size_t>(voice);
+    
+    voiceNotes[lane] = midiNoteNumber;
+    noteFrequencies[lane] = frequency;
+    laneGains[lane] = parameters.velocitySensitivity * velocity + (1.0f - parameters.velocitySensitivity);
+    feedbackHistory[0][lane] = feedbackHistory[1][lane] = 0.0f;
+    
+    for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+    {
+        phases[static_cast<size_t>(operatorIndex * numLanes + voice)] = 0.0f;
+        envelopes[static_cast<size_t>(voice * numOperators + operatorIndex)]->noteOn();
+    }
+    
+    updatePhaseIncrements(voice);
+}
+
+void FMSynthModule::stopVoice(int midiNoteNumber)
+{
+    const int voice = voiceAllocator.noteOff(midiNoteNumber);
+    
+    if (voice < 0)
+        return;
+    
+    for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+    {
+        envelopes[static_cast<size_t>(voice * numOperators + operatorIndex)]->noteOff();
+    }
+}
+
+void FMSynthModule::updatePhaseIncrements(int voiceIndex)
+{
+    const float baseIncrement = noteFrequencies[static_cast<size_t>(voiceIndex)] / static_cast<float>(currentSampleRate);
+    
+    for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+    {
+        phaseIncrements[static_cast<size_t>(operatorIndex * numLanes + voiceIndex)]
+            = juce::jmin(0.5f, baseIncrement * operatorFrequencyRatios[static_cast<size_t>(operatorIndex)]);
+    }
+}
+
+void FMSynthModule::renderVoices(float* outputBuffer, int numSamples)
+{
+    // Lane buffers are sized for one block, so render longer spans in pieces
+    for (int offset = 0; offset < numSamples; offset += currentBlockSize)
+    {
+        renderSpan(outputBuffer + offset, juce::jmin(currentBlockSize, numSamples - offset));
+    }
+}
+
+void FMSynthModule::renderSpan(float* outputBuffer, int numSamples)
+{
+    // Lanes past the highest playing voice are skipped in groups of four
+    int highestVoice = -1;
+    for (int voice = 0; voice < numVoices; ++voice)
+    {
+        if (voiceNotes[static_cast<size_t>(voice)] >= 0)
+            highestVoice = voice;
+    }
+    
+    if (highestVoice < 0 || numSamples <= 0)
+        return;
+    
+    const int lanes = ((highestVoice + laneBlock) / laneBlock) * laneBlock;
+    const int laneSamples = numSamples * lanes;
+    const AlgorithmLayout& layout = algorithmLayouts[static_cast<int>(parameters.algorithm)];
+    
+    // Operators that are heard or modulate something, and are turned up
+    int usedOperators = layout.carriers;
+    for (auto modulators : layout.modulators)
+    {
+        usedOperators |= modulators;
+    }
+    
+    int activeOperators = 0;
+    for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+    {
+        if ((usedOperators & op(operatorIndex)) != 0 && parameters.operators[static_cast<size_t>(operatorIndex)].level > 0.0f)
+            activeOperators |= op(operatorIndex);
+    }
+    
+    // Render envelopes scaled by operator level, interleaved into lanes
+    float* scratch = envelopeScratch.getWritePointer(0);
+    
+    for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+    {
+        if ((activeOperators & op(operatorIndex)) == 0)
+            continue;
+        
+        const float level = parameters.operators[static_cast<size_t>(operatorIndex)].level;
+        float* envelope = envelopeValues.getWritePointer(operatorIndex);
+        
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            const bool playing = lane < numVoices && voiceNotes[static_cast<size_t>(lane)] >= 0;
+            
+            if (playing)
+                envelopes[static_cast<size_t>(lane * numOperators + operatorIndex)]->process(scratch, numSamples);
+            
+            for (int i = 0; i < numSamples; ++i)
+            {
+                envelope[i * lanes + lane] = playing ? scratch[i] * level : 0.0f;
+            }
+        }
+    }
+    
+    // Render operators from 6 down to 1, so modulators are ready before the operators they modulate
+    float* modulation = laneScratch.getWritePointer(0);
+    
+    for (int operatorIndex = numOperators - 1; operatorIndex >= 0; --operatorIndex)
+    {
+        if ((activeOperators & op(operatorIndex)) == 0)
+            continue;
+        
+        bool modulated = false;
+        
+        for (int modulator = operatorIndex + 1; modulator < numOperators; ++modulator)
+        {
+            if ((layout.modulators[static_cast<size_t>(operatorIndex)] & activeOperators & op(modulator)) == 0)
+                continue;
+            
+            if (modulated)
+                juce::FloatVectorOperations::add(modulation, operatorOutputs.getReadPointer(modulator), laneSamples);
+            else
+                juce::FloatVectorOperations::copy(modulation, operatorOutputs.getReadPointer(modulator), laneSamples);
+            
+            modulated = true;
+        }
+        
+        renderOperator(operatorIndex, modulated ? modulation : nullptr, numSamples, lanes,
+                       operatorIndex == numOperators - 1 && parameters.feedback > 0.0f);
+    }
+    
+    // Sum the carriers, reusing the modulation buffer
+    float* carrierSum = modulation;
+    juce::FloatVectorOperations::clear(carrierSum, laneSamples);
+    int numCarriers = 0;
+    
+    for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+    {
+        if ((layout.carriers & activeOperators & op(operatorIndex)) != 0)
+        {
+            juce::FloatVectorOperations::add(carrierSum, operatorOutputs.getReadPointer(operatorIndex), laneSamples);
+            ++numCarriers;
+        }
+    }
+    
+    // Mix the lanes into the output with velocity applied
+    const float carrierGain = 1.0f / static_cast<float>(juce::jmax(1, numCarriers));
+    const float* gains = laneGains.data();
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float* frame = carrierSum + i * lanes;
+        float sum = 0.0f;
+        
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            sum += frame[lane] * gains[lane];
+        }
+        
+        outputBuffer[i] += sum * carrierGain;
+    }
+    
+    // A voice is finished once all of its carrier envelopes are idle
+    for (int voice = 0; voice <= highestVoice; ++voice)
+    {
+        if (voiceNotes[static_cast<size_t>(voice)] < 0)
+            continue;
+        
+        bool carrierActive = false;
+        float level = 0.0f;
+        
+        for (int operatorIndex = 0; operatorIndex < numOperators; ++operatorIndex)
+        {
+            if ((layout.carriers & activeOperators & op(operatorIndex)) == 0)
+                continue;
+            
+            const Envelope& envelope = *envelopes[static_cast<size_t>(voice * numOperators + operatorIndex)];
+            carrierActive = carrierActive || envelope.isActive();
+            level = juce::jmax(level, envelope.getCurrentValue());
+        }
+        
+        if (carrierActive)
+        {
+            voiceAllocator.setVoiceLevel(voice, level * laneGains[static_cast<size_t>(voice)]);
+        }
+        else
+        {
+            voiceNotes[static_cast<size_t>(voice)] = -1;
+            voiceAllocator.voiceFinished(voice);
+        }
+    }
+}
+
+void FMSynthModule::renderOperator(int operatorIndex, const float* modulation, int numSamples, int lanes, bool withFeedback)
+{
+    float* output = operatorOutputs.getWritePointer(operatorIndex);
+    const float* envelope = envelopeValues.getReadPointer(operatorIndex);
+    float* phase = phases.data() + operatorIndex * numLanes;
+    const float* increment = phaseIncrements.data() + operatorIndex * numLanes;
+    float* history1 = feedbackHistory[0].data();
+    float* history2 = feedbackHistory[1].data();
+    const float feedbackAmount = parameters.feedback * feedbackDepth;
+    
+    if (withFeedback)
+    {
+        if (modulation != nullptr)
+            renderOperatorLanes<true, true>(output, envelope, modulation, phase, increment, history1, history2, feedbackAmount, numSamples, lanes);
+        else
+            renderOperatorLanes<false, true>(output, envelope, modulation, phase, increment, history1, history2, feedbackAmount, numSamples, lanes);
+    }
+    else
+    {
+        if (modulation != nullptr)
+            renderOperatorLanes<true, false>(output, envelope, modulation, phase, increment, history1, history2, feedbackAmount, numSamples, lanes);
+        else
+            renderOperatorLanes<false, false>(output, envelope, modulation, phase, increment, history1, history2, feedbackAmount, numSamples, lanes);
+    }
+}
+
+} // namespace UndergroundBeats
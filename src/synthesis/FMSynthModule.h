@@ -0,0 +1,221 @@
+/*
+ * Underground Beats
+ * FMSynthModule.h
+ * 
+ * Polyphonic six-operator FM synthesizer module
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Envelope.h"
+#include "VoiceAllocator.h"
+#include "MidiEventIterator.h"
+#include "Tuning.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of FM operator algorithms
+ * 
+ * Operators are numbered 1 to 6, and an arrow means "modulates". Carriers
+ * (the operators that are heard) are listed last in each chain.
+ */
+enum class FMAlgorithm {
+    Stack,        // 6 > 5 > 4 > 3 > 2 > 1
+    TwoStacks,    // 3 > 2 > 1, 6 > 5 > 4
+    ThreePairs,   // 2 > 1, 4 > 3, 6 > 5
+    StackAndPair, // 2 > 1, 6 > 5 > 4 > 3
+    TwoIntoOne,   // 2 + 3 > 1, 5 + 6 > 4
+    OneToThree,   // 2 > 1, 6 > 3 + 4 + 5
+    Additive,     // 1, 2, 3, 4, 5, 6 all carriers
+    NumAlgorithms
+};
+
+/**
+ * @brief Settings for one FM operator
+ */
+struct FMOperatorParameters {
+    float ratio = 1.0f;       // Frequency as a multiple of the note frequency
+    float detuneCents = 0.0f; // Fine detune in cents
+    float level = 0.0f;       // Output level for carriers, modulation depth for modulators (0 to 1)
+    EnvelopeSettings envelope;
+};
+
+/**
+ * @brief Settings for the whole FM voice
+ */
+struct FMParameters {
+    static constexpr int numOperators = 6;
+    
+    FMAlgorithm algorithm = FMAlgorithm::Stack;
+    float feedback = 0.0f; // Self-modulation of operator 6 (0 to 1)
+    float velocitySensitivity = 0.7f;
+    std::array<FMOperatorParameters, numOperators> operators;
+};
+
+/**
+ * @class FMSynthModule
+ * @brief Polyphonic phase-modulation synthesizer with six sine operators
+ * 
+ * Voices are rendered together rather than one at a time. Each voice is a
+ * lane, and per-voice state (operator phases, increments, envelope values,
+ * outputs) is stored interleaved as [sample][lane], so the innermost loop runs
+ * across voices over contiguous memory that the compiler can vectorize. Each
+ * operator is rendered for the whole block before the operators it
+ * modulates, using a polynomial sine that needs no table lookups.
+ * 
+ * Operators with a level of zero are skipped entirely, so four-operator
+ * patches cost no more than four operators.
+ */
+class FMSynthModule {
+public:
+    static constexpr int numOperators = FMParameters::numOperators;
+    
+    FMSynthModule(int numVoices = 16);
+    ~FMSynthModule();
+    
+    /**
+     * @brief Process incoming MIDI messages and generate audio
+     * 
+     * @param midiMessages MIDI messages to process
+     * @param outputBuffer Buffer to write output to
+     * @param numSamples Number of samples to generate
+     */
+    void processBlock(const juce::MidiBuffer& midiMessages, float* outputBuffer, int numSamples);
+    
+    /**
+     * @brief Prepare the synthesizer for playback
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param maximumBlockSize The largest block size expected (sizes the lane buffers)
+     */
+    void prepare(double sampleRate, int maximumBlockSize = 512);
+    
+    /**
+     * @brief Set the operator algorithm
+     * 
+     * @param algorithm The algorithm
+     */
+    void setAlgorithm(FMAlgorithm algorithm);
+    
+    /**
+     * @brief Set the feedback of operator 6 onto itself
+     * 
+     * @param amount Feedback amount (0 to 1)
+     */
+    void setFeedback(float amount);
+    
+    /**
+     * @brief Set an operator's frequency ratio
+     * 
+     * @param operatorIndex The operator (0 to 5)
+     * @param ratio Frequency as a multiple of the note frequency
+     * @param detuneCents Fine detune in cents
+     */
+    void setOperatorRatio(int operatorIndex, float ratio, float detuneCents = 0.0f);
+    
+    /**
+     * @brief Set an operator's level
+     * 
+     * @param operatorIndex The operator (0 to 5)
+     * @param level Output level or modulation depth (0 to 1, 0 disables the operator)
+     */
+    void setOperatorLevel(int operatorIndex, float level);
+    
+    /**
+     * @brief Set an operator's envelope
+     * 
+     * @param operatorIndex The operator (0 to 5)
+     * @param attackMs Attack time in milliseconds
+     * @param decayMs Decay time in milliseconds
+     * @param sustainLevel Sustain level (0 to 1)
+     * @param releaseMs Release time in milliseconds
+     */
+    void setOperatorEnvelope(int operatorIndex, float attackMs, float decayMs, float sustainLevel, float releaseMs);
+    
+    /**
+     * @brief Set the velocity sensitivity
+     * 
+     * @param sensitivity How much velocity affects output (0 to 1)
+     */
+    void setVelocitySensitivity(float sensitivity);
+    
+    /**
+     * @brief Set the tuning of one or all MIDI channels
+     * 
+     * Takes effect from the next note; notes already playing keep their pitch.
+     * Call from the message thread.
+     * 
+     * @param table The tuning table, or nullptr for 12-tone equal temperament
+     * @param channel MIDI channel (1 to 16), or 0 for all channels
+     */
+    void setTuning(std::shared_ptr<const TuningTable> table, int channel = 0);
+    
+private:
+    static constexpr int laneBlock = 4;
+    
+    int numVoices;
+    int numLanes; // numVoices padded to a multiple of laneBlock
+    double currentSampleRate;
+    int currentBlockSize;
+    VoiceAllocator voiceAllocator;
+    TuningSet tuning;
+    
+    // Parameters written by setters and applied at the start of the next block
+    juce::SpinLock parameterLock;
+    FMParameters pendingParameters;
+    std::atomic<juce::uint32> pendingVersion;
+    FMParameters parameters;
+    juce::uint32 appliedVersion;
+    std::array<float, numOperators> operatorFrequencyRatios; // Ratio times detune
+    
+    // Per-voice state
+    std::vector<int> voiceNotes;                   // Note per voice, -1 if idle
+    std::vector<std::unique_ptr<Envelope>> envelopes; // [voice * numOperators + operator]
+    
+    // Per-lane state, [operator * numLanes + lane]
+    std::vector<float> phases;
+    std::vector<float> phaseIncrements;
+    std::vector<float> noteFrequencies;            // [lane]
+    std::vector<float> laneGains;                  // [lane], velocity gain (0 for idle lanes)
+    std::array<std::vector<float>, 2> feedbackHistory; // [lane], last two outputs of operator 6
+    
+    // Interleaved [sample * numLanes + lane] buffers, one channel per operator
+    juce::AudioBuffer<float> envelopeValues;
+    juce::AudioBuffer<float> operatorOutputs;
+    juce::AudioBuffer<float> laneScratch;          // Modulation input, then the carrier sum
+    juce::AudioBuffer<float> envelopeScratch;      // One voice's envelope before interleaving
+    
+    // Apply pending parameter changes (audio thread, never blocks)
+    void refreshParameters();
+    
+    // Apply a single MIDI event
+    void handleMidiEvent(const MidiEvent& event);
+    
+    // Start a note on the voice chosen by the allocator
+    void startVoice(int midiNoteNumber, float velocity, int channel);
+    
+    // Release the voice playing a note
+    void stopVoice(int midiNoteNumber);
+    
+    // Set a voice's operator increments from its note frequency
+    void updatePhaseIncrements(int voiceIndex);
+    
+    // Render all voices into a span of the output
+    void renderVoices(float* outputBuffer, int numSamples);
+    
+    // Render a span no longer than the block size
+    void renderSpan(float* outputBuffer, int numSamples);
+    
+    // Render one operator for all lanes into its output channel
+    void renderOperator(int operatorIndex, const float* modulation, int numSamples, int lanes, bool withFeedback);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FMSynthModule)
+};
+
+} // namespace UndergroundBeats
@@ -90,6 +90,29 @@ float Filter::getGain() const
     return gain;
 }
 
+void Filter::setParameters(FilterType type, float frequencyHz, float amount, const FilterCoefficients& coefficients)
+{
+    filterType = type;
+    cutoffFrequency = juce::jlimit(20.0f, static_cast<float>(currentSampleRate) * 0.5f, frequencyHz);
+    resonance = juce::jlimit(0.0f, 0.99f, amount);
+    a0 = coefficients.a0;
+    a1 = coefficients.a1;
+    a2 = coefficients.a2;
+    b1 = coefficients.b1;
+    b2 = coefficients.b2;
+}
+
+FilterCoefficients Filter::getCoefficients() const
+{
+    FilterCoefficients c;
+    c.a0 = a0;
+    c.a1 = a1;
+    c.a2 = a2;
+    c.b1 = b1;
+    c.b2 = b2;
+    return c;
+}
+
 float Filter::processSample(float sample)
 {
     // Direct form II transposed implementation
@@ -108,6 +131,37 @@ void Filter::process(float* buffer, int numSamples)
     }
 }
 
+void Filter::processRamped(float* buffer, int numSamples, const FilterCoefficients& target)
+{
+    if (numSamples <= 0)
+        return;
+    
+    const float scale = 1.0f / static_cast<float>(numSamples);
+    const float da0 = (target.a0 - a0) * scale;
+    const float da1 = (target.a1 - a1) * scale;
+    const float da2 = (target.a2 - a2) * scale;
+    const float db1 = (target.b1 - b1) * scale;
+    const float db2 = (target.b2 - b2) * scale;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        a0 += da0;
+        a1 += da1;
+        a2 += da2;
+        b1 += db1;
+        b2 += db2;
+        
+        buffer[i] = processSample(buffer[i]);
+    }
+    
+    // Land exactly on the target to avoid accumulated drift
+    a0 = target.a0;
+    a1 = target.a1;
+    a2 = target.a2;
+    b1 = target.b1;
+    b2 = target.b2;
+}
+
 void Filter::processStereo(float* leftBuffer, float* rightBuffer, int numSamples)
 {
     for (int i = 0; i < numSamples; ++i)
@@ -126,6 +180,42 @@ void Filter::processStereo(float* leftBuffer, float* rightBuffer, int numSamples
     }
 }
 
+void Filter::processStereoRamped(float* leftBuffer, float* rightBuffer, int numSamples, const FilterCoefficients& target)
+{
+    if (numSamples <= 0)
+        return;
+    
+    const float scale = 1.0f / static_cast<float>(numSamples);
+    const float da0 = (target.a0 - a0) * scale;
+    const float da1 = (target.a1 - a1) * scale;
+    const float da2 = (target.a2 - a2) * scale;
+    const float db1 = (target.b1 - b1) * scale;
+    const float db2 = (target.b2 - b2) * scale;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        a0 += da0;
+        a1 += da1;
+        a2 += da2;
+        b1 += db1;
+        b2 += db2;
+        
+        leftBuffer[i] = processSample(leftBuffer[i]);
+        
+        const float outputR = a0 * rightBuffer[i] + z1Right;
+        z1Right = a1 * rightBuffer[i] - b1 * outputR + z2Right;
+        z2Right = a2 * rightBuffer[i] - b2 * outputR;
+        rightBuffer[i] = outputR;
+    }
+    
+    // Land exactly on the target to avoid accumulated drift
+    a0 = target.a0;
+    a1 = target.a1;
+    a2 = target.a2;
+    b1 = target.b1;
+    b2 = target.b2;
+}
+
 void Filter::prepare(double sampleRate)
 {
     currentSampleRate = sampleRate;
@@ -138,92 +228,124 @@ void Filter::reset()
     z1 = z2 = z1Right = z2Right = 0.0f;
 }
 
-void Filter::updateCoefficients()
+FilterCoefficients Filter::calculateCoefficients(FilterType type, float frequencyHz, float amount, float gainDb, double sampleRate)
+{
+    // Apply the same limits as the individual setters
+    amount = juce::jlimit(0.0f, 0.99f, amount);
+    
+    // Resonance maps to Q as it always has, so saved patches keep their sound
+    return calculateCoefficientsForQ(type, frequencyHz, 1.0f - amount, gainDb, sampleRate);
+}
+
+FilterCoefficients Filter::calculateCoefficientsForQ(FilterType type, float frequencyHz, float q, float gainDb, double sampleRate)
 {
+    FilterCoefficients c;
+    
+    frequencyHz = juce::jlimit(20.0f, static_cast<float>(sampleRate) * 0.5f, frequencyHz);
+    q = juce::jmax(0.01f, q);
+    
     // Normalize cutoff frequency to [0, 1] range
-    float omega = 2.0f * juce::MathConstants<float>::pi * cutoffFrequency / static_cast<float>(currentSampleRate);
+    float omega = 2.0f * juce::MathConstants<float>::pi * frequencyHz / static_cast<float>(sampleRate);
     float cosOmega = std::cos(omega);
     float sinOmega = std::sin(omega);
-    float alpha = sinOmega / (2.0f * (1.0f - resonance));
+    float alpha = sinOmega / (2.0f * q);
+    
+    // Shelf and peak amplitude (square root of the linear gain)
+    float gainAmplitude = std::pow(10.0f, gainDb / 40.0f);
+    float sqrtGain = std::sqrt(gainAmplitude);
     
-    // Convert gain from dB to linear
-    float gainLinear = std::pow(10.0f, gain / 20.0f);
-    float sqrtGain = std::sqrt(gainLinear);
+    // Denominator coefficient used for normalization
+    float denominator = 1.0f + alpha;
     
     // Calculate the filter coefficients based on the filter type
-    switch (filterType)
+    switch (type)
     {
         case FilterType::LowPass:
             // Low pass filter
-            a0 = (1.0f - cosOmega) / 2.0f;
-            a1 = 1.0f - cosOmega;
-            a2 = (1.0f - cosOmega) / 2.0f;
-            b1 = -2.0f * cosOmega;
-            b2 = 1.0f - alpha;
+            c.a0 = (1.0f - cosOmega) / 2.0f;
+            c.a1 = 1.0f - cosOmega;
+            c.a2 = (1.0f - cosOmega) / 2.0f;
+            c.b1 = -2.0f * cosOmega;
+            c.b2 = 1.0f - alpha;
             break;
             
         case FilterType::HighPass:
             // High pass filter
-            a0 = (1.0f + cosOmega) / 2.0f;
-            a1 = -(1.0f + cosOmega);
-            a2 = (1.0f + cosOmega) / 2.0f;
-            b1 = -2.0f * cosOmega;
-            b2 = 1.0f - alpha;
+            c.a0 = (1.0f + cosOmega) / 2.0f;
+            c.a1 = -(1.0f + cosOmega);
+            c.a2 = (1.0f + cosOmega) / 2.0f;
+            c.b1 = -2.0f * cosOmega;
+            c.b2 = 1.0f - alpha;
             break;
             
         case FilterType::BandPass:
             // Band pass filter
-            a0 = alpha;
-            a1 = 0.0f;
-            a2 = -alpha;
-            b1 = -2.0f * cosOmega;
-            b2 = 1.0f - alpha;
+            c.a0 = alpha;
+            c.a1 = 0.0f;
+            c.a2 = -alpha;
+            c.b1 = -2.0f * cosOmega;
+            c.b2 = 1.0f - alpha;
             break;
             
         case FilterType::Notch:
             // Notch filter
-            a0 = 1.0f;
-            a1 = -2.0f * cosOmega;
-            a2 = 1.0f;
-            b1 = -2.0f * cosOmega;
-            b2 = 1.0f - alpha;
+            c.a0 = 1.0f;
+            c.a1 = -2.0f * cosOmega;
+            c.a2 = 1.0f;
+            c.b1 = -2.0f * cosOmega;
+            c.b2 = 1.0f - alpha;
             break;
             
         case FilterType::LowShelf:
             // Low shelf filter
-            a0 = gainLinear * ((gainLinear + 1.0f) - (gainLinear - 1.0f) * cosOmega + 2.0f * sqrtGain * alpha);
-            a1 = 2.0f * gainLinear * ((gainLinear - 1.0f) - (gainLinear + 1.0f) * cosOmega);
-            a2 = gainLinear * ((gainLinear + 1.0f) - (gainLinear - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha);
-            b1 = -2.0f * ((gainLinear - 1.0f) + (gainLinear + 1.0f) * cosOmega);
-            b2 = (gainLinear + 1.0f) + (gainLinear - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha;
+            c.a0 = gainAmplitude * ((gainAmplitude + 1.0f) - (gainAmplitude - 1.0f) * cosOmega + 2.0f * sqrtGain * alpha);
+            c.a1 = 2.0f * gainAmplitude * ((gainAmplitude - 1.0f) - (gainAmplitude + 1.0f) * cosOmega);
+            c.a2 = gainAmplitude * ((gainAmplitude + 1.0f) - (gainAmplitude - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha);
+            c.b1 = -2.0f * ((gainAmplitude - 1.0f) + (gainAmplitude + 1.0f) * cosOmega);
+            c.b2 = (gainAmplitude + 1.0f) + (gainAmplitude - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha;
+            denominator = (gainAmplitude + 1.0f) + (gainAmplitude - 1.0f) * cosOmega + 2.0f * sqrtGain * alpha;
             break;
             
         case FilterType::HighShelf:
             // High shelf filter
-            a0 = gainLinear * ((gainLinear + 1.0f) + (gainLinear - 1.0f) * cosOmega + 2.0f * sqrtGain * alpha);
-            a1 = -2.0f * gainLinear * ((gainLinear - 1.0f) + (gainLinear + 1.0f) * cosOmega);
-            a2 = gainLinear * ((gainLinear + 1.0f) + (gainLinear - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha);
-            b1 = 2.0f * ((gainLinear - 1.0f) - (gainLinear + 1.0f) * cosOmega);
-            b2 = (gainLinear + 1.0f) - (gainLinear - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha;
+            c.a0 = gainAmplitude * ((gainAmplitude + 1.0f) + (gainAmplitude - 1.0f) * cosOmega + 2.0f * sqrtGain * alpha);
+            c.a1 = -2.0f * gainAmplitude * ((gainAmplitude - 1.0f) + (gainAmplitude + 1.0f) * cosOmega);
+            c.a2 = gainAmplitude * ((gainAmplitude + 1.0f) + (gainAmplitude - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha);
+            c.b1 = 2.0f * ((gainAmplitude - 1.0f) - (gainAmplitude + 1.0f) * cosOmega);
+            c.b2 = (gainAmplitude + 1.0f) - (gainAmplitude - 1.0f) * cosOmega - 2.0f * sqrtGain * alpha;
+            denominator = (gainAmplitude + 1.0f) - (gainAmplitude - 1.0f) * cosOmega + 2.0f * sqrtGain * alpha;
             break;
             
         case FilterType::Peak:
             // Peak filter
-            a0 = 1.0f + alpha * gainLinear;
-            a1 = -2.0f * cosOmega;
-            a2 = 1.0f - alpha * gainLinear;
-            b1 = -2.0f * cosOmega;
-            b2 = 1.0f - alpha / gainLinear;
+            c.a0 = 1.0f + alpha * gainAmplitude;
+            c.a1 = -2.0f * cosOmega;
+            c.a2 = 1.0f - alpha * gainAmplitude;
+            c.b1 = -2.0f * cosOmega;
+            c.b2 = 1.0f - alpha / gainAmplitude;
+            denominator = 1.0f + alpha / gainAmplitude;
             break;
     }
     
-    // Normalize the coefficients
-    float norm = 1.0f / (1.0f + b1 + b2);
-    a0 *= norm;
-    a1 *= norm;
-    a2 *= norm;
-    b1 *= norm;
-    b2 *= norm;
+    // Normalize the coefficients by the leading denominator coefficient
+    float norm = 1.0f / denominator;
+    c.a0 *= norm;
+    c.a1 *= norm;
+    c.a2 *= norm;
+    c.b1 *= norm;
+    c.b2 *= norm;
+    
+    return c;
+}
+
+void Filter::updateCoefficients()
+{
+    const FilterCoefficients c = calculateCoefficients(filterType, cutoffFrequency, resonance, gain, currentSampleRate);
+    a0 = c.a0;
+    a1 = c.a1;
+    a2 = c.a2;
+    b1 = c.b1;
+    b2 = c.b2;
 }
 
 } // namespace UndergroundBeats
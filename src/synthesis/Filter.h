@@ -24,6 +24,17 @@ enum class FilterType {
     Peak
 };
 
+/**
+ * @brief Normalized biquad coefficients
+ */
+struct FilterCoefficients {
+    float a0 = 1.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+};
+
 /**
  * @class Filter
  * @brief Multi-mode filter with various filter types and resonance control
@@ -93,6 +104,53 @@ public:
      */
     float getGain() const;
     
+    /**
+     * @brief Set type, cutoff and resonance with precomputed coefficients
+     * 
+     * Lets many filters with identical settings share one coefficient
+     * calculation instead of each recomputing it.
+     * 
+     * @param type The filter type
+     * @param frequencyHz Cutoff frequency in Hertz
+     * @param amount Resonance amount (0 to 1)
+     * @param coefficients Coefficients computed for these settings with calculateCoefficients
+     */
+    void setParameters(FilterType type, float frequencyHz, float amount, const FilterCoefficients& coefficients);
+    
+    /**
+     * @brief Get the coefficients currently in use
+     * 
+     * @return The current coefficients
+     */
+    FilterCoefficients getCoefficients() const;
+    
+    /**
+     * @brief Calculate the coefficients for a set of filter settings
+     * 
+     * @param type The filter type
+     * @param frequencyHz Cutoff frequency in Hertz
+     * @param amount Resonance amount (0 to 1)
+     * @param gainDb Gain in decibels (shelf and peak filters)
+     * @param sampleRate The sample rate in Hz
+     * @return The normalized coefficients
+     */
+    static FilterCoefficients calculateCoefficients(FilterType type, float frequencyHz, float amount, float gainDb, double sampleRate);
+    
+    /**
+     * @brief Calculate the coefficients for a filter with a given Q
+     * 
+     * Takes the quality factor directly rather than a resonance amount, so it
+     * reaches the wide bandwidths an equalizer needs.
+     * 
+     * @param type The filter type
+     * @param frequencyHz Cutoff or centre frequency in Hertz
+     * @param q Quality factor (above 0)
+     * @param gainDb Gain in decibels (shelf and peak filters)
+     * @param sampleRate The sample rate in Hz
+     * @return The normalized coefficients
+     */
+    static FilterCoefficients calculateCoefficientsForQ(FilterType type, float frequencyHz, float q, float gainDb, double sampleRate);
+    
     /**
      * @brief Process a single sample through the filter
      * 
@@ -109,6 +167,19 @@ public:
      */
     void process(float* buffer, int numSamples);
     
+    /**
+     * @brief Process a buffer while moving linearly to new coefficients
+     * 
+     * Used for modulated cutoff and resonance: coefficients are calculated
+     * once per control step and interpolated per sample in between, which
+     * avoids zipper noise without a coefficient calculation per sample.
+     * 
+     * @param buffer Buffer containing samples to process
+     * @param numSamples Number of samples to process
+     * @param target Coefficients reached at the end of the buffer
+     */
+    void processRamped(float* buffer, int numSamples, const FilterCoefficients& target);
+    
     /**
      * @brief Process a stereo buffer of samples through the filter
      * 
@@ -118,6 +189,18 @@ public:
      */
     void processStereo(float* leftBuffer, float* rightBuffer, int numSamples);
     
+    /**
+     * @brief Process a stereo buffer while moving linearly to new coefficients
+     * 
+     * Both channels follow the same ramp as processRamped().
+     * 
+     * @param leftBuffer Left channel buffer
+     * @param rightBuffer Right channel buffer
+     * @param numSamples Number of samples to process
+     * @param target Coefficients reached at the end of the buffer
+     */
+    void processStereoRamped(float* leftBuffer, float* rightBuffer, int numSamples, const FilterCoefficients& target);
+    
     /**
      * @brief Prepare the filter for playback
      * 
@@ -0,0 +1,198 @@
+/*
+ * Underground Beats
+ * GrainPool.cpp
+ * 
+ * Implementation of the grain pool
+ */
+
+#include "GrainPool.h"
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Window value at a position through the grain (0 to 1)
+float getWindowValue(GrainWindow window, double x)
+{
+    switch (window)
+    {
+        case GrainWindow::Gaussian:
+        {
+            const double z = (x - 0.5) / 0.15;
+            return static_cast<float>(std::exp(-0.5 * z * z));
+        }
+        
+        case GrainWindow::Triangle:
+            return static_cast<float>(1.0 - std::abs(2.0 * x - 1.0));
+            
+        case GrainWindow::Trapezoid:
+            // Linear fades over the first and last fifth of the grain
+            return static_cast<float>(juce::jmin(1.0, 5.0 * x, 5.0 * (1.0 - x)));
+            
+        default:
+            return static_cast<float>(0.5 - 0.5 * std::cos(juce::MathConstants<double>::twoPi * x));
+    }
+}
+
+// Each table has two guard samples, so rounding at the very end of a grain stays inside it
+constexpr int windowStride = GrainPool::windowSize + 2;
+
+struct WindowTables {
+    std::vector<float> samples;
+    
+    WindowTables()
+        : samples(static_cast<size_t>(static_cast<int>(GrainWindow::NumWindows) * windowStride))
+    {
+        for (int window = 0; window < static_cast<int>(GrainWindow::NumWindows); ++window)
+        {
+            float* table = samples.data() + window * windowStride;
+            
+            for (int i = 0; i <= GrainPool::windowSize; ++i)
+            {
+                table[i] = getWindowValue(static_cast<GrainWindow>(window), static_cast<double>(i) / GrainPool::windowSize);
+            }
+            
+            table[GrainPool::windowSize + 1] = table[GrainPool::windowSize];
+        }
+    }
+};
+
+} // namespace
+
+GrainPool::GrainPool(int capacityToUse)
+    : capacity(juce::jmax(1, capacityToUse))
+    , numActive(0)
+{
+    const size_t size = static_cast<size_t>(capacity);
+    sourceStarts.assign(size, 0);
+    readPositions.assign(size, 0.0f);
+    increments.assign(size, 0.0f);
+    windowPositions.assign(size, 0.0f);
+    windowIncrements.assign(size, 0.0f);
+    gainsLeft.assign(size, 0.0f);
+    gainsRight.assign(size, 0.0f);
+    samplesRemaining.assign(size, 0);
+    delays.assign(size, 0);
+}
+
+GrainPool::~GrainPool()
+{
+}
+
+const float* GrainPool::getWindowTable(GrainWindow window)
+{
+    static const WindowTables tables;
+    
+    if (window == GrainWindow::NumWindows)
+        window = GrainWindow::Hann;
+    
+    return tables.samples.data() + static_cast<int>(window) * windowStride;
+}
+
+bool GrainPool::startGrain(const Grain& grain)
+{
+    if (numActive >= capacity || grain.length <= 0)
+        return false;
+    
+    const size_t index = static_cast<size_t>(numActive++);
+    sourceStarts[index] = grain.sourceStart;
+    readPositions[index] = 0.0f;
+    increments[index] = grain.increment;
+    windowPositions[index] = 0.0f;
+    windowIncrements[index] = static_cast<float>(windowSize) / static_cast<float>(grain.length);
+    gainsLeft[index] = grain.gainLeft;
+    gainsRight[index] = grain.gainRight;
+    samplesRemaining[index] = grain.length;
+    delays[index] = juce::jmax(0, grain.delay);
+    
+    return true;
+}
+
+void GrainPool::render(const float* sourceLeft, const float* sourceRight, const float* window,
+                       float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    int index = 0;
+    
+    while (index < numActive)
+    {
+        const size_t grain = static_cast<size_t>(index);
+        const int start = juce::jmin(delays[grain], numSamples);
+        const int count = juce::jmin(numSamples - start, samplesRemaining[grain]);
+        
+        const float* left = sourceLeft + sourceStarts[grain];
+        const float* right = sourceRight + sourceStarts[grain];
+        const float readPosition = readPositions[grain];
+        const float increment = increments[grain];
+        const float windowPosition = windowPositions[grain];
+        const float windowIncrement = windowIncrements[grain];
+        const float gainLeft = gainsLeft[grain];
+        const float gainRight = gainsRight[grain];
+        float* outLeft = leftBuffer + start;
+        float* outRight = rightBuffer + start;
+        
+        for (int i = 0; i < count; ++i)
+        {
+            const float sampleIndex = static_cast<float>(i);
+            
+            const float position = readPosition + sampleIndex * increment;
+            const int frame = static_cast<int>(position);
+            const float fraction = position - static_cast<float>(frame);
+            
+            const float windowPoint = windowPosition + sampleIndex * windowIncrement;
+            const int windowIndex = static_cast<int>(windowPoint);
+            const float windowFraction = windowPoint - static_cast<float>(windowIndex);
+            const float amplitude = window[windowIndex] + windowFraction * (window[windowIndex + 1] - window[windowIndex]);
+            
+            outLeft[i] += (left[frame] + fraction * (left[frame + 1] - left[frame])) * amplitude * gainLeft;
+            outRight[i] += (right[frame] + fraction * (right[frame + 1] - right[frame])) * amplitude * gainRight;
+        }
+        
+        samplesRemaining[grain] -= count;
+        
+        if (samplesRemaining[grain] <= 0)
+        {
+            // The last grain moves into this slot and is rendered next
+            removeGrain(index);
+            continue;
+        }
+        
+        const float advanced = static_cast<float>(count);
+        readPositions[grain] = readPosition + advanced * increment;
+        windowPositions[grain] = windowPosition + advanced * windowIncrement;
+        delays[grain] -= start;
+        ++index;
+    }
+}
+
+void GrainPool::clear()
+{
+    numActive = 0;
+}
+
+int GrainPool::getNumActiveGrains() const
+{
+    return numActive;
+}
+
+int GrainPool::getCapacity() const
+{
+    return capacity;
+}
+
+void GrainPool::removeGrain(int index)
+{
+    const size_t grain = static_cast<size_t>(index);
+    const size_t last = static_cast<size_t>(--numActive);
+    
+    sourceStarts[grain] = sourceStarts[last];
+    readPositions[grain] = readPositions[last];
+    increments[grain] = increments[last];
+    windowPositions[grain] = windowPositions[last];
+    windowIncrements[grain] = windowIncrements[last];
+    gainsLeft[grain] = gainsLeft[last];
+    gainsRight[grain] = gainsRight[last];
+    samplesRemaining[grain] = samplesRemaining[last];
+    delays[grain] = delays[last];
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,139 @@
+/*
+ * Underground Beats
+ * GrainPool.h
+ * 
+ * Fixed-size pool of playing grains for granular synthesis
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of grain window shapes
+ */
+enum class GrainWindow {
+    Hann,
+    Gaussian,
+    Triangle,
+    Trapezoid,
+    NumWindows
+};
+
+/**
+ * @brief A grain to start playing
+ */
+struct Grain {
+    int sourceStart = 0;      // First source frame the grain reads
+    float increment = 1.0f;   // Source frames read per output sample
+    int length = 0;           // Length in output samples
+    float gainLeft = 0.0f;    // Left gain, including pan
+    float gainRight = 0.0f;   // Right gain, including pan
+    int delay = 0;            // Samples into the next render before the grain starts
+};
+
+/**
+ * @class GrainPool
+ * @brief Preallocated storage and rendering for many concurrent grains
+ * 
+ * All grain state is allocated up front and stored as one array per field.
+ * Playing grains are kept packed at the front of the arrays: starting a grain
+ * appends it, and a finished grain is replaced by the last one, so starting
+ * and finishing are constant time and the audio thread never allocates.
+ * 
+ * Each grain is rendered in a single loop over its samples that reads the
+ * source and the window table with linear interpolation. Positions are
+ * computed from the sample index rather than accumulated, so iterations are
+ * independent and the compiler can vectorize the loop.
+ */
+class GrainPool {
+public:
+    /** Samples per window table, not counting the end point and guard samples */
+    static constexpr int windowSize = 1024;
+    
+    /**
+     * @brief Create a pool
+     * 
+     * @param capacity Maximum number of grains playing at once
+     */
+    explicit GrainPool(int capacity = 4096);
+    ~GrainPool();
+    
+    /**
+     * @brief Get the shared window table for a shape
+     * 
+     * @param window The window shape
+     * @return windowSize + 1 samples from the start to the end of a grain, followed by a guard sample
+     */
+    static const float* getWindowTable(GrainWindow window);
+    
+    /**
+     * @brief Start playing a grain
+     * 
+     * The caller must make sure the grain's reads stay inside the source,
+     * including one frame past the last position for interpolation.
+     * 
+     * @param grain The grain to start
+     * @return false if the pool is full and the grain was dropped
+     */
+    bool startGrain(const Grain& grain);
+    
+    /**
+     * @brief Render all playing grains, adding to the output
+     * 
+     * Grains that reach their end are removed from the pool.
+     * 
+     * @param sourceLeft Left channel of the source
+     * @param sourceRight Right channel of the source
+     * @param window Window table from getWindowTable
+     * @param leftBuffer Left output buffer to add to
+     * @param rightBuffer Right output buffer to add to
+     * @param numSamples Number of samples to render
+     */
+    void render(const float* sourceLeft, const float* sourceRight, const float* window,
+                float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    /**
+     * @brief Stop all grains immediately
+     */
+    void clear();
+    
+    /**
+     * @brief Get the number of playing grains
+     * 
+     * @return The grain count
+     */
+    int getNumActiveGrains() const;
+    
+    /**
+     * @brief Get the maximum number of playing grains
+     * 
+     * @return The pool capacity
+     */
+    int getCapacity() const;
+    
+private:
+    int capacity;
+    int numActive;
+    
+    // Grain state, [grain]
+    std::vector<int> sourceStarts;
+    std::vector<float> readPositions;    // Source frames already read, relative to sourceStarts
+    std::vector<float> increments;
+    std::vector<float> windowPositions;  // Position in the window table
+    std::vector<float> windowIncrements;
+    std::vector<float> gainsLeft;
+    std::vector<float> gainsRight;
+    std::vector<int> samplesRemaining;
+    std::vector<int> delays;
+    
+    // Move the last playing grain into a finished grain's slot
+    void removeGrain(int index);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrainPool)
+};
+
+} // namespace UndergroundBeats
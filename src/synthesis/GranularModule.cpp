@@ -0,0 +1,414 @@
+/*
+ * Underground Beats
+ * GranularModule.cpp
+ * 
+ * Implementation of the granular synthesizer
+ */
+
+#include "GranularModule.h"
+
+namespace UndergroundBeats {
+
+GranularModule::GranularModule(int numVoicesToUse, int maxGrains)
+    : numVoices(juce::jmax(1, numVoicesToUse))
+    , currentSampleRate(44100.0)
+    , currentBlockSize(512)
+    , voiceAllocator(juce::jmax(1, numVoicesToUse))
+    , grainPool(maxGrains)
+    , pendingVersion(1)
+    , appliedVersion(0)
+    , grainLength(1)
+    , grainInterval(1.0)
+    , grainGain(0.0f)
+    , windowTable(GrainPool::getWindowTable(GrainWindow::Hann))
+    , pendingRootNote(60)
+    , sourceChanged(false)
+    , rootNote(60)
+    , randomSeed(0)
+    , seedChanged(false)
+    , numActiveGrains(0)
+{
+    voiceNotes.assign(static_cast<size_t>(numVoices), -1);
+    voiceChannels.assign(static_cast<size_t>(numVoices), 1);
+    voiceGains.assign(static_cast<size_t>(numVoices), 0.0f);
+    voicePitchRatios.assign(static_cast<size_t>(numVoices), 1.0f);
+    grainCountdowns.assign(static_cast<size_t>(numVoices), 0.0);
+    
+    for (int i = 0; i < numVoices; ++i)
+    {
+        envelopes.push_back(std::make_unique<Envelope>());
+    }
+    
+    prepare(currentSampleRate, currentBlockSize);
+}
+
+GranularModule::~GranularModule()
+{
+}
+
+void GranularModule::processBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    // Clear the output buffers
+    std::fill(leftBuffer, leftBuffer + numSamples, 0.0f);
+    std::fill(rightBuffer, rightBuffer + numSamples, 0.0f);
+    
+    if (seedChanged.exchange(false))
+        random.setSeed(randomSeed.load());
+    
+    tuning.beginBlock();
+    refreshSource();
+    refreshParameters();
+    
+    renderSplitAtEvents(midiMessages, numSamples,
+                        [this, leftBuffer, rightBuffer](int start, int length) { renderVoices(leftBuffer + start, rightBuffer + start, length); },
+                        [this](const MidiEvent& event) { handleMidiEvent(event); });
+    
+    numActiveGrains.store(grainPool.getNumActiveGrains(), std::memory_order_relaxed);
+}
+
+void GranularModule::prepare(double sampleRate, int maximumBlockSize)
+{
+    currentSampleRate = sampleRate;
+    currentBlockSize = juce::jmax(1, maximumBlockSize);
+    
+    for (auto& envelope : envelopes)
+    {
+        envelope->prepare(sampleRate);
+        envelope->reset();
+    }
+    
+    envelopeBuffer.setSize(1, currentBlockSize);
+    
+    // Start from silence and the beginning of the random sequence
+    grainPool.clear();
+    voiceAllocator.reset();
+    std::fill(voiceNotes.begin(), voiceNotes.end(), -1);
+    random.setSeed(randomSeed.load());
+    seedChanged.store(false);
+    
+    // Grain lengths and envelope sample counts depend on the sample rate
+    pendingVersion.fetch_add(1, std::memory_order_release);
+    refreshParameters();
+}
+
+void GranularModule::setSource(std::shared_ptr<SampleData> data, int rootNoteToUse)
+{
+    // The previous pending source is released after the lock, on this thread
+    std::shared_ptr<SampleData> previous;
+    
+    {
+        const juce::SpinLock::ScopedLockType lock(sourceLock);
+        previous = std::move(pendingSource);
+        pendingSource = std::move(data);
+        pendingRootNote = juce::jlimit(0, 127, rootNoteToUse);
+        sourceChanged = true;
+    }
+}
+
+void GranularModule::setGrainSize(float milliseconds)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.grainSize = juce::jlimit(1.0f, 1000.0f, milliseconds);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setDensity(float grainsPerSecond)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.density = juce::jlimit(0.5f, 2000.0f, grainsPerSecond);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setPosition(float position, float spread)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.position = juce::jlimit(0.0f, 1.0f, position);
+    pendingParameters.positionSpread = juce::jlimit(0.0f, 1.0f, spread);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setPitchSpread(float semitones)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.pitchSpread = juce::jlimit(0.0f, 24.0f, semitones);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setPanSpread(float amount)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.panSpread = juce::jlimit(0.0f, 1.0f, amount);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setWindow(GrainWindow window)
+{
+    if (window == GrainWindow::NumWindows)
+        return;
+    
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.window = window;
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setEnvelope(float attackMs, float decayMs, float sustainLevel, float releaseMs)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.envelope.attackTime = attackMs;
+    pendingParameters.envelope.decayTime = decayMs;
+    pendingParameters.envelope.sustainLevel = juce::jlimit(0.0f, 1.0f, sustainLevel);
+    pendingParameters.envelope.releaseTime = releaseMs;
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setLevel(float level)
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    pendingParameters.level = juce::jlimit(0.0f, 1.0f, level);
+    pendingVersion.fetch_add(1, std::memory_order_release);
+}
+
+void GranularModule::setTuning(std::shared_ptr<const TuningTable> table, int channel)
+{
+    tuning.setTable(std::move(table), channel);
+}
+
+void GranularModule::setRandomSeed(juce::int64 seed)
+{
+    randomSeed.store(seed);
+    seedChanged.store(true);
+}
+
+int GranularModule::getNumActiveGrains() const
+{
+    return numActiveGrains.load(std::memory_order_relaxed);
+}
+
+void GranularModule::refreshParameters()
+{
+    if (pendingVersion.load(std::memory_order_acquire) == appliedVersion)
+        return;
+    
+    {
+        const juce::SpinLock::ScopedTryLockType lock(parameterLock);
+        
+        // A setter holds the lock; try again next block
+        if (!lock.isLocked())
+            return;
+        
+        parameters = pendingParameters;
+        appliedVersion = pendingVersion.load(std::memory_order_relaxed);
+    }
+    
+    grainLength = juce::jmax(1, juce::roundToInt(parameters.grainSize * 0.001 * currentSampleRate));
+    grainInterval = currentSampleRate / parameters.density;
+    windowTable = GrainPool::getWindowTable(parameters.window);
+    
+    // Overlapping grains add up roughly like uncorrelated signals
+    const float overlap = parameters.density * parameters.grainSize * 0.001f;
+    grainGain = parameters.level / std::sqrt(juce::jmax(1.0f, overlap));
+    
+    EnvelopeSettings settings = parameters.envelope;
+    settings.updateSampleCounts(currentSampleRate);
+    
+    for (auto& envelope : envelopes)
+    {
+        envelope->setSettings(settings);
+    }
+}
+
+void GranularModule::refreshSource()
+{
+    const juce::SpinLock::ScopedTryLockType lock(sourceLock);
+    
+    // setSource holds the lock; try again next block
+    if (!lock.isLocked() || !sourceChanged)
+        return;
+    
+    // The outgoing source is parked in pendingSource so the message thread releases it
+    std::swap(source, pendingSource);
+    rootNote = pendingRootNote;
+    sourceChanged = false;
+    
+    // Playing grains point into the old source
+    grainPool.clear();
+    
+    for (int voice = 0; voice < numVoices; ++voice)
+    {
+        const size_t index = static_cast<size_t>(voice);
+        
+        const float pitchRatio = voiceNotes[index] >= 0 ? getPitchRatio(voiceNotes[index], voiceChannels[index]) : 0.0f;
+        
+        if (pitchRatio > 0.0f)
+            voicePitchRatios[index] = pitchRatio;
+    }
+}
+
+void GranularModule::handleMidiEvent(const MidiEvent& event)
+{
+    switch (event.type)
+    {
+        case MidiEventType::NoteOn:
+            startVoice(event.data1, event.getVelocity(), event.channel);
+            break;
+            
+        case MidiEventType::NoteOff:
+            stopVoice(event.data1);
+            break;
+            
+        case MidiEventType::AllNotesOff:
+            voiceAllocator.releaseAllNotes();
+            
+            for (auto& envelope : envelopes)
+            {
+                envelope->noteOff();
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+void GranularModule::startVoice(int midiNoteNumber, float velocity, int channel)
+{
+    const float pitchRatio = getPitchRatio(midiNoteNumber, channel);
+    
+    // Keys the tuning leaves unmapped do not sound
+    if (pitchRatio <= 0.0f)
+        return;
+    
+    // A stolen voice keeps its grains and retriggers its envelope from the current value
+    const int voice = voiceAllocator.noteOn(midiNoteNumber).voiceIndex;
+    
+    if (voice < 0)
+        return;
+    
+    const size_t index = static_cast<size_t>(voice);
+    
+    voiceNotes[index] = midiNoteNumber;
+    voiceChannels[index] = channel;
+    voiceGains[index] = parameters.velocitySensitivity * velocity + (1.0f - parameters.velocitySensitivity);
+    voicePitchRatios[index] = pitchRatio;
+    
+    // The first grain starts with the note
+    grainCountdowns[index] = 0.0;
+    envelopes[index]->noteOn();
+}
+
+float GranularModule::getPitchRatio(int midiNoteNumber, int channel) const
+{
+    const TuningTable& table = tuning.getTable(channel);
+    const float rootFrequency = table.getFrequency(rootNote);
+    
+    // A root the tuning leaves unmapped plays every note at the source's pitch
+    if (rootFrequency <= 0.0f)
+        return table.getFrequency(midiNoteNumber) > 0.0f ? 1.0f : 0.0f;
+    
+    return table.getFrequency(midiNoteNumber) / rootFrequency;
+}
+
+void GranularModule::stopVoice(int midiNoteNumber)
+{
+    const int voice = voiceAllocator.noteOff(midiNoteNumber);
+    
+    if (voice >= 0)
+        envelopes[static_cast<size_t>(voice)]->noteOff();
+}
+
+void GranularModule::renderVoices(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    // The envelope buffer is sized for one block, so render longer spans in pieces
+    for (int offset = 0; offset < numSamples; offset += currentBlockSize)
+    {
+        renderSpan(leftBuffer + offset, rightBuffer + offset, juce::jmin(currentBlockSize, numSamples - offset));
+    }
+}
+
+void GranularModule::renderSpan(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+    
+    float* envelope = envelopeBuffer.getWritePointer(0);
+    
+    // Start each note's grains at their exact sample in the span
+    for (int voice = 0; voice < numVoices; ++voice)
+    {
+        const size_t index = static_cast<size_t>(voice);
+        
+        if (voiceNotes[index] < 0)
+            continue;
+        
+        Envelope& voiceEnvelope = *envelopes[index];
+        voiceEnvelope.process(envelope, numSamples);
+        
+        double& countdown = grainCountdowns[index];
+        
+        while (countdown < numSamples)
+        {
+            const int delay = static_cast<int>(countdown);
+            startGrain(voice, delay, envelope[delay]);
+            countdown += grainInterval;
+        }
+        
+        countdown -= numSamples;
+        
+        // Grains already started play on after the note has finished
+        if (voiceEnvelope.isActive())
+        {
+            voiceAllocator.setVoiceLevel(voice, voiceEnvelope.getCurrentValue() * voiceGains[index]);
+        }
+        else
+        {
+            voiceNotes[index] = -1;
+            voiceAllocator.voiceFinished(voice);
+        }
+    }
+    
+    if (source == nullptr)
+        return;
+    
+    const juce::AudioBuffer<float>& preload = source->getPreload();
+    grainPool.render(preload.getReadPointer(0), preload.getReadPointer(1), windowTable, leftBuffer, rightBuffer, numSamples);
+}
+
+void GranularModule::startGrain(int voiceIndex, int delay, float envelopeValue)
+{
+    // Every grain draws the same random values, so the sequence does not depend on the spreads
+    const float positionRandom = random.nextFloat() * 2.0f - 1.0f;
+    const float pitchRandom = random.nextFloat() * 2.0f - 1.0f;
+    const float panRandom = random.nextFloat() * 2.0f - 1.0f;
+    
+    if (source == nullptr || envelopeValue <= 0.0f)
+        return;
+    
+    const size_t index = static_cast<size_t>(voiceIndex);
+    const float pitchRatio = voicePitchRatios[index] * TuningTable::semitonesToRatio(pitchRandom * parameters.pitchSpread);
+    const float increment = pitchRatio * static_cast<float>(source->getSampleRate() / currentSampleRate);
+    
+    // Leave room for rounding and the interpolation frame at the end of the grain
+    const int readFrames = static_cast<int>(std::ceil(static_cast<float>(grainLength) * increment)) + 2;
+    const int availableFrames = source->getPreloadFrames() - readFrames;
+    
+    if (availableFrames <= 0)
+        return;
+    
+    const float position = juce::jlimit(0.0f, 1.0f, parameters.position + positionRandom * parameters.positionSpread);
+    
+    // Equal-power pan
+    const float angle = (panRandom * parameters.panSpread + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+    const float gain = envelopeValue * voiceGains[index] * grainGain;
+    
+    Grain grain;
+    grain.sourceStart = static_cast<int>(position * static_cast<float>(availableFrames));
+    grain.increment = increment;
+    grain.length = grainLength;
+    grain.gainLeft = std::cos(angle) * gain;
+    grain.gainRight = std::sin(angle) * gain;
+    grain.delay = delay;
+    
+    grainPool.startGrain(grain);
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,260 @@
+/*
+ * Underground Beats
+ * GranularModule.h
+ * 
+ * Polyphonic granular synthesizer playing grains from a sample
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GrainPool.h"
+#include "SampleData.h"
+#include "Envelope.h"
+#include "VoiceAllocator.h"
+#include "MidiEventIterator.h"
+#include "Tuning.h"
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Settings for grain generation
+ */
+struct GranularParameters {
+    float grainSize = 80.0f;         // Grain length in milliseconds
+    float density = 40.0f;           // Grains started per second by each note
+    float position = 0.5f;           // Read position through the source (0 to 1)
+    float positionSpread = 0.05f;    // Random position offset per grain (0 to 1)
+    float pitchSpread = 0.0f;        // Random pitch offset per grain in semitones
+    float panSpread = 0.5f;          // Random stereo position per grain (0 to 1)
+    GrainWindow window = GrainWindow::Hann;
+    float level = 1.0f;
+    float velocitySensitivity = 0.7f;
+    EnvelopeSettings envelope;       // Note envelope, applied to each grain as it starts
+};
+
+/**
+ * @class GranularModule
+ * @brief Polyphonic granular synthesizer
+ * 
+ * Each held note starts short windowed grains from a sample at a steady rate,
+ * pitched relative to the source's root note. Grains are taken from a single
+ * preallocated GrainPool shared by all notes and play to their end even after
+ * the note that started them has finished, so thousands of grains can overlap
+ * without the audio thread allocating.
+ * 
+ * Grains read the resident preload of the SampleData only; use a preload long
+ * enough to cover the source (see SampleCache::setPreloadTime).
+ * 
+ * Grain positions, pitches, and pans are drawn from a seeded random generator
+ * in a fixed order, so rendering the same MIDI with the same parameters and
+ * seed produces identical output.
+ */
+class GranularModule {
+public:
+    /**
+     * @brief Create a granular synthesizer
+     * 
+     * @param numVoices Number of notes that can play at once
+     * @param maxGrains Maximum number of grains playing at once
+     */
+    GranularModule(int numVoices = 8, int maxGrains = 4096);
+    ~GranularModule();
+    
+    /**
+     * @brief Process incoming MIDI messages and generate stereo audio
+     * 
+     * @param midiMessages MIDI messages to process
+     * @param leftBuffer Left channel output buffer
+     * @param rightBuffer Right channel output buffer
+     * @param numSamples Number of samples to generate
+     */
+    void processBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    /**
+     * @brief Prepare the synthesizer for playback
+     * 
+     * Stops all grains and notes and restarts the random sequence from the seed.
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param maximumBlockSize The largest block size expected
+     */
+    void prepare(double sampleRate, int maximumBlockSize = 512);
+    
+    /**
+     * @brief Set the sample that grains are taken from
+     * 
+     * Takes effect at the start of the next block, stopping any playing grains.
+     * Call from the message thread; the previous sample is released there, not
+     * on the audio thread.
+     * 
+     * @param data The sample data, or nullptr for silence
+     * @param rootNote Note at which grains play at the source's original pitch
+     */
+    void setSource(std::shared_ptr<SampleData> data, int rootNote = 60);
+    
+    /**
+     * @brief Set the grain length
+     * 
+     * @param milliseconds Grain length (1 to 1000 ms)
+     */
+    void setGrainSize(float milliseconds);
+    
+    /**
+     * @brief Set how often each note starts a grain
+     * 
+     * @param grainsPerSecond Grain rate per note (0.5 to 2000)
+     */
+    void setDensity(float grainsPerSecond);
+    
+    /**
+     * @brief Set where grains read from the source
+     * 
+     * @param position Read position through the source (0 to 1)
+     * @param spread Random offset around the position (0 to 1)
+     */
+    void setPosition(float position, float spread);
+    
+    /**
+     * @brief Set the random pitch offset of each grain
+     * 
+     * @param semitones Largest offset in either direction (0 to 24)
+     */
+    void setPitchSpread(float semitones);
+    
+    /**
+     * @brief Set the random stereo position of each grain
+     * 
+     * @param amount Pan spread (0 for centered, 1 for full width)
+     */
+    void setPanSpread(float amount);
+    
+    /**
+     * @brief Set the grain window shape
+     * 
+     * @param window The window shape
+     */
+    void setWindow(GrainWindow window);
+    
+    /**
+     * @brief Set the note envelope
+     * 
+     * @param attackMs Attack time in milliseconds
+     * @param decayMs Decay time in milliseconds
+     * @param sustainLevel Sustain level (0 to 1)
+     * @param releaseMs Release time in milliseconds
+     */
+    void setEnvelope(float attackMs, float decayMs, float sustainLevel, float releaseMs);
+    
+    /**
+     * @brief Set the output level
+     * 
+     * @param level Output level (0 to 1)
+     */
+    void setLevel(float level);
+    
+    /**
+     * @brief Set the tuning of one or all MIDI channels
+     * 
+     * Notes are pitched by the ratio of their frequency to the root note's in
+     * the same table. Takes effect from the next note; notes already playing
+     * keep their pitch. Call from the message thread.
+     * 
+     * @param table The tuning table, or nullptr for 12-tone equal temperament
+     * @param channel MIDI channel (1 to 16), or 0 for all channels
+     */
+    void setTuning(std::shared_ptr<const TuningTable> table, int channel = 0);
+    
+    /**
+     * @brief Set the seed of the grain scheduler
+     * 
+     * The random sequence restarts from this seed at the start of the next block
+     * and on every prepare().
+     * 
+     * @param seed The random seed
+     */
+    void setRandomSeed(juce::int64 seed);
+    
+    /**
+     * @brief Get the number of playing grains
+     * 
+     * @return The grain count at the end of the last block
+     */
+    int getNumActiveGrains() const;
+    
+private:
+    int numVoices;
+    double currentSampleRate;
+    int currentBlockSize;
+    VoiceAllocator voiceAllocator;
+    GrainPool grainPool;
+    TuningSet tuning;
+    
+    // Parameters written by setters and applied at the start of the next block
+    juce::SpinLock parameterLock;
+    GranularParameters pendingParameters;
+    std::atomic<juce::uint32> pendingVersion;
+    GranularParameters parameters;
+    juce::uint32 appliedVersion;
+    
+    // Derived from the parameters
+    int grainLength;        // In output samples
+    double grainInterval;   // Samples between grains of one note
+    float grainGain;        // Level normalized for the number of overlapping grains
+    const float* windowTable;
+    
+    // Source swapped in by the audio thread; the old one waits in pendingSource
+    juce::SpinLock sourceLock;
+    std::shared_ptr<SampleData> pendingSource;
+    int pendingRootNote;
+    bool sourceChanged;
+    std::shared_ptr<SampleData> source;
+    int rootNote;
+    
+    // Grain scheduler
+    juce::Random random;
+    std::atomic<juce::int64> randomSeed;
+    std::atomic<bool> seedChanged;
+    std::atomic<int> numActiveGrains;
+    
+    // Per-voice state, [voice]
+    std::vector<int> voiceNotes;           // Note per voice, -1 if idle
+    std::vector<int> voiceChannels;        // MIDI channel of the note, for its tuning
+    std::vector<float> voiceGains;         // Velocity gain
+    std::vector<float> voicePitchRatios;   // Pitch of the note relative to the root note
+    std::vector<double> grainCountdowns;   // Samples until the voice's next grain
+    std::vector<std::unique_ptr<Envelope>> envelopes;
+    juce::AudioBuffer<float> envelopeBuffer;
+    
+    // Apply pending parameter and source changes (audio thread, never blocks)
+    void refreshParameters();
+    void refreshSource();
+    
+    // Apply a single MIDI event
+    void handleMidiEvent(const MidiEvent& event);
+    
+    // Start a note on the voice chosen by the allocator
+    void startVoice(int midiNoteNumber, float velocity, int channel);
+    
+    // Pitch of a note relative to the root note in its channel's tuning (0 if unmapped)
+    float getPitchRatio(int midiNoteNumber, int channel) const;
+    
+    // Release the voice playing a note
+    void stopVoice(int midiNoteNumber);
+    
+    // Render all voices into a span of the output
+    void renderVoices(float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    // Render a span no longer than the block size
+    void renderSpan(float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    // Start one grain for a voice, delay samples into the current span
+    void startGrain(int voiceIndex, int delay, float envelopeValue);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GranularModule)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,103 @@
+/*
+ * Underground Beats
+ * LFO.cpp
+ * 
+ * Implementation of the low-frequency oscillator
+ */
+
+#include "LFO.h"
+
+namespace UndergroundBeats {
+
+LFO::LFO()
+    : shape(LFOShape::Sine)
+    , rate(1.0f)
+    , currentSampleRate(44100.0)
+    , phase(0.0)
+    , phaseIncrement(0.0)
+    , heldValue(0.0f)
+{
+    prepare(currentSampleRate);
+}
+
+LFO::~LFO()
+{
+}
+
+void LFO::setShape(LFOShape newShape)
+{
+    shape = newShape;
+}
+
+void LFO::setRate(float frequencyHz)
+{
+    rate = juce::jlimit(0.01f, 100.0f, frequencyHz);
+    phaseIncrement = rate / currentSampleRate;
+}
+
+void LFO::reset()
+{
+    phase = 0.0;
+    heldValue = random.nextFloat() * 2.0f - 1.0f;
+}
+
+float LFO::advance(int numSamples)
+{
+    phase += phaseIncrement * numSamples;
+    
+    if (phase >= 1.0)
+    {
+        phase -= std::floor(phase);
+        
+        // Pick a new random value once per cycle
+        heldValue = random.nextFloat() * 2.0f - 1.0f;
+    }
+    
+    return getValue();
+}
+
+void LFO::renderControlValues(float* values, int numSamples, int interval)
+{
+    int position = 0;
+    int index = 0;
+    
+    while (position < numSamples)
+    {
+        const int stepSamples = juce::jmin(interval, numSamples - position);
+        values[index++] = advance(stepSamples);
+        position += stepSamples;
+    }
+}
+
+void LFO::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    phaseIncrement = rate / currentSampleRate;
+}
+
+float LFO::getValue() const
+{
+    const float p = static_cast<float>(phase);
+    
+    switch (shape)
+    {
+        case LFOShape::Sine:
+            return std::sin(juce::MathConstants<float>::twoPi * p);
+            
+        case LFOShape::Triangle:
+            return 1.0f - 4.0f * std::abs(p - 0.5f);
+            
+        case LFOShape::Sawtooth:
+            return 2.0f * p - 1.0f;
+            
+        case LFOShape::Square:
+            return p < 0.5f ? 1.0f : -1.0f;
+            
+        case LFOShape::SampleAndHold:
+            return heldValue;
+    }
+    
+    return 0.0f;
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,103 @@
+/*
+ * Underground Beats
+ * LFO.h
+ * 
+ * Low-frequency oscillator for control-rate modulation
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of LFO shapes
+ */
+enum class LFOShape {
+    Sine,
+    Triangle,
+    Sawtooth,
+    Square,
+    SampleAndHold
+};
+
+/**
+ * @class LFO
+ * @brief Bipolar low-frequency oscillator evaluated at control rate
+ * 
+ * The LFO produces one value per control step rather than per sample, so its
+ * cost does not depend on the audio sample rate. Consumers interpolate between
+ * successive values.
+ */
+class LFO {
+public:
+    LFO();
+    ~LFO();
+    
+    /**
+     * @brief Set the LFO shape
+     * 
+     * @param newShape The shape
+     */
+    void setShape(LFOShape newShape);
+    
+    /**
+     * @brief Set the LFO rate
+     * 
+     * @param frequencyHz Rate in Hertz
+     */
+    void setRate(float frequencyHz);
+    
+    /**
+     * @brief Restart the LFO at the beginning of its cycle
+     */
+    void reset();
+    
+    /**
+     * @brief Advance the LFO and return its value at the new position
+     * 
+     * @param numSamples Number of samples to advance by
+     * @return The LFO value (-1 to 1)
+     */
+    float advance(int numSamples);
+    
+    /**
+     * @brief Render one value per control step for a span of samples
+     * 
+     * Value i is the LFO at the end of step i, i.e. at sample
+     * min((i + 1) * interval, numSamples).
+     * 
+     * @param values Buffer receiving (numSamples + interval - 1) / interval values
+     * @param numSamples Number of samples in the span
+     * @param interval Control step length in samples
+     */
+    void renderControlValues(float* values, int numSamples, int interval);
+    
+    /**
+     * @brief Prepare the LFO for playback
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void prepare(double sampleRate);
+    
+private:
+    LFOShape shape;
+    float rate;
+    double currentSampleRate;
+    
+    // Phase as a fraction of a cycle (0 to 1)
+    double phase;
+    double phaseIncrement;
+    
+    // Value held by the sample-and-hold shape and its random generator
+    float heldValue;
+    juce::Random random;
+    
+    // Calculate the value for the current phase
+    float getValue() const;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LFO)
+};
+
+} // namespace UndergroundBeats
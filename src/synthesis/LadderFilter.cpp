@@ -0,0 +1,227 @@
+/*
+ * Underground Beats
+ * LadderFilter.cpp
+ * 
+ * Implementation of the zero-delay-feedback ladder filter
+ */
+
+#include "LadderFilter.h"
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Feedback at full resonance, slightly above the self-oscillation threshold of 4
+constexpr float maxFeedback = 4.2f;
+
+// Rational approximation of tan, accurate to 3% up to 0.45 * pi
+inline float fastTan(float x)
+{
+    const float x2 = x * x;
+    return x * (105.0f - 10.0f * x2) / (105.0f - 45.0f * x2 + x2 * x2);
+}
+
+} // namespace
+
+LadderFilter::LadderFilter()
+    : cutoffFrequency(1000.0f)
+    , resonance(0.5f)
+    , drive(1.0f)
+    , oversampling(false)
+    , currentSampleRate(44100.0)
+    , gain(0.0f)
+    , feedback(0.0f)
+    , state({0.0f, 0.0f, 0.0f, 0.0f})
+    , previousInput(0.0f)
+{
+    gain = getGainForCutoff(cutoffFrequency);
+    feedback = getFeedbackForResonance(resonance);
+}
+
+LadderFilter::~LadderFilter()
+{
+}
+
+void LadderFilter::setCutoff(float frequencyHz)
+{
+    cutoffFrequency = juce::jlimit(20.0f, static_cast<float>(currentSampleRate) * 0.45f, frequencyHz);
+    gain = getGainForCutoff(cutoffFrequency);
+}
+
+float LadderFilter::getCutoff() const
+{
+    return cutoffFrequency;
+}
+
+void LadderFilter::setResonance(float amount)
+{
+    resonance = juce::jlimit(0.0f, 1.0f, amount);
+    feedback = getFeedbackForResonance(resonance);
+}
+
+float LadderFilter::getResonance() const
+{
+    return resonance;
+}
+
+void LadderFilter::setDrive(float newDrive)
+{
+    drive = juce::jlimit(0.0f, 16.0f, newDrive);
+}
+
+float LadderFilter::getDrive() const
+{
+    return drive;
+}
+
+void LadderFilter::setOversampling(bool enabled)
+{
+    oversampling = enabled;
+    gain = getGainForCutoff(cutoffFrequency);
+}
+
+bool LadderFilter::isOversampling() const
+{
+    return oversampling;
+}
+
+float LadderFilter::processSample(float sample)
+{
+    return processWithGain(sample, gain, feedback);
+}
+
+void LadderFilter::process(float* buffer, int numSamples)
+{
+    const float g = gain;
+    const float k = feedback;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        buffer[i] = processWithGain(buffer[i], g, k);
+    }
+}
+
+void LadderFilter::processRamped(float* buffer, int numSamples, float targetCutoff, float targetResonance)
+{
+    if (numSamples <= 0)
+        return;
+    
+    cutoffFrequency = juce::jlimit(20.0f, static_cast<float>(currentSampleRate) * 0.45f, targetCutoff);
+    resonance = juce::jlimit(0.0f, 1.0f, targetResonance);
+    
+    // The ladder is stable for any pole gain between 0 and 1, so interpolating it is safe
+    const float targetGain = getGainForCutoff(cutoffFrequency);
+    const float targetFeedback = getFeedbackForResonance(resonance);
+    const float scale = 1.0f / static_cast<float>(numSamples);
+    const float gainStep = (targetGain - gain) * scale;
+    const float feedbackStep = (targetFeedback - feedback) * scale;
+    
+    float g = gain;
+    float k = feedback;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        g += gainStep;
+        k += feedbackStep;
+        buffer[i] = processWithGain(buffer[i], g, k);
+    }
+    
+    // Land exactly on the target to avoid accumulated drift
+    gain = targetGain;
+    feedback = targetFeedback;
+}
+
+void LadderFilter::processModulated(float* buffer, const float* cutoffHz, int numSamples)
+{
+    const float maxCutoff = static_cast<float>(currentSampleRate) * 0.45f;
+    const float k = feedback;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float g = getGainForCutoff(juce::jlimit(20.0f, maxCutoff, cutoffHz[i]));
+        buffer[i] = processWithGain(buffer[i], g, k);
+    }
+}
+
+void LadderFilter::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    cutoffFrequency = juce::jlimit(20.0f, static_cast<float>(currentSampleRate) * 0.45f, cutoffFrequency);
+    gain = getGainForCutoff(cutoffFrequency);
+    reset();
+}
+
+void LadderFilter::reset()
+{
+    state.fill(0.0f);
+    previousInput = 0.0f;
+}
+
+float LadderFilter::fastTanh(float x)
+{
+    if (x <= -3.0f)
+        return -1.0f;
+    
+    if (x >= 3.0f)
+        return 1.0f;
+    
+    const float x2 = x * x;
+    return x * (27.0f + x2) / (27.0f + 9.0f * x2);
+}
+
+float LadderFilter::getProcessingRate() const
+{
+    return static_cast<float>(currentSampleRate) * (oversampling ? 2.0f : 1.0f);
+}
+
+float LadderFilter::getGainForCutoff(float frequencyHz) const
+{
+    // Prewarped so the cutoff is exact despite the trapezoidal integration
+    const float g = fastTan(juce::MathConstants<float>::pi * frequencyHz / getProcessingRate());
+    return g / (1.0f + g);
+}
+
+float LadderFilter::getFeedbackForResonance(float amount)
+{
+    return amount * maxFeedback;
+}
+
+float LadderFilter::tick(float input, float poleGain, float feedbackAmount)
+{
+    // Each pole gives y = G * x + (1 - G) * s, so the ladder output is G^4 * u
+    // plus a sum of the states, and the loop can be solved for u directly
+    const float G = poleGain;
+    const float stateSum = (state[3] + G * (state[2] + G * (state[1] + G * state[0]))) * (1.0f - G);
+    const float G2 = G * G;
+    
+    const float u = fastTanh((input - feedbackAmount * stateSum) / (1.0f + feedbackAmount * G2 * G2));
+    
+    float output = u;
+    
+    for (auto& s : state)
+    {
+        const float v = (output - s) * G;
+        output = v + s;
+        s = output + v;
+    }
+    
+    return output;
+}
+
+float LadderFilter::processWithGain(float input, float poleGain, float feedbackAmount)
+{
+    input *= drive;
+    
+    if (!oversampling)
+        return tick(input, poleGain, feedbackAmount);
+    
+    // Linear interpolation up, then average the two outputs back down
+    const float midpoint = 0.5f * (previousInput + input);
+    previousInput = input;
+    
+    const float first = tick(midpoint, poleGain, feedbackAmount);
+    const float second = tick(input, poleGain, feedbackAmount);
+    return 0.5f * (first + second);
+}
+
+} // namespace UndergroundBeats
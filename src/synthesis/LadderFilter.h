@@ -0,0 +1,203 @@
+/*
+ * Underground Beats
+ * LadderFilter.h
+ * 
+ * Zero-delay-feedback transistor ladder filter
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Filter circuits available to synthesizer voices
+ */
+enum class FilterModel {
+    Biquad,    // Multi-mode biquad (see Filter), follows the filter type
+    Ladder     // 24 dB/octave ladder low-pass (see LadderFilter)
+};
+
+/**
+ * @class LadderFilter
+ * @brief Four-pole ladder low-pass filter with a saturating feedback loop
+ * 
+ * Each pole is a trapezoidal one-pole integrator, and the feedback loop is
+ * solved implicitly, so there is no unit delay in the loop and the cutoff and
+ * resonance stay in tune up to the top of the range. The filter is stable for
+ * any positive cutoff, so it can be modulated every sample without the
+ * blowups of interpolated biquad coefficients.
+ * 
+ * The loop input passes through a rational tanh approximation, which limits
+ * self-oscillation at high resonance and adds the ladder's characteristic
+ * overdrive. Optional 2x oversampling lowers the aliasing of the saturation.
+ * It uses linear interpolation and a two-sample average rather than steep
+ * half-band filters, which keeps it cheap enough for every voice but rolls off
+ * the top octave slightly.
+ */
+class LadderFilter {
+public:
+    LadderFilter();
+    ~LadderFilter();
+    
+    /**
+     * @brief Set the filter cutoff frequency
+     * 
+     * @param frequencyHz Cutoff frequency in Hertz
+     */
+    void setCutoff(float frequencyHz);
+    
+    /**
+     * @brief Get the current cutoff frequency
+     * 
+     * @return The current cutoff frequency in Hertz
+     */
+    float getCutoff() const;
+    
+    /**
+     * @brief Set the filter resonance
+     * 
+     * The filter self-oscillates towards the top of the range.
+     * 
+     * @param amount Resonance amount (0 to 1)
+     */
+    void setResonance(float amount);
+    
+    /**
+     * @brief Get the current resonance amount
+     * 
+     * @return The current resonance amount
+     */
+    float getResonance() const;
+    
+    /**
+     * @brief Set the gain into the saturating feedback loop
+     * 
+     * @param drive Input gain (1 is clean at moderate levels, up to 16)
+     */
+    void setDrive(float drive);
+    
+    /**
+     * @brief Get the current drive
+     * 
+     * @return The current input gain
+     */
+    float getDrive() const;
+    
+    /**
+     * @brief Enable or disable 2x oversampling
+     * 
+     * Doubles the cost of the filter. Takes effect immediately.
+     * 
+     * @param enabled Whether to run the filter at twice the sample rate
+     */
+    void setOversampling(bool enabled);
+    
+    /**
+     * @brief Check whether 2x oversampling is enabled
+     * 
+     * @return true if the filter runs at twice the sample rate
+     */
+    bool isOversampling() const;
+    
+    /**
+     * @brief Process a single sample through the filter
+     * 
+     * @param sample The input sample
+     * @return The filtered sample
+     */
+    float processSample(float sample);
+    
+    /**
+     * @brief Process a buffer of samples through the filter
+     * 
+     * @param buffer Buffer containing samples to process
+     * @param numSamples Number of samples to process
+     */
+    void process(float* buffer, int numSamples);
+    
+    /**
+     * @brief Process a buffer while moving linearly to a new cutoff and resonance
+     * 
+     * The targets are converted once and interpolated per sample. They become
+     * the filter's settings at the end of the buffer.
+     * 
+     * @param buffer Buffer containing samples to process
+     * @param numSamples Number of samples to process
+     * @param targetCutoff Cutoff frequency reached at the end of the buffer
+     * @param targetResonance Resonance reached at the end of the buffer
+     */
+    void processRamped(float* buffer, int numSamples, float targetCutoff, float targetResonance);
+    
+    /**
+     * @brief Process a buffer with a separate cutoff for every sample
+     * 
+     * For audio-rate cutoff modulation. The cutoff buffer is read only; the
+     * filter's cutoff setting is left unchanged.
+     * 
+     * @param buffer Buffer containing samples to process
+     * @param cutoffHz Cutoff frequency in Hertz for each sample
+     * @param numSamples Number of samples to process
+     */
+    void processModulated(float* buffer, const float* cutoffHz, int numSamples);
+    
+    /**
+     * @brief Prepare the filter for playback
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void prepare(double sampleRate);
+    
+    /**
+     * @brief Reset the filter state
+     */
+    void reset();
+    
+    /**
+     * @brief Rational approximation of tanh
+     * 
+     * Within 3% of tanh, exactly +-1 beyond |x| = 3, and much cheaper than
+     * std::tanh.
+     * 
+     * @param x The input value
+     * @return The approximate hyperbolic tangent
+     */
+    static float fastTanh(float x);
+    
+private:
+    // Filter parameters
+    float cutoffFrequency;
+    float resonance;
+    float drive;
+    bool oversampling;
+    double currentSampleRate;
+    
+    // Pole gain and feedback amount for the current settings
+    float gain;
+    float feedback;
+    
+    // Filter state: one integrator per pole, and the last input for oversampling
+    std::array<float, 4> state;
+    float previousInput;
+    
+    // Rate at which the ladder runs
+    float getProcessingRate() const;
+    
+    // Convert a cutoff frequency to the gain of one pole at the processing rate (0 to 1)
+    float getGainForCutoff(float frequencyHz) const;
+    
+    // Convert a resonance amount to a feedback amount
+    static float getFeedbackForResonance(float amount);
+    
+    // Run one input sample, oversampled if enabled
+    float processWithGain(float input, float poleGain, float feedbackAmount);
+    
+    // Run the ladder once at the processing rate
+    float tick(float input, float poleGain, float feedbackAmount);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LadderFilter)
+};
+
+} // namespace UndergroundBeats
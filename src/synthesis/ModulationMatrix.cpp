@@ -0,0 +1,67 @@
+/*
+ * Underground Beats
+ * ModulationMatrix.cpp
+ * 
+ * Implementation of the modulation matrix
+ */
+
+#include "ModulationMatrix.h"
+
+namespace UndergroundBeats {
+
+ModulationMatrix::ModulationMatrix()
+{
+}
+
+ModulationMatrix::~ModulationMatrix()
+{
+}
+
+void ModulationMatrix::setRoute(int slot, const ModulationRoute& route)
+{
+    if (slot < 0 || slot >= maxRoutes)
+        return;
+    
+    routes[static_cast<size_t>(slot)] = route;
+}
+
+ModulationRoute ModulationMatrix::getRoute(int slot) const
+{
+    if (slot < 0 || slot >= maxRoutes)
+        return {};
+    
+    return routes[static_cast<size_t>(slot)];
+}
+
+void ModulationMatrix::clear()
+{
+    routes.fill({});
+}
+
+bool ModulationMatrix::isDestinationModulated(ModulationDestination destination) const
+{
+    for (const auto& route : routes)
+    {
+        if (route.destination == destination && route.source != ModulationSource::None && route.amount != 0.0f)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void ModulationMatrix::evaluate(const float* sourceValues, float* destinationValues) const
+{
+    std::fill(destinationValues, destinationValues + numDestinations, 0.0f);
+    
+    for (const auto& route : routes)
+    {
+        destinationValues[static_cast<int>(route.destination)] += route.amount * sourceValues[static_cast<int>(route.source)];
+    }
+    
+    // Unused slots accumulate into None, which nothing reads
+    destinationValues[static_cast<int>(ModulationDestination::None)] = 0.0f;
+}
+
+} // namespace UndergroundBeats
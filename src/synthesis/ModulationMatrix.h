@@ -0,0 +1,127 @@
+/*
+ * Underground Beats
+ * ModulationMatrix.h
+ * 
+ * Routing of modulation sources to synthesizer voice destinations
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of modulation sources
+ */
+enum class ModulationSource {
+    None,
+    LFO1,           // Shared LFO 1 (-1 to 1)
+    LFO2,           // Shared LFO 2 (-1 to 1)
+    AmpEnvelope,    // Voice amplitude envelope (0 to 1)
+    FilterEnvelope, // Voice filter envelope (0 to 1)
+    Velocity,       // Note velocity (0 to 1)
+    Aftertouch,     // Greater of channel and polyphonic aftertouch (0 to 1)
+    NumSources
+};
+
+/**
+ * @brief Enumeration of modulation destinations
+ */
+enum class ModulationDestination {
+    None,
+    Pitch,            // Semitones
+    FilterCutoff,     // Octaves
+    FilterResonance,  // Added to the resonance amount (0 to 1)
+    Oscillator1Level, // Added to the oscillator level (0 to 1)
+    Oscillator2Level, // Added to the oscillator level (0 to 1)
+    NumDestinations
+};
+
+/**
+ * @brief A single connection from a source to a destination
+ */
+struct ModulationRoute {
+    ModulationSource source = ModulationSource::None;
+    ModulationDestination destination = ModulationDestination::None;
+    float amount = 0.0f; // Destination units per unit of source
+};
+
+/**
+ * @brief Modulation values shared by all voices of a module for one span
+ * 
+ * Sources that do not depend on the voice are computed once per span by the
+ * module, and each voice reads them instead of computing its own copy.
+ */
+struct SharedModulationValues {
+    std::array<const float*, 2> lfoValues = { nullptr, nullptr }; // One value per control step
+    float channelAftertouch = 0.0f;                               // Channel pressure (0 to 1)
+};
+
+/**
+ * @class ModulationMatrix
+ * @brief Fixed-size table of modulation routes
+ * 
+ * The matrix is evaluated once per control step rather than per sample: it
+ * turns a snapshot of the source values into a total offset per destination,
+ * and the voice interpolates between successive results.
+ */
+class ModulationMatrix {
+public:
+    /** Number of route slots */
+    static constexpr int maxRoutes = 8;
+    
+    /** Number of source and destination values passed to evaluate() */
+    static constexpr int numSources = static_cast<int>(ModulationSource::NumSources);
+    static constexpr int numDestinations = static_cast<int>(ModulationDestination::NumDestinations);
+    
+    ModulationMatrix();
+    ~ModulationMatrix();
+    
+    /**
+     * @brief Set a route slot
+     * 
+     * @param slot The slot to set (0 to maxRoutes - 1)
+     * @param route The route, or a default route to clear the slot
+     */
+    void setRoute(int slot, const ModulationRoute& route);
+    
+    /**
+     * @brief Get a route slot
+     * 
+     * @param slot The slot to get (0 to maxRoutes - 1)
+     * @return The route in the slot
+     */
+    ModulationRoute getRoute(int slot) const;
+    
+    /**
+     * @brief Clear all route slots
+     */
+    void clear();
+    
+    /**
+     * @brief Check whether any route targets a destination
+     * 
+     * Lets voices skip the per-sample work for destinations nothing modulates.
+     * 
+     * @param destination The destination to check
+     * @return true if a route with a non-zero amount targets the destination
+     */
+    bool isDestinationModulated(ModulationDestination destination) const;
+    
+    /**
+     * @brief Sum the routes into per-destination offsets
+     * 
+     * @param sourceValues One value per ModulationSource
+     * @param destinationValues Receives one offset per ModulationDestination
+     */
+    void evaluate(const float* sourceValues, float* destinationValues) const;
+    
+private:
+    std::array<ModulationRoute, maxRoutes> routes;
+    
+    JUCE_LEAK_DETECTOR(ModulationMatrix)
+};
+
+} // namespace UndergroundBeats
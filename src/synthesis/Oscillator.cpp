@@ -6,6 +6,7 @@
  */
 
 #include "Oscillator.h"
+#include "Tuning.h"
 
 namespace UndergroundBeats {
 
@@ -81,10 +82,15 @@ float Oscillator::getSample(float frequencyModulation)
     if (frequencyModulation != 0.0f)
     {
         // Convert -1 to 1 range to a frequency multiplier (0.5 to 2.0 for one octave)
-        float multiplier = std::pow(2.0f, frequencyModulation);
+        float multiplier = TuningTable::centsToRatio(frequencyModulation * 1200.0f);
         modulatedPhaseIncrement *= multiplier;
     }
     
+    return generateSample(modulatedPhaseIncrement);
+}
+
+float Oscillator::generateSample(float increment)
+{
     // Generate sample based on current waveform type
     float output = 0.0f;
     
@@ -111,7 +117,7 @@ float Oscillator::getSample(float frequencyModulation)
     }
     
     // Update phase for next sample
-    phase += modulatedPhaseIncrement;
+    phase += increment;
     
     // Keep phase in the range [0, 2π)
     while (phase >= juce::MathConstants<float>::twoPi)
@@ -141,6 +147,18 @@ void Oscillator::process(float* buffer, int numSamples, const float* frequencyMo
     }
 }
 
+void Oscillator::processRamped(float* buffer, int numSamples, float startRatio, float endRatio)
+{
+    const float ratioStep = (endRatio - startRatio) / static_cast<float>(numSamples);
+    float ratio = startRatio;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        ratio += ratioStep;
+        buffer[i] = generateSample(phaseIncrement * ratio);
+    }
+}
+
 void Oscillator::prepare(double sampleRate)
 {
     currentSampleRate = sampleRate;
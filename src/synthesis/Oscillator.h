@@ -112,6 +112,19 @@ public:
      */
     void process(float* buffer, int numSamples, const float* frequencyModulation = nullptr);
     
+    /**
+     * @brief Process a buffer of samples with the frequency scaled by a ramping ratio
+     * 
+     * The ratio moves linearly from startRatio to endRatio, reaching endRatio
+     * on the last sample, so pitch modulation glides rather than steps.
+     * 
+     * @param buffer The buffer to fill with generated samples
+     * @param numSamples The number of samples to generate
+     * @param startRatio Frequency ratio before the first sample
+     * @param endRatio Frequency ratio on the last sample
+     */
+    void processRamped(float* buffer, int numSamples, float startRatio, float endRatio);
+    
     /**
      * @brief Prepare the oscillator for playback
      * 
@@ -133,6 +146,9 @@ private:
     // Anti-aliasing state
     float lastOutput;
     
+    // Generate the current sample and move the phase on by an increment
+    float generateSample(float increment);
+    
     // Sample generation methods for different waveforms
     float generateSine(float phase);
     float generateTriangle(float phase);
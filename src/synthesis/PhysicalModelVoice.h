@@ -0,0 +1,146 @@
+/*
+ * Underground Beats
+ * PhysicalModelVoice.h
+ * 
+ * Synthesizer voice that plays a physical model resonator through the voice filter
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SynthVoiceBase.h"
+#include "SynthVoiceT.h"
+#include "PhysicalModels.h"
+#include <utility>
+
+namespace UndergroundBeats {
+
+/**
+ * @class PhysicalModelVoice
+ * @brief Synthesizer voice driven by a resonator instead of oscillators
+ * 
+ * The resonator is excited when a note starts and decays on its own, and the
+ * voice keeps the envelopes, modulation, filter, and note handling of
+ * SynthVoiceBase. The first oscillator's level and detune set the resonator's
+ * level and tuning; the second oscillator is unused. A natural decay needs an
+ * amplitude envelope with a fast attack and full sustain.
+ * 
+ * Retuning a resonator means recomputing its coefficients, so pitch modulation
+ * ramps across each control step in segments of pitchSegmentSamples rather
+ * than every sample.
+ * 
+ * @tparam Resonator Type of the sound source (KarplusStrongString or ModalBank)
+ * @tparam VoiceFilter Type of the filter (BiquadFilterModel or LadderFilterModel)
+ */
+template <typename Resonator, typename VoiceFilter>
+class PhysicalModelVoice : public SynthVoiceBase {
+public:
+    /**
+     * @brief Create a voice
+     * 
+     * @param resonatorArguments Arguments for the resonator's constructor
+     */
+    template <typename... ResonatorArguments>
+    explicit PhysicalModelVoice(ResonatorArguments&&... resonatorArguments)
+        : resonator(std::forward<ResonatorArguments>(resonatorArguments)...)
+        , frequency(440.0f)
+        , pitchRatio(1.0f)
+    {
+    }
+    
+    ~PhysicalModelVoice() override {}
+    
+protected:
+    void prepareComponents(double sampleRate) override
+    {
+        resonator.prepare(sampleRate);
+        filter.prepare(sampleRate);
+    }
+    
+    void applyComponentParameters(const SharedVoiceParameters& parameters) override
+    {
+        resonator.setParameters(parameters);
+        filter.setParameters(parameters);
+    }
+    
+    void resetOscillators() override
+    {
+        // Start from the unmodulated pitch, as the oscillator voices do
+        if (pitchRatio != 1.0f)
+        {
+            pitchRatio = 1.0f;
+            resonator.setFrequency(frequency);
+        }
+        
+        resonator.excite();
+    }
+    
+    void setOscillatorFrequency(int oscillatorIndex, float frequencyHz) override
+    {
+        if (oscillatorIndex == 0)
+        {
+            frequency = frequencyHz;
+            resonator.setFrequency(frequency * pitchRatio);
+        }
+    }
+    
+    void setFilterTarget(const FilterTarget& target) override
+    {
+        filter.setTarget(target);
+    }
+    
+    void renderStep(float* voiceData, int numSamples, const VoiceStep& step) override
+    {
+        if (step.startPitchRatio == step.endPitchRatio)
+        {
+            setPitchRatio(step.endPitchRatio);
+            resonator.process(voiceData, numSamples, step.startLevels[0], step.endLevels[0]);
+        }
+        else
+        {
+            // Retune at the middle of each segment, so the segments follow the ramp
+            const float scale = 1.0f / static_cast<float>(numSamples);
+            const float levelStep = (step.endLevels[0] - step.startLevels[0]) * scale;
+            const float pitchStep = (step.endPitchRatio - step.startPitchRatio) * scale;
+            
+            for (int start = 0; start < numSamples; start += pitchSegmentSamples)
+            {
+                const int end = juce::jmin(numSamples, start + pitchSegmentSamples);
+                const float middle = 0.5f * static_cast<float>(start + end + 1);
+                
+                setPitchRatio(step.startPitchRatio + middle * pitchStep);
+                resonator.process(voiceData + start, end - start,
+                                  step.startLevels[0] + static_cast<float>(start) * levelStep,
+                                  step.startLevels[0] + static_cast<float>(end) * levelStep);
+            }
+        }
+        
+        if (step.filterTarget != nullptr)
+            filter.processRamped(voiceData, numSamples, *step.filterTarget);
+        else
+            filter.process(voiceData, numSamples);
+    }
+    
+private:
+    Resonator resonator;
+    VoiceFilter filter;
+    float frequency;     // Unmodulated resonator frequency
+    float pitchRatio;    // Pitch modulation ratio the resonator is tuned to
+    
+    // Samples between retunings while the pitch ratio is ramping
+    static constexpr int pitchSegmentSamples = 8;
+    
+    // Retune the resonator to a pitch modulation ratio if it changed
+    void setPitchRatio(float ratio)
+    {
+        if (ratio != pitchRatio)
+        {
+            pitchRatio = ratio;
+            resonator.setFrequency(frequency * pitchRatio);
+        }
+    }
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PhysicalModelVoice)
+};
+
+} // namespace UndergroundBeats
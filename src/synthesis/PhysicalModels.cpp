@@ -0,0 +1,416 @@
+/*
+ * Underground Beats
+ * PhysicalModels.cpp
+ * 
+ * Implementation of the Karplus-Strong string and modal resonator bank
+ */
+
+#include "PhysicalModels.h"
+#include "VoiceParameters.h"
+#include <algorithm>
+#include <cmath>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Natural log of 1000, the amplitude ratio of a 60 dB decay
+constexpr float decay60dB = 6.9077553f;
+
+using ModeRatios = std::array<float, ModalBankSettings::numModes>;
+
+// Free bar: (2n + 1)^2 relative to the first mode
+constexpr ModeRatios barRatios = {
+    1.0f, 2.756f, 5.404f, 8.933f, 13.345f, 18.638f, 24.812f, 31.873f,
+    39.813f, 48.639f, 58.343f, 68.931f, 80.399f, 92.751f, 105.985f, 120.101f
+};
+
+// Circular membrane: zeros of the Bessel functions relative to the first
+constexpr ModeRatios membraneRatios = {
+    1.0f, 1.594f, 2.136f, 2.296f, 2.653f, 2.918f, 3.156f, 3.501f,
+    3.600f, 3.652f, 4.060f, 4.154f, 4.601f, 4.832f, 4.903f, 5.131f
+};
+
+// Church bell: hum, prime, minor third, fifth, nominal, and upper partials
+constexpr ModeRatios bellRatios = {
+    0.5f, 1.0f, 1.183f, 1.506f, 2.0f, 2.514f, 2.662f, 3.011f,
+    4.166f, 5.433f, 6.796f, 8.215f, 9.688f, 11.209f, 12.768f, 14.365f
+};
+
+const ModeRatios& getModeRatios(ModalBody body)
+{
+    switch (body)
+    {
+        case ModalBody::Membrane:
+            return membraneRatios;
+        case ModalBody::Bell:
+            return bellRatios;
+        default:
+            return barRatios;
+    }
+}
+
+} // namespace
+
+//==============================================================================
+// DelayLinePool Implementation
+//==============================================================================
+
+DelayLinePool::DelayLinePool(int numLinesToUse)
+    : numLines(juce::jmax(0, numLinesToUse))
+    , lineLength(0)
+{
+}
+
+DelayLinePool::~DelayLinePool()
+{
+}
+
+void DelayLinePool::prepare(double sampleRate)
+{
+    // One period of the lowest note, plus room for the fractional delay
+    lineLength = juce::nextPowerOfTwo(static_cast<int>(std::ceil(sampleRate / lowestFrequency)) + 4);
+    memory.assign(static_cast<size_t>(numLines) * static_cast<size_t>(lineLength), 0.0f);
+}
+
+int DelayLinePool::getNumLines() const
+{
+    return numLines;
+}
+
+int DelayLinePool::getLineLength() const
+{
+    return lineLength;
+}
+
+float* DelayLinePool::getLine(int index)
+{
+    if (index < 0 || index >= numLines || memory.empty())
+        return nullptr;
+    
+    return memory.data() + static_cast<size_t>(index) * static_cast<size_t>(lineLength);
+}
+
+//==============================================================================
+// KarplusStrongString Implementation
+//==============================================================================
+
+KarplusStrongString::KarplusStrongString(DelayLinePool& delayLines, int lineIndex)
+    : pool(delayLines)
+    , line(lineIndex)
+    , buffer(nullptr)
+    , mask(0)
+    , writeIndex(0)
+    , currentSampleRate(44100.0)
+    , frequency(440.0f)
+    , decaySeconds(1.5f)
+    , brightness(0.5f)
+    , pluckPosition(0.2f)
+    , delaySamples(1)
+    , loopGain(0.0f)
+    , damping(0.25f)
+    , allpassCoefficient(0.0f)
+    , previousSample(0.0f)
+    , allpassInput(0.0f)
+    , allpassOutput(0.0f)
+    , random(lineIndex + 1)
+{
+}
+
+KarplusStrongString::~KarplusStrongString()
+{
+}
+
+void KarplusStrongString::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    
+    // The line may still be in use by a voice this one is replacing, so it is
+    // only cleared when a note starts
+    buffer = pool.getLine(line);
+    mask = buffer != nullptr ? pool.getLineLength() - 1 : 0;
+    writeIndex = 0;
+    previousSample = allpassInput = allpassOutput = 0.0f;
+    
+    updateCoefficients();
+}
+
+void KarplusStrongString::setParameters(const SharedVoiceParameters& parameters)
+{
+    decaySeconds = juce::jlimit(0.01f, 30.0f, parameters.values.physicalDecaySeconds);
+    brightness = juce::jlimit(0.0f, 1.0f, parameters.values.physicalBrightness);
+    pluckPosition = juce::jlimit(0.0f, 0.5f, parameters.values.physicalPosition);
+    
+    updateCoefficients();
+}
+
+void KarplusStrongString::setFrequency(float frequencyHz)
+{
+    frequency = frequencyHz;
+    updateCoefficients();
+}
+
+void KarplusStrongString::excite()
+{
+    if (buffer == nullptr)
+        return;
+    
+    // Clear the whole line so a later drop in pitch never reads an old note
+    std::fill(buffer, buffer + mask + 1, 0.0f);
+    previousSample = allpassInput = allpassOutput = 0.0f;
+    
+    // Fill the period about to be read with noise through a one-pole low-pass;
+    // the scale keeps the level roughly constant across brightness settings
+    const int length = delaySamples;
+    const int start = writeIndex - length;
+    const float smoothing = 0.05f + 0.95f * brightness;
+    const float scale = 0.5f * std::sqrt((2.0f - smoothing) / smoothing);
+    float filtered = 0.0f;
+    
+    for (int i = 0; i < length; ++i)
+    {
+        filtered += smoothing * (random.nextFloat() * 2.0f - 1.0f - filtered);
+        buffer[(start + i) & mask] = filtered * scale;
+    }
+    
+    // Plucking at a point along the string cancels the harmonics with a node there
+    const int pickDelay = juce::roundToInt(pluckPosition * static_cast<float>(length));
+    
+    if (pickDelay > 0)
+    {
+        for (int i = length - 1; i >= pickDelay; --i)
+        {
+            buffer[(start + i) & mask] -= buffer[(start + i - pickDelay) & mask];
+        }
+    }
+    
+    // Remove the offset so the string settles at zero
+    float sum = 0.0f;
+    
+    for (int i = 0; i < length; ++i)
+    {
+        sum += buffer[(start + i) & mask];
+    }
+    
+    const float offset = sum / static_cast<float>(length);
+    
+    for (int i = 0; i < length; ++i)
+    {
+        buffer[(start + i) & mask] -= offset;
+    }
+}
+
+void KarplusStrongString::process(float* output, int numSamples, float startLevel, float endLevel)
+{
+    if (buffer == nullptr)
+    {
+        std::fill(output, output + numSamples, 0.0f);
+        return;
+    }
+    
+    const float levelStep = (endLevel - startLevel) / static_cast<float>(numSamples);
+    const int delay = delaySamples;
+    const float gain = loopGain;
+    const float d = damping;
+    const float c = allpassCoefficient;
+    
+    float previous = previousSample;
+    float apInput = allpassInput;
+    float apOutput = allpassOutput;
+    int index = writeIndex;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float delayed = buffer[(index - delay) & mask];
+        
+        // One-zero damping, then the allpass for the fractional delay
+        const float damped = gain * (delayed + d * (previous - delayed));
+        previous = delayed;
+        
+        const float sample = c * (damped - apOutput) + apInput;
+        apInput = damped;
+        apOutput = sample;
+        
+        buffer[index & mask] = sample;
+        ++index;
+        
+        output[i] = sample * (startLevel + static_cast<float>(i + 1) * levelStep);
+    }
+    
+    previousSample = previous;
+    allpassInput = apInput;
+    allpassOutput = apOutput;
+    writeIndex = index & mask;
+}
+
+void KarplusStrongString::updateCoefficients()
+{
+    if (buffer == nullptr)
+        return;
+    
+    const float sampleRate = static_cast<float>(currentSampleRate);
+    const float period = juce::jmin(sampleRate / juce::jlimit(DelayLinePool::lowestFrequency, sampleRate * 0.25f, frequency),
+                                    static_cast<float>(mask - 1));
+    
+    // The damping filter delays by `damping` samples at low frequencies, and the
+    // allpass makes up the rest with a delay between 0.5 and 1.5 samples
+    damping = 0.5f * (1.0f - brightness);
+    delaySamples = juce::jlimit(1, mask - 1, static_cast<int>(period - damping - 0.5f));
+    
+    const float fraction = period - damping - static_cast<float>(delaySamples);
+    allpassCoefficient = (1.0f - fraction) / (1.0f + fraction);
+    
+    // The signal passes through the loop once per period
+    loopGain = std::exp(-decay60dB * period / (decaySeconds * sampleRate));
+}
+
+//==============================================================================
+// ModalBank Implementation
+//==============================================================================
+
+ModalBank::ModalBank()
+    : currentSampleRate(44100.0)
+    , frequency(440.0f)
+    , settings(calculateSettings(ModalBody::Bar, 1.5f, 0.5f, 44100.0))
+{
+    real.fill(0.0f);
+    imaginary.fill(0.0f);
+    cosines.fill(0.0f);
+    sines.fill(0.0f);
+    gains.fill(0.0f);
+}
+
+ModalBank::~ModalBank()
+{
+}
+
+void ModalBank::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    real.fill(0.0f);
+    imaginary.fill(0.0f);
+    updateCoefficients();
+}
+
+void ModalBank::setParameters(const SharedVoiceParameters& parameters)
+{
+    settings = parameters.modalBank;
+    updateCoefficients();
+}
+
+void ModalBank::setFrequency(float frequencyHz)
+{
+    frequency = frequencyHz;
+    updateCoefficients();
+}
+
+void ModalBank::excite()
+{
+    // Every mode starts at its peak amplitude with a phase of zero, so the
+    // output rises from silence without a click
+    real.fill(1.0f);
+    imaginary.fill(0.0f);
+}
+
+void ModalBank::process(float* output, int numSamples, float startLevel, float endLevel)
+{
+    const float levelStep = (endLevel - startLevel) / static_cast<float>(numSamples);
+    
+    // Work on local copies so the compiler knows nothing else touches them
+    alignas(32) std::array<float, numModes> re = real;
+    alignas(32) std::array<float, numModes> im = imaginary;
+    alignas(32) const std::array<float, numModes> c = cosines;
+    alignas(32) const std::array<float, numModes> s = sines;
+    alignas(32) const std::array<float, numModes> g = gains;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        alignas(32) std::array<float, laneWidth> sums = {};
+        
+        for (int group = 0; group < numModes; group += laneWidth)
+        {
+            for (int lane = 0; lane < laneWidth; ++lane)
+            {
+                const int mode = group + lane;
+                const float nextReal = re[mode] * c[mode] - im[mode] * s[mode];
+                const float nextImaginary = re[mode] * s[mode] + im[mode] * c[mode];
+                re[mode] = nextReal;
+                im[mode] = nextImaginary;
+                sums[lane] += nextImaginary * g[mode];
+            }
+        }
+        
+        float sample = 0.0f;
+        
+        for (const float sum : sums)
+        {
+            sample += sum;
+        }
+        
+        output[i] = sample * (startLevel + static_cast<float>(i + 1) * levelStep);
+    }
+    
+    real = re;
+    imaginary = im;
+}
+
+ModalBankSettings ModalBank::calculateSettings(ModalBody body, float decaySeconds, float brightness, double sampleRate)
+{
+    const ModeRatios& ratios = getModeRatios(body);
+    const float decay = juce::jlimit(0.01f, 30.0f, decaySeconds);
+    const float hardness = juce::jlimit(0.0f, 1.0f, brightness);
+    
+    // Soft strikes excite the upper modes less, and those modes die away faster
+    const float tilt = 0.5f + 2.0f * (1.0f - hardness);
+    const float dampingExponent = 1.0f - hardness;
+    
+    ModalBankSettings result;
+    float gainSum = 0.0f;
+    
+    for (int mode = 0; mode < numModes; ++mode)
+    {
+        const size_t index = static_cast<size_t>(mode);
+        const float relative = ratios[index] / ratios[0];
+        const float modeDecay = juce::jmax(0.005f, decay * std::pow(relative, -dampingExponent));
+        
+        result.ratios[index] = ratios[index];
+        result.gains[index] = std::pow(relative, -tilt);
+        result.radii[index] = std::exp(-decay60dB / (modeDecay * static_cast<float>(sampleRate)));
+        gainSum += result.gains[index];
+    }
+    
+    for (auto& gain : result.gains)
+    {
+        gain /= gainSum;
+    }
+    
+    return result;
+}
+
+void ModalBank::updateCoefficients()
+{
+    const float sampleRate = static_cast<float>(currentSampleRate);
+    const float limit = 0.45f * sampleRate;
+    
+    for (size_t mode = 0; mode < static_cast<size_t>(numModes); ++mode)
+    {
+        const float modeFrequency = frequency * settings.ratios[mode];
+        
+        if (modeFrequency < limit)
+        {
+            const float phaseStep = juce::MathConstants<float>::twoPi * modeFrequency / sampleRate;
+            cosines[mode] = settings.radii[mode] * std::cos(phaseStep);
+            sines[mode] = settings.radii[mode] * std::sin(phaseStep);
+            gains[mode] = settings.gains[mode];
+        }
+        else
+        {
+            // A zero rotation also clears the mode's state on the next sample
+            cosines[mode] = 0.0f;
+            sines[mode] = 0.0f;
+            gains[mode] = 0.0f;
+        }
+    }
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,290 @@
+/*
+ * Underground Beats
+ * PhysicalModels.h
+ * 
+ * Karplus-Strong strings and modal resonator banks for physical model voices
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+namespace UndergroundBeats {
+
+struct SharedVoiceParameters;
+
+/**
+ * @brief Sound generators available to synthesizer voices
+ */
+enum class VoiceModel {
+    Subtractive,     // Two oscillators into a filter (SynthVoice, SynthVoiceT)
+    PluckedString,   // Karplus-Strong string (KarplusStrongString)
+    ModalPercussion  // Bank of decaying resonant modes (ModalBank)
+};
+
+/**
+ * @brief Mode tunings for ModalBank
+ */
+enum class ModalBody {
+    Bar,       // Free bar, as in marimbas and glockenspiels
+    Membrane,  // Circular membrane, as in toms and hand drums
+    Bell       // Church bell partials, including the hum tone an octave down
+};
+
+/**
+ * @brief Mode settings derived from the physical model parameters
+ * 
+ * The same for every voice and note, so computed once per parameter change.
+ */
+struct ModalBankSettings {
+    static constexpr int numModes = 16;
+    
+    std::array<float, numModes> ratios;  // Mode frequency as a multiple of the note frequency
+    std::array<float, numModes> gains;   // Output gain of each mode
+    std::array<float, numModes> radii;   // Per-sample decay factor of each mode
+};
+
+/**
+ * @class DelayLinePool
+ * @brief Delay memory for the strings of all voices of a module
+ * 
+ * All lines live in one allocation, one after the other, and every line has
+ * the same power-of-two length so it wraps with a mask. Voices are rendered in
+ * order, so the delay reads and writes of a block walk through a single
+ * contiguous region instead of one heap allocation per voice.
+ */
+class DelayLinePool {
+public:
+    /**
+     * @brief Create a pool
+     * 
+     * @param numLines Number of delay lines, normally one per voice
+     */
+    DelayLinePool(int numLines = 0);
+    ~DelayLinePool();
+    
+    /**
+     * @brief Allocate lines long enough for the lowest frequency (message thread)
+     * 
+     * Moves the lines, so the voices using them must be prepared again afterwards.
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void prepare(double sampleRate);
+    
+    /**
+     * @brief Get the number of lines in the pool
+     * 
+     * @return The number of lines
+     */
+    int getNumLines() const;
+    
+    /**
+     * @brief Get the length shared by all lines
+     * 
+     * @return The line length in samples (a power of two)
+     */
+    int getLineLength() const;
+    
+    /**
+     * @brief Get the memory of one line
+     * 
+     * @param index The line index
+     * @return The start of the line, or nullptr if the index is out of range
+     */
+    float* getLine(int index);
+    
+    /** Lowest frequency a line can hold one period of */
+    static constexpr float lowestFrequency = 20.0f;
+    
+private:
+    std::vector<float> memory;
+    int numLines;
+    int lineLength;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DelayLinePool)
+};
+
+/**
+ * @class KarplusStrongString
+ * @brief Plucked string made from a delay line, a damping filter, and an allpass
+ * 
+ * A note starts by filling one period of the line with a burst of filtered
+ * noise. Each pass around the loop the signal is scaled for the decay time
+ * and smoothed by a one-zero damping filter, so the upper harmonics die away
+ * first. The loop delay is an integer number of samples plus a first-order
+ * allpass for the fraction, so high notes stay in tune.
+ */
+class KarplusStrongString {
+public:
+    /**
+     * @brief Create a string that uses one line of a pool
+     * 
+     * @param delayLines The pool holding the delay memory
+     * @param lineIndex The line of the pool owned by this string
+     */
+    KarplusStrongString(DelayLinePool& delayLines, int lineIndex);
+    ~KarplusStrongString();
+    
+    /**
+     * @brief Prepare the string for playback (after the pool has been prepared)
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void prepare(double sampleRate);
+    
+    /**
+     * @brief Apply the decay, brightness, and pluck position
+     * 
+     * @param parameters The shared voice parameters
+     */
+    void setParameters(const SharedVoiceParameters& parameters);
+    
+    /**
+     * @brief Set the pitch of the string
+     * 
+     * @param frequencyHz Frequency in Hz
+     */
+    void setFrequency(float frequencyHz);
+    
+    /**
+     * @brief Pluck the string, replacing whatever it was playing
+     */
+    void excite();
+    
+    /**
+     * @brief Write the string output, scaled by a linear gain ramp
+     * 
+     * @param output Buffer to write to
+     * @param numSamples Number of samples to generate
+     * @param startLevel Gain before the first sample
+     * @param endLevel Gain on the last sample
+     */
+    void process(float* output, int numSamples, float startLevel, float endLevel);
+    
+private:
+    DelayLinePool& pool;
+    int line;
+    float* buffer;
+    int mask;
+    int writeIndex;
+    double currentSampleRate;
+    
+    // Settings
+    float frequency;
+    float decaySeconds;
+    float brightness;
+    float pluckPosition;
+    
+    // Loop coefficients for the current settings
+    int delaySamples;      // Integer part of the loop delay
+    float loopGain;        // Gain per pass around the loop
+    float damping;         // Weight of the previous sample in the damping filter (0 to 0.5)
+    float allpassCoefficient;
+    
+    // Filter state
+    float previousSample;
+    float allpassInput;
+    float allpassOutput;
+    
+    // Noise source for the pluck
+    juce::Random random;
+    
+    // Recompute the loop coefficients
+    void updateCoefficients();
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(KarplusStrongString)
+};
+
+/**
+ * @class ModalBank
+ * @brief Bank of exponentially decaying sine modes for struck sounds
+ * 
+ * Each mode is a complex one-pole resonator, a rotation of a two-value state
+ * scaled by its decay factor. A note starts every mode at full amplitude with
+ * zero phase, which is the impulse response of the struck body. Mode state is
+ * stored as separate arrays, and modes are updated in groups of laneWidth with
+ * a separate partial sum per lane, so the mode loop has no dependency between
+ * iterations and the compiler can vectorize it.
+ */
+class ModalBank {
+public:
+    static constexpr int numModes = ModalBankSettings::numModes;
+    static constexpr int laneWidth = 8;
+    
+    ModalBank();
+    ~ModalBank();
+    
+    /**
+     * @brief Prepare the bank for playback
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void prepare(double sampleRate);
+    
+    /**
+     * @brief Apply the mode ratios, gains, and decays
+     * 
+     * @param parameters The shared voice parameters
+     */
+    void setParameters(const SharedVoiceParameters& parameters);
+    
+    /**
+     * @brief Set the frequency that the mode ratios are relative to
+     * 
+     * Modes that would fall above 0.45 times the sample rate are silenced.
+     * 
+     * @param frequencyHz Frequency in Hz
+     */
+    void setFrequency(float frequencyHz);
+    
+    /**
+     * @brief Strike the body, replacing whatever it was playing
+     */
+    void excite();
+    
+    /**
+     * @brief Write the bank output, scaled by a linear gain ramp
+     * 
+     * @param output Buffer to write to
+     * @param numSamples Number of samples to generate
+     * @param startLevel Gain before the first sample
+     * @param endLevel Gain on the last sample
+     */
+    void process(float* output, int numSamples, float startLevel, float endLevel);
+    
+    /**
+     * @brief Calculate the mode settings for a set of physical model parameters
+     * 
+     * Higher modes decay faster as the brightness goes down, and their gains
+     * are tilted down. The gains add up to 1.
+     * 
+     * @param body The mode tuning
+     * @param decaySeconds Time for the lowest mode to decay by 60 dB
+     * @param brightness Strike hardness (0 to 1)
+     * @param sampleRate The sample rate in Hz
+     * @return The settings
+     */
+    static ModalBankSettings calculateSettings(ModalBody body, float decaySeconds, float brightness, double sampleRate);
+    
+private:
+    double currentSampleRate;
+    float frequency;
+    ModalBankSettings settings;
+    
+    // Mode state and coefficients, one entry per mode
+    alignas(32) std::array<float, numModes> real;
+    alignas(32) std::array<float, numModes> imaginary;
+    alignas(32) std::array<float, numModes> cosines;  // Decay factor times the cosine of the mode's phase step
+    alignas(32) std::array<float, numModes> sines;    // Decay factor times the sine of the mode's phase step
+    alignas(32) std::array<float, numModes> gains;    // Mode gains, zero above the frequency limit
+    
+    // Recompute the rotation coefficients for the current frequency
+    void updateCoefficients();
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ModalBank)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,268 @@
+/*
+ * Underground Beats
+ * SampleCache.cpp
+ * 
+ * Implementation of the process-wide sample cache
+ */
+
+#include "SampleCache.h"
+#include <vector>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Bytes hashed from each end of a file
+constexpr int hashEdgeBytes = 64 * 1024;
+
+// File hashes remembered before the least recently used are forgotten
+constexpr size_t maxFileHashes = 4096;
+
+// 64-bit FNV-1a
+constexpr juce::uint64 fnvOffsetBasis = 14695981039346656037ULL;
+constexpr juce::uint64 fnvPrime = 1099511628211ULL;
+
+juce::uint64 hashBytes(juce::uint64 hash, const void* data, size_t numBytes)
+{
+    const auto* bytes = static_cast<const juce::uint8*>(data);
+    
+    for (size_t i = 0; i < numBytes; ++i)
+    {
+        hash = (hash ^ bytes[i]) * fnvPrime;
+    }
+    
+    return hash;
+}
+
+} // namespace
+
+SampleCache::SampleCache()
+    : memoryBudget(512 * 1024 * 1024)
+    , memoryUsage(0)
+    , useCounter(0)
+    , preloadSeconds(1.0)
+    , hits(0)
+    , misses(0)
+    , evictions(0)
+    , loadPool(2)
+{
+    formatManager.registerBasicFormats();
+}
+
+SampleCache::~SampleCache()
+{
+    loadPool.removeAllJobs(true, 5000);
+}
+
+SampleCache& SampleCache::getInstance()
+{
+    static SampleCache instance;
+    return instance;
+}
+
+std::shared_ptr<SampleData> SampleCache::load(const juce::File& file)
+{
+    const juce::uint64 hash = getContentHash(file);
+    
+    if (hash == 0)
+        return nullptr;
+    
+    double preload;
+    
+    {
+        const juce::ScopedLock sl(lock);
+        
+        if (auto cached = findEntry(hash))
+        {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return cached;
+        }
+        
+        preload = preloadSeconds;
+    }
+    
+    misses.fetch_add(1, std::memory_order_relaxed);
+    
+    // Decode outside the lock so other loads are not held up
+    auto data = std::make_shared<SampleData>();
+    
+    if (!data->loadFromFile(file, formatManager, preload))
+        return nullptr;
+    
+    const juce::ScopedLock sl(lock);
+    
+    // Another thread may have decoded the same content in the meantime
+    if (auto cached = findEntry(hash))
+        return cached;
+    
+    const size_t dataSize = data->getMemoryUsage();
+    entries[hash] = { data, ++useCounter, dataSize };
+    memoryUsage += dataSize;
+    
+    evictToBudget(memoryBudget);
+    
+    return data;
+}
+
+void SampleCache::loadAsync(const juce::File& file, LoadCallback callback)
+{
+    loadPool.addJob([this, file, callback]
+    {
+        auto data = load(file);
+        
+        if (callback)
+            callback(data);
+    });
+}
+
+void SampleCache::setMemoryBudget(size_t bytes)
+{
+    const juce::ScopedLock sl(lock);
+    
+    memoryBudget = bytes;
+    evictToBudget(memoryBudget);
+}
+
+void SampleCache::setPreloadTime(double seconds)
+{
+    const juce::ScopedLock sl(lock);
+    
+    preloadSeconds = juce::jmax(0.05, seconds);
+}
+
+void SampleCache::purgeUnused()
+{
+    const juce::ScopedLock sl(lock);
+    
+    evictToBudget(0);
+}
+
+SampleCache::Statistics SampleCache::getStatistics() const
+{
+    Statistics statistics;
+    statistics.hits = hits.load(std::memory_order_relaxed);
+    statistics.misses = misses.load(std::memory_order_relaxed);
+    statistics.evictions = evictions.load(std::memory_order_relaxed);
+    
+    const juce::ScopedLock sl(lock);
+    statistics.memoryUsage = memoryUsage;
+    statistics.memoryBudget = memoryBudget;
+    statistics.numEntries = static_cast<int>(entries.size());
+    
+    return statistics;
+}
+
+juce::uint64 SampleCache::hashFileContents(const juce::File& file)
+{
+    juce::FileInputStream stream(file);
+    
+    if (!stream.openedOk())
+        return 0;
+    
+    const juce::int64 fileSize = stream.getTotalLength();
+    const juce::int64 modificationTime = file.getLastModificationTime().toMilliseconds();
+    juce::uint64 hash = hashBytes(fnvOffsetBasis, &fileSize, sizeof(fileSize));
+    hash = hashBytes(hash, &modificationTime, sizeof(modificationTime));
+    
+    std::vector<char> buffer(static_cast<size_t>(hashEdgeBytes));
+    
+    // The start of the file, then the end; a file shorter than both is simply read through
+    for (int edge = 0; edge < 2; ++edge)
+    {
+        if (edge == 1 && fileSize > 2 * hashEdgeBytes && !stream.setPosition(fileSize - hashEdgeBytes))
+            return 0;
+        
+        const int bytesRead = stream.read(buffer.data(), hashEdgeBytes);
+        
+        if (bytesRead > 0)
+            hash = hashBytes(hash, buffer.data(), static_cast<size_t>(bytesRead));
+    }
+    
+    // 0 is reserved for unreadable files
+    return hash != 0 ? hash : 1;
+}
+
+juce::uint64 SampleCache::getContentHash(const juce::File& file)
+{
+    const juce::String path = file.getFullPathName();
+    const juce::int64 size = file.getSize();
+    const juce::int64 modificationTime = file.getLastModificationTime().toMilliseconds();
+    
+    {
+        const juce::ScopedLock sl(lock);
+        
+        auto it = fileHashes.find(path);
+        
+        if (it != fileHashes.end() && it->second.size == size && it->second.modificationTime == modificationTime)
+        {
+            it->second.lastUsed = ++useCounter;
+            return it->second.hash;
+        }
+    }
+    
+    // Read the file outside the lock so other loads are not held up
+    const juce::uint64 hash = hashFileContents(file);
+    
+    if (hash != 0)
+    {
+        const juce::ScopedLock sl(lock);
+        fileHashes[path] = { size, modificationTime, hash, ++useCounter };
+        trimFileHashes();
+    }
+    
+    return hash;
+}
+
+void SampleCache::trimFileHashes()
+{
+    while (fileHashes.size() > maxFileHashes)
+    {
+        auto oldest = fileHashes.begin();
+        
+        for (auto it = fileHashes.begin(); it != fileHashes.end(); ++it)
+        {
+            if (it->second.lastUsed < oldest->second.lastUsed)
+                oldest = it;
+        }
+        
+        fileHashes.erase(oldest);
+    }
+}
+
+std::shared_ptr<SampleData> SampleCache::findEntry(juce::uint64 hash)
+{
+    auto it = entries.find(hash);
+    
+    if (it == entries.end())
+        return nullptr;
+    
+    it->second.lastUsed = ++useCounter;
+    return it->second.data;
+}
+
+void SampleCache::evictToBudget(size_t budget)
+{
+    while (memoryUsage > budget)
+    {
+        // Find the least recently used entry that nothing outside the cache references
+        auto oldest = entries.end();
+        
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->second.data.use_count() == 1 && (oldest == entries.end() || it->second.lastUsed < oldest->second.lastUsed))
+            {
+                oldest = it;
+            }
+        }
+        
+        // Everything left is in use
+        if (oldest == entries.end())
+            break;
+        
+        memoryUsage -= oldest->second.memoryUsage;
+        entries.erase(oldest);
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace UndergroundBeats
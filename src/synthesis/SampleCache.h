@@ -0,0 +1,174 @@
+/*
+ * Underground Beats
+ * SampleCache.h
+ * 
+ * Process-wide cache of decoded samples with a memory budget
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleData.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SampleCache
+ * @brief Deduplicates decoded sample data across the whole application
+ * 
+ * Samples are keyed by a hash of their file's size, modification time and the
+ * bytes at its start and end, so the same kick used by ten instruments is
+ * decoded and stored only once, and hashing a long recording costs two short
+ * reads. The hashes of recently loaded files are remembered, so a file is only
+ * read again once its size or modification time changes.
+ * 
+ * Entries that are still referenced (by a SampleRegion, and therefore playable)
+ * are never evicted. When the decoded data of all entries exceeds the memory
+ * budget, unreferenced entries are evicted in least-recently-used order, so
+ * memory stays flat as projects and kits grow while recently used samples
+ * reload instantly.
+ */
+class SampleCache {
+public:
+    /**
+     * @brief Cache usage counters
+     */
+    struct Statistics {
+        juce::int64 hits = 0;      // Loads served from the cache
+        juce::int64 misses = 0;    // Loads that had to decode the file
+        juce::int64 evictions = 0; // Entries dropped to stay within the budget
+        size_t memoryUsage = 0;    // Bytes of decoded audio currently cached
+        size_t memoryBudget = 0;   // Configured budget in bytes
+        int numEntries = 0;        // Number of cached samples
+    };
+    
+    /**
+     * @brief Callback for an asynchronous load
+     * 
+     * Receives the loaded data, or nullptr if the file could not be read.
+     * Called on the cache's loading thread.
+     */
+    using LoadCallback = std::function<void(std::shared_ptr<SampleData>)>;
+    
+    SampleCache();
+    ~SampleCache();
+    
+    /**
+     * @brief Get the application-wide cache
+     * 
+     * @return The shared cache instance
+     */
+    static SampleCache& getInstance();
+    
+    /**
+     * @brief Load a sample, decoding it only if it is not cached
+     * 
+     * Blocks while the file is read, so never call this from the audio thread.
+     * 
+     * @param file The audio file to load
+     * @return The shared sample data, or nullptr if the file could not be read
+     */
+    std::shared_ptr<SampleData> load(const juce::File& file);
+    
+    /**
+     * @brief Load a sample on a background thread
+     * 
+     * @param file The audio file to load
+     * @param callback Called with the result once loading has finished
+     */
+    void loadAsync(const juce::File& file, LoadCallback callback);
+    
+    /**
+     * @brief Set the memory budget for decoded audio
+     * 
+     * Evicts unreferenced entries immediately if the cache is over the new budget.
+     * 
+     * @param bytes Budget in bytes
+     */
+    void setMemoryBudget(size_t bytes);
+    
+    /**
+     * @brief Set how much of each newly decoded sample is kept in memory
+     * 
+     * Longer preloads tolerate slower disks at the cost of memory.
+     * 
+     * @param seconds Preload length in seconds of source audio
+     */
+    void setPreloadTime(double seconds);
+    
+    /**
+     * @brief Evict every entry that is no longer referenced
+     */
+    void purgeUnused();
+    
+    /**
+     * @brief Get the cache usage counters
+     * 
+     * @return A snapshot of the statistics
+     */
+    Statistics getStatistics() const;
+    
+    /**
+     * @brief Compute the content hash used as the cache key
+     * 
+     * Hashes the file's size and modification time together with its first and
+     * last 64 KB, so the cost does not grow with the length of the file.
+     * 
+     * @param file The file to hash
+     * @return The 64-bit hash, or 0 if the file could not be read
+     */
+    static juce::uint64 hashFileContents(const juce::File& file);
+    
+private:
+    struct Entry {
+        std::shared_ptr<SampleData> data;
+        juce::uint64 lastUsed;
+        size_t memoryUsage;
+    };
+    
+    // Content hash of a file, valid while its size and modification time are unchanged
+    struct FileHash {
+        juce::int64 size;
+        juce::int64 modificationTime;
+        juce::uint64 hash;
+        juce::uint64 lastUsed;
+    };
+    
+    std::unordered_map<juce::uint64, Entry> entries;
+    std::map<juce::String, FileHash> fileHashes;
+    juce::CriticalSection lock;
+    juce::AudioFormatManager formatManager;
+    
+    size_t memoryBudget;
+    size_t memoryUsage;
+    juce::uint64 useCounter;
+    double preloadSeconds;
+    
+    std::atomic<juce::int64> hits;
+    std::atomic<juce::int64> misses;
+    std::atomic<juce::int64> evictions;
+    
+    // Background loading (destroyed first so no job outlives the cache)
+    juce::ThreadPool loadPool;
+    
+    // Get a file's content hash, hashing the file only if it is new or has changed since
+    juce::uint64 getContentHash(const juce::File& file);
+    
+    // Forget the least recently used file hashes beyond the limit (lock must be held)
+    void trimFileHashes();
+    
+    // Look up an entry and mark it as used (lock must be held)
+    std::shared_ptr<SampleData> findEntry(juce::uint64 hash);
+    
+    // Evict unreferenced entries until the cache fits the budget (lock must be held)
+    void evictToBudget(size_t budget);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleCache)
+};
+
+} // namespace UndergroundBeats
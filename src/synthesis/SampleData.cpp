@@ -0,0 +1,85 @@
+/*
+ * Underground Beats
+ * SampleData.cpp
+ * 
+ * Implementation of shared decoded sample data
+ */
+
+#include "SampleData.h"
+
+namespace UndergroundBeats {
+
+SampleData::SampleData()
+    : numFrames(0)
+    , sampleRate(44100.0)
+{
+}
+
+SampleData::~SampleData()
+{
+}
+
+bool SampleData::loadFromFile(const juce::File& file, juce::AudioFormatManager& formatManager, double preloadSeconds)
+{
+    std::unique_ptr<juce::AudioFormatReader> newReader(formatManager.createReaderFor(file));
+    
+    if (newReader == nullptr || newReader->lengthInSamples <= 0)
+        return false;
+    
+    numFrames = newReader->lengthInSamples;
+    sampleRate = newReader->sampleRate;
+    
+    // Keep the start of the sample resident so notes can start without touching the disk
+    const juce::int64 preloadFrames = static_cast<juce::int64>(juce::jmax(0.0, preloadSeconds) * sampleRate);
+    const int framesToLoad = static_cast<int>(juce::jmin(preloadFrames, numFrames));
+    preload.setSize(2, framesToLoad);
+    newReader->read(&preload, 0, framesToLoad, 0, true, true);
+    
+    // Fully resident samples never stream, so their reader can be closed
+    if (isFullyResident())
+        reader.reset();
+    else
+        reader = std::move(newReader);
+    
+    return true;
+}
+
+juce::int64 SampleData::getNumFrames() const
+{
+    return numFrames;
+}
+
+double SampleData::getSampleRate() const
+{
+    return sampleRate;
+}
+
+const juce::AudioBuffer<float>& SampleData::getPreload() const
+{
+    return preload;
+}
+
+int SampleData::getPreloadFrames() const
+{
+    return preload.getNumSamples();
+}
+
+bool SampleData::isFullyResident() const
+{
+    return getPreloadFrames() >= numFrames;
+}
+
+size_t SampleData::getMemoryUsage() const
+{
+    return static_cast<size_t>(preload.getNumChannels()) * static_cast<size_t>(preload.getNumSamples()) * sizeof(float);
+}
+
+bool SampleData::readFrames(juce::AudioBuffer<float>& destination, int destinationStart, int framesToRead, juce::int64 startFrame)
+{
+    if (reader == nullptr)
+        return false;
+    
+    return reader->read(&destination, destinationStart, framesToRead, startFrame, true, true);
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,105 @@
+/*
+ * Underground Beats
+ * SampleData.h
+ * 
+ * Decoded audio of a sample file, shared between everything that plays it
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SampleData
+ * @brief The decoded start of a sample file and a reader for the rest
+ * 
+ * Only the start of the sample (the preload) is decoded into memory. Samples
+ * no longer than the preload are fully resident; the rest of a longer sample
+ * is read from disk on demand by the DiskStreamer thread, which is the only
+ * thread that calls readFrames() once the data has been loaded.
+ * 
+ * Sample data is always exposed as two channels; mono files are duplicated
+ * into both channels. Instances are shared through the SampleCache, so the
+ * same file is only decoded once however many regions use it.
+ */
+class SampleData {
+public:
+    SampleData();
+    ~SampleData();
+    
+    /**
+     * @brief Open a sample file and decode its preload into memory
+     * 
+     * @param file The audio file to load
+     * @param formatManager Format manager used to create the reader
+     * @param preloadSeconds Length of the start of the sample to keep resident in memory
+     * @return true if the file was opened successfully
+     */
+    bool loadFromFile(const juce::File& file, juce::AudioFormatManager& formatManager, double preloadSeconds);
+    
+    /**
+     * @brief Get the total length of the sample
+     * 
+     * @return Length in frames
+     */
+    juce::int64 getNumFrames() const;
+    
+    /**
+     * @brief Get the sample rate of the source file
+     * 
+     * @return Sample rate in Hz
+     */
+    double getSampleRate() const;
+    
+    /**
+     * @brief Get the resident start of the sample
+     * 
+     * @return Two-channel buffer holding the first getPreloadFrames() frames
+     */
+    const juce::AudioBuffer<float>& getPreload() const;
+    
+    /**
+     * @brief Get the number of frames kept in memory
+     * 
+     * @return Number of preloaded frames
+     */
+    int getPreloadFrames() const;
+    
+    /**
+     * @brief Check if the whole sample is held in memory
+     * 
+     * @return true if no disk streaming is needed
+     */
+    bool isFullyResident() const;
+    
+    /**
+     * @brief Get the memory used by the decoded audio
+     * 
+     * @return Size of the preload in bytes
+     */
+    size_t getMemoryUsage() const;
+    
+    /**
+     * @brief Read frames from the sample file (disk streaming thread only)
+     * 
+     * @param destination Two-channel buffer to read into
+     * @param destinationStart First frame to write in the destination
+     * @param numFrames Number of frames to read
+     * @param startFrame First frame to read from the file
+     * @return true if the read succeeded
+     */
+    bool readFrames(juce::AudioBuffer<float>& destination, int destinationStart, int numFrames, juce::int64 startFrame);
+    
+private:
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    juce::AudioBuffer<float> preload;
+    juce::int64 numFrames;
+    double sampleRate;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleData)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,92 @@
+/*
+ * Underground Beats
+ * SampleRegion.cpp
+ * 
+ * Implementation of sample regions
+ */
+
+#include "SampleRegion.h"
+
+namespace UndergroundBeats {
+
+SampleRegion::SampleRegion(std::shared_ptr<SampleData> sampleData)
+    : data(std::move(sampleData))
+    , lowNote(0)
+    , highNote(127)
+    , lowVelocity(1)
+    , highVelocity(127)
+    , rootNote(60)
+    , gain(1.0f)
+    , oneShot(true)
+    , releaseTime(50.0f)
+{
+}
+
+SampleRegion::~SampleRegion()
+{
+}
+
+SampleData& SampleRegion::getData() const
+{
+    return *data;
+}
+
+bool SampleRegion::appliesTo(int midiNoteNumber, int velocity) const
+{
+    return midiNoteNumber >= lowNote && midiNoteNumber <= highNote
+        && velocity >= lowVelocity && velocity <= highVelocity;
+}
+
+void SampleRegion::setNoteRange(int newLowNote, int newHighNote)
+{
+    lowNote = juce::jlimit(0, 127, newLowNote);
+    highNote = juce::jlimit(lowNote, 127, newHighNote);
+}
+
+void SampleRegion::setVelocityRange(int newLowVelocity, int newHighVelocity)
+{
+    lowVelocity = juce::jlimit(0, 127, newLowVelocity);
+    highVelocity = juce::jlimit(lowVelocity, 127, newHighVelocity);
+}
+
+void SampleRegion::setRootNote(int midiNoteNumber)
+{
+    rootNote = juce::jlimit(0, 127, midiNoteNumber);
+}
+
+void SampleRegion::setGain(float newGain)
+{
+    gain = juce::jmax(0.0f, newGain);
+}
+
+void SampleRegion::setOneShot(bool shouldBeOneShot)
+{
+    oneShot = shouldBeOneShot;
+}
+
+void SampleRegion::setReleaseTime(float timeMs)
+{
+    releaseTime = juce::jmax(1.0f, timeMs);
+}
+
+int SampleRegion::getRootNote() const
+{
+    return rootNote;
+}
+
+float SampleRegion::getGain() const
+{
+    return gain;
+}
+
+bool SampleRegion::isOneShot() const
+{
+    return oneShot;
+}
+
+float SampleRegion::getReleaseTime() const
+{
+    return releaseTime;
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,142 @@
+/*
+ * Underground Beats
+ * SampleRegion.h
+ * 
+ * A recorded sample mapped to a range of notes and velocities
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleData.h"
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SampleRegion
+ * @brief A sample mapped to a key and velocity range
+ * 
+ * The region holds a shared reference to its decoded SampleData, which keeps
+ * the data cached for as long as the region exists. Several regions can
+ * share the same data, for example to map one sample across velocity layers.
+ */
+class SampleRegion {
+public:
+    /**
+     * @brief Create a region playing decoded sample data
+     * 
+     * @param data The sample data to play
+     */
+    explicit SampleRegion(std::shared_ptr<SampleData> data);
+    ~SampleRegion();
+    
+    /**
+     * @brief Get the sample data played by the region
+     * 
+     * @return The shared sample data
+     */
+    SampleData& getData() const;
+    
+    /**
+     * @brief Check if the region should play a note
+     * 
+     * @param midiNoteNumber The MIDI note number
+     * @param velocity The MIDI velocity (0 to 127)
+     * @return true if the note and velocity are inside the region's ranges
+     */
+    bool appliesTo(int midiNoteNumber, int velocity) const;
+    
+    /**
+     * @brief Set the range of MIDI notes that trigger the region
+     * 
+     * @param lowNote Lowest note (inclusive)
+     * @param highNote Highest note (inclusive)
+     */
+    void setNoteRange(int lowNote, int highNote);
+    
+    /**
+     * @brief Set the range of MIDI velocities that trigger the region
+     * 
+     * @param lowVelocity Lowest velocity (inclusive, 0 to 127)
+     * @param highVelocity Highest velocity (inclusive, 0 to 127)
+     */
+    void setVelocityRange(int lowVelocity, int highVelocity);
+    
+    /**
+     * @brief Set the note at which the sample plays at its original pitch
+     * 
+     * @param midiNoteNumber The root MIDI note number
+     */
+    void setRootNote(int midiNoteNumber);
+    
+    /**
+     * @brief Set the playback gain of the region
+     * 
+     * @param gain Linear gain
+     */
+    void setGain(float gain);
+    
+    /**
+     * @brief Set whether note-offs are ignored
+     * 
+     * One-shot regions (typical for drum hits) always play to the end of the sample.
+     * 
+     * @param shouldBeOneShot true to ignore note-offs
+     */
+    void setOneShot(bool shouldBeOneShot);
+    
+    /**
+     * @brief Set the release time used after a note-off
+     * 
+     * @param timeMs Release time in milliseconds
+     */
+    void setReleaseTime(float timeMs);
+    
+    /**
+     * @brief Get the root note of the region
+     * 
+     * @return The root MIDI note number
+     */
+    int getRootNote() const;
+    
+    /**
+     * @brief Get the playback gain of the region
+     * 
+     * @return Linear gain
+     */
+    float getGain() const;
+    
+    /**
+     * @brief Check if note-offs are ignored
+     * 
+     * @return true if the region always plays to the end of the sample
+     */
+    bool isOneShot() const;
+    
+    /**
+     * @brief Get the release time used after a note-off
+     * 
+     * @return Release time in milliseconds
+     */
+    float getReleaseTime() const;
+    
+private:
+    std::shared_ptr<SampleData> data;
+    
+    // Mapping
+    int lowNote;
+    int highNote;
+    int lowVelocity;
+    int highVelocity;
+    int rootNote;
+    
+    // Playback
+    float gain;
+    bool oneShot;
+    float releaseTime;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleRegion)
+};
+
+} // namespace UndergroundBeats
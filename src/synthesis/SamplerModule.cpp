@@ -0,0 +1,249 @@
+/*
+ * Underground Beats
+ * SamplerModule.cpp
+ * 
+ * Implementation of the sampler module
+ */
+
+#include "SamplerModule.h"
+
+namespace UndergroundBeats {
+
+SamplerModule::SamplerModule(int numVoices)
+    : voiceAllocator(numVoices)
+    , regionVersion(0)
+    , currentSampleRate(44100.0)
+{
+    // Create the requested number of voices
+    voices.reserve(numVoices);
+    for (int i = 0; i < numVoices; ++i)
+    {
+        voices.push_back(std::make_unique<SamplerVoice>());
+    }
+}
+
+SamplerModule::~SamplerModule()
+{
+    // Stop streaming before the regions it reads from are destroyed
+    diskStreamer.stopThread(2000);
+}
+
+void SamplerModule::processBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    // After a clear, any sounding voice may be playing a cleared region: stop them all, and their streams, first
+    const juce::uint32 version = retiredRegions.getPublishedVersion();
+    
+    if (version != regionVersion)
+    {
+        for (auto& voice : voices)
+        {
+            voice->noteOff(false);
+        }
+        
+        voiceAllocator.reset();
+        regionVersion = version;
+    }
+    
+    retiredRegions.acknowledge(version);
+    
+    // Clear the output buffers
+    std::fill(leftBuffer, leftBuffer + numSamples, 0.0f);
+    std::fill(rightBuffer, rightBuffer + numSamples, 0.0f);
+    
+    bool notesStarted = false;
+    
+    renderSplitAtEvents(midiMessages, numSamples,
+                        [this, leftBuffer, rightBuffer](int start, int length) { renderVoices(leftBuffer + start, rightBuffer + start, length); },
+                        [this, &notesStarted](const MidiEvent& event)
+                        {
+                            handleMidiEvent(event);
+                            notesStarted = notesStarted || event.type == MidiEventType::NoteOn;
+                        });
+    
+    // Wake the streaming thread so new notes' streams fill before their preload runs out
+    if (notesStarted)
+    {
+        diskStreamer.requestFill();
+    }
+}
+
+void SamplerModule::prepare(double sampleRate, int maximumBlockSize)
+{
+    currentSampleRate = sampleRate;
+    
+    diskStreamer.prepare(static_cast<int>(voices.size()), streamRingFrames);
+    
+    // Prepare all voices and give each one its own stream
+    for (size_t i = 0; i < voices.size(); ++i)
+    {
+        voices[i]->prepare(sampleRate, maximumBlockSize);
+        voices[i]->setStream(diskStreamer.getStream(static_cast<int>(i)));
+    }
+}
+
+SampleRegion* SamplerModule::addRegion(const juce::File& file, int lowNote, int highNote, int rootNote)
+{
+    return addRegion(SampleCache::getInstance().load(file), lowNote, highNote, rootNote);
+}
+
+SampleRegion* SamplerModule::addRegion(std::shared_ptr<SampleData> data, int lowNote, int highNote, int rootNote)
+{
+    if (data == nullptr)
+        return nullptr;
+    
+    auto region = std::make_unique<SampleRegion>(std::move(data));
+    region->setNoteRange(lowNote, highNote);
+    region->setRootNote(rootNote);
+    
+    SampleRegion* newRegion = region.get();
+    
+    const juce::SpinLock::ScopedLockType lock(regionLock);
+    regions.push_back(std::move(region));
+    
+    return newRegion;
+}
+
+void SamplerModule::clearRegions()
+{
+    std::vector<std::unique_ptr<SampleRegion>> cleared;
+    
+    {
+        const juce::SpinLock::ScopedLockType lock(regionLock);
+        cleared.swap(regions);
+    }
+    
+    DiskStreamer* streamer = &diskStreamer;
+    
+    for (auto& region : cleared)
+    {
+        // Destroyed under the read lock, so the streaming thread is never reading the sample data as it goes
+        retiredRegions.retire(std::shared_ptr<const SampleRegion>(region.release(), [streamer](const SampleRegion* retired)
+        {
+            const juce::ScopedLock readLock(streamer->getReadLock());
+            delete retired;
+        }));
+    }
+    
+    retiredRegions.publish();
+}
+
+int SamplerModule::getNumRegions() const
+{
+    const juce::SpinLock::ScopedLockType lock(regionLock);
+    return static_cast<int>(regions.size());
+}
+
+int SamplerModule::getNumStreamUnderruns() const
+{
+    return diskStreamer.getNumUnderruns();
+}
+
+void SamplerModule::handleMidiEvent(const MidiEvent& event)
+{
+    switch (event.type)
+    {
+        case MidiEventType::NoteOn:
+            startVoice(event.data1, event.data2);
+            break;
+        
+        case MidiEventType::NoteOff:
+            stopVoice(event.data1);
+            break;
+        
+        case MidiEventType::AllNotesOff:
+            // Release all voices (one-shots still play to the end)
+            voiceAllocator.releaseAllNotes();
+            
+            for (auto& voice : voices)
+            {
+                voice->noteOff(true);
+            }
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void SamplerModule::renderVoices(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    if (numSamples <= 0)
+    {
+        return;
+    }
+    
+    for (size_t i = 0; i < voices.size(); ++i)
+    {
+        SamplerVoice* voice = voices[i].get();
+        
+        if (!voice->isActive())
+            continue;
+        
+        voice->renderNextBlock(leftBuffer, rightBuffer, numSamples);
+        
+        if (voice->isActive())
+        {
+            voiceAllocator.setVoiceLevel(static_cast<int>(i), voice->getCurrentLevel());
+        }
+        else
+        {
+            // Hand finished voices back to the allocator
+            voiceAllocator.voiceFinished(static_cast<int>(i));
+        }
+    }
+}
+
+SampleRegion* SamplerModule::findRegion(int midiNoteNumber, int velocity)
+{
+    // Skip the note rather than wait if regions are being added
+    const juce::SpinLock::ScopedTryLockType lock(regionLock);
+    
+    if (!lock.isLocked())
+        return nullptr;
+    
+    for (auto& region : regions)
+    {
+        if (region->appliesTo(midiNoteNumber, velocity))
+            return region.get();
+    }
+    
+    return nullptr;
+}
+
+void SamplerModule::startVoice(int midiNoteNumber, int velocity)
+{
+    SampleRegion* region = findRegion(midiNoteNumber, velocity);
+    
+    if (region == nullptr)
+        return;
+    
+    const auto allocation = voiceAllocator.noteOn(midiNoteNumber);
+    
+    if (allocation.voiceIndex < 0)
+        return;
+    
+    SamplerVoice* voice = voices[static_cast<size_t>(allocation.voiceIndex)].get();
+    const float gain = static_cast<float>(velocity) / 127.0f;
+    
+    if (allocation.stolenNote >= 0 || allocation.retriggered)
+    {
+        // Fade out the sounding sample before the new one starts
+        voice->steal(region, midiNoteNumber, gain);
+    }
+    else
+    {
+        voice->noteOn(region, midiNoteNumber, gain);
+    }
+}
+
+void SamplerModule::stopVoice(int midiNoteNumber)
+{
+    const int voiceIndex = voiceAllocator.noteOff(midiNoteNumber);
+    
+    if (voiceIndex >= 0)
+    {
+        voices[static_cast<size_t>(voiceIndex)]->noteOff(true);
+    }
+}
+
+} // namespace UndergroundBeats
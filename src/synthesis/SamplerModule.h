@@ -0,0 +1,149 @@
+/*
+ * Underground Beats
+ * SamplerModule.h
+ * 
+ * Polyphonic sample playback module with disk streaming
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleRegion.h"
+#include "SampleCache.h"
+#include "SamplerVoice.h"
+#include "DiskStreamer.h"
+#include "VoiceAllocator.h"
+#include "MidiEventIterator.h"
+#include "DeferredRelease.h"
+#include <vector>
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SamplerModule
+ * @brief Polyphonic sampler for drum hits and loops
+ * 
+ * The SamplerModule maps sample files to note and velocity ranges and plays
+ * them with the same constant-time voice allocation and sample-accurate MIDI
+ * handling as the SynthModule.
+ * 
+ * Sample data comes from the shared SampleCache, so a sample used by several
+ * instruments is decoded once. Only the first part of each sample is loaded
+ * into memory. When a note starts,
+ * the voice plays from that preload while the DiskStreamer thread streams the
+ * remainder into the voice's ring buffer, so large kits do not need to fit in
+ * RAM and the audio thread never waits on the disk.
+ */
+class SamplerModule {
+public:
+    SamplerModule(int numVoices = 16);
+    ~SamplerModule();
+    
+    /**
+     * @brief Process incoming MIDI messages and generate stereo audio
+     * 
+     * @param midiMessages MIDI messages to process
+     * @param leftBuffer Left channel output buffer
+     * @param rightBuffer Right channel output buffer
+     * @param numSamples Number of samples to generate
+     */
+    void processBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    /**
+     * @brief Prepare the sampler for playback
+     * 
+     * Allocates the per-voice stream buffers and starts the disk streaming thread.
+     * 
+     * @param sampleRate The sample rate in Hz
+     * @param maximumBlockSize The largest block size expected
+     */
+    void prepare(double sampleRate, int maximumBlockSize = 512);
+    
+    /**
+     * @brief Load a sample file through the SampleCache and map it to a range of notes
+     * 
+     * Reads the file's preload from disk on a cache miss, so call this from a
+     * background or message thread, never the audio thread.
+     * 
+     * @param file The audio file to load
+     * @param lowNote Lowest note that triggers the sample
+     * @param highNote Highest note that triggers the sample
+     * @param rootNote Note at which the sample plays at its original pitch
+     * @return The new region for further configuration, or nullptr if the file could not be read
+     */
+    SampleRegion* addRegion(const juce::File& file, int lowNote, int highNote, int rootNote);
+    
+    /**
+     * @brief Map already loaded sample data to a range of notes
+     * 
+     * Use this with SampleCache::loadAsync to add regions without blocking.
+     * 
+     * @param data The sample data to play
+     * @param lowNote Lowest note that triggers the sample
+     * @param highNote Highest note that triggers the sample
+     * @param rootNote Note at which the sample plays at its original pitch
+     * @return The new region for further configuration, or nullptr if data is null
+     */
+    SampleRegion* addRegion(std::shared_ptr<SampleData> data, int lowNote, int highNote, int rootNote);
+    
+    /**
+     * @brief Remove all regions (message thread)
+     * 
+     * Safe during playback: the audio thread stops every voice at the start
+     * of its next block, and the regions and their sample data are destroyed
+     * once it has, never while the streaming thread is reading them.
+     */
+    void clearRegions();
+    
+    /**
+     * @brief Get the number of mapped regions
+     * 
+     * @return The region count
+     */
+    int getNumRegions() const;
+    
+    /**
+     * @brief Get the number of times a voice ran out of streamed data
+     * 
+     * @return The underrun count across all voices
+     */
+    int getNumStreamUnderruns() const;
+    
+private:
+    std::vector<std::unique_ptr<SamplerVoice>> voices;
+    VoiceAllocator voiceAllocator;
+    DiskStreamer diskStreamer;
+    
+    // Regions are added from other threads, so the audio thread only try-locks them
+    std::vector<std::unique_ptr<SampleRegion>> regions;
+    mutable juce::SpinLock regionLock;
+    
+    // Cleared regions, held until the audio thread has stopped the voices that may be playing them
+    DeferredRelease retiredRegions;
+    juce::uint32 regionVersion;     // Latest clear the audio thread has stopped its voices for
+    
+    double currentSampleRate;
+    
+    // Ring buffer size for each voice's stream, in frames
+    static constexpr int streamRingFrames = 65536;
+    
+    // Apply a single MIDI event
+    void handleMidiEvent(const MidiEvent& event);
+    
+    // Render all active voices into a span of the output
+    void renderVoices(float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    // Find the first region that plays a note at a velocity
+    SampleRegion* findRegion(int midiNoteNumber, int velocity);
+    
+    // Start a note on the voice chosen by the allocator
+    void startVoice(int midiNoteNumber, int velocity);
+    
+    // Release the voice playing a note
+    void stopVoice(int midiNoteNumber);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SamplerModule)
+};
+
+} // namespace UndergroundBeats
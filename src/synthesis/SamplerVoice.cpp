@@ -0,0 +1,304 @@
+/*
+ * Underground Beats
+ * SamplerVoice.cpp
+ * 
+ * Implementation of the sample playback voice
+ */
+
+#include "SamplerVoice.h"
+
+namespace UndergroundBeats {
+
+SamplerVoice::SamplerVoice()
+    : active(false)
+    , currentNote(-1)
+    , noteGain(0.0f)
+    , currentSampleRate(44100.0)
+    , maxBlockSize(512)
+    , region(nullptr)
+    , sample(nullptr)
+    , stream(nullptr)
+    , pitchRatio(1.0)
+    , playFrame(0)
+    , nextFetchFrame(0)
+    , fraction(0.0)
+    , baseFrame{0.0f, 0.0f}
+    , nextFrame{0.0f, 0.0f}
+    , pendingRegion(nullptr)
+    , pendingNote(-1)
+    , pendingVelocity(0.0f)
+{
+    // Samples carry their own attack, so the envelope only declicks and releases
+    ampEnvelope = std::make_unique<Envelope>();
+    ampEnvelope->setAttackTime(0.5f);
+    ampEnvelope->setDecayTime(0.0f);
+    ampEnvelope->setSustainLevel(1.0f);
+    ampEnvelope->setReleaseCurve(EnvelopeCurve::Exponential);
+    
+    prepare(currentSampleRate, maxBlockSize);
+}
+
+SamplerVoice::~SamplerVoice()
+{
+}
+
+bool SamplerVoice::isActive() const
+{
+    return active;
+}
+
+void SamplerVoice::noteOn(SampleRegion* newRegion, int midiNoteNumber, float velocity)
+{
+    pendingNote = -1;
+    startNote(newRegion, midiNoteNumber, velocity);
+}
+
+void SamplerVoice::noteOff(bool allowTailOff)
+{
+    if (allowTailOff)
+    {
+        // One-shots play to the end, including a note still waiting for a steal fade
+        SampleRegion* noteRegion = (pendingNote >= 0) ? pendingRegion : region;
+        if (noteRegion != nullptr && noteRegion->isOneShot())
+            return;
+        
+        pendingNote = -1;
+        ampEnvelope->noteOff();
+    }
+    else
+    {
+        // Stop immediately
+        pendingNote = -1;
+        ampEnvelope->reset();
+        finish();
+    }
+}
+
+void SamplerVoice::steal(SampleRegion* newRegion, int midiNoteNumber, float velocity)
+{
+    if (!active)
+    {
+        noteOn(newRegion, midiNoteNumber, velocity);
+        return;
+    }
+    
+    // Fade out the current sample; the new one starts when the fade ends
+    ampEnvelope->fastRelease(stealFadeMs);
+    pendingRegion = newRegion;
+    pendingNote = midiNoteNumber;
+    pendingVelocity = velocity;
+}
+
+float SamplerVoice::getCurrentLevel() const
+{
+    return active ? ampEnvelope->getCurrentValue() * noteGain : 0.0f;
+}
+
+int SamplerVoice::getCurrentNote() const
+{
+    return currentNote;
+}
+
+void SamplerVoice::renderNextBlock(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    if (!active)
+        return;
+    
+    if (pendingNote >= 0 && ampEnvelope->willBeIdleWithin(numSamples))
+    {
+        // Finish the steal fade, then start the pending note at that sample
+        const int fadeSamples = ampEnvelope->getSamplesUntilIdle();
+        renderVoice(leftBuffer, rightBuffer, fadeSamples);
+        
+        startNote(pendingRegion, pendingNote, pendingVelocity);
+        pendingNote = -1;
+        
+        renderVoice(leftBuffer + fadeSamples, rightBuffer + fadeSamples, numSamples - fadeSamples);
+        return;
+    }
+    
+    renderVoice(leftBuffer, rightBuffer, numSamples);
+    
+    // The stolen sample ran out before its fade did, so start the pending note now
+    if (!active && pendingNote >= 0)
+    {
+        startNote(pendingRegion, pendingNote, pendingVelocity);
+        pendingNote = -1;
+    }
+}
+
+void SamplerVoice::setStream(SampleStream* newStream)
+{
+    stream = newStream;
+}
+
+void SamplerVoice::prepare(double sampleRate, int maximumBlockSize)
+{
+    currentSampleRate = sampleRate;
+    maxBlockSize = juce::jmax(1, maximumBlockSize);
+    
+    ampEnvelope->prepare(sampleRate);
+    
+    // Room for the fastest playback speed plus the two interpolation frames
+    const int maxSourceFrames = static_cast<int>(std::ceil(maxBlockSize * maxPitchRatio)) + 2;
+    sourceBuffer.setSize(2, maxSourceFrames);
+    envelopeBuffer.setSize(1, maxBlockSize);
+}
+
+void SamplerVoice::startNote(SampleRegion* newRegion, int midiNoteNumber, float velocity)
+{
+    if (newRegion == nullptr)
+        return;
+    
+    region = newRegion;
+    sample = &region->getData();
+    currentNote = midiNoteNumber;
+    noteGain = region->getGain() * velocity;
+    
+    // Transpose from the root note and convert from the file's sample rate
+    const double semitones = static_cast<double>(midiNoteNumber - region->getRootNote());
+    pitchRatio = std::pow(2.0, semitones / 12.0) * sample->getSampleRate() / currentSampleRate;
+    pitchRatio = juce::jmin(maxPitchRatio, pitchRatio);
+    
+    playFrame = 0;
+    nextFetchFrame = 0;
+    fraction = 0.0;
+    
+    // Start streaming the part after the preload while the preload plays
+    if (stream != nullptr && !sample->isFullyResident())
+    {
+        stream->start(sample, sample->getPreloadFrames());
+    }
+    
+    fetchFrames(&baseFrame[0], &baseFrame[1], 1);
+    fetchFrames(&nextFrame[0], &nextFrame[1], 1);
+    
+    ampEnvelope->setReleaseTime(region->getReleaseTime());
+    ampEnvelope->noteOn();
+    active = true;
+}
+
+void SamplerVoice::renderVoice(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    // Render in chunks that fit the prepared source buffer
+    while (active && numSamples > 0)
+    {
+        const int chunkSamples = juce::jmin(numSamples, maxBlockSize);
+        renderChunk(leftBuffer, rightBuffer, chunkSamples);
+        
+        leftBuffer += chunkSamples;
+        rightBuffer += chunkSamples;
+        numSamples -= chunkSamples;
+    }
+}
+
+void SamplerVoice::renderChunk(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    // Stop rendering as soon as the amplitude envelope has finished its release
+    const bool envelopeEnds = ampEnvelope->willBeIdleWithin(numSamples);
+    if (envelopeEnds)
+    {
+        numSamples = ampEnvelope->getSamplesUntilIdle();
+    }
+    
+    // Fetch every source frame this chunk reads, after the two carried-over frames
+    const double endPosition = fraction + numSamples * pitchRatio;
+    const int framesToFetch = static_cast<int>(endPosition);
+    
+    float* sourceLeft = sourceBuffer.getWritePointer(0);
+    float* sourceRight = sourceBuffer.getWritePointer(1);
+    
+    sourceLeft[0] = baseFrame[0];
+    sourceRight[0] = baseFrame[1];
+    sourceLeft[1] = nextFrame[0];
+    sourceRight[1] = nextFrame[1];
+    
+    fetchFrames(sourceLeft + 2, sourceRight + 2, framesToFetch);
+    
+    // Envelope values scaled by the note gain
+    float* gainData = envelopeBuffer.getWritePointer(0);
+    ampEnvelope->process(gainData, numSamples);
+    juce::FloatVectorOperations::multiply(gainData, noteGain, numSamples);
+    
+    // Linear interpolation at the playback speed
+    double position = fraction;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const int index = static_cast<int>(position);
+        const float alpha = static_cast<float>(position - index);
+        
+        const float left = sourceLeft[index] + alpha * (sourceLeft[index + 1] - sourceLeft[index]);
+        const float right = sourceRight[index] + alpha * (sourceRight[index + 1] - sourceRight[index]);
+        
+        leftBuffer[i] += left * gainData[i];
+        rightBuffer[i] += right * gainData[i];
+        
+        position += pitchRatio;
+    }
+    
+    // Carry the new interpolation base into the next chunk
+    baseFrame[0] = sourceLeft[framesToFetch];
+    baseFrame[1] = sourceRight[framesToFetch];
+    nextFrame[0] = sourceLeft[framesToFetch + 1];
+    nextFrame[1] = sourceRight[framesToFetch + 1];
+    
+    playFrame += framesToFetch;
+    fraction = endPosition - framesToFetch;
+    
+    if (envelopeEnds || !ampEnvelope->isActive() || playFrame >= sample->getNumFrames())
+    {
+        finish();
+    }
+}
+
+void SamplerVoice::fetchFrames(float* left, float* right, int numFrames)
+{
+    int framesDone = 0;
+    
+    // Resident start of the sample
+    const int preloadFrames = sample->getPreloadFrames();
+    if (nextFetchFrame < preloadFrames)
+    {
+        const int framesFromPreload = static_cast<int>(juce::jmin(static_cast<juce::int64>(numFrames), preloadFrames - nextFetchFrame));
+        const int offset = static_cast<int>(nextFetchFrame);
+        
+        juce::FloatVectorOperations::copy(left, sample->getPreload().getReadPointer(0, offset), framesFromPreload);
+        juce::FloatVectorOperations::copy(right, sample->getPreload().getReadPointer(1, offset), framesFromPreload);
+        framesDone = framesFromPreload;
+    }
+    
+    // Streamed remainder of the sample
+    const juce::int64 streamFrame = nextFetchFrame + framesDone;
+    if (framesDone < numFrames && streamFrame < sample->getNumFrames() && stream != nullptr)
+    {
+        const int framesFromStream = static_cast<int>(juce::jmin(static_cast<juce::int64>(numFrames - framesDone), sample->getNumFrames() - streamFrame));
+        
+        // An underrun plays silence here; the stream skips the missed frames so it stays at streamFrame
+        stream->read(left + framesDone, right + framesDone, framesFromStream);
+        framesDone += framesFromStream;
+    }
+    
+    // Silence past the end of the sample
+    if (framesDone < numFrames)
+    {
+        juce::FloatVectorOperations::clear(left + framesDone, numFrames - framesDone);
+        juce::FloatVectorOperations::clear(right + framesDone, numFrames - framesDone);
+    }
+    
+    nextFetchFrame += numFrames;
+}
+
+void SamplerVoice::finish()
+{
+    if (stream != nullptr && sample != nullptr && !sample->isFullyResident())
+    {
+        stream->stop();
+    }
+    
+    active = false;
+    currentNote = -1;
+    region = nullptr;
+    sample = nullptr;
+}
+
+} // namespace UndergroundBeats
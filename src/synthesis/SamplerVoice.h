@@ -0,0 +1,165 @@
+/*
+ * Underground Beats
+ * SamplerVoice.h
+ * 
+ * A single voice playing a sample region, streamed from memory and disk
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Envelope.h"
+#include "SampleRegion.h"
+#include "DiskStreamer.h"
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SamplerVoice
+ * @brief A single voice for polyphonic sample playback
+ * 
+ * Plays a SampleRegion transposed from its root note with linear interpolation.
+ * The start of the sample is read from the resident preload, and the
+ * rest from the voice's SampleStream, which the DiskStreamer thread fills in
+ * the background while the preload plays.
+ */
+class SamplerVoice {
+public:
+    SamplerVoice();
+    ~SamplerVoice();
+    
+    /**
+     * @brief Check if the voice is currently active
+     * 
+     * @return true if the voice is playing a sample
+     */
+    bool isActive() const;
+    
+    /**
+     * @brief Start playing a region
+     * 
+     * @param region The region to play
+     * @param midiNoteNumber The MIDI note number that triggered the region
+     * @param velocity The velocity of the note (0 to 1)
+     */
+    void noteOn(SampleRegion* region, int midiNoteNumber, float velocity);
+    
+    /**
+     * @brief Stop playing the current note
+     * 
+     * One-shot regions ignore tail-off note-offs and play to the end.
+     * 
+     * @param allowTailOff Whether to allow envelope release phase
+     */
+    void noteOff(bool allowTailOff = true);
+    
+    /**
+     * @brief Take over this voice for a new note
+     * 
+     * The current sample is faded out with a short release to avoid a click,
+     * and the new one starts at the sample where the fade ends.
+     * 
+     * @param region The region to play
+     * @param midiNoteNumber The MIDI note number that triggered the region
+     * @param velocity The velocity of the note (0 to 1)
+     */
+    void steal(SampleRegion* region, int midiNoteNumber, float velocity);
+    
+    /**
+     * @brief Get the current output level of the voice
+     * 
+     * @return The amplitude envelope level scaled by the note gain
+     */
+    float getCurrentLevel() const;
+    
+    /**
+     * @brief Get the current MIDI note number
+     * 
+     * @return The MIDI note number currently playing, or -1 if not active
+     */
+    int getCurrentNote() const;
+    
+    /**
+     * @brief Render audio for this voice
+     * 
+     * @param leftBuffer Left channel buffer to add output to
+     * @param rightBuffer Right channel buffer to add output to
+     * @param numSamples Number of samples to generate
+     */
+    void renderNextBlock(float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    /**
+     * @brief Set the disk stream that feeds this voice
+     * 
+     * @param stream The stream, or nullptr to play only resident samples
+     */
+    void setStream(SampleStream* stream);
+    
+    /**
+     * @brief Prepare the voice for playback
+     * 
+     * @param sampleRate The output sample rate in Hz
+     * @param maximumBlockSize The largest block size rendered in one go
+     */
+    void prepare(double sampleRate, int maximumBlockSize);
+    
+    // Highest playback speed relative to the source (limits transposition up)
+    static constexpr double maxPitchRatio = 8.0;
+    
+private:
+    // Voice state
+    bool active;
+    int currentNote;
+    float noteGain;
+    double currentSampleRate;
+    int maxBlockSize;
+    
+    // Region being played and where the voice is within it
+    SampleRegion* region;
+    SampleData* sample;
+    SampleStream* stream;
+    double pitchRatio;
+    juce::int64 playFrame;      // Source frame at the interpolation base
+    juce::int64 nextFetchFrame; // Next source frame to fetch from memory or disk
+    double fraction;            // Position between playFrame and playFrame + 1
+    
+    // Interpolation base frame and the frame after it
+    float baseFrame[2];
+    float nextFrame[2];
+    
+    std::unique_ptr<Envelope> ampEnvelope;
+    
+    // Note waiting for a steal fade-out to finish
+    SampleRegion* pendingRegion;
+    int pendingNote;
+    float pendingVelocity;
+    
+    // Source frames fetched for a block (two leading interpolation frames included)
+    juce::AudioBuffer<float> sourceBuffer;
+    
+    // Envelope values for a block
+    juce::AudioBuffer<float> envelopeBuffer;
+    
+    // Fade-out time used when the voice is stolen
+    static constexpr float stealFadeMs = 5.0f;
+    
+    // Start a note immediately
+    void startNote(SampleRegion* newRegion, int midiNoteNumber, float velocity);
+    
+    // Render a span of samples for the current note
+    void renderVoice(float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    // Render at most one prepared block of samples
+    void renderChunk(float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    // Copy the next source frames from the preload or the disk stream
+    void fetchFrames(float* left, float* right, int numFrames);
+    
+    // Stop the voice and release its stream
+    void finish();
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SamplerVoice)
+};
+
+} // namespace UndergroundBeats
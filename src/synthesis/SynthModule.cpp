@@ -6,22 +6,38 @@
  */
 
 #include "SynthModule.h"
+#include "SynthVoiceFactory.h"
 
 namespace UndergroundBeats {
 
+namespace {
+
+// Add one oscillator to the voice mix, ramping its level linearly to the step's target
+void addOscillator(float* voiceData, const float* oscillatorData, int numSamples, float startLevel, float endLevel)
+{
+    if (startLevel == endLevel)
+    {
+        juce::FloatVectorOperations::addWithMultiply(voiceData, oscillatorData, endLevel, numSamples);
+        return;
+    }
+    
+    const float increment = (endLevel - startLevel) / static_cast<float>(numSamples);
+    float level = startLevel;
+    
+    for (int sample = 0; sample < numSamples; ++sample)
+    {
+        level += increment;
+        voiceData[sample] += oscillatorData[sample] * level;
+    }
+}
+
+} // namespace
+
 //==============================================================================
 // SynthVoice Implementation
 //==============================================================================
 
 SynthVoice::SynthVoice()
-    : active(false)
-    , currentNote(-1)
-    , currentVelocity(0.0f)
-    , currentSampleRate(44100.0)
-    , oscillatorLevels({0.5f, 0.5f})
-    , oscillatorDetuneCents({0.0f, 0.0f})
-    , velocitySensitivity(0.7f)
-    , filterEnvelopeAmount(0.5f)
 {
     // Create oscillators
     for (auto& osc : oscillators)
@@ -29,418 +45,772 @@ SynthVoice::SynthVoice()
         osc = std::make_unique<Oscillator>();
     }
     
-    // Set second oscillator's default detune
-    oscillatorDetuneCents[1] = 5.0f;
-    
-    // Create envelopes
-    ampEnvelope = std::make_unique<Envelope>();
-    filterEnvelope = std::make_unique<Envelope>();
-    
-    // Set default envelope parameters
-    ampEnvelope->setAttackTime(10.0f);
-    ampEnvelope->setDecayTime(100.0f);
-    ampEnvelope->setSustainLevel(0.7f);
-    ampEnvelope->setReleaseTime(200.0f);
-    
-    filterEnvelope->setAttackTime(50.0f);
-    filterEnvelope->setDecayTime(500.0f);
-    filterEnvelope->setSustainLevel(0.5f);
-    filterEnvelope->setReleaseTime(500.0f);
+    for (auto& osc : unisonOscillators)
+    {
+        osc = std::make_unique<UnisonOscillator>();
+    }
     
-    // Create filter
+    // Create filters
     filter = std::make_unique<Filter>();
     filter->setCutoff(1000.0f);
     filter->setResonance(0.5f);
     
-    // Allocate temp buffer
-    tempBuffer.setSize(1, 512);
+    ladderFilter = std::make_unique<LadderFilter>();
+    rightLadderFilter = std::make_unique<LadderFilter>();
+    filterModel = FilterModel::Biquad;
+    
+    // Control steps are at most 512 samples
+    oscillatorBuffer.setSize(2, 512);
 }
 
 SynthVoice::~SynthVoice()
 {
 }
 
-bool SynthVoice::isActive() const
+void SynthVoice::prepareComponents(double sampleRate)
 {
-    return active;
+    for (auto& osc : oscillators)
+    {
+        osc->prepare(sampleRate);
+    }
+    
+    for (auto& osc : unisonOscillators)
+    {
+        osc->prepare(sampleRate);
+    }
+    
+    filter->prepare(sampleRate);
+    ladderFilter->prepare(sampleRate);
+    rightLadderFilter->prepare(sampleRate);
 }
 
-void SynthVoice::noteOn(int midiNoteNumber, float velocity)
+void SynthVoice::applyComponentParameters(const SharedVoiceParameters& parameters)
 {
-    currentNote = midiNoteNumber;
-    currentVelocity = velocity;
-    active = true;
-    
-    // Set oscillator frequencies based on the MIDI note
-    oscillators[0]->setFrequency(midiNoteToFrequency(midiNoteNumber, oscillatorDetuneCents[0]));
-    oscillators[1]->setFrequency(midiNoteToFrequency(midiNoteNumber, oscillatorDetuneCents[1]));
+    for (size_t i = 0; i < oscillators.size(); ++i)
+    {
+        oscillators[i]->setWaveform(parameters.values.oscillatorWaveforms[i]);
+        
+        unisonOscillators[i]->setWaveform(parameters.values.oscillatorWaveforms[i]);
+        unisonOscillators[i]->setNumVoices(parameters.values.oscillatorUnisonVoices[i]);
+        unisonOscillators[i]->setDetune(parameters.values.oscillatorUnisonDetuneCents[i]);
+    }
     
+    filterModel = parameters.values.filterModel;
+    ladderFilter->setDrive(parameters.values.filterDrive);
+    ladderFilter->setOversampling(parameters.values.filterOversampling);
+    rightLadderFilter->setDrive(parameters.values.filterDrive);
+    rightLadderFilter->setOversampling(parameters.values.filterOversampling);
+}
+
+void SynthVoice::resetOscillators()
+{
     // Reset oscillator phases to avoid clicks
     oscillators[0]->resetPhase();
     oscillators[1]->resetPhase();
     
-    // Trigger envelopes
-    ampEnvelope->noteOn();
-    filterEnvelope->noteOn();
+    // Unison stacks start at random phases so they do not sound phasey
+    unisonOscillators[0]->resetPhases();
+    unisonOscillators[1]->resetPhases();
 }
 
-void SynthVoice::noteOff(bool allowTailOff)
+void SynthVoice::setOscillatorFrequency(int oscillatorIndex, float frequencyHz)
 {
-    if (allowTailOff)
+    oscillators[static_cast<size_t>(oscillatorIndex)]->setFrequency(frequencyHz);
+    unisonOscillators[static_cast<size_t>(oscillatorIndex)]->setFrequency(frequencyHz);
+}
+
+void SynthVoice::setFilterTarget(const FilterTarget& target)
+{
+    if (filterModel == FilterModel::Ladder)
     {
-        // Start envelope release phase
-        ampEnvelope->noteOff();
-        filterEnvelope->noteOff();
+        ladderFilter->setCutoff(target.cutoff);
+        ladderFilter->setResonance(target.resonance);
+        rightLadderFilter->setCutoff(target.cutoff);
+        rightLadderFilter->setResonance(target.resonance);
     }
     else
     {
-        // Stop immediately
-        active = false;
-        ampEnvelope->reset();
-        filterEnvelope->reset();
-        currentNote = -1;
+        filter->setParameters(filter->getType(), target.cutoff, target.resonance, target.coefficients);
     }
 }
 
-int SynthVoice::getCurrentNote() const
+void SynthVoice::renderStep(float* voiceData, int numSamples, const VoiceStep& step)
 {
-    return currentNote;
-}
-
-void SynthVoice::renderNextBlock(float* outputBuffer, int numSamples)
-{
-    if (!active)
-        return;
+    float* oscillatorData = oscillatorBuffer.getWritePointer(0);
     
-    // Ensure temp buffer is large enough
-    if (tempBuffer.getNumSamples() < numSamples)
-    {
-        tempBuffer.setSize(1, numSamples, false, true, true);
-    }
-    
-    // Clear the buffer
-    tempBuffer.clear();
-    float* tempData = tempBuffer.getWritePointer(0);
+    // Mix the oscillators, ramping pitch and each level linearly to its target for this step
+    juce::FloatVectorOperations::clear(voiceData, numSamples);
     
-    // Generate audio from oscillators
     for (size_t i = 0; i < oscillators.size(); ++i)
     {
-        // Generate samples from this oscillator
-        oscillators[i]->process(tempData, numSamples);
-        
-        // Apply oscillator level
-        juce::FloatVectorOperations::multiply(tempData, oscillatorLevels[i], numSamples);
+        if (unisonOscillators[i]->getNumVoices() > 1)
+        {
+            unisonOscillators[i]->processRamped(oscillatorData, numSamples, step.startPitchRatio, step.endPitchRatio);
+        }
+        else
+        {
+            oscillators[i]->processRamped(oscillatorData, numSamples, step.startPitchRatio, step.endPitchRatio);
+        }
         
-        // Mix into output buffer
-        juce::FloatVectorOperations::add(outputBuffer, tempData, numSamples);
+        addOscillator(voiceData, oscillatorData, numSamples, step.startLevels[i], step.endLevels[i]);
     }
     
-    // Process filter envelope
-    filterEnvelope->process(tempData, numSamples);
-    
-    // Apply filter envelope to cutoff frequency
-    float baseCutoff = filter->getCutoff();
-    for (int i = 0; i < numSamples; ++i)
+    if (filterModel == FilterModel::Ladder)
     {
-        // Scale filter cutoff based on envelope
-        float envelopeAmount = tempData[i];
-        float cutoffMod = baseCutoff * (1.0f + filterEnvelopeAmount * envelopeAmount);
-        filter->setCutoff(cutoffMod);
-        
-        // Apply filter to the sample
-        outputBuffer[i] = filter->processSample(outputBuffer[i]);
+        if (step.filterTarget != nullptr)
+        {
+            ladderFilter->processRamped(voiceData, numSamples, step.filterTarget->cutoff, step.filterTarget->resonance);
+        }
+        else
+        {
+            ladderFilter->process(voiceData, numSamples);
+        }
     }
+    else if (step.filterTarget != nullptr)
+    {
+        filter->processRamped(voiceData, numSamples, step.filterTarget->coefficients);
+    }
+    else
+    {
+        filter->process(voiceData, numSamples);
+    }
+}
+
+bool SynthVoice::rendersStereo() const
+{
+    return unisonOscillators[0]->getNumVoices() > 1 || unisonOscillators[1]->getNumVoices() > 1;
+}
+
+void SynthVoice::renderStereoStep(float* leftData, float* rightData, int numSamples, const VoiceStep& step)
+{
+    float* oscillatorLeft = oscillatorBuffer.getWritePointer(0);
+    float* oscillatorRight = oscillatorBuffer.getWritePointer(1);
     
-    // Reset filter cutoff
-    filter->setCutoff(baseCutoff);
-    
-    // Apply amplitude envelope
-    ampEnvelope->process(outputBuffer, numSamples);
+    juce::FloatVectorOperations::clear(leftData, numSamples);
+    juce::FloatVectorOperations::clear(rightData, numSamples);
     
-    // Apply velocity sensitivity
-    if (velocitySensitivity > 0.0f)
+    // Unison stacks are spread across the channels; a single oscillator sits in the centre
+    for (size_t i = 0; i < oscillators.size(); ++i)
     {
-        // Calculate velocity amount (mix of velocity sensitivity and full volume)
-        float velocityAmount = velocitySensitivity * currentVelocity + (1.0f - velocitySensitivity);
-        juce::FloatVectorOperations::multiply(outputBuffer, velocityAmount, numSamples);
+        if (unisonOscillators[i]->getNumVoices() > 1)
+        {
+            unisonOscillators[i]->processStereoRamped(oscillatorLeft, oscillatorRight, numSamples, step.startPitchRatio, step.endPitchRatio);
+            addOscillator(leftData, oscillatorLeft, numSamples, step.startLevels[i], step.endLevels[i]);
+            addOscillator(rightData, oscillatorRight, numSamples, step.startLevels[i], step.endLevels[i]);
+        }
+        else
+        {
+            oscillators[i]->processRamped(oscillatorLeft, numSamples, step.startPitchRatio, step.endPitchRatio);
+            addOscillator(leftData, oscillatorLeft, numSamples, step.startLevels[i], step.endLevels[i]);
+            addOscillator(rightData, oscillatorLeft, numSamples, step.startLevels[i], step.endLevels[i]);
+        }
     }
     
-    // Check if voice is still active after processing
-    if (!ampEnvelope->isActive())
+    if (filterModel == FilterModel::Ladder)
     {
-        active = false;
-        currentNote = -1;
+        if (step.filterTarget != nullptr)
+        {
+            ladderFilter->processRamped(leftData, numSamples, step.filterTarget->cutoff, step.filterTarget->resonance);
+            rightLadderFilter->processRamped(rightData, numSamples, step.filterTarget->cutoff, step.filterTarget->resonance);
+        }
+        else
+        {
+            ladderFilter->process(leftData, numSamples);
+            rightLadderFilter->process(rightData, numSamples);
+        }
+    }
+    else if (step.filterTarget != nullptr)
+    {
+        filter->processStereoRamped(leftData, rightData, numSamples, step.filterTarget->coefficients);
+    }
+    else
+    {
+        filter->processStereo(leftData, rightData, numSamples);
     }
 }
 
-void SynthVoice::setOscillatorWaveform(int oscillatorIndex, WaveformType type)
+//==============================================================================
+// SynthModule Implementation
+//==============================================================================
+
+SynthModule::SynthModule(int numVoices)
+    : delayLines(numVoices)
+    , voiceAllocator(numVoices)
+    , currentSampleRate(44100.0)
+    , currentBlockSize(512)
+    , appliedLFOVersion(0)
+    , workerPool(nullptr)
+    , parallelRenderingEnabled(false)
+    , minVoicesPerPartition(16)
+    , voiceSpecializationEnabled(false)
+    , voiceConfiguration(SynthVoiceFactory::runtimeConfiguration)
+    , numPendingReplacements(0)
+    , replacementsAccessible(false)
 {
-    if (oscillatorIndex >= 0 && oscillatorIndex < static_cast<int>(oscillators.size()))
+    // Physical model voices created before prepare() need their delay memory
+    delayLines.prepare(currentSampleRate);
+    
+    // Create the requested number of voices
+    voices.reserve(numVoices);
+    for (int i = 0; i < numVoices; ++i)
     {
-        oscillators[oscillatorIndex]->setWaveform(type);
+        voices.push_back(std::make_unique<SynthVoice>());
+        voices.back()->setParameters(&parameters.getShared());
+        voices.back()->setModulationValues(&modulationValues);
     }
+    
+    activeVoiceIndices.resize(voices.size());
+    replacementVoices.resize(voices.size());
+    replacementPending.assign(voices.size(), false);
+    
+    // Room for one LFO value per sample, the shortest control step
+    lfoControlValues.setSize(2, currentBlockSize);
+    modulationValues.lfoValues = { lfoControlValues.getReadPointer(0), lfoControlValues.getReadPointer(1) };
+}
+
+SynthModule::~SynthModule()
+{
+}
+
+void SynthModule::processBlock(const juce::MidiBuffer& midiMessages, float* outputBuffer, int numSamples)
+{
+    renderBlock(midiMessages, outputBuffer, nullptr, numSamples);
+}
+
+void SynthModule::processStereoBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    renderBlock(midiMessages, leftBuffer, rightBuffer, numSamples);
 }
 
-void SynthVoice::setOscillatorDetune(int oscillatorIndex, float cents)
+void SynthModule::renderBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples)
 {
-    if (oscillatorIndex >= 0 && oscillatorIndex < static_cast<int>(oscillators.size()))
+    // Decaying resonator tails would otherwise spend most of their time on denormals
+    juce::ScopedNoDenormals noDenormals;
+    
+    // Clear the output buffers
+    std::fill(leftBuffer, leftBuffer + numSamples, 0.0f);
+    
+    if (rightBuffer != nullptr)
     {
-        oscillatorDetuneCents[oscillatorIndex] = cents;
-        
-        // If the voice is active, update the frequency
-        if (active && currentNote >= 0)
+        std::fill(rightBuffer, rightBuffer + numSamples, 0.0f);
+    }
+    
+    // Recompute shared derived parameters once if anything changed
+    parameters.refresh();
+    applyLFOParameters();
+    tuning.beginBlock();
+    
+    // The message thread never touches the playing voices, so if it is handing over
+    // replacements right now they simply wait for the next block
+    const juce::SpinLock::ScopedTryLockType lock(voiceLock);
+    replacementsAccessible = lock.isLocked();
+    
+    if (replacementsAccessible && numPendingReplacements > 0)
+    {
+        for (int i = 0; i < static_cast<int>(voices.size()); ++i)
         {
-            oscillators[oscillatorIndex]->setFrequency(midiNoteToFrequency(currentNote, cents));
+            if (voiceAllocator.getVoiceState(i) == VoiceState::Free)
+            {
+                replaceVoice(i);
+            }
         }
     }
+    
+    renderSplitAtEvents(midiMessages, numSamples,
+                        [this, leftBuffer, rightBuffer](int start, int length) { renderVoices(leftBuffer, rightBuffer, start, length); },
+                        [this](const MidiEvent& event) { handleMidiEvent(event); });
 }
 
-void SynthVoice::setOscillatorLevel(int oscillatorIndex, float level)
+void SynthModule::prepare(double sampleRate, int maximumBlockSize)
 {
-    if (oscillatorIndex >= 0 && oscillatorIndex < static_cast<int>(oscillators.size()))
+    currentSampleRate = sampleRate;
+    currentBlockSize = juce::jmax(1, maximumBlockSize);
+    
+    parameters.prepare(sampleRate);
+    
+    for (auto& lfo : lfos)
+    {
+        lfo.prepare(sampleRate);
+        lfo.reset();
+    }
+    
+    lfoControlValues.setSize(2, currentBlockSize);
+    modulationValues.lfoValues = { lfoControlValues.getReadPointer(0), lfoControlValues.getReadPointer(1) };
+    
+    // Prepare all voices, after their delay memory has moved
+    delayLines.prepare(sampleRate);
+    
+    for (auto& voice : voices)
     {
-        oscillatorLevels[oscillatorIndex] = juce::jlimit(0.0f, 1.0f, level);
+        voice->prepare(sampleRate);
     }
+    
+    {
+        const juce::SpinLock::ScopedLockType lock(voiceLock);
+        
+        for (auto& voice : replacementVoices)
+        {
+            if (voice != nullptr)
+                voice->prepare(sampleRate);
+        }
+    }
+    
+    updatePartitionBuffers();
 }
 
-void SynthVoice::setFilterType(FilterType type)
+void SynthModule::setWorkerPool(AudioWorkerPool* pool)
 {
-    filter->setType(type);
+    workerPool = pool;
+    updatePartitionBuffers();
 }
 
-void SynthVoice::setFilterCutoff(float frequencyHz)
+void SynthModule::setParallelRendering(bool enabled, int minVoicesPerThread)
 {
-    filter->setCutoff(frequencyHz);
+    minVoicesPerPartition.store(juce::jmax(1, minVoicesPerThread), std::memory_order_relaxed);
+    parallelRenderingEnabled.store(enabled, std::memory_order_relaxed);
 }
 
-void SynthVoice::setFilterResonance(float amount)
+bool SynthModule::isParallelRenderingEnabled() const
 {
-    filter->setResonance(amount);
+    return parallelRenderingEnabled.load(std::memory_order_relaxed);
 }
 
-void SynthVoice::setEnvelopeParameters(float attackMs, float decayMs, float sustainLevel, float releaseMs)
+int SynthModule::getMinVoicesPerThread() const
 {
-    ampEnvelope->setAttackTime(attackMs);
-    ampEnvelope->setDecayTime(decayMs);
-    ampEnvelope->setSustainLevel(sustainLevel);
-    ampEnvelope->setReleaseTime(releaseMs);
+    return minVoicesPerPartition.load(std::memory_order_relaxed);
 }
 
-void SynthVoice::setVelocitySensitivity(float sensitivity)
+void SynthModule::setVoiceSpecialization(bool enabled)
 {
-    velocitySensitivity = juce::jlimit(0.0f, 1.0f, sensitivity);
+    voiceSpecializationEnabled = enabled;
+    updateVoiceConfiguration();
 }
 
-void SynthVoice::prepare(double sampleRate)
+void SynthModule::setVoiceModel(VoiceModel model)
 {
-    currentSampleRate = sampleRate;
-    
-    // Prepare all components with the new sample rate
-    for (auto& osc : oscillators)
+    parameters.update([=](VoiceParameters& p) { p.voiceModel = model; });
+    updateVoiceConfiguration();
+}
+
+void SynthModule::setPhysicalModelParameters(float decaySeconds, float brightness, float pluckPosition)
+{
+    parameters.update([=](VoiceParameters& p)
     {
-        osc->prepare(sampleRate);
-    }
+        p.physicalDecaySeconds = decaySeconds;
+        p.physicalBrightness = brightness;
+        p.physicalPosition = pluckPosition;
+    });
+}
+
+void SynthModule::setModalBody(ModalBody body)
+{
+    parameters.update([=](VoiceParameters& p) { p.modalBody = body; });
+}
+
+void SynthModule::setOscillatorWaveform(int oscillatorIndex, WaveformType type)
+{
+    if (oscillatorIndex < 0 || oscillatorIndex > 1)
+        return;
     
-    ampEnvelope->prepare(sampleRate);
-    filterEnvelope->prepare(sampleRate);
-    filter->prepare(sampleRate);
+    parameters.update([=](VoiceParameters& p) { p.oscillatorWaveforms[static_cast<size_t>(oscillatorIndex)] = type; });
+    updateVoiceConfiguration();
 }
 
-float SynthVoice::midiNoteToFrequency(int midiNote, float cents) const
+void SynthModule::setOscillatorDetune(int oscillatorIndex, float cents)
 {
-    // Convert MIDI note to frequency using standard formula: freq = 440 * 2^((note - 69) / 12)
-    float note = static_cast<float>(midiNote) + cents / 100.0f;
-    return 440.0f * std::pow(2.0f, (note - 69.0f) / 12.0f);
+    if (oscillatorIndex < 0 || oscillatorIndex > 1)
+        return;
+    
+    parameters.update([=](VoiceParameters& p) { p.oscillatorDetuneCents[static_cast<size_t>(oscillatorIndex)] = cents; });
 }
 
-//==============================================================================
-// SynthModule Implementation
-//==============================================================================
+void SynthModule::setOscillatorLevel(int oscillatorIndex, float level)
+{
+    if (oscillatorIndex < 0 || oscillatorIndex > 1)
+        return;
+    
+    parameters.update([=](VoiceParameters& p) { p.oscillatorLevels[static_cast<size_t>(oscillatorIndex)] = level; });
+}
 
-SynthModule::SynthModule(int numVoices)
-    : currentSampleRate(44100.0)
+void SynthModule::setOscillatorUnison(int oscillatorIndex, int numVoices, float detuneCents)
 {
-    // Create the requested number of voices
-    voices.reserve(numVoices);
-    for (int i = 0; i < numVoices; ++i)
+    if (oscillatorIndex < 0 || oscillatorIndex > 1)
+        return;
+    
+    parameters.update([=](VoiceParameters& p)
     {
-        voices.push_back(std::make_unique<SynthVoice>());
-    }
+        p.oscillatorUnisonVoices[static_cast<size_t>(oscillatorIndex)] = juce::jlimit(1, UnisonOscillator::maxVoices, numVoices);
+        p.oscillatorUnisonDetuneCents[static_cast<size_t>(oscillatorIndex)] = detuneCents;
+    });
+    updateVoiceConfiguration();
 }
 
-SynthModule::~SynthModule()
+void SynthModule::setFilterModel(FilterModel model)
 {
+    parameters.update([=](VoiceParameters& p) { p.filterModel = model; });
+    updateVoiceConfiguration();
 }
 
-void SynthModule::processBlock(const juce::MidiBuffer& midiMessages, float* outputBuffer, int numSamples)
+void SynthModule::setFilterType(FilterType type)
+{
+    parameters.update([=](VoiceParameters& p) { p.filterType = type; });
+}
+
+void SynthModule::setFilterCutoff(float frequencyHz)
+{
+    parameters.update([=](VoiceParameters& p) { p.filterCutoff = frequencyHz; });
+}
+
+void SynthModule::setFilterResonance(float amount)
+{
+    parameters.update([=](VoiceParameters& p) { p.filterResonance = amount; });
+}
+
+void SynthModule::setFilterDrive(float drive)
+{
+    parameters.update([=](VoiceParameters& p) { p.filterDrive = juce::jlimit(1.0f, 16.0f, drive); });
+}
+
+void SynthModule::setFilterOversampling(bool enabled)
+{
+    parameters.update([=](VoiceParameters& p) { p.filterOversampling = enabled; });
+}
+
+void SynthModule::setEnvelopeParameters(float attackMs, float decayMs, float sustainLevel, float releaseMs)
+{
+    parameters.update([=](VoiceParameters& p)
+    {
+        p.attackMs = attackMs;
+        p.decayMs = decayMs;
+        p.sustainLevel = sustainLevel;
+        p.releaseMs = releaseMs;
+    });
+}
+
+void SynthModule::setVelocitySensitivity(float sensitivity)
+{
+    parameters.update([=](VoiceParameters& p) { p.velocitySensitivity = sensitivity; });
+}
+
+void SynthModule::setModulationRoute(int slot, ModulationSource source, ModulationDestination destination, float amount)
+{
+    if (slot < 0 || slot >= ModulationMatrix::maxRoutes)
+        return;
+    
+    parameters.update([=](VoiceParameters& p) { p.modulation.setRoute(slot, { source, destination, amount }); });
+}
+
+void SynthModule::setLFOShape(int lfoIndex, LFOShape shape)
 {
-    // Clear the output buffer
-    std::fill(outputBuffer, outputBuffer + numSamples, 0.0f);
+    if (lfoIndex < 0 || lfoIndex > 1)
+        return;
     
-    // Process MIDI messages
-    for (const auto metadata : midiMessages)
+    parameters.update([=](VoiceParameters& p) { p.lfoShapes[static_cast<size_t>(lfoIndex)] = shape; });
+}
+
+void SynthModule::setLFORate(int lfoIndex, float frequencyHz)
+{
+    if (lfoIndex < 0 || lfoIndex > 1)
+        return;
+    
+    parameters.update([=](VoiceParameters& p) { p.lfoRates[static_cast<size_t>(lfoIndex)] = frequencyHz; });
+}
+
+void SynthModule::setModulationRate(int intervalSamples)
+{
+    parameters.update([=](VoiceParameters& p) { p.modulationInterval = juce::jlimit(1, 512, intervalSamples); });
+}
+
+void SynthModule::setTuning(std::shared_ptr<const TuningTable> table, int channel)
+{
+    tuning.setTable(std::move(table), channel);
+}
+
+void SynthModule::handleMidiEvent(const MidiEvent& event)
+{
+    switch (event.type)
     {
-        const auto message = metadata.getMessage();
-        const int samplePosition = metadata.samplePosition;
-        
-        if (message.isNoteOn())
-        {
-            // Handle note on
-            const int midiNote = message.getNoteNumber();
-            const float velocity = message.getVelocity() / 127.0f;
+        case MidiEventType::NoteOn:
+            startVoice(event.data1, event.getVelocity(), event.channel);
+            break;
             
-            // Find a free voice or steal one
-            SynthVoice* voice = findFreeVoice(midiNote, velocity);
-            if (voice != nullptr)
+        case MidiEventType::NoteOff:
+            stopVoice(event.data1);
+            break;
+            
+        case MidiEventType::AllNotesOff:
+            // Turn off all voices
+            voiceAllocator.releaseAllNotes();
+            
+            for (auto& voice : voices)
             {
-                voice->noteOn(midiNote, velocity);
+                voice->noteOff(true);
             }
-        }
-        else if (message.isNoteOff())
+            break;
+            
+        case MidiEventType::ChannelPressure:
+            modulationValues.channelAftertouch = static_cast<float>(event.data2) / 127.0f;
+            break;
+            
+        case MidiEventType::PolyAftertouch:
         {
-            // Handle note off
-            const int midiNote = message.getNoteNumber();
+            const int voiceIndex = voiceAllocator.getVoiceForNote(event.data1);
             
-            // Find any voices playing this note
-            for (auto& voice : voices)
+            if (voiceIndex >= 0)
             {
-                if (voice->getCurrentNote() == midiNote)
-                {
-                    voice->noteOff(true);
-                }
+                voices[static_cast<size_t>(voiceIndex)]->setAftertouch(static_cast<float>(event.data2) / 127.0f);
             }
+            break;
         }
-        else if (message.isAllNotesOff())
+        
+        default:
+            break;
+    }
+}
+
+void SynthModule::renderVoices(float* leftBuffer, float* rightBuffer, int startSample, int numSamples)
+{
+    if (numSamples <= 0)
+    {
+        return;
+    }
+    
+    // Gather the active voices
+    int numActiveVoices = 0;
+    for (size_t i = 0; i < voices.size(); ++i)
+    {
+        if (voices[i]->isActive())
         {
-            // Turn off all voices
-            for (auto& voice : voices)
-            {
-                voice->noteOff(true);
-            }
+            activeVoiceIndices[static_cast<size_t>(numActiveVoices++)] = static_cast<int>(i);
         }
     }
     
-    // Render audio for all active voices
-    for (auto& voice : voices)
+    // Shared LFO values are sized for one block, so render longer spans in pieces
+    for (int offset = startSample; offset < startSample + numSamples; offset += currentBlockSize)
+    {
+        renderActiveVoices(leftBuffer + offset, rightBuffer != nullptr ? rightBuffer + offset : nullptr,
+                           juce::jmin(currentBlockSize, startSample + numSamples - offset), numActiveVoices);
+    }
+    
+    // Allocator bookkeeping stays on the calling thread
+    for (int i = 0; i < numActiveVoices; ++i)
     {
+        const int voiceIndex = activeVoiceIndices[static_cast<size_t>(i)];
+        SynthVoiceBase* voice = voices[static_cast<size_t>(voiceIndex)].get();
+        
         if (voice->isActive())
         {
-            voice->renderNextBlock(outputBuffer, numSamples);
+            voiceAllocator.setVoiceLevel(voiceIndex, voice->getCurrentLevel());
+        }
+        else
+        {
+            // Hand finished voices back to the allocator
+            voiceAllocator.voiceFinished(voiceIndex);
         }
     }
 }
 
-void SynthModule::processStereoBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples)
+void SynthModule::renderActiveVoices(float* leftBuffer, float* rightBuffer, int numSamples, int numActiveVoices)
 {
-    // Clear the output buffers
-    std::fill(leftBuffer, leftBuffer + numSamples, 0.0f);
+    // LFOs run once per span for all voices, even when none is active, so they stay in time
+    const int interval = juce::jlimit(1, 512, parameters.getShared().values.modulationInterval);
+    for (size_t i = 0; i < lfos.size(); ++i)
+    {
+        lfos[i].renderControlValues(lfoControlValues.getWritePointer(static_cast<int>(i)), numSamples, interval);
+    }
     
-    // Process mono first
-    processBlock(midiMessages, leftBuffer, numSamples);
+    const int numPartitions = getNumRenderPartitions(numActiveVoices);
     
-    // Copy to right channel
-    std::copy(leftBuffer, leftBuffer + numSamples, rightBuffer);
+    if (numPartitions > 1)
+    {
+        renderVoicesParallel(leftBuffer, rightBuffer, numSamples, numActiveVoices, numPartitions);
+    }
+    else
+    {
+        for (int i = 0; i < numActiveVoices; ++i)
+        {
+            voices[static_cast<size_t>(activeVoiceIndices[static_cast<size_t>(i)])]->renderNextBlock(leftBuffer, rightBuffer, numSamples);
+        }
+    }
 }
 
-void SynthModule::prepare(double sampleRate)
+void SynthModule::applyLFOParameters()
 {
-    currentSampleRate = sampleRate;
+    const SharedVoiceParameters& shared = parameters.getShared();
     
-    // Prepare all voices
-    for (auto& voice : voices)
+    if (shared.version == appliedLFOVersion)
+        return;
+    
+    appliedLFOVersion = shared.version;
+    
+    for (size_t i = 0; i < lfos.size(); ++i)
     {
-        voice->prepare(sampleRate);
+        lfos[i].setShape(shared.values.lfoShapes[i]);
+        lfos[i].setRate(shared.values.lfoRates[i]);
     }
 }
 
-void SynthModule::setOscillatorWaveform(int oscillatorIndex, WaveformType type)
+int SynthModule::getNumRenderPartitions(int numActiveVoices) const
 {
-    for (auto& voice : voices)
+    if (!parallelRenderingEnabled.load(std::memory_order_relaxed) || workerPool == nullptr)
     {
-        voice->setOscillatorWaveform(oscillatorIndex, type);
+        return 1;
     }
+    
+    const int maxPartitions = partitionBuffers.getNumChannels() / 2 + 1;
+    return juce::jlimit(1, maxPartitions, numActiveVoices / minVoicesPerPartition.load(std::memory_order_relaxed));
 }
 
-void SynthModule::setOscillatorDetune(int oscillatorIndex, float cents)
+void SynthModule::renderVoicesParallel(float* leftBuffer, float* rightBuffer, int numSamples, int numActiveVoices, int numPartitions)
 {
-    for (auto& voice : voices)
+    const int maxChunk = partitionBuffers.getNumSamples();
+    
+    for (int offset = 0; offset < numSamples; offset += maxChunk)
     {
-        voice->setOscillatorDetune(oscillatorIndex, cents);
+        const int chunkSamples = juce::jmin(maxChunk, numSamples - offset);
+        RenderTask task { this, leftBuffer + offset, rightBuffer != nullptr ? rightBuffer + offset : nullptr,
+                          chunkSamples, numActiveVoices, numPartitions };
+        
+        workerPool->run(numPartitions, &SynthModule::renderPartition, &task);
+        
+        // Sum the private partition buffers into the output
+        for (int partition = 1; partition < numPartitions; ++partition)
+        {
+            juce::FloatVectorOperations::add(task.leftBuffer, partitionBuffers.getReadPointer(2 * (partition - 1)), chunkSamples);
+            
+            if (task.rightBuffer != nullptr)
+            {
+                juce::FloatVectorOperations::add(task.rightBuffer, partitionBuffers.getReadPointer(2 * (partition - 1) + 1), chunkSamples);
+            }
+        }
     }
 }
 
-void SynthModule::setOscillatorLevel(int oscillatorIndex, float level)
+void SynthModule::renderPartition(void* context, int partitionIndex)
 {
-    for (auto& voice : voices)
+    // Worker threads have their own floating point mode
+    juce::ScopedNoDenormals noDenormals;
+    
+    const RenderTask& task = *static_cast<RenderTask*>(context);
+    SynthModule& module = *task.module;
+    
+    // Partition 0 renders straight into the output; the others use private buffers
+    float* left = task.leftBuffer;
+    float* right = task.rightBuffer;
+    if (partitionIndex > 0)
     {
-        voice->setOscillatorLevel(oscillatorIndex, level);
+        left = module.partitionBuffers.getWritePointer(2 * (partitionIndex - 1));
+        juce::FloatVectorOperations::clear(left, task.numSamples);
+        
+        if (right != nullptr)
+        {
+            right = module.partitionBuffers.getWritePointer(2 * (partitionIndex - 1) + 1);
+            juce::FloatVectorOperations::clear(right, task.numSamples);
+        }
     }
-}
-
-void SynthModule::setFilterType(FilterType type)
-{
-    for (auto& voice : voices)
+    
+    const int firstVoice = partitionIndex * task.numVoices / task.numPartitions;
+    const int lastVoice = (partitionIndex + 1) * task.numVoices / task.numPartitions;
+    
+    for (int i = firstVoice; i < lastVoice; ++i)
     {
-        voice->setFilterType(type);
+        const int voiceIndex = module.activeVoiceIndices[static_cast<size_t>(i)];
+        module.voices[static_cast<size_t>(voiceIndex)]->renderNextBlock(left, right, task.numSamples);
     }
 }
 
-void SynthModule::setFilterCutoff(float frequencyHz)
+void SynthModule::updatePartitionBuffers()
 {
-    for (auto& voice : voices)
-    {
-        voice->setFilterCutoff(frequencyHz);
-    }
+    const int numWorkers = (workerPool != nullptr) ? workerPool->getNumWorkers() : 0;
+    partitionBuffers.setSize(2 * numWorkers, numWorkers > 0 ? currentBlockSize : 0);
 }
 
-void SynthModule::setFilterResonance(float amount)
+void SynthModule::startVoice(int midiNoteNumber, float velocity, int channel)
 {
-    for (auto& voice : voices)
+    const float frequency = tuning.getFrequency(midiNoteNumber, channel);
+    
+    // Keys the tuning leaves unmapped do not sound
+    if (frequency <= 0.0f)
+        return;
+    
+    const auto allocation = voiceAllocator.noteOn(midiNoteNumber);
+    
+    if (allocation.voiceIndex < 0)
+        return;
+    
+    // A free slot starts its note on the replacement voice; a stolen one keeps its voice for now
+    if (allocation.stolenNote < 0 && replacementsAccessible)
     {
-        voice->setFilterResonance(amount);
+        replaceVoice(allocation.voiceIndex);
     }
-}
-
-void SynthModule::setEnvelopeParameters(float attackMs, float decayMs, float sustainLevel, float releaseMs)
-{
-    for (auto& voice : voices)
+    
+    SynthVoiceBase* voice = voices[static_cast<size_t>(allocation.voiceIndex)].get();
+    
+    if (allocation.stolenNote >= 0)
     {
-        voice->setEnvelopeParameters(attackMs, decayMs, sustainLevel, releaseMs);
+        // Fade out the stolen note before the new one starts
+        voice->steal(midiNoteNumber, velocity, frequency);
+    }
+    else
+    {
+        voice->noteOn(midiNoteNumber, velocity, frequency);
     }
 }
 
-void SynthModule::setVelocitySensitivity(float sensitivity)
+void SynthModule::stopVoice(int midiNoteNumber)
 {
-    for (auto& voice : voices)
+    const int voiceIndex = voiceAllocator.noteOff(midiNoteNumber);
+    
+    if (voiceIndex >= 0)
     {
-        voice->setVelocitySensitivity(sensitivity);
+        voices[static_cast<size_t>(voiceIndex)]->noteOff(true);
     }
 }
 
-SynthVoice* SynthModule::findFreeVoice(int midiNoteNumber, float velocity) const
+void SynthModule::updateVoiceConfiguration()
 {
-    // First, check if the note is already playing (voice stealing for legato)
-    for (auto& voice : voices)
+    int configuration = SynthVoiceFactory::getConfiguration(parameters.getPendingValues());
+    
+    if (!voiceSpecializationEnabled && !SynthVoiceFactory::isPhysicalModel(configuration))
+        configuration = SynthVoiceFactory::runtimeConfiguration;
+    
+    if (configuration == voiceConfiguration)
+        return;
+    
+    // Build and prepare the new voices here, so the audio thread only swaps them in
+    std::vector<std::unique_ptr<SynthVoiceBase>> newVoices;
+    newVoices.reserve(voices.size());
+    
+    for (size_t i = 0; i < voices.size(); ++i)
     {
-        if (voice->getCurrentNote() == midiNoteNumber)
-        {
-            return voice.get();
-        }
+        newVoices.push_back(SynthVoiceFactory::create(configuration, delayLines, static_cast<int>(i)));
+        newVoices.back()->setParameters(&parameters.getShared());
+        newVoices.back()->setModulationValues(&modulationValues);
+        newVoices.back()->prepare(currentSampleRate);
     }
     
-    // Then look for an inactive voice
-    for (auto& voice : voices)
     {
-        if (!voice->isActive())
-        {
-            return voice.get();
-        }
+        const juce::SpinLock::ScopedLockType lock(voiceLock);
+        replacementVoices.swap(newVoices);
+        replacementPending.assign(voices.size(), true);
+        numPendingReplacements = static_cast<int>(voices.size());
+        voiceConfiguration = configuration;
     }
     
-    // If all voices are active, steal the oldest one
-    // In a more sophisticated implementation, we would use a more
-    // intelligent voice stealing algorithm based on note priority, etc.
-    return voices[0].get();
+    // The voices replaced last time, and replacements that never got swapped in, are released here
+}
+
+void SynthModule::replaceVoice(int voiceIndex)
+{
+    const size_t index = static_cast<size_t>(voiceIndex);
+    
+    if (!replacementPending[index])
+        return;
+    
+    // The outgoing voice stays in replacementVoices until the message thread releases it
+    voices[index].swap(replacementVoices[index]);
+    replacementPending[index] = false;
+    --numPendingReplacements;
 }
 
 } // namespace UndergroundBeats
@@ -9,8 +9,20 @@
 
 #include <JuceHeader.h>
 #include "Oscillator.h"
+#include "UnisonOscillator.h"
 #include "Envelope.h"
 #include "Filter.h"
+#include "LadderFilter.h"
+#include "Tuning.h"
+#include "SynthVoiceBase.h"
+#include "VoiceAllocator.h"
+#include "MidiEventIterator.h"
+#include "AudioWorkerPool.h"
+#include "VoiceParameters.h"
+#include "PhysicalModels.h"
+#include "LFO.h"
+#include "ModulationMatrix.h"
+#include <atomic>
 #include <vector>
 #include <memory>
 
@@ -18,188 +30,166 @@ namespace UndergroundBeats {
 
 /**
  * @class SynthVoice
- * @brief A single voice for polyphonic synthesis
+ * @brief Synthesizer voice built from runtime-configurable components
  * 
- * Represents a single voice in a polyphonic synthesizer, containing
- * oscillators, envelopes, and filters.
+ * Supports every oscillator waveform, unison stacks, and every filter model,
+ * and can be reconfigured while playing. The SynthModule uses it whenever no
+ * SynthVoiceT specialization matches the current settings. While either
+ * oscillator has a unison stack, stereo output keeps the stack's spread.
  */
-class SynthVoice {
+class SynthVoice : public SynthVoiceBase {
 public:
     SynthVoice();
-    ~SynthVoice();
+    ~SynthVoice() override;
+    
+protected:
+    void prepareComponents(double sampleRate) override;
+    void applyComponentParameters(const SharedVoiceParameters& parameters) override;
+    void resetOscillators() override;
+    void setOscillatorFrequency(int oscillatorIndex, float frequencyHz) override;
+    void setFilterTarget(const FilterTarget& target) override;
+    void renderStep(float* voiceData, int numSamples, const VoiceStep& step) override;
+    bool rendersStereo() const override;
+    void renderStereoStep(float* leftData, float* rightData, int numSamples, const VoiceStep& step) override;
     
-    /**
-     * @brief Check if the voice is currently active
-     * 
-     * @return true if the voice is playing a note
-     */
-    bool isActive() const;
-    
-    /**
-     * @brief Start playing a note with this voice
-     * 
-     * @param midiNoteNumber The MIDI note number to play
-     * @param velocity The velocity of the note (0 to 1)
-     */
-    void noteOn(int midiNoteNumber, float velocity);
+private:
+    // Synthesis components
+    std::array<std::unique_ptr<Oscillator>, 2> oscillators;
+    std::array<std::unique_ptr<UnisonOscillator>, 2> unisonOscillators; // Used instead when unison is on
+    std::unique_ptr<Filter> filter;
+    std::unique_ptr<LadderFilter> ladderFilter;      // Used instead for the ladder model
+    std::unique_ptr<LadderFilter> rightLadderFilter; // Right channel of the ladder while rendering in stereo
+    FilterModel filterModel;
     
-    /**
-     * @brief Stop playing the current note
-     * 
-     * @param allowTailOff Whether to allow envelope release phase
-     */
-    void noteOff(bool allowTailOff = true);
+    // Scratch buffer for one oscillator over a control step (left and right)
+    juce::AudioBuffer<float> oscillatorBuffer;
     
-    /**
-     * @brief Get the current MIDI note number
-     * 
-     * @return The MIDI note number currently playing, or -1 if not active
-     */
-    int getCurrentNote() const;
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthVoice)
+};
+
+/**
+ * @class SynthModule
+ * @brief Complete polyphonic synthesizer module
+ * 
+ * The SynthModule class implements a complete polyphonic synthesizer with
+ * multiple voices, oscillators, filters, and envelopes.
+ * 
+ * Parameter setters only update a shared, versioned parameter block, so they
+ * cost the same regardless of the number of voices. Derived values are
+ * recomputed once at the start of the next block and picked up by each voice.
+ */
+class SynthModule {
+public:
+    SynthModule(int numVoices = 8);
+    ~SynthModule();
     
     /**
-     * @brief Render audio for this voice
+     * @brief Process incoming MIDI messages and generate audio
      * 
+     * @param midiMessages MIDI messages to process
      * @param outputBuffer Buffer to write output to
      * @param numSamples Number of samples to generate
      */
-    void renderNextBlock(float* outputBuffer, int numSamples);
+    void processBlock(const juce::MidiBuffer& midiMessages, float* outputBuffer, int numSamples);
     
     /**
-     * @brief Set the oscillator waveform
+     * @brief Process MIDI messages and generate audio for stereo output
      * 
-     * @param oscillatorIndex The oscillator to set (0 or 1)
-     * @param type The waveform type
-     */
-    void setOscillatorWaveform(int oscillatorIndex, WaveformType type);
-    
-    /**
-     * @brief Set the oscillator detune amount
+     * Unison stacks keep their stereo spread; everything else is the same in
+     * both channels.
      * 
-     * @param oscillatorIndex The oscillator to set (0 or 1)
-     * @param cents Detune amount in cents
+     * @param midiMessages MIDI messages to process
+     * @param leftBuffer Left channel output buffer
+     * @param rightBuffer Right channel output buffer
+     * @param numSamples Number of samples to generate
      */
-    void setOscillatorDetune(int oscillatorIndex, float cents);
+    void processStereoBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples);
     
     /**
-     * @brief Set the oscillator level
+     * @brief Prepare the synthesizer for playback
      * 
-     * @param oscillatorIndex The oscillator to set (0 or 1)
-     * @param level Oscillator level (0 to 1)
+     * @param sampleRate The sample rate in Hz
+     * @param maximumBlockSize The largest block size expected (sizes the parallel render buffers)
      */
-    void setOscillatorLevel(int oscillatorIndex, float level);
+    void prepare(double sampleRate, int maximumBlockSize = 512);
     
     /**
-     * @brief Set the filter type
+     * @brief Set the worker pool used for parallel voice rendering
      * 
-     * @param type The filter type
-     */
-    void setFilterType(FilterType type);
-    
-    /**
-     * @brief Set the filter cutoff frequency
+     * Allocates one accumulation buffer per worker, so call this before playback.
      * 
-     * @param frequencyHz Cutoff frequency in Hertz
+     * @param pool The worker pool, or nullptr to always render on the calling thread
      */
-    void setFilterCutoff(float frequencyHz);
+    void setWorkerPool(AudioWorkerPool* pool);
     
     /**
-     * @brief Set the filter resonance
+     * @brief Enable or disable rendering voices on multiple threads
      * 
-     * @param amount Resonance amount (0 to 1)
+     * Active voices are split into one partition per thread, and each partition is
+     * rendered into its own buffer before the buffers are summed. The number of
+     * partitions follows the active voice count, so small counts stay on the
+     * calling thread. Takes effect from the next block, so it can be changed
+     * during playback.
+     * 
+     * @param enabled true to render in parallel when enough voices are active
+     * @param minVoicesPerThread Minimum number of active voices per partition
      */
-    void setFilterResonance(float amount);
+    void setParallelRendering(bool enabled, int minVoicesPerThread = 16);
     
     /**
-     * @brief Set the ADSR envelope parameters
+     * @brief Check whether voices are rendered on multiple threads
      * 
-     * @param attackMs Attack time in milliseconds
-     * @param decayMs Decay time in milliseconds
-     * @param sustainLevel Sustain level (0 to 1)
-     * @param releaseMs Release time in milliseconds
+     * @return true if parallel rendering is enabled
      */
-    void setEnvelopeParameters(float attackMs, float decayMs, float sustainLevel, float releaseMs);
+    bool isParallelRenderingEnabled() const;
     
     /**
-     * @brief Set the velocity sensitivity
+     * @brief Get the minimum number of active voices per render thread
      * 
-     * @param sensitivity How much velocity affects output (0 to 1)
+     * @return The minimum number of voices per partition
      */
-    void setVelocitySensitivity(float sensitivity);
+    int getMinVoicesPerThread() const;
     
     /**
-     * @brief Prepare the voice for playback
+     * @brief Enable or disable compile-time specialized voices
      * 
-     * @param sampleRate The sample rate in Hz
+     * When enabled, voices are created through the SynthVoiceFactory as
+     * SynthVoiceT instances for the current oscillator waveforms, falling back
+     * to the runtime SynthVoice for settings without a specialization. Changing
+     * a waveform or the unison settings then replaces the voices: each voice is
+     * swapped for its replacement once it is idle, so playing notes finish on
+     * the voice that started them. Call from the message thread.
+     * 
+     * @param enabled true to use specialized voices where available
      */
-    void prepare(double sampleRate);
-    
-private:
-    // Voice state
-    bool active;
-    int currentNote;
-    float currentVelocity;
-    double currentSampleRate;
-    
-    // Synthesis components
-    std::array<std::unique_ptr<Oscillator>, 2> oscillators;
-    std::array<float, 2> oscillatorLevels;
-    std::array<float, 2> oscillatorDetuneCents;
-    
-    std::unique_ptr<Envelope> ampEnvelope;
-    std::unique_ptr<Envelope> filterEnvelope;
-    std::unique_ptr<Filter> filter;
-    
-    // Parameters
-    float velocitySensitivity;
-    float filterEnvelopeAmount;
-    
-    // Temp buffer for processing
-    juce::AudioBuffer<float> tempBuffer;
-    
-    // Convert MIDI note to frequency
-    float midiNoteToFrequency(int midiNote, float cents = 0.0f) const;
-    
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthVoice)
-};
-
-/**
- * @class SynthModule
- * @brief Complete polyphonic synthesizer module
- * 
- * The SynthModule class implements a complete polyphonic synthesizer with
- * multiple voices, oscillators, filters, and envelopes.
- */
-class SynthModule {
-public:
-    SynthModule(int numVoices = 8);
-    ~SynthModule();
+    void setVoiceSpecialization(bool enabled);
     
     /**
-     * @brief Process incoming MIDI messages and generate audio
+     * @brief Set the sound generator for all voices
      * 
-     * @param midiMessages MIDI messages to process
-     * @param outputBuffer Buffer to write output to
-     * @param numSamples Number of samples to generate
+     * The plucked string and modal percussion models always use specialized
+     * voices, whether or not voice specialization is enabled, so changing the
+     * model replaces the voices. Call from the message thread.
+     * 
+     * @param model The voice model
      */
-    void processBlock(const juce::MidiBuffer& midiMessages, float* outputBuffer, int numSamples);
+    void setVoiceModel(VoiceModel model);
     
     /**
-     * @brief Process MIDI messages and generate audio for stereo output
+     * @brief Set the physical model parameters for all voices
      * 
-     * @param midiMessages MIDI messages to process
-     * @param leftBuffer Left channel output buffer
-     * @param rightBuffer Right channel output buffer
-     * @param numSamples Number of samples to generate
+     * @param decaySeconds Time for the fundamental to decay by 60 dB
+     * @param brightness Pluck or strike hardness (0 to 1)
+     * @param pluckPosition Pluck point along the string (0 to 0.5, plucked string only)
      */
-    void processStereoBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples);
+    void setPhysicalModelParameters(float decaySeconds, float brightness, float pluckPosition);
     
     /**
-     * @brief Prepare the synthesizer for playback
+     * @brief Set the mode tuning of the modal percussion model
      * 
-     * @param sampleRate The sample rate in Hz
+     * @param body The body whose modes are played
      */
-    void prepare(double sampleRate);
+    void setModalBody(ModalBody body);
     
     /**
      * @brief Set the oscillator waveform for all voices
@@ -225,9 +215,32 @@ public:
      */
     void setOscillatorLevel(int oscillatorIndex, float level);
     
+    /**
+     * @brief Set the unison stack for an oscillator on all voices
+     * 
+     * With more than one unison voice the oscillator is replaced by a bank of
+     * band-limited, detuned copies (sine, triangle, sawtooth, or square).
+     * 
+     * @param oscillatorIndex The oscillator to set (0 or 1)
+     * @param numVoices Number of detuned copies (1 turns unison off, up to 16)
+     * @param detuneCents Distance between the lowest and highest copy in cents
+     */
+    void setOscillatorUnison(int oscillatorIndex, int numVoices, float detuneCents);
+    
+    /**
+     * @brief Set the filter circuit for all voices
+     * 
+     * With voice specialization enabled, changing the model replaces the voices.
+     * 
+     * @param model The filter model
+     */
+    void setFilterModel(FilterModel model);
+    
     /**
      * @brief Set the filter type for all voices
      * 
+     * Applies to the biquad model; the ladder is always a low-pass.
+     * 
      * @param type The filter type
      */
     void setFilterType(FilterType type);
@@ -246,6 +259,20 @@ public:
      */
     void setFilterResonance(float amount);
     
+    /**
+     * @brief Set the ladder filter drive for all voices
+     * 
+     * @param drive Gain into the ladder's saturating feedback loop (1 to 16)
+     */
+    void setFilterDrive(float drive);
+    
+    /**
+     * @brief Enable or disable 2x oversampling of the ladder filter
+     * 
+     * @param enabled Whether the ladder runs at twice the sample rate
+     */
+    void setFilterOversampling(bool enabled);
+    
     /**
      * @brief Set the ADSR envelope parameters for all voices
      * 
@@ -263,12 +290,136 @@ public:
      */
     void setVelocitySensitivity(float sensitivity);
     
+    /**
+     * @brief Set a modulation route for all voices
+     * 
+     * The default route connects the filter envelope to the filter cutoff
+     * in slot 0.
+     * 
+     * @param slot The route slot (0 to ModulationMatrix::maxRoutes - 1)
+     * @param source The modulation source
+     * @param destination The modulation destination
+     * @param amount Destination units per unit of source (semitones for pitch, octaves for cutoff)
+     */
+    void setModulationRoute(int slot, ModulationSource source, ModulationDestination destination, float amount);
+    
+    /**
+     * @brief Set the shape of a shared LFO
+     * 
+     * @param lfoIndex The LFO to set (0 or 1)
+     * @param shape The LFO shape
+     */
+    void setLFOShape(int lfoIndex, LFOShape shape);
+    
+    /**
+     * @brief Set the rate of a shared LFO
+     * 
+     * @param lfoIndex The LFO to set (0 or 1)
+     * @param frequencyHz Rate in Hertz
+     */
+    void setLFORate(int lfoIndex, float frequencyHz);
+    
+    /**
+     * @brief Set how often modulation is evaluated
+     * 
+     * Shorter steps follow fast modulation more closely at a higher CPU cost;
+     * values are interpolated per sample between steps either way.
+     * 
+     * @param intervalSamples Control step length in samples (1 to 512)
+     */
+    void setModulationRate(int intervalSamples);
+    
+    /**
+     * @brief Set the tuning of one or all MIDI channels
+     * 
+     * Takes effect from the next note; notes already playing keep their pitch.
+     * Call from the message thread.
+     * 
+     * @param table The tuning table, or nullptr for 12-tone equal temperament
+     * @param channel MIDI channel (1 to 16), or 0 for all channels
+     */
+    void setTuning(std::shared_ptr<const TuningTable> table, int channel = 0);
+    
 private:
-    std::vector<std::unique_ptr<SynthVoice>> voices;
+    DelayLinePool delayLines; // String memory for physical model voices, one line per voice
+    std::vector<std::unique_ptr<SynthVoiceBase>> voices;
+    VoiceAllocator voiceAllocator;
+    VoiceParameterBlock parameters;
+    TuningSet tuning;
     double currentSampleRate;
-    
-    // Find a free voice or steal one if needed
-    SynthVoice* findFreeVoice(int midiNoteNumber, float velocity) const;
+    int currentBlockSize;
+    
+    // Shared modulation sources, computed once per span for all voices
+    std::array<LFO, 2> lfos;
+    juce::AudioBuffer<float> lfoControlValues; // One channel per LFO, one value per control step
+    SharedModulationValues modulationValues;
+    juce::uint32 appliedLFOVersion;
+    
+    // Parallel rendering state
+    AudioWorkerPool* workerPool;
+    std::atomic<bool> parallelRenderingEnabled;  // Set on the message thread, read per block
+    std::atomic<int> minVoicesPerPartition;
+    std::vector<int> activeVoiceIndices;       // Active voices gathered for the current span
+    juce::AudioBuffer<float> partitionBuffers; // A left and right accumulation buffer per worker
+    
+    // Replacement voices are built on the message thread and handed over under voiceLock,
+    // which the audio thread only try-locks; it swaps each one in when its slot is idle
+    juce::SpinLock voiceLock;
+    bool voiceSpecializationEnabled;
+    int voiceConfiguration;  // SynthVoiceFactory configuration of the newest voices
+    std::vector<std::unique_ptr<SynthVoiceBase>> replacementVoices; // Per slot: waiting to be swapped in, or the voice it replaced
+    std::vector<bool> replacementPending;  // Per slot: replacementVoices holds a voice still to be swapped in
+    int numPendingReplacements;
+    bool replacementsAccessible;  // The audio thread holds voiceLock for the current block
+    
+    // Arguments for a parallel render batch
+    struct RenderTask {
+        SynthModule* module;
+        float* leftBuffer;
+        float* rightBuffer; // nullptr for mono output
+        int numSamples;
+        int numVoices;
+        int numPartitions;
+    };
+    
+    // Process a block into one channel (rightBuffer nullptr) or two
+    void renderBlock(const juce::MidiBuffer& midiMessages, float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    // Apply a single MIDI event
+    void handleMidiEvent(const MidiEvent& event);
+    
+    // Render all active voices into a span of the output
+    void renderVoices(float* leftBuffer, float* rightBuffer, int startSample, int numSamples);
+    
+    // Render the gathered active voices into a span no longer than the block size
+    void renderActiveVoices(float* leftBuffer, float* rightBuffer, int numSamples, int numActiveVoices);
+    
+    // Pull LFO settings from the shared parameter block if its version changed
+    void applyLFOParameters();
+    
+    // Number of partitions to split the given number of active voices into
+    int getNumRenderPartitions(int numActiveVoices) const;
+    
+    // Render the gathered active voices across the worker pool
+    void renderVoicesParallel(float* leftBuffer, float* rightBuffer, int numSamples, int numActiveVoices, int numPartitions);
+    
+    // Worker pool task: render one partition of the active voices
+    static void renderPartition(void* context, int partitionIndex);
+    
+    // Size the per-worker accumulation buffers
+    void updatePartitionBuffers();
+    
+    // Start a note on the voice chosen by the allocator
+    void startVoice(int midiNoteNumber, float velocity, int channel);
+    
+    // Release the voice playing a note
+    void stopVoice(int midiNoteNumber);
+    
+    // Replace the voices if the factory would choose a different type for the current settings
+    void updateVoiceConfiguration();
+    
+    // Swap in the replacement for a slot if one is waiting (audio thread, voiceLock held)
+    void replaceVoice(int voiceIndex);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthModule)
 };
@@ -0,0 +1,417 @@
+/*
+ * Underground Beats
+ * SynthVoiceBase.cpp
+ * 
+ * Implementation of the shared synthesizer voice logic
+ */
+
+#include "SynthVoiceBase.h"
+
+namespace UndergroundBeats {
+
+SynthVoiceBase::SynthVoiceBase()
+    : currentSampleRate(44100.0)
+    , active(false)
+    , currentNote(-1)
+    , currentVelocity(0.0f)
+    , oscillatorLevels({0.5f, 0.5f})
+    , oscillatorDetuneRatios({1.0f, 1.0f})
+    , noteFrequency(440.0f)
+    , filterModel(FilterModel::Biquad)
+    , filterType(FilterType::LowPass)
+    , filterCutoff(1000.0f)
+    , filterResonance(0.5f)
+    , velocitySensitivity(0.7f)
+    , modulationValues(nullptr)
+    , controlInterval(32)
+    , aftertouch(0.0f)
+    , pitchModulated(false)
+    , filterModulated(false)
+    , modulationStarted(false)
+    , currentLevels({0.5f, 0.5f})
+    , currentPitchRatio(1.0f)
+    , currentFilterCutoff(-1.0f)
+    , currentFilterResonance(0.0f)
+    , sharedParameters(nullptr)
+    , appliedParameterVersion(0)
+    , pendingNote(-1)
+    , pendingVelocity(0.0f)
+    , pendingFrequency(440.0f)
+{
+    // Set second oscillator's default detune (5 cents)
+    oscillatorDetuneRatios[1] = TuningTable::centsToRatio(5.0f);
+    
+    // Set default envelope parameters
+    ampEnvelope.setAttackTime(10.0f);
+    ampEnvelope.setDecayTime(100.0f);
+    ampEnvelope.setSustainLevel(0.7f);
+    ampEnvelope.setReleaseTime(200.0f);
+    
+    filterEnvelope.setAttackTime(50.0f);
+    filterEnvelope.setDecayTime(500.0f);
+    filterEnvelope.setSustainLevel(0.5f);
+    filterEnvelope.setReleaseTime(500.0f);
+    
+    // Allocate temp buffers (voice mix, filter envelope, amp envelope, right voice mix)
+    tempBuffer.setSize(4, 512);
+}
+
+SynthVoiceBase::~SynthVoiceBase()
+{
+}
+
+bool SynthVoiceBase::isActive() const
+{
+    return active;
+}
+
+void SynthVoiceBase::noteOn(int midiNoteNumber, float velocity, float frequencyHz)
+{
+    pendingNote = -1;
+    startNote(midiNoteNumber, velocity, frequencyHz);
+}
+
+void SynthVoiceBase::noteOff(bool allowTailOff)
+{
+    // A note still waiting for a steal fade never starts
+    pendingNote = -1;
+    
+    if (allowTailOff)
+    {
+        // Start envelope release phase
+        ampEnvelope.noteOff();
+        filterEnvelope.noteOff();
+    }
+    else
+    {
+        // Stop immediately
+        active = false;
+        ampEnvelope.reset();
+        filterEnvelope.reset();
+        currentNote = -1;
+    }
+}
+
+void SynthVoiceBase::steal(int midiNoteNumber, float velocity, float frequencyHz)
+{
+    if (!active)
+    {
+        noteOn(midiNoteNumber, velocity, frequencyHz);
+        return;
+    }
+    
+    // Fade out the current note; the new one starts when the fade ends
+    ampEnvelope.fastRelease(stealFadeMs);
+    pendingNote = midiNoteNumber;
+    pendingVelocity = velocity;
+    pendingFrequency = frequencyHz;
+}
+
+float SynthVoiceBase::getCurrentLevel() const
+{
+    return active ? ampEnvelope.getCurrentValue() * getVelocityGain() : 0.0f;
+}
+
+int SynthVoiceBase::getCurrentNote() const
+{
+    return currentNote;
+}
+
+void SynthVoiceBase::renderNextBlock(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    if (!active)
+        return;
+    
+    applyParameters();
+    
+    if (pendingNote >= 0 && ampEnvelope.willBeIdleWithin(numSamples))
+    {
+        // Finish the steal fade, then start the pending note at that sample
+        const int fadeSamples = ampEnvelope.getSamplesUntilIdle();
+        renderVoice(leftBuffer, rightBuffer, fadeSamples, 0);
+        
+        startNote(pendingNote, pendingVelocity, pendingFrequency);
+        pendingNote = -1;
+        
+        renderVoice(leftBuffer + fadeSamples, rightBuffer != nullptr ? rightBuffer + fadeSamples : nullptr,
+                    numSamples - fadeSamples, fadeSamples);
+        return;
+    }
+    
+    renderVoice(leftBuffer, rightBuffer, numSamples, 0);
+}
+
+void SynthVoiceBase::setAftertouch(float pressure)
+{
+    aftertouch = juce::jlimit(0.0f, 1.0f, pressure);
+}
+
+void SynthVoiceBase::setModulationValues(const SharedModulationValues* values)
+{
+    modulationValues = values;
+}
+
+void SynthVoiceBase::setParameters(const SharedVoiceParameters* parameters)
+{
+    sharedParameters = parameters;
+    appliedParameterVersion = 0;
+}
+
+void SynthVoiceBase::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    
+    // Prepare all components with the new sample rate
+    ampEnvelope.prepare(sampleRate);
+    filterEnvelope.prepare(sampleRate);
+    filterCutoff = juce::jlimit(20.0f, static_cast<float>(sampleRate) * 0.5f, filterCutoff);
+    prepareComponents(sampleRate);
+}
+
+bool SynthVoiceBase::rendersStereo() const
+{
+    return false;
+}
+
+void SynthVoiceBase::renderStereoStep(float* leftData, float* rightData, int numSamples, const VoiceStep& step)
+{
+    renderStep(leftData, numSamples, step);
+    juce::FloatVectorOperations::copy(rightData, leftData, numSamples);
+}
+
+void SynthVoiceBase::startNote(int midiNoteNumber, float velocity, float frequencyHz)
+{
+    applyParameters();
+    
+    currentNote = midiNoteNumber;
+    currentVelocity = velocity;
+    noteFrequency = frequencyHz;
+    aftertouch = 0.0f;
+    modulationStarted = false;
+    active = true;
+    
+    // Set oscillator frequencies based on the MIDI note, then restart them to avoid clicks
+    setOscillatorFrequencies();
+    resetOscillators();
+    
+    // Trigger envelopes
+    ampEnvelope.noteOn();
+    filterEnvelope.noteOn();
+}
+
+void SynthVoiceBase::renderVoice(float* leftBuffer, float* rightBuffer, int numSamples, int spanOffset)
+{
+    if (!active || numSamples <= 0)
+        return;
+    
+    // Ensure temp buffer is large enough
+    if (tempBuffer.getNumSamples() < numSamples)
+    {
+        tempBuffer.setSize(4, numSamples, false, true, true);
+    }
+    
+    // Stop rendering as soon as the amplitude envelope has finished its release
+    if (ampEnvelope.willBeIdleWithin(numSamples))
+    {
+        numSamples = ampEnvelope.getSamplesUntilIdle();
+    }
+    
+    float* voiceData = tempBuffer.getWritePointer(0);
+    float* ampEnvelopeData = tempBuffer.getWritePointer(2);
+    float* rightVoiceData = tempBuffer.getWritePointer(3);
+    
+    // Voices that sound the same in both channels are rendered once
+    const bool stereo = rightBuffer != nullptr && rendersStereo();
+    
+    // Envelopes do not depend on modulation, so render them for the whole span first
+    filterEnvelope.process(tempBuffer.getWritePointer(1), numSamples);
+    ampEnvelope.process(ampEnvelopeData, numSamples);
+    
+    // Steps end on the module's control grid, so every voice samples the shared
+    // LFO values at the points they were computed for
+    int position = 0;
+    while (position < numSamples)
+    {
+        const int gridPosition = spanOffset + position;
+        const int stepEnd = juce::jmin(numSamples, (gridPosition / controlInterval + 1) * controlInterval - spanOffset);
+        
+        renderControlStep(position, stepEnd - position, gridPosition / controlInterval, stereo);
+        position = stepEnd;
+    }
+    
+    // Apply amplitude envelope
+    juce::FloatVectorOperations::multiply(voiceData, ampEnvelopeData, numSamples);
+    
+    if (stereo)
+    {
+        juce::FloatVectorOperations::multiply(rightVoiceData, ampEnvelopeData, numSamples);
+    }
+    
+    // Mix the voice into the output buffers with velocity sensitivity applied
+    const float gain = getVelocityGain();
+    juce::FloatVectorOperations::addWithMultiply(leftBuffer, voiceData, gain, numSamples);
+    
+    if (rightBuffer != nullptr)
+    {
+        juce::FloatVectorOperations::addWithMultiply(rightBuffer, stereo ? rightVoiceData : voiceData, gain, numSamples);
+    }
+    
+    // Check if voice is still active after processing
+    if (!ampEnvelope.isActive())
+    {
+        active = false;
+        currentNote = -1;
+    }
+}
+
+void SynthVoiceBase::renderControlStep(int start, int numSamples, int controlIndex, bool stereo)
+{
+    const int last = start + numSamples - 1;
+    
+    // Snapshot the sources at the end of the step
+    std::array<float, ModulationMatrix::numSources> sources {};
+    sources[static_cast<size_t>(ModulationSource::AmpEnvelope)] = tempBuffer.getSample(2, last);
+    sources[static_cast<size_t>(ModulationSource::FilterEnvelope)] = tempBuffer.getSample(1, last);
+    sources[static_cast<size_t>(ModulationSource::Velocity)] = currentVelocity;
+    sources[static_cast<size_t>(ModulationSource::Aftertouch)] = aftertouch;
+    
+    if (modulationValues != nullptr)
+    {
+        sources[static_cast<size_t>(ModulationSource::LFO1)] = modulationValues->lfoValues[0][controlIndex];
+        sources[static_cast<size_t>(ModulationSource::LFO2)] = modulationValues->lfoValues[1][controlIndex];
+        sources[static_cast<size_t>(ModulationSource::Aftertouch)] = juce::jmax(aftertouch, modulationValues->channelAftertouch);
+    }
+    
+    std::array<float, ModulationMatrix::numDestinations> destinations;
+    modulation.evaluate(sources.data(), destinations.data());
+    
+    // Oscillator levels and pitch ramp linearly to their targets for this step
+    VoiceStep step;
+    
+    const float targetPitchRatio = pitchModulated
+                                   ? TuningTable::semitonesToRatio(destinations[static_cast<size_t>(ModulationDestination::Pitch)])
+                                   : 1.0f;
+    
+    step.startPitchRatio = modulationStarted ? currentPitchRatio : targetPitchRatio;
+    step.endPitchRatio = targetPitchRatio;
+    currentPitchRatio = targetPitchRatio;
+    
+    for (size_t i = 0; i < oscillatorLevels.size(); ++i)
+    {
+        const size_t levelDestination = static_cast<size_t>(ModulationDestination::Oscillator1Level) + i;
+        const float targetLevel = juce::jlimit(0.0f, 1.0f, oscillatorLevels[i] + destinations[levelDestination]);
+        
+        step.startLevels[i] = modulationStarted ? currentLevels[i] : targetLevel;
+        step.endLevels[i] = targetLevel;
+        currentLevels[i] = targetLevel;
+    }
+    
+    // Filter settings are calculated once per step and interpolated per sample
+    FilterTarget filterTarget;
+    step.filterTarget = nullptr;
+    
+    if (filterModulated)
+    {
+        const float cutoff = filterCutoff * std::exp2(destinations[static_cast<size_t>(ModulationDestination::FilterCutoff)]);
+        const float resonance = filterResonance + destinations[static_cast<size_t>(ModulationDestination::FilterResonance)];
+        
+        // A held envelope or a still LFO leaves the filter where the last step moved it
+        if (!modulationStarted || cutoff != currentFilterCutoff || resonance != currentFilterResonance)
+        {
+            currentFilterCutoff = cutoff;
+            currentFilterResonance = resonance;
+            filterTarget.cutoff = cutoff;
+            filterTarget.resonance = resonance;
+            
+            if (filterModel == FilterModel::Biquad)
+            {
+                filterTarget.coefficients = Filter::calculateCoefficients(filterType, cutoff, resonance,
+                                                                          0.0f, currentSampleRate);
+            }
+            
+            if (!modulationStarted)
+            {
+                setFilterTarget(filterTarget);
+            }
+            
+            step.filterTarget = &filterTarget;
+        }
+    }
+    
+    if (stereo)
+    {
+        renderStereoStep(tempBuffer.getWritePointer(0) + start, tempBuffer.getWritePointer(3) + start, numSamples, step);
+    }
+    else
+    {
+        renderStep(tempBuffer.getWritePointer(0) + start, numSamples, step);
+    }
+    
+    modulationStarted = true;
+}
+
+void SynthVoiceBase::applyParameters()
+{
+    if (sharedParameters == nullptr || sharedParameters->version == appliedParameterVersion)
+        return;
+    
+    const SharedVoiceParameters& parameters = *sharedParameters;
+    appliedParameterVersion = parameters.version;
+    
+    for (size_t i = 0; i < oscillatorLevels.size(); ++i)
+    {
+        oscillatorLevels[i] = juce::jlimit(0.0f, 1.0f, parameters.values.oscillatorLevels[i]);
+        oscillatorDetuneRatios[i] = parameters.oscillatorDetuneRatios[i];
+    }
+    
+    applyComponentParameters(parameters);
+    
+    // If the voice is active, update the frequencies
+    if (active)
+    {
+        setOscillatorFrequencies();
+    }
+    
+    // Sample counts and filter coefficients were computed once for all voices
+    ampEnvelope.setSettings(parameters.ampEnvelope);
+    
+    modulation = parameters.values.modulation;
+    controlInterval = juce::jlimit(1, 512, parameters.values.modulationInterval);
+    pitchModulated = modulation.isDestinationModulated(ModulationDestination::Pitch);
+    filterModulated = modulation.isDestinationModulated(ModulationDestination::FilterCutoff)
+                      || modulation.isDestinationModulated(ModulationDestination::FilterResonance);
+    
+    filterModel = parameters.values.filterModel;
+    filterType = parameters.values.filterType;
+    filterCutoff = juce::jlimit(20.0f, static_cast<float>(currentSampleRate) * 0.5f, parameters.values.filterCutoff);
+    
+    // The ladder is allowed to self-oscillate
+    filterResonance = juce::jlimit(0.0f, filterModel == FilterModel::Ladder ? 1.0f : 0.99f, parameters.values.filterResonance);
+    
+    // A modulated filter keeps its current settings and ramps from them at the next step
+    if (!(active && filterModulated))
+    {
+        setFilterTarget({ parameters.filterCoefficients, filterCutoff, filterResonance });
+    }
+    
+    // New base settings reach a modulated filter at the next step even while the modulation holds still
+    currentFilterCutoff = -1.0f;
+    
+    velocitySensitivity = juce::jlimit(0.0f, 1.0f, parameters.values.velocitySensitivity);
+}
+
+void SynthVoiceBase::setOscillatorFrequencies()
+{
+    for (size_t i = 0; i < oscillatorDetuneRatios.size(); ++i)
+    {
+        setOscillatorFrequency(static_cast<int>(i), noteFrequency * oscillatorDetuneRatios[i]);
+    }
+}
+
+float SynthVoiceBase::getVelocityGain() const
+{
+    // Mix of velocity sensitivity and full volume
+    return velocitySensitivity * currentVelocity + (1.0f - velocitySensitivity);
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,260 @@
+/*
+ * Underground Beats
+ * SynthVoiceBase.h
+ * 
+ * Note handling, envelopes, and modulation shared by all synthesizer voices
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Envelope.h"
+#include "Filter.h"
+#include "VoiceParameters.h"
+#include "ModulationMatrix.h"
+#include "Tuning.h"
+#include <array>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Filter settings for a voice
+ * 
+ * The biquad model uses the coefficients, the ladder model the cutoff and
+ * resonance; the coefficients are only calculated for the biquad model.
+ */
+struct FilterTarget {
+    FilterCoefficients coefficients;
+    float cutoff;
+    float resonance;
+};
+
+/**
+ * @brief Targets for one control step of a voice
+ * 
+ * Oscillator levels move linearly from the start to the end levels over the
+ * step, and so does the pitch ratio, which scales the frequencies set with
+ * setOscillatorFrequency(). The filter moves to filterTarget over the step
+ * when it is modulated.
+ */
+struct VoiceStep {
+    std::array<float, 2> startLevels;
+    std::array<float, 2> endLevels;
+    float startPitchRatio;
+    float endPitchRatio;
+    const FilterTarget* filterTarget; // nullptr to keep the current filter settings
+};
+
+/**
+ * @class SynthVoiceBase
+ * @brief A single voice for polyphonic synthesis
+ * 
+ * Handles everything a voice does apart from generating and filtering its
+ * signal: starting, stopping and stealing notes, the amplitude and filter
+ * envelopes, shared parameters, and the modulation matrix.
+ * 
+ * Modulation is applied at control rate: every control step the voice takes a
+ * snapshot of its sources, evaluates the modulation matrix once, and passes
+ * the resulting oscillator levels, pitch, and filter settings to renderStep(),
+ * which ramps towards them per sample.
+ * 
+ * Subclasses provide the two oscillators and the filter. SynthVoice builds
+ * them from runtime objects and supports every setting; SynthVoiceT stores
+ * fixed component types inline so the compiler can inline the whole step.
+ */
+class SynthVoiceBase {
+public:
+    SynthVoiceBase();
+    virtual ~SynthVoiceBase();
+    
+    /**
+     * @brief Check if the voice is currently active
+     * 
+     * @return true if the voice is playing a note
+     */
+    bool isActive() const;
+    
+    /**
+     * @brief Start playing a note with this voice
+     * 
+     * @param midiNoteNumber The MIDI note number to play
+     * @param velocity The velocity of the note (0 to 1)
+     * @param frequencyHz Frequency of the note, from the module's tuning table
+     */
+    void noteOn(int midiNoteNumber, float velocity, float frequencyHz);
+    
+    /**
+     * @brief Stop playing the current note
+     * 
+     * @param allowTailOff Whether to allow envelope release phase
+     */
+    void noteOff(bool allowTailOff = true);
+    
+    /**
+     * @brief Take over this voice for a new note
+     * 
+     * The current note is faded out with a short release to avoid a click,
+     * and the new note starts at the sample where the fade ends.
+     * 
+     * @param midiNoteNumber The MIDI note number to play
+     * @param velocity The velocity of the note (0 to 1)
+     * @param frequencyHz Frequency of the note, from the module's tuning table
+     */
+    void steal(int midiNoteNumber, float velocity, float frequencyHz);
+    
+    /**
+     * @brief Get the current output level of the voice
+     * 
+     * @return The amplitude envelope level scaled by velocity (0 to 1)
+     */
+    float getCurrentLevel() const;
+    
+    /**
+     * @brief Get the current MIDI note number
+     * 
+     * @return The MIDI note number currently playing, or -1 if not active
+     */
+    int getCurrentNote() const;
+    
+    /**
+     * @brief Render audio for this voice
+     * 
+     * Voices that render in stereo (see rendersStereo()) add separate left and
+     * right signals; every other voice adds the same signal to both channels.
+     * 
+     * @param leftBuffer Buffer to add the left channel (or the mono output) to
+     * @param rightBuffer Buffer to add the right channel to, or nullptr for mono output
+     * @param numSamples Number of samples to generate
+     */
+    void renderNextBlock(float* leftBuffer, float* rightBuffer, int numSamples);
+    
+    /**
+     * @brief Set the polyphonic aftertouch for the current note
+     * 
+     * @param pressure Aftertouch amount (0 to 1)
+     */
+    void setAftertouch(float pressure);
+    
+    /**
+     * @brief Set the modulation values shared by all voices of the module
+     * 
+     * @param values Values for the span being rendered, or nullptr for none
+     */
+    void setModulationValues(const SharedModulationValues* values);
+    
+    /**
+     * @brief Set the parameter block this voice reads its settings from
+     * 
+     * The voice applies new values lazily at the start of its next block
+     * (or note), and only when the block's version has changed.
+     * 
+     * @param parameters The shared parameters, or nullptr to keep the current settings
+     */
+    void setParameters(const SharedVoiceParameters* parameters);
+    
+    /**
+     * @brief Prepare the voice for playback
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void prepare(double sampleRate);
+    
+protected:
+    double currentSampleRate;
+    
+    // Prepare the oscillators and filter for a sample rate
+    virtual void prepareComponents(double sampleRate) = 0;
+    
+    // Apply the oscillator and filter settings that are not fixed by the voice type
+    virtual void applyComponentParameters(const SharedVoiceParameters& parameters) = 0;
+    
+    // Restart the oscillators for a new note
+    virtual void resetOscillators() = 0;
+    
+    // Set the unmodulated frequency of one oscillator
+    virtual void setOscillatorFrequency(int oscillatorIndex, float frequencyHz) = 0;
+    
+    // Replace the filter settings without ramping
+    virtual void setFilterTarget(const FilterTarget& target) = 0;
+    
+    // Write the mixed and filtered oscillators for one control step
+    virtual void renderStep(float* voiceData, int numSamples, const VoiceStep& step) = 0;
+    
+    // Whether the current settings give the two channels different signals
+    virtual bool rendersStereo() const;
+    
+    // Write one control step in stereo (only called while rendersStereo() is true)
+    virtual void renderStereoStep(float* leftData, float* rightData, int numSamples, const VoiceStep& step);
+    
+private:
+    // Voice state
+    bool active;
+    int currentNote;
+    float currentVelocity;
+    
+    std::array<float, 2> oscillatorLevels;
+    std::array<float, 2> oscillatorDetuneRatios;
+    float noteFrequency;
+    
+    Envelope ampEnvelope;
+    Envelope filterEnvelope;
+    
+    // Base filter settings that modulation is applied to
+    FilterModel filterModel;
+    FilterType filterType;
+    float filterCutoff;
+    float filterResonance;
+    
+    // Parameters
+    float velocitySensitivity;
+    
+    // Modulation routing and per-voice state
+    ModulationMatrix modulation;
+    const SharedModulationValues* modulationValues;
+    int controlInterval;
+    float aftertouch;
+    bool pitchModulated;
+    bool filterModulated;
+    bool modulationStarted;                // False until the first step of a note sets the initial values
+    std::array<float, 2> currentLevels;    // Oscillator levels reached at the end of the last step
+    float currentPitchRatio;               // Pitch ratio reached at the end of the last step
+    float currentFilterCutoff;             // Modulated cutoff the filter was last moved to (-1 if stale)
+    float currentFilterResonance;          // Modulated resonance the filter was last moved to
+    
+    // Shared parameter block and the version last applied from it
+    const SharedVoiceParameters* sharedParameters;
+    juce::uint32 appliedParameterVersion;
+    
+    // Note waiting for a steal fade-out to finish (-1 if none)
+    int pendingNote;
+    float pendingVelocity;
+    float pendingFrequency;
+    
+    // Temp buffer for processing (voice mix, filter envelope, amp envelope, right voice mix)
+    juce::AudioBuffer<float> tempBuffer;
+    
+    // Fade-out time used when the voice is stolen
+    static constexpr float stealFadeMs = 5.0f;
+    
+    // Start a note immediately
+    void startNote(int midiNoteNumber, float velocity, float frequencyHz);
+    
+    // Render a span of samples for the current note, starting spanOffset samples into the module's span
+    void renderVoice(float* leftBuffer, float* rightBuffer, int numSamples, int spanOffset);
+    
+    // Render one control step into the voice buffers (envelopes must already be rendered)
+    void renderControlStep(int start, int numSamples, int controlIndex, bool stereo);
+    
+    // Pull new values from the shared parameter block if its version changed
+    void applyParameters();
+    
+    // Set both oscillators to the note frequency times their detune
+    void setOscillatorFrequencies();
+    
+    // Get the output gain for the current velocity
+    float getVelocityGain() const;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthVoiceBase)
+};
+
+} // namespace UndergroundBeats
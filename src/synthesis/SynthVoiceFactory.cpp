@@ -0,0 +1,135 @@
+/*
+ * Underground Beats
+ * SynthVoiceFactory.cpp
+ * 
+ * Implementation of the synthesizer voice factory
+ */
+
+#include "SynthVoiceFactory.h"
+#include "SynthVoiceT.h"
+#include "PhysicalModelVoice.h"
+#include "SynthModule.h"
+
+namespace UndergroundBeats {
+
+namespace {
+
+constexpr int numShapes = 4;
+constexpr int numConfigurationsPerFilter = numShapes * numShapes;
+
+// Physical model configurations follow the oscillator ones, two filters per model
+constexpr int firstPhysicalConfiguration = 2 * numConfigurationsPerFilter;
+constexpr int numPhysicalConfigurations = 4;
+
+// Index of a waveform with a FixedOscillator, or -1
+int getShapeIndex(WaveformType waveform)
+{
+    switch (waveform)
+    {
+        case WaveformType::Sine:
+            return 0;
+        case WaveformType::Triangle:
+            return 1;
+        case WaveformType::Sawtooth:
+            return 2;
+        case WaveformType::Square:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+template <typename OscA, typename VoiceFilter>
+std::unique_ptr<SynthVoiceBase> createWithFirstOscillator(int shapeB)
+{
+    switch (shapeB)
+    {
+        case 0:
+            return std::make_unique<SynthVoiceT<OscA, SineOscillator, VoiceFilter>>();
+        case 1:
+            return std::make_unique<SynthVoiceT<OscA, TriangleOscillator, VoiceFilter>>();
+        case 2:
+            return std::make_unique<SynthVoiceT<OscA, SawtoothOscillator, VoiceFilter>>();
+        default:
+            return std::make_unique<SynthVoiceT<OscA, SquareOscillator, VoiceFilter>>();
+    }
+}
+
+template <typename VoiceFilter>
+std::unique_ptr<SynthVoiceBase> createWithFilter(int shapeA, int shapeB)
+{
+    switch (shapeA)
+    {
+        case 0:
+            return createWithFirstOscillator<SineOscillator, VoiceFilter>(shapeB);
+        case 1:
+            return createWithFirstOscillator<TriangleOscillator, VoiceFilter>(shapeB);
+        case 2:
+            return createWithFirstOscillator<SawtoothOscillator, VoiceFilter>(shapeB);
+        default:
+            return createWithFirstOscillator<SquareOscillator, VoiceFilter>(shapeB);
+    }
+}
+
+template <typename VoiceFilter>
+std::unique_ptr<SynthVoiceBase> createPhysicalModel(int modelIndex, DelayLinePool& delayLines, int voiceIndex)
+{
+    if (modelIndex == 0)
+        return std::make_unique<PhysicalModelVoice<KarplusStrongString, VoiceFilter>>(delayLines, voiceIndex);
+    
+    return std::make_unique<PhysicalModelVoice<ModalBank, VoiceFilter>>();
+}
+
+} // namespace
+
+int SynthVoiceFactory::getConfiguration(const VoiceParameters& parameters)
+{
+    const int filterIndex = parameters.filterModel == FilterModel::Ladder ? 1 : 0;
+    
+    // Physical models only exist as specialized voices
+    if (parameters.voiceModel != VoiceModel::Subtractive)
+    {
+        const int modelIndex = parameters.voiceModel == VoiceModel::PluckedString ? 0 : 1;
+        return firstPhysicalConfiguration + modelIndex * 2 + filterIndex;
+    }
+    
+    const int shapeA = getShapeIndex(parameters.oscillatorWaveforms[0]);
+    const int shapeB = getShapeIndex(parameters.oscillatorWaveforms[1]);
+    
+    if (shapeA < 0 || shapeB < 0 || parameters.oscillatorUnisonVoices[0] > 1 || parameters.oscillatorUnisonVoices[1] > 1)
+        return runtimeConfiguration;
+    
+    return filterIndex * numConfigurationsPerFilter + shapeA * numShapes + shapeB;
+}
+
+bool SynthVoiceFactory::isPhysicalModel(int configuration)
+{
+    return configuration >= firstPhysicalConfiguration
+           && configuration < firstPhysicalConfiguration + numPhysicalConfigurations;
+}
+
+std::unique_ptr<SynthVoiceBase> SynthVoiceFactory::create(int configuration, DelayLinePool& delayLines, int voiceIndex)
+{
+    if (isPhysicalModel(configuration))
+    {
+        const int modelIndex = (configuration - firstPhysicalConfiguration) / 2;
+        
+        if ((configuration - firstPhysicalConfiguration) % 2 == 1)
+            return createPhysicalModel<LadderFilterModel>(modelIndex, delayLines, voiceIndex);
+        
+        return createPhysicalModel<BiquadFilterModel>(modelIndex, delayLines, voiceIndex);
+    }
+    
+    if (configuration < 0 || configuration >= 2 * numConfigurationsPerFilter)
+        return std::make_unique<SynthVoice>();
+    
+    const int shapeA = (configuration % numConfigurationsPerFilter) / numShapes;
+    const int shapeB = configuration % numShapes;
+    
+    if (configuration >= numConfigurationsPerFilter)
+        return createWithFilter<LadderFilterModel>(shapeA, shapeB);
+    
+    return createWithFilter<BiquadFilterModel>(shapeA, shapeB);
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,68 @@
+/*
+ * Underground Beats
+ * SynthVoiceFactory.h
+ * 
+ * Creates the synthesizer voice type that matches a set of voice parameters
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SynthVoiceBase.h"
+#include "VoiceParameters.h"
+#include "PhysicalModels.h"
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @class SynthVoiceFactory
+ * @brief Chooses between specialized and runtime synthesizer voices
+ * 
+ * Every pairing of the sine, triangle, sawtooth, and square waveforms is
+ * instantiated as a SynthVoiceT with a BiquadFilterModel and with a
+ * LadderFilterModel, which covers the subtractive patches the synthesizer is
+ * normally used for. Anything else
+ * (unison stacks, noise, or wavetable oscillators) gets the runtime SynthVoice.
+ * 
+ * The physical models are always specialized: each resonator is instantiated
+ * as a PhysicalModelVoice with both filters, and has no runtime equivalent.
+ */
+class SynthVoiceFactory {
+public:
+    /** Configuration served by the runtime SynthVoice */
+    static constexpr int runtimeConfiguration = -1;
+    
+    /**
+     * @brief Get the voice configuration for a set of parameters
+     * 
+     * Voices of the same configuration are interchangeable, so a module only
+     * needs to replace its voices when the configuration changes.
+     * 
+     * @param parameters The voice parameters
+     * @return A specialized configuration, or runtimeConfiguration
+     */
+    static int getConfiguration(const VoiceParameters& parameters);
+    
+    /**
+     * @brief Check whether a configuration is a physical model voice
+     * 
+     * @param configuration A value returned by getConfiguration
+     * @return true for a plucked string or modal percussion configuration
+     */
+    static bool isPhysicalModel(int configuration);
+    
+    /**
+     * @brief Create a voice for a configuration
+     * 
+     * Allocates, so never call this from the audio thread.
+     * 
+     * @param configuration A value returned by getConfiguration
+     * @param delayLines Delay memory shared by the module's voices
+     * @param voiceIndex Index of the voice in its module, which picks its delay line
+     * @return The new voice
+     */
+    static std::unique_ptr<SynthVoiceBase> create(int configuration, DelayLinePool& delayLines, int voiceIndex);
+};
+
+} // namespace UndergroundBeats
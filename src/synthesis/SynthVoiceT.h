@@ -0,0 +1,316 @@
+/*
+ * Underground Beats
+ * SynthVoiceT.h
+ * 
+ * Synthesizer voice specialized at compile time for fixed oscillator and filter types
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SynthVoiceBase.h"
+#include "LadderFilter.h"
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Waveform shapes for FixedOscillator, matching the Oscillator waveforms
+ * 
+ * Each shape maps a phase in cycles (0 to 1) to a sample (-1 to 1).
+ */
+struct SineShape {
+    static float evaluate(float phase) { return std::sin(phase * juce::MathConstants<float>::twoPi); }
+};
+
+struct TriangleShape {
+    static float evaluate(float phase) { return 1.0f - 2.0f * std::abs(2.0f * phase - 1.0f); }
+};
+
+struct SawtoothShape {
+    static float evaluate(float phase) { return 2.0f * phase - 1.0f; }
+};
+
+struct SquareShape {
+    static float evaluate(float phase) { return phase < 0.5f ? 1.0f : -1.0f; }
+};
+
+/**
+ * @class FixedOscillator
+ * @brief Oscillator with its waveform fixed at compile time
+ * 
+ * Samples are computed from the phase at the start of the block plus the
+ * sample index, so a loop reading them has no dependency between iterations
+ * and no branch on the waveform. The frequency can be scaled by a ratio that
+ * ramps linearly across the block; the phase is then a quadratic in the
+ * sample index, which keeps the same form.
+ */
+template <typename Shape>
+class FixedOscillator {
+public:
+    void prepare(double sampleRate)
+    {
+        currentSampleRate = sampleRate;
+        phaseIncrement = frequency / static_cast<float>(currentSampleRate);
+    }
+    
+    void setFrequency(float frequencyHz)
+    {
+        frequency = frequencyHz;
+        phaseIncrement = frequency / static_cast<float>(currentSampleRate);
+    }
+    
+    void reset()
+    {
+        phase = 0.0f;
+    }
+    
+    // Sample at an offset from the current phase, with the frequency ratio
+    // starting at startRatio and growing by ratioStep every sample
+    float getSample(int offset, float startRatio, float ratioStep) const
+    {
+        float position = phase + getPhaseAdvance(offset, startRatio, ratioStep);
+        position -= static_cast<float>(static_cast<int>(position));
+        return Shape::evaluate(position);
+    }
+    
+    // Move the phase on by a number of samples, ramping the ratio as getSample() does
+    void advance(int numSamples, float startRatio, float ratioStep)
+    {
+        phase += getPhaseAdvance(numSamples, startRatio, ratioStep);
+        phase -= static_cast<float>(static_cast<int>(phase));
+    }
+    
+private:
+    float phase = 0.0f;
+    float phaseIncrement = 0.0f;
+    float frequency = 440.0f;
+    double currentSampleRate = 44100.0;
+    
+    // Cycles covered by the first numSamples increments, each reaching its ratio before it is applied
+    float getPhaseAdvance(int numSamples, float startRatio, float ratioStep) const
+    {
+        const float n = static_cast<float>(numSamples);
+        return phaseIncrement * (n * startRatio + ratioStep * n * (n + 1.0f) * 0.5f);
+    }
+};
+
+using SineOscillator = FixedOscillator<SineShape>;
+using TriangleOscillator = FixedOscillator<TriangleShape>;
+using SawtoothOscillator = FixedOscillator<SawtoothShape>;
+using SquareOscillator = FixedOscillator<SquareShape>;
+
+/**
+ * @class BiquadFilterModel
+ * @brief Inline biquad driven by precomputed coefficients
+ * 
+ * Produces the same output as Filter for the same coefficients, for every
+ * filter type, without a call per buffer.
+ */
+class BiquadFilterModel {
+public:
+    void prepare(double /*sampleRate*/)
+    {
+        reset();
+    }
+    
+    void reset()
+    {
+        z1 = z2 = 0.0f;
+    }
+    
+    void setParameters(const SharedVoiceParameters& /*parameters*/)
+    {
+    }
+    
+    void setTarget(const FilterTarget& target)
+    {
+        coefficients = target.coefficients;
+    }
+    
+    void process(float* buffer, int numSamples)
+    {
+        const FilterCoefficients c = coefficients;
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float input = buffer[i];
+            const float output = c.a0 * input + z1;
+            z1 = c.a1 * input - c.b1 * output + z2;
+            z2 = c.a2 * input - c.b2 * output;
+            buffer[i] = output;
+        }
+    }
+    
+    void processRamped(float* buffer, int numSamples, const FilterTarget& filterTarget)
+    {
+        if (numSamples <= 0)
+            return;
+        
+        const FilterCoefficients& target = filterTarget.coefficients;
+        const float scale = 1.0f / static_cast<float>(numSamples);
+        const float da0 = (target.a0 - coefficients.a0) * scale;
+        const float da1 = (target.a1 - coefficients.a1) * scale;
+        const float da2 = (target.a2 - coefficients.a2) * scale;
+        const float db1 = (target.b1 - coefficients.b1) * scale;
+        const float db2 = (target.b2 - coefficients.b2) * scale;
+        FilterCoefficients c = coefficients;
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            c.a0 += da0;
+            c.a1 += da1;
+            c.a2 += da2;
+            c.b1 += db1;
+            c.b2 += db2;
+            
+            const float input = buffer[i];
+            const float output = c.a0 * input + z1;
+            z1 = c.a1 * input - c.b1 * output + z2;
+            z2 = c.a2 * input - c.b2 * output;
+            buffer[i] = output;
+        }
+        
+        // Land exactly on the target to avoid accumulated drift
+        coefficients = target;
+    }
+    
+private:
+    FilterCoefficients coefficients = Filter::calculateCoefficients(FilterType::LowPass, 1000.0f, 0.5f, 0.0f, 44100.0);
+    float z1 = 0.0f;
+    float z2 = 0.0f;
+};
+
+/**
+ * @class LadderFilterModel
+ * @brief LadderFilter driven by cutoff and resonance targets
+ */
+class LadderFilterModel {
+public:
+    void prepare(double sampleRate)
+    {
+        filter.prepare(sampleRate);
+    }
+    
+    void reset()
+    {
+        filter.reset();
+    }
+    
+    void setParameters(const SharedVoiceParameters& parameters)
+    {
+        filter.setDrive(parameters.values.filterDrive);
+        filter.setOversampling(parameters.values.filterOversampling);
+    }
+    
+    void setTarget(const FilterTarget& target)
+    {
+        filter.setCutoff(target.cutoff);
+        filter.setResonance(target.resonance);
+    }
+    
+    void process(float* buffer, int numSamples)
+    {
+        filter.process(buffer, numSamples);
+    }
+    
+    void processRamped(float* buffer, int numSamples, const FilterTarget& target)
+    {
+        filter.processRamped(buffer, numSamples, target.cutoff, target.resonance);
+    }
+    
+private:
+    LadderFilter filter;
+};
+
+/**
+ * @class SynthVoiceT
+ * @brief Synthesizer voice with its oscillator and filter types fixed at compile time
+ * 
+ * The oscillators and filter are stored inline rather than behind pointers,
+ * and a control step is a single loop that generates both oscillators and
+ * mixes them, followed by the filter, all visible to the compiler. This avoids
+ * the per-sample waveform switch of the runtime SynthVoice.
+ * 
+ * The oscillator waveforms and filter model set in the shared parameters are
+ * ignored; use SynthVoiceFactory to create the voice type that matches them. Unison,
+ * noise, and wavetable oscillators need the runtime SynthVoice.
+ * 
+ * @tparam OscA Type of the first oscillator (a FixedOscillator)
+ * @tparam OscB Type of the second oscillator (a FixedOscillator)
+ * @tparam VoiceFilter Type of the filter (BiquadFilterModel or LadderFilterModel)
+ */
+template <typename OscA, typename OscB, typename VoiceFilter>
+class SynthVoiceT : public SynthVoiceBase {
+public:
+    SynthVoiceT() {}
+    ~SynthVoiceT() override {}
+    
+protected:
+    void prepareComponents(double sampleRate) override
+    {
+        oscillatorA.prepare(sampleRate);
+        oscillatorB.prepare(sampleRate);
+        filter.prepare(sampleRate);
+    }
+    
+    void applyComponentParameters(const SharedVoiceParameters& parameters) override
+    {
+        // Waveforms and the filter model are part of the type
+        filter.setParameters(parameters);
+    }
+    
+    void resetOscillators() override
+    {
+        oscillatorA.reset();
+        oscillatorB.reset();
+    }
+    
+    void setOscillatorFrequency(int oscillatorIndex, float frequencyHz) override
+    {
+        if (oscillatorIndex == 0)
+            oscillatorA.setFrequency(frequencyHz);
+        else
+            oscillatorB.setFrequency(frequencyHz);
+    }
+    
+    void setFilterTarget(const FilterTarget& target) override
+    {
+        filter.setTarget(target);
+    }
+    
+    void renderStep(float* voiceData, int numSamples, const VoiceStep& step) override
+    {
+        // Levels and pitch reach their targets on the last sample of the step
+        const float scale = 1.0f / static_cast<float>(numSamples);
+        const float levelA = step.startLevels[0];
+        const float levelB = step.startLevels[1];
+        const float levelStepA = (step.endLevels[0] - levelA) * scale;
+        const float levelStepB = (step.endLevels[1] - levelB) * scale;
+        const float pitchRatio = step.startPitchRatio;
+        const float pitchStep = (step.endPitchRatio - pitchRatio) * scale;
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float position = static_cast<float>(i + 1);
+            voiceData[i] = oscillatorA.getSample(i, pitchRatio, pitchStep) * (levelA + position * levelStepA)
+                           + oscillatorB.getSample(i, pitchRatio, pitchStep) * (levelB + position * levelStepB);
+        }
+        
+        oscillatorA.advance(numSamples, pitchRatio, pitchStep);
+        oscillatorB.advance(numSamples, pitchRatio, pitchStep);
+        
+        if (step.filterTarget != nullptr)
+            filter.processRamped(voiceData, numSamples, *step.filterTarget);
+        else
+            filter.process(voiceData, numSamples);
+    }
+    
+private:
+    OscA oscillatorA;
+    OscB oscillatorB;
+    VoiceFilter filter;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthVoiceT)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,346 @@
+/*
+ * Underground Beats
+ * Tuning.cpp
+ * 
+ * Implementation of tuning tables and per-channel tunings
+ */
+
+#include "Tuning.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace UndergroundBeats {
+
+namespace {
+
+// Frequency ratios for 0 to 1200 cents in one-cent steps
+std::array<float, 1201> createCentRatios()
+{
+    std::array<float, 1201> ratios;
+    
+    for (size_t i = 0; i < ratios.size(); ++i)
+    {
+        ratios[i] = static_cast<float>(std::pow(2.0, static_cast<double>(i) / 1200.0));
+    }
+    
+    return ratios;
+}
+
+const std::array<float, 1201> centRatios = createCentRatios();
+
+// Lines of a Scala file with comments and blank lines removed
+juce::StringArray getScalaLines(const juce::String& text)
+{
+    juce::StringArray lines;
+    
+    for (const auto& line : juce::StringArray::fromLines(text))
+    {
+        if (!line.startsWithChar('!'))
+            lines.add(line);
+    }
+    
+    return lines;
+}
+
+// First whitespace-separated token of a line
+juce::String getFirstToken(const juce::String& line)
+{
+    return line.trim().upToFirstOccurrenceOf(" ", false, false).upToFirstOccurrenceOf("\t", false, false);
+}
+
+// Parse a scale degree, given in cents if it contains a period or as a ratio otherwise
+bool parsePitch(const juce::String& line, double& cents)
+{
+    const juce::String token = getFirstToken(line);
+    
+    if (token.isEmpty())
+        return false;
+    
+    if (token.containsChar('.'))
+    {
+        cents = token.getDoubleValue();
+        return true;
+    }
+    
+    const double numerator = token.upToFirstOccurrenceOf("/", false, false).getDoubleValue();
+    const double denominator = token.containsChar('/') ? token.fromFirstOccurrenceOf("/", false, false).getDoubleValue() : 1.0;
+    
+    if (numerator <= 0.0 || denominator <= 0.0)
+        return false;
+    
+    cents = 1200.0 * std::log2(numerator / denominator);
+    return true;
+}
+
+// Settings of a Scala keyboard mapping
+struct KeyboardMapping {
+    int firstNote = 0;
+    int lastNote = 127;
+    int middleNote = 60;
+    int referenceNote = 69;
+    double referenceFrequency = 440.0;
+    int octaveDegree = 0;       // Scale degree of the formal octave, 0 for the scale's own
+    std::vector<int> degrees;   // Scale degree per key, -1 if unmapped; empty for a linear mapping
+};
+
+bool parseKeyboardMapping(const juce::String& text, KeyboardMapping& mapping)
+{
+    const juce::StringArray lines = getScalaLines(text);
+    
+    int index = 0;
+    auto nextToken = [&]() -> juce::String
+    {
+        while (index < lines.size())
+        {
+            const juce::String token = getFirstToken(lines[index++]);
+            
+            if (token.isNotEmpty())
+                return token;
+        }
+        
+        return {};
+    };
+    
+    const juce::String sizeToken = nextToken();
+    const juce::String header[] = { nextToken(), nextToken(), nextToken(), nextToken(), nextToken(), nextToken() };
+    
+    for (const auto& token : header)
+    {
+        if (token.isEmpty())
+            return false;
+    }
+    
+    const int mapSize = sizeToken.getIntValue();
+    
+    if (mapSize < 0 || mapSize > TuningTable::numNotes)
+        return false;
+    
+    mapping.firstNote = header[0].getIntValue();
+    mapping.lastNote = header[1].getIntValue();
+    mapping.middleNote = header[2].getIntValue();
+    mapping.referenceNote = header[3].getIntValue();
+    mapping.referenceFrequency = header[4].getDoubleValue();
+    mapping.octaveDegree = header[5].getIntValue();
+    
+    if (mapping.referenceFrequency <= 0.0 || mapping.octaveDegree < 0)
+        return false;
+    
+    // Missing entries at the end of the map are unmapped
+    mapping.degrees.assign(static_cast<size_t>(mapSize), -1);
+    
+    for (auto& degree : mapping.degrees)
+    {
+        const juce::String token = nextToken();
+        
+        if (token.isEmpty())
+            break;
+        
+        if (!token.startsWithChar('x') && !token.startsWithChar('X'))
+            degree = token.getIntValue();
+    }
+    
+    return true;
+}
+
+// Integer division rounding towards negative infinity
+int floorDivide(int value, int divisor)
+{
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+} // namespace
+
+TuningTable::TuningTable()
+{
+    setEqualTemperament();
+}
+
+TuningTable::~TuningTable()
+{
+}
+
+void TuningTable::setEqualTemperament(float referenceFrequency, int referenceNote)
+{
+    for (int note = 0; note < numNotes; ++note)
+    {
+        frequencies[static_cast<size_t>(note)] = static_cast<float>(referenceFrequency * std::pow(2.0, (note - referenceNote) / 12.0));
+    }
+    
+    description.clear();
+}
+
+bool TuningTable::loadScala(const juce::String& scale, const juce::String& keyboardMapping)
+{
+    // Scale: a description line, the number of notes, then one pitch per degree above the tonic
+    const juce::StringArray lines = getScalaLines(scale);
+    
+    if (lines.size() < 2)
+        return false;
+    
+    const int numDegrees = getFirstToken(lines[1]).getIntValue();
+    
+    if (numDegrees <= 0 || lines.size() < 2 + numDegrees)
+        return false;
+    
+    std::vector<double> degreeCents(static_cast<size_t>(numDegrees) + 1, 0.0);
+    
+    for (int degree = 1; degree <= numDegrees; ++degree)
+    {
+        if (!parsePitch(lines[1 + degree], degreeCents[static_cast<size_t>(degree)]))
+            return false;
+    }
+    
+    KeyboardMapping mapping;
+    
+    if (keyboardMapping.trim().isNotEmpty() && !parseKeyboardMapping(keyboardMapping, mapping))
+        return false;
+    
+    // Pitch of any degree, continuing through the scale's repeating period
+    const double period = degreeCents[static_cast<size_t>(numDegrees)];
+    auto getDegreeCents = [&](int degree)
+    {
+        const int octave = floorDivide(degree, numDegrees);
+        return octave * period + degreeCents[static_cast<size_t>(degree - octave * numDegrees)];
+    };
+    
+    const int mapSize = static_cast<int>(mapping.degrees.size());
+    const double formalOctave = mapping.octaveDegree > 0 ? getDegreeCents(mapping.octaveDegree) : period;
+    
+    // Pitch of a key relative to the middle note, or false if the key is unmapped
+    auto getKeyCents = [&](int note, double& cents)
+    {
+        if (mapSize == 0)
+        {
+            cents = getDegreeCents(note - mapping.middleNote);
+            return true;
+        }
+        
+        const int octave = floorDivide(note - mapping.middleNote, mapSize);
+        const int degree = mapping.degrees[static_cast<size_t>(note - mapping.middleNote - octave * mapSize)];
+        
+        if (degree < 0)
+            return false;
+        
+        cents = octave * formalOctave + getDegreeCents(degree);
+        return true;
+    };
+    
+    double referenceCents = 0.0;
+    
+    if (!getKeyCents(mapping.referenceNote, referenceCents))
+        return false;
+    
+    for (int note = 0; note < numNotes; ++note)
+    {
+        double cents = 0.0;
+        const bool mapped = note >= mapping.firstNote && note <= mapping.lastNote && getKeyCents(note, cents);
+        
+        frequencies[static_cast<size_t>(note)] = mapped
+            ? static_cast<float>(mapping.referenceFrequency * std::pow(2.0, (cents - referenceCents) / 1200.0))
+            : 0.0f;
+    }
+    
+    description = lines[0].trim();
+    return true;
+}
+
+bool TuningTable::loadScalaFiles(const juce::File& scaleFile, const juce::File& keyboardMappingFile)
+{
+    if (!scaleFile.existsAsFile())
+        return false;
+    
+    juce::String keyboardMapping;
+    
+    if (keyboardMappingFile != juce::File())
+    {
+        if (!keyboardMappingFile.existsAsFile())
+            return false;
+        
+        keyboardMapping = keyboardMappingFile.loadFileAsString();
+    }
+    
+    return loadScala(scaleFile.loadFileAsString(), keyboardMapping);
+}
+
+const juce::String& TuningTable::getDescription() const
+{
+    return description;
+}
+
+float TuningTable::centsToRatio(float cents)
+{
+    // Split into whole octaves and cents within the octave
+    int octaves = static_cast<int>(cents * (1.0f / 1200.0f));
+    
+    if (cents < static_cast<float>(octaves) * 1200.0f)
+        --octaves;
+    
+    const float position = cents - static_cast<float>(octaves) * 1200.0f;
+    const int index = juce::jmin(1199, static_cast<int>(position));
+    const float fraction = position - static_cast<float>(index);
+    
+    const float ratio = centRatios[static_cast<size_t>(index)]
+                        + fraction * (centRatios[static_cast<size_t>(index) + 1] - centRatios[static_cast<size_t>(index)]);
+    
+    // Whole octaves are applied exactly by building the power of two directly
+    const juce::uint32 exponentBits = static_cast<juce::uint32>(juce::jlimit(-126, 127, octaves) + 127) << 23;
+    float octaveScale;
+    std::memcpy(&octaveScale, &exponentBits, sizeof(octaveScale));
+    
+    return ratio * octaveScale;
+}
+
+TuningSet::TuningSet()
+    : equalTemperament(std::make_shared<TuningTable>())
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        owners[static_cast<size_t>(channel)] = equalTemperament;
+        tables[static_cast<size_t>(channel)].store(equalTemperament.get(), std::memory_order_relaxed);
+    }
+}
+
+TuningSet::~TuningSet()
+{
+}
+
+void TuningSet::setTable(std::shared_ptr<const TuningTable> table, int channel)
+{
+    if (channel < 0 || channel > numChannels)
+        return;
+    
+    if (table == nullptr)
+        table = equalTemperament;
+    
+    const int firstChannel = channel == 0 ? 1 : channel;
+    const int lastChannel = channel == 0 ? numChannels : channel;
+    
+    for (int c = firstChannel; c <= lastChannel; ++c)
+    {
+        const size_t index = static_cast<size_t>(c - 1);
+        tables[index].store(table.get(), std::memory_order_release);
+        
+        retiredTables.retire(std::move(owners[index]));
+        owners[index] = table;
+    }
+    
+    retiredTables.publish();
+}
+
+const TuningTable& TuningSet::getTable(int channel) const
+{
+    return *tables[static_cast<size_t>(juce::jlimit(1, numChannels, channel) - 1)].load(std::memory_order_acquire);
+}
+
+float TuningSet::getFrequency(int midiNote, int channel) const
+{
+    return getTable(channel).getFrequency(midiNote);
+}
+
+void TuningSet::beginBlock()
+{
+    retiredTables.acknowledge();
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,182 @@
+/*
+ * Underground Beats
+ * Tuning.h
+ * 
+ * Precomputed note frequency tables, Scala import, and per-channel tunings
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DeferredRelease.h"
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace UndergroundBeats {
+
+/**
+ * @class TuningTable
+ * @brief Frequencies of all 128 MIDI notes
+ * 
+ * Pitch conversions are done once, when the table is built, so turning a
+ * note into a frequency is a single table read. Tables start out as 12-tone
+ * equal temperament at A4 = 440 Hz and can be loaded from Scala scale (.scl)
+ * and keyboard mapping (.kbm) files.
+ */
+class TuningTable {
+public:
+    /** Number of MIDI notes in a table */
+    static constexpr int numNotes = 128;
+    
+    /**
+     * @brief Create a 12-tone equal temperament table at A4 = 440 Hz
+     */
+    TuningTable();
+    ~TuningTable();
+    
+    /**
+     * @brief Fill the table with 12-tone equal temperament
+     * 
+     * @param referenceFrequency Frequency of the reference note in Hz
+     * @param referenceNote MIDI note that plays the reference frequency
+     */
+    void setEqualTemperament(float referenceFrequency = 440.0f, int referenceNote = 69);
+    
+    /**
+     * @brief Fill the table from the contents of Scala files
+     * 
+     * Without a keyboard mapping, scale degree 0 is on MIDI note 60 and note
+     * 69 plays 440 Hz. Notes the mapping leaves out get a frequency of 0 and
+     * should not be played. On failure the table is left unchanged.
+     * 
+     * @param scale Contents of a .scl file
+     * @param keyboardMapping Contents of a .kbm file, or empty for the default mapping
+     * @return true if both were parsed successfully
+     */
+    bool loadScala(const juce::String& scale, const juce::String& keyboardMapping = {});
+    
+    /**
+     * @brief Fill the table from Scala files on disk
+     * 
+     * @param scaleFile The .scl file
+     * @param keyboardMappingFile The .kbm file, or a default File for the default mapping
+     * @return true if the files were read and parsed successfully
+     */
+    bool loadScalaFiles(const juce::File& scaleFile, const juce::File& keyboardMappingFile = {});
+    
+    /**
+     * @brief Get the frequency of a note
+     * 
+     * @param midiNote The MIDI note number (0 to 127)
+     * @return Frequency in Hz, or 0 if the note is not mapped
+     */
+    float getFrequency(int midiNote) const
+    {
+        return frequencies[static_cast<size_t>(juce::jlimit(0, numNotes - 1, midiNote))];
+    }
+    
+    /**
+     * @brief Get the description line of the loaded scale
+     * 
+     * @return The description, or an empty string for equal temperament
+     */
+    const juce::String& getDescription() const;
+    
+    /**
+     * @brief Convert a pitch offset in cents to a frequency multiplier
+     * 
+     * Uses a one-cent lookup table with linear interpolation, accurate to
+     * better than 0.001 cents and cheaper than std::pow.
+     * 
+     * @param cents Pitch offset in cents (100 per equal-tempered semitone)
+     * @return The frequency ratio
+     */
+    static float centsToRatio(float cents);
+    
+    /**
+     * @brief Convert a pitch offset in semitones to a frequency multiplier
+     * 
+     * @param semitones Pitch offset in equal-tempered semitones
+     * @return The frequency ratio
+     */
+    static float semitonesToRatio(float semitones)
+    {
+        return centsToRatio(semitones * 100.0f);
+    }
+    
+private:
+    std::array<float, numNotes> frequencies;
+    juce::String description;
+    
+    JUCE_LEAK_DETECTOR(TuningTable)
+};
+
+/**
+ * @class TuningSet
+ * @brief Tuning tables for the 16 MIDI channels
+ * 
+ * Tables are replaced on the message thread by publishing a pointer
+ * atomically, so the audio thread never waits. A replaced table is kept alive
+ * until the audio thread has started a new block since the replacement, at
+ * which point it can no longer be reading it, and is then released by the
+ * ReclaimThread.
+ */
+class TuningSet {
+public:
+    /** Number of MIDI channels */
+    static constexpr int numChannels = 16;
+    
+    /**
+     * @brief Create a set with 12-tone equal temperament on every channel
+     */
+    TuningSet();
+    ~TuningSet();
+    
+    /**
+     * @brief Replace the tuning of one or all channels (message thread)
+     * 
+     * @param table The new table; nullptr restores equal temperament
+     * @param channel MIDI channel (1 to 16), or 0 for all channels
+     */
+    void setTable(std::shared_ptr<const TuningTable> table, int channel = 0);
+    
+    /**
+     * @brief Get the table used by a channel (audio thread)
+     * 
+     * Only valid until the next call to beginBlock().
+     * 
+     * @param channel MIDI channel (1 to 16)
+     * @return The channel's table
+     */
+    const TuningTable& getTable(int channel) const;
+    
+    /**
+     * @brief Get the frequency of a note on a channel (audio thread)
+     * 
+     * @param midiNote The MIDI note number
+     * @param channel MIDI channel (1 to 16)
+     * @return Frequency in Hz, or 0 if the note is not mapped
+     */
+    float getFrequency(int midiNote, int channel) const;
+    
+    /**
+     * @brief Mark the start of an audio block (audio thread)
+     * 
+     * Tells the set that no table read before this point is still in use.
+     */
+    void beginBlock();
+    
+private:
+    // Tables read by the audio thread, and the owners that keep them alive
+    std::array<std::atomic<const TuningTable*>, numChannels> tables;
+    std::array<std::shared_ptr<const TuningTable>, numChannels> owners;
+    std::shared_ptr<const TuningTable> equalTemperament;
+    
+    // Replaced tables, held until the audio thread has moved past them
+    DeferredRelease retiredTables;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TuningSet)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,208 @@
+/*
+ * Underground Beats
+ * UnisonOscillator.cpp
+ * 
+ * Implementation of the unison oscillator bank
+ */
+
+#include "UnisonOscillator.h"
+#include "Tuning.h"
+
+namespace UndergroundBeats {
+
+UnisonOscillator::UnisonOscillator()
+    : wavetable(&BandLimitedWavetable::get(WaveformType::Sawtooth))
+    , numVoices(1)
+    , numLanes(laneBlock)
+    , detuneCents(20.0f)
+    , stereoSpread(1.0f)
+    , frequency(440.0f)
+    , maxPhaseIncrement(0.0f)
+    , currentSampleRate(44100.0)
+{
+    phases.fill(0.0f);
+    phaseIncrements.fill(0.0f);
+    updateLanes();
+}
+
+UnisonOscillator::~UnisonOscillator()
+{
+}
+
+void UnisonOscillator::setWaveform(WaveformType type)
+{
+    wavetable = &BandLimitedWavetable::get(type);
+}
+
+void UnisonOscillator::setNumVoices(int newNumVoices)
+{
+    newNumVoices = juce::jlimit(1, maxVoices, newNumVoices);
+    
+    if (newNumVoices == numVoices)
+        return;
+    
+    // Lanes joining a playing stack start at random phases like the others
+    for (int lane = numVoices; lane < newNumVoices; ++lane)
+    {
+        phases[static_cast<size_t>(lane)] = random.nextFloat();
+    }
+    
+    numVoices = newNumVoices;
+    updateLanes();
+}
+
+int UnisonOscillator::getNumVoices() const
+{
+    return numVoices;
+}
+
+void UnisonOscillator::setDetune(float cents)
+{
+    detuneCents = juce::jmax(0.0f, cents);
+    updateLanes();
+}
+
+void UnisonOscillator::setStereoSpread(float amount)
+{
+    stereoSpread = juce::jlimit(0.0f, 1.0f, amount);
+    updateLanes();
+}
+
+void UnisonOscillator::setFrequency(float frequencyHz)
+{
+    frequency = frequencyHz;
+    updatePhaseIncrements();
+}
+
+void UnisonOscillator::resetPhases()
+{
+    if (numVoices == 1)
+    {
+        phases[0] = 0.0f;
+        return;
+    }
+    
+    for (int lane = 0; lane < numVoices; ++lane)
+    {
+        phases[static_cast<size_t>(lane)] = random.nextFloat();
+    }
+}
+
+void UnisonOscillator::process(float* buffer, int numSamples)
+{
+    render<false>(buffer, nullptr, numSamples, 1.0f, 1.0f);
+}
+
+void UnisonOscillator::processRamped(float* buffer, int numSamples, float startRatio, float endRatio)
+{
+    render<false>(buffer, nullptr, numSamples, startRatio, endRatio);
+}
+
+void UnisonOscillator::processStereo(float* leftBuffer, float* rightBuffer, int numSamples)
+{
+    render<true>(leftBuffer, rightBuffer, numSamples, 1.0f, 1.0f);
+}
+
+void UnisonOscillator::processStereoRamped(float* leftBuffer, float* rightBuffer, int numSamples, float startRatio, float endRatio)
+{
+    render<true>(leftBuffer, rightBuffer, numSamples, startRatio, endRatio);
+}
+
+void UnisonOscillator::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    updatePhaseIncrements();
+}
+
+void UnisonOscillator::updateLanes()
+{
+    numLanes = ((numVoices + laneBlock - 1) / laneBlock) * laneBlock;
+    
+    // Equal-power normalization keeps the level steady as voices are added
+    const float normalization = 1.0f / std::sqrt(static_cast<float>(numVoices));
+    
+    for (int lane = 0; lane < maxLanes; ++lane)
+    {
+        const size_t index = static_cast<size_t>(lane);
+        
+        if (lane >= numVoices)
+        {
+            // Padding lanes play silently
+            detuneRatios[index] = 1.0f;
+            leftGains[index] = rightGains[index] = monoGains[index] = 0.0f;
+            continue;
+        }
+        
+        // Position of the voice across the stack (-1 to 1)
+        const float position = numVoices > 1 ? 2.0f * static_cast<float>(lane) / static_cast<float>(numVoices - 1) - 1.0f : 0.0f;
+        detuneRatios[index] = TuningTable::centsToRatio(position * 0.5f * detuneCents);
+        
+        // Equal-power pan, scaled so the centre matches the mono level
+        const float angle = (position * stereoSpread + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+        leftGains[index] = std::cos(angle) * juce::MathConstants<float>::sqrt2 * normalization;
+        rightGains[index] = std::sin(angle) * juce::MathConstants<float>::sqrt2 * normalization;
+        monoGains[index] = normalization;
+    }
+    
+    updatePhaseIncrements();
+}
+
+void UnisonOscillator::updatePhaseIncrements()
+{
+    const float baseIncrement = frequency / static_cast<float>(currentSampleRate);
+    maxPhaseIncrement = 0.0f;
+    
+    for (int lane = 0; lane < maxLanes; ++lane)
+    {
+        const size_t index = static_cast<size_t>(lane);
+        phaseIncrements[index] = lane < numVoices ? juce::jlimit(0.0f, 0.5f, baseIncrement * detuneRatios[index]) : 0.0f;
+        maxPhaseIncrement = juce::jmax(maxPhaseIncrement, phaseIncrements[index]);
+    }
+}
+
+template <bool stereo>
+void UnisonOscillator::render(float* leftBuffer, float* rightBuffer, int numSamples, float startRatio, float endRatio)
+{
+    // Keep the highest voice below half the sample rate, so one subtract still wraps the phase
+    const float ratioLimit = maxPhaseIncrement > 0.0f ? 0.5f / maxPhaseIncrement : 1.0f;
+    startRatio = juce::jmin(startRatio, ratioLimit);
+    endRatio = juce::jmin(endRatio, ratioLimit);
+    
+    const float ratioStep = (endRatio - startRatio) / static_cast<float>(numSamples);
+    float ratio = startRatio;
+    
+    // One table for the whole bank, band-limited for its highest voice at the highest ratio
+    const float* table = wavetable->getTable(maxPhaseIncrement * juce::jmax(startRatio, endRatio));
+    const float* leftGain = stereo ? leftGains.data() : monoGains.data();
+    const float* rightGain = rightGains.data();
+    float* phase = phases.data();
+    const float* increment = phaseIncrements.data();
+    const int lanes = numLanes;
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float left = 0.0f;
+        float right = 0.0f;
+        ratio += ratioStep;
+        
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            const float value = BandLimitedWavetable::lookup(table, phase[lane]);
+            left += value * leftGain[lane];
+            
+            if (stereo)
+                right += value * rightGain[lane];
+            
+            // Increments are below one cycle per sample, so one conditional subtract wraps the phase
+            const float next = phase[lane] + increment[lane] * ratio;
+            phase[lane] = next >= 1.0f ? next - 1.0f : next;
+        }
+        
+        leftBuffer[i] = left;
+        
+        if (stereo)
+            rightBuffer[i] = right;
+    }
+}
+
+} // namespace UndergroundBeats
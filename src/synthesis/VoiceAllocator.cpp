@@ -0,0 +1,273 @@
+/*
+ * Underground Beats
+ * VoiceAllocator.cpp
+ * 
+ * Implementation of constant-time voice allocation
+ */
+
+#include "VoiceAllocator.h"
+
+namespace UndergroundBeats {
+
+VoiceAllocator::VoiceAllocator(int numVoices)
+    : freeListHead(-1)
+    , numActiveVoices(0)
+{
+    setNumVoices(numVoices);
+}
+
+VoiceAllocator::~VoiceAllocator()
+{
+}
+
+void VoiceAllocator::setNumVoices(int numVoices)
+{
+    slots.resize(static_cast<size_t>(std::max(1, numVoices)));
+    reset();
+}
+
+int VoiceAllocator::getNumVoices() const
+{
+    return static_cast<int>(slots.size());
+}
+
+VoiceAllocator::Allocation VoiceAllocator::noteOn(int midiNoteNumber)
+{
+    if (midiNoteNumber < 0 || midiNoteNumber > 127)
+    {
+        return { -1, -1, false };
+    }
+    
+    // Retrigger the voice already playing this note
+    const int existingVoice = noteToVoice[midiNoteNumber];
+    if (existingVoice >= 0)
+    {
+        VoiceSlot& slot = slots[existingVoice];
+        removeFromList(listForState(slot.state), existingVoice);
+        slot.state = VoiceState::Held;
+        appendToList(heldVoices, existingVoice);
+        
+        return { existingVoice, -1, true };
+    }
+    
+    int voiceIndex = freeListHead;
+    int stolenNote = -1;
+    
+    if (voiceIndex >= 0)
+    {
+        // Pop a voice from the free list
+        freeListHead = slots[voiceIndex].next;
+        ++numActiveVoices;
+    }
+    else
+    {
+        // Steal a sounding voice
+        voiceIndex = chooseVoiceToSteal();
+        VoiceSlot& stolen = slots[voiceIndex];
+        removeFromList(listForState(stolen.state), voiceIndex);
+        stolenNote = stolen.note;
+        noteToVoice[stolenNote] = -1;
+    }
+    
+    VoiceSlot& slot = slots[voiceIndex];
+    slot.state = VoiceState::Held;
+    slot.note = midiNoteNumber;
+    slot.level = 1.0f;
+    appendToList(heldVoices, voiceIndex);
+    noteToVoice[midiNoteNumber] = voiceIndex;
+    
+    return { voiceIndex, stolenNote, false };
+}
+
+int VoiceAllocator::noteOff(int midiNoteNumber)
+{
+    if (midiNoteNumber < 0 || midiNoteNumber > 127)
+    {
+        return -1;
+    }
+    
+    const int voiceIndex = noteToVoice[midiNoteNumber];
+    if (voiceIndex < 0 || slots[voiceIndex].state != VoiceState::Held)
+    {
+        return -1;
+    }
+    
+    // Move to the back of the released list (newest release)
+    removeFromList(heldVoices, voiceIndex);
+    slots[voiceIndex].state = VoiceState::Released;
+    appendToList(releasedVoices, voiceIndex);
+    
+    return voiceIndex;
+}
+
+void VoiceAllocator::releaseAllNotes()
+{
+    while (heldVoices.head >= 0)
+    {
+        const int voiceIndex = heldVoices.head;
+        removeFromList(heldVoices, voiceIndex);
+        slots[voiceIndex].state = VoiceState::Released;
+        appendToList(releasedVoices, voiceIndex);
+    }
+}
+
+void VoiceAllocator::voiceFinished(int voiceIndex)
+{
+    if (voiceIndex < 0 || voiceIndex >= getNumVoices())
+    {
+        return;
+    }
+    
+    VoiceSlot& slot = slots[voiceIndex];
+    if (slot.state == VoiceState::Free)
+    {
+        return;
+    }
+    
+    removeFromList(listForState(slot.state), voiceIndex);
+    
+    if (slot.note >= 0 && noteToVoice[slot.note] == voiceIndex)
+    {
+        noteToVoice[slot.note] = -1;
+    }
+    
+    // Push onto the free list
+    slot.state = VoiceState::Free;
+    slot.note = -1;
+    slot.level = 0.0f;
+    slot.previous = -1;
+    slot.next = freeListHead;
+    freeListHead = voiceIndex;
+    --numActiveVoices;
+}
+
+void VoiceAllocator::setVoiceLevel(int voiceIndex, float level)
+{
+    if (voiceIndex >= 0 && voiceIndex < getNumVoices())
+    {
+        slots[voiceIndex].level = level;
+    }
+}
+
+int VoiceAllocator::getVoiceForNote(int midiNoteNumber) const
+{
+    if (midiNoteNumber < 0 || midiNoteNumber > 127)
+    {
+        return -1;
+    }
+    
+    return noteToVoice[midiNoteNumber];
+}
+
+VoiceState VoiceAllocator::getVoiceState(int voiceIndex) const
+{
+    if (voiceIndex < 0 || voiceIndex >= getNumVoices())
+    {
+        return VoiceState::Free;
+    }
+    
+    return slots[voiceIndex].state;
+}
+
+int VoiceAllocator::getNumActiveVoices() const
+{
+    return numActiveVoices;
+}
+
+void VoiceAllocator::reset()
+{
+    noteToVoice.fill(-1);
+    heldVoices = VoiceList();
+    releasedVoices = VoiceList();
+    numActiveVoices = 0;
+    
+    // Chain every voice into the free list in index order
+    const int numVoices = getNumVoices();
+    for (int i = 0; i < numVoices; ++i)
+    {
+        VoiceSlot& slot = slots[i];
+        slot.state = VoiceState::Free;
+        slot.note = -1;
+        slot.level = 0.0f;
+        slot.previous = -1;
+        slot.next = (i + 1 < numVoices) ? i + 1 : -1;
+    }
+    
+    freeListHead = 0;
+}
+
+void VoiceAllocator::appendToList(VoiceList& list, int voiceIndex)
+{
+    VoiceSlot& slot = slots[voiceIndex];
+    slot.previous = list.tail;
+    slot.next = -1;
+    
+    if (list.tail >= 0)
+    {
+        slots[list.tail].next = voiceIndex;
+    }
+    else
+    {
+        list.head = voiceIndex;
+    }
+    
+    list.tail = voiceIndex;
+}
+
+void VoiceAllocator::removeFromList(VoiceList& list, int voiceIndex)
+{
+    VoiceSlot& slot = slots[voiceIndex];
+    
+    if (slot.previous >= 0)
+    {
+        slots[slot.previous].next = slot.next;
+    }
+    else
+    {
+        list.head = slot.next;
+    }
+    
+    if (slot.next >= 0)
+    {
+        slots[slot.next].previous = slot.previous;
+    }
+    else
+    {
+        list.tail = slot.previous;
+    }
+    
+    slot.previous = -1;
+    slot.next = -1;
+}
+
+VoiceAllocator::VoiceList& VoiceAllocator::listForState(VoiceState state)
+{
+    return (state == VoiceState::Released) ? releasedVoices : heldVoices;
+}
+
+int VoiceAllocator::chooseVoiceToSteal() const
+{
+    // The oldest released voice is the least audible loss
+    if (releasedVoices.head >= 0)
+    {
+        return releasedVoices.head;
+    }
+    
+    // Otherwise take the quietest of the oldest few held voices
+    int candidate = heldVoices.head;
+    int quietest = candidate;
+    
+    for (int i = 0; i < maxStealCandidates && candidate >= 0; ++i)
+    {
+        if (slots[candidate].level < slots[quietest].level)
+        {
+            quietest = candidate;
+        }
+        
+        candidate = slots[candidate].next;
+    }
+    
+    return quietest;
+}
+
+} // namespace UndergroundBeats
@@ -0,0 +1,169 @@
+/*
+ * Underground Beats
+ * VoiceAllocator.h
+ * 
+ * Constant-time voice allocation and voice stealing for polyphonic modules
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Enumeration of voice allocation states
+ */
+enum class VoiceState {
+    Free,     // Not playing, available for a new note
+    Held,     // Playing a note whose key is still down
+    Released  // Playing the release tail of a note
+};
+
+/**
+ * @class VoiceAllocator
+ * @brief Decides which voice plays each note
+ * 
+ * The VoiceAllocator tracks voices by index only, so its decisions can be
+ * exercised without any audio rendering. Every operation is constant time
+ * regardless of the number of voices:
+ * - a 128-entry table maps MIDI notes to the voice playing them
+ * - free voices form an intrusive singly-linked free list
+ * - held and released voices form intrusive age-ordered lists
+ * 
+ * When no voice is free, the oldest released voice is stolen. If every voice
+ * is held, the quietest of the few oldest held voices is stolen instead.
+ */
+class VoiceAllocator {
+public:
+    /**
+     * @brief Result of allocating a voice for a note
+     */
+    struct Allocation {
+        int voiceIndex;   // Index of the voice that should play the note, or -1
+        int stolenNote;   // Note the voice was playing if it was stolen, or -1
+        bool retriggered; // true if the voice was already playing the same note
+    };
+    
+    VoiceAllocator(int numVoices = 8);
+    ~VoiceAllocator();
+    
+    /**
+     * @brief Set the number of voices (resets all allocation state)
+     * 
+     * @param numVoices Number of voices to manage
+     */
+    void setNumVoices(int numVoices);
+    
+    /**
+     * @brief Get the number of voices managed
+     * 
+     * @return The number of voices
+     */
+    int getNumVoices() const;
+    
+    /**
+     * @brief Allocate a voice for a note-on
+     * 
+     * @param midiNoteNumber The MIDI note number to play
+     * @return The allocation decision, with a voice index of -1 if the note is
+     *         outside the MIDI range
+     */
+    Allocation noteOn(int midiNoteNumber);
+    
+    /**
+     * @brief Release the voice holding a note
+     * 
+     * @param midiNoteNumber The MIDI note number to release
+     * @return The index of the released voice, or -1 if the note was not held
+     */
+    int noteOff(int midiNoteNumber);
+    
+    /**
+     * @brief Move every held voice to the released state
+     */
+    void releaseAllNotes();
+    
+    /**
+     * @brief Return a voice to the free list once it has stopped sounding
+     * 
+     * @param voiceIndex The voice that finished
+     */
+    void voiceFinished(int voiceIndex);
+    
+    /**
+     * @brief Report the current output level of a voice (used for stealing)
+     * 
+     * @param voiceIndex The voice to update
+     * @param level The current level of the voice (0 to 1)
+     */
+    void setVoiceLevel(int voiceIndex, float level);
+    
+    /**
+     * @brief Get the voice currently assigned to a note
+     * 
+     * @param midiNoteNumber The MIDI note number
+     * @return The voice index, or -1 if no voice is playing the note
+     */
+    int getVoiceForNote(int midiNoteNumber) const;
+    
+    /**
+     * @brief Get the allocation state of a voice
+     * 
+     * @param voiceIndex The voice to query
+     * @return The voice state
+     */
+    VoiceState getVoiceState(int voiceIndex) const;
+    
+    /**
+     * @brief Get the number of voices that are held or released
+     * 
+     * @return The number of sounding voices
+     */
+    int getNumActiveVoices() const;
+    
+    /**
+     * @brief Free every voice and clear all note assignments
+     */
+    void reset();
+    
+private:
+    // Per-voice bookkeeping, linked intrusively by index
+    struct VoiceSlot {
+        VoiceState state;
+        int note;
+        float level;
+        int previous; // Previous voice in the held/released list
+        int next;     // Next voice in the held/released list (or free list)
+    };
+    
+    // Doubly-linked list of voice indices, oldest at the head
+    struct VoiceList {
+        int head = -1;
+        int tail = -1;
+    };
+    
+    std::vector<VoiceSlot> slots;
+    std::array<int, 128> noteToVoice;
+    int freeListHead;
+    VoiceList heldVoices;
+    VoiceList releasedVoices;
+    int numActiveVoices;
+    
+    // Number of oldest held voices compared by level when stealing a held voice
+    static constexpr int maxStealCandidates = 4;
+    
+    // List helpers
+    void appendToList(VoiceList& list, int voiceIndex);
+    void removeFromList(VoiceList& list, int voiceIndex);
+    VoiceList& listForState(VoiceState state);
+    
+    // Pick the voice to steal when none are free
+    int chooseVoiceToSteal() const;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceAllocator)
+};
+
+} // namespace UndergroundBeats
@@ -0,0 +1,91 @@
+/*
+ * Underground Beats
+ * VoiceParameters.cpp
+ * 
+ * Implementation of the shared voice parameter block
+ */
+
+#include "VoiceParameters.h"
+
+namespace UndergroundBeats {
+
+VoiceParameterBlock::VoiceParameterBlock()
+    : pendingVersion(1)
+    , currentSampleRate(44100.0)
+{
+    // The filter envelope opens the cutoff by up to half an octave and a bit (x1.5)
+    pendingValues.modulation.setRoute(0, { ModulationSource::FilterEnvelope, ModulationDestination::FilterCutoff, 0.585f });
+    
+    // Version 0 means "never applied", so voices pick up the defaults
+    shared.version = 0;
+    refresh();
+}
+
+VoiceParameterBlock::~VoiceParameterBlock()
+{
+}
+
+VoiceParameters VoiceParameterBlock::getPendingValues() const
+{
+    const juce::SpinLock::ScopedLockType lock(parameterLock);
+    return pendingValues;
+}
+
+bool VoiceParameterBlock::refresh()
+{
+    const juce::uint32 version = pendingVersion.load(std::memory_order_acquire);
+    
+    if (version == shared.version)
+    {
+        return false;
+    }
+    
+    const juce::SpinLock::ScopedTryLockType lock(parameterLock);
+    
+    if (!lock.isLocked())
+    {
+        return false;
+    }
+    
+    shared.values = pendingValues;
+    updateDerivedValues();
+    shared.version = pendingVersion.load(std::memory_order_relaxed);
+    
+    return true;
+}
+
+void VoiceParameterBlock::prepare(double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    pendingVersion.fetch_add(1, std::memory_order_release);
+    refresh();
+}
+
+const SharedVoiceParameters& VoiceParameterBlock::getShared() const
+{
+    return shared;
+}
+
+void VoiceParameterBlock::updateDerivedValues()
+{
+    const VoiceParameters& values = shared.values;
+    
+    for (size_t i = 0; i < values.oscillatorDetuneCents.size(); ++i)
+    {
+        shared.oscillatorDetuneRatios[i] = TuningTable::centsToRatio(values.oscillatorDetuneCents[i]);
+    }
+    
+    shared.ampEnvelope.attackTime = values.attackMs;
+    shared.ampEnvelope.decayTime = values.decayMs;
+    shared.ampEnvelope.sustainLevel = juce::jlimit(0.0f, 1.0f, values.sustainLevel);
+    shared.ampEnvelope.releaseTime = values.releaseMs;
+    shared.ampEnvelope.updateSampleCounts(currentSampleRate);
+    
+    shared.filterCoefficients = Filter::calculateCoefficients(values.filterType, values.filterCutoff,
+                                                              values.filterResonance, 0.0f, currentSampleRate);
+    
+    shared.modalBank = ModalBank::calculateSettings(values.modalBody, values.physicalDecaySeconds,
+                                                    values.physicalBrightness, currentSampleRate);
+}
+
+} // namespace UndergroundBeats
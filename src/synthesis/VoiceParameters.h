@@ -0,0 +1,153 @@
+/*
+ * Underground Beats
+ * VoiceParameters.h
+ * 
+ * Versioned parameter block shared by all voices of a synthesizer module
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Oscillator.h"
+#include "Envelope.h"
+#include "Filter.h"
+#include "LadderFilter.h"
+#include "LFO.h"
+#include "ModulationMatrix.h"
+#include "Tuning.h"
+#include "PhysicalModels.h"
+#include <array>
+#include <atomic>
+
+namespace UndergroundBeats {
+
+/**
+ * @brief Raw synthesizer voice parameters as set by the user
+ */
+struct VoiceParameters {
+    VoiceModel voiceModel = VoiceModel::Subtractive;
+    
+    std::array<WaveformType, 2> oscillatorWaveforms = { WaveformType::Sine, WaveformType::Sine };
+    std::array<float, 2> oscillatorDetuneCents = { 0.0f, 5.0f };
+    std::array<float, 2> oscillatorLevels = { 0.5f, 0.5f };
+    std::array<int, 2> oscillatorUnisonVoices = { 1, 1 };
+    std::array<float, 2> oscillatorUnisonDetuneCents = { 20.0f, 20.0f };
+    
+    FilterModel filterModel = FilterModel::Biquad;
+    FilterType filterType = FilterType::LowPass; // Biquad model only
+    float filterCutoff = 1000.0f;
+    float filterResonance = 0.5f;
+    float filterDrive = 1.0f;                    // Ladder model only
+    bool filterOversampling = false;             // Ladder model only
+    
+    float physicalDecaySeconds = 1.5f;           // Physical models: 60 dB decay time of the fundamental
+    float physicalBrightness = 0.5f;             // Physical models: pluck or strike hardness (0 to 1)
+    float physicalPosition = 0.2f;               // Plucked string only: pluck point along the string (0 to 0.5)
+    ModalBody modalBody = ModalBody::Bar;        // Modal percussion only
+    
+    float attackMs = 10.0f;
+    float decayMs = 100.0f;
+    float sustainLevel = 0.7f;
+    float releaseMs = 200.0f;
+    
+    float velocitySensitivity = 0.7f;
+    
+    ModulationMatrix modulation;
+    std::array<LFOShape, 2> lfoShapes = { LFOShape::Sine, LFOShape::Triangle };
+    std::array<float, 2> lfoRates = { 2.0f, 0.5f };
+    int modulationInterval = 32; // Control step length in samples
+};
+
+/**
+ * @brief Voice parameters plus the values derived from them
+ * 
+ * Derived values are the same for every voice, so they are computed once per
+ * parameter change and read by all voices.
+ */
+struct SharedVoiceParameters {
+    juce::uint32 version = 0;                   // Changes whenever any value changes
+    VoiceParameters values;                     // The raw parameters
+    std::array<float, 2> oscillatorDetuneRatios = { 1.0f, 1.0f }; // Frequency multipliers for the detune amounts
+    EnvelopeSettings ampEnvelope;               // Amplitude envelope with sample counts
+    FilterCoefficients filterCoefficients;      // Coefficients for the base filter settings
+    ModalBankSettings modalBank;                // Mode settings for the modal percussion model
+};
+
+/**
+ * @class VoiceParameterBlock
+ * @brief Single source of voice parameters for a synthesizer module
+ * 
+ * Setters may be called from any thread. Each change is O(1): it updates the raw
+ * values and bumps a version number. Once per block, the audio thread calls
+ * refresh(), which recomputes the derived values only if the version changed.
+ * Voices compare the shared version with the last one they applied and pull new
+ * values lazily at their next block.
+ */
+class VoiceParameterBlock {
+public:
+    VoiceParameterBlock();
+    ~VoiceParameterBlock();
+    
+    /**
+     * @brief Change one or more raw parameters
+     * 
+     * @param change Callable receiving a VoiceParameters& to modify
+     */
+    template <typename ChangeFunction>
+    void update(ChangeFunction&& change)
+    {
+        const juce::SpinLock::ScopedLockType lock(parameterLock);
+        change(pendingValues);
+        pendingVersion.fetch_add(1, std::memory_order_release);
+    }
+    
+    /**
+     * @brief Get a copy of the most recently set raw parameters
+     * 
+     * Includes changes the audio thread has not applied yet. Takes the setter
+     * lock, so do not call this from the audio thread.
+     * 
+     * @return The raw parameters
+     */
+    VoiceParameters getPendingValues() const;
+    
+    /**
+     * @brief Recompute the shared values if any parameter changed (audio thread)
+     * 
+     * Never blocks: if a setter holds the lock, the refresh is retried next block.
+     * 
+     * @return true if the shared values were updated
+     */
+    bool refresh();
+    
+    /**
+     * @brief Set the sample rate used for derived values (forces a refresh)
+     * 
+     * @param sampleRate The sample rate in Hz
+     */
+    void prepare(double sampleRate);
+    
+    /**
+     * @brief Get the values read by voices
+     * 
+     * @return The shared parameters
+     */
+    const SharedVoiceParameters& getShared() const;
+    
+private:
+    // Written by setters under the lock
+    mutable juce::SpinLock parameterLock;
+    VoiceParameters pendingValues;
+    std::atomic<juce::uint32> pendingVersion;
+    
+    // Read by voices on the audio thread
+    SharedVoiceParameters shared;
+    double currentSampleRate;
+    
+    // Compute the derived values from shared.values
+    void updateDerivedValues();
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceParameterBlock)
+};
+
+} // namespace UndergroundBeats
@@ -8,6 +8,9 @@
 #include "AppComponent.h"
 #include "views/PatternEditorView.h"
 #include "views/MixerView.h"
+#include "views/SettingsView.h"
+#include "../effects/Reverb.h"
+#include "../effects/FDNReverb.h"
 
 namespace UndergroundBeats {
 
@@ -24,6 +27,13 @@ AppComponent::AppComponent()
 AppComponent::~AppComponent()
 {
     stopTimer();
+    
+    // Stop rendering before the modules it uses are destroyed
+    if (audioEngine != nullptr)
+    {
+        audioEngine->stop();
+        audioEngine->setRenderer(nullptr);
+    }
 }
 
 bool AppComponent::initialize()
@@ -41,6 +51,10 @@ bool AppComponent::initialize()
     // Create the UI components
     createComponents();
     
+    // Start playing the synth and effects
+    audioEngine->setRenderer(this);
+    audioEngine->start();
+    
     return true;
 }
 
@@ -176,8 +190,12 @@ bool AppComponent::initializeSynthesis()
     // Create the synth module with 8 voices
     synthModule = std::make_unique<SynthModule>(8);
     
+    // Render voices on the engine's workers once enough of them are playing
+    synthModule->setWorkerPool(&audioEngine->getWorkerPool());
+    synthModule->setParallelRendering(true, minVoicesPerRenderThread);
+    
     // Initialize with default settings
-    synthModule->prepare(audioEngine->getSampleRate());
+    synthModule->prepare(audioEngine->getSampleRate(), audioEngine->getBufferSize());
     
     return true;
 }
@@ -190,6 +208,18 @@ bool AppComponent::initializeEffects()
     // Initialize with default settings
     effectsChain->prepare(audioEngine->getSampleRate(), audioEngine->getBufferSize());
     
+    // Create the send buses, processing their returns on the engine's workers
+    sendReturnBuses = std::make_unique<SendReturnBuses>();
+    sendReturnBuses->setWorkerPool(&audioEngine->getWorkerPool());
+    sendReturnBuses->prepare(audioEngine->getSampleRate(), audioEngine->getBufferSize());
+    
+    // Default returns for the mixer's default sends: a room and a hall, both fully wet
+    sendReturnBuses->getReturnChain(0)->addEffect(std::make_unique<Reverb>());
+    
+    auto hall = std::make_unique<FDNReverb>();
+    hall->setRoomSize(0.8f);
+    sendReturnBuses->getReturnChain(1)->addEffect(std::move(hall));
+    
     return true;
 }
 
@@ -262,6 +292,8 @@ void AppComponent::createMixerTab()
         mixerView->setAudioEngine(audioEngine.get());
     }
     
+    mixerView->setSendReturnBuses(sendReturnBuses.get());
+    
     // Add to tabs
     mainTabs.addTab("Mixer", juce::Colours::darkgrey, mixerView, true);
 }
@@ -288,12 +320,44 @@ void AppComponent::createEffectsTab()
 
 void AppComponent::createSettingsTab()
 {
-    // Create the settings component (placeholder for now)
-    auto settings = new juce::Component();
-    settings->setName("Settings");
+    // Create the settings view
+    auto settings = new SettingsView();
+    settings->setSynthModule(synthModule.get());
     
     // Add to tabs
     mainTabs.addTab("Settings", juce::Colours::darkgrey, settings, true);
 }
 
+void AppComponent::prepareToRender(double sampleRate, int blockSize)
+{
+    // The device may run at other settings than the engine was initialized with
+    synthModule->prepare(sampleRate, blockSize);
+    effectsChain->prepare(sampleRate, blockSize);
+    sendReturnBuses->prepare(sampleRate, blockSize);
+    sequencer->prepare(sampleRate, blockSize);
+    
+    // Room for a busy block of sequenced notes without allocating on the audio thread
+    sequencedMidi.ensureSize(4096);
+}
+
+void AppComponent::render(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    const int numSamples = buffer.getNumSamples();
+    float* left = buffer.getWritePointer(0);
+    float* right = buffer.getWritePointer(1);
+    
+    // The sequencer replaces the input with its notes while playing, and passes it through otherwise
+    sequencedMidi.clear();
+    sequencer->processMidi(midiMessages, sequencedMidi);
+    
+    // The synth's channel, through its effects
+    synthModule->processStereoBlock(sequencedMidi, left, right, numSamples);
+    effectsChain->processStereo(left, right, numSamples);
+    
+    // Feed the channel to the sends at its send levels, then mix in the returns
+    sendReturnBuses->beginBlock(numSamples);
+    sendReturnBuses->addToSends(synthChannel, left, right);
+    sendReturnBuses->renderReturns(left, right);
+}
+
 } // namespace UndergroundBeats
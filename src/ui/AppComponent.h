@@ -11,6 +11,7 @@
 #include "../audio-engine/AudioEngine.h"
 #include "../synthesis/SynthModule.h"
 #include "../effects/EffectsChain.h"
+#include "../effects/SendReturnBuses.h"
 #include "../sequencer/Sequencer.h"
 #include "../sequencer/MidiEngine.h"
 #include <memory>
@@ -25,10 +26,15 @@ namespace UndergroundBeats {
  * and manages the application state. It integrates all components of the
  * application (audio, synthesis, effects, sequencer) and provides the main
  * interface for user interaction.
+ * 
+ * It also renders what the audio engine plays: the synth, on the first mixer
+ * channel, through the effects chain and into the effect sends, with the
+ * returns mixed into the output.
  */
 class AppComponent : public juce::Component,
                     public juce::Timer,
-                    public juce::ApplicationCommandTarget {
+                    public juce::ApplicationCommandTarget,
+                    private AudioEngine::Renderer {
 public:
     AppComponent();
     ~AppComponent() override;
@@ -97,10 +103,20 @@ private:
     std::unique_ptr<AudioEngine> audioEngine;
     std::unique_ptr<SynthModule> synthModule;
     std::unique_ptr<EffectsChain> effectsChain;
+    std::unique_ptr<SendReturnBuses> sendReturnBuses;
     std::shared_ptr<Timeline> timeline;
     std::unique_ptr<Sequencer> sequencer;
     std::unique_ptr<MidiEngine> midiEngine;
     
+    // MIDI the synth plays each block, from the sequencer or passed through from the input
+    juce::MidiBuffer sequencedMidi;
+    
+    // Mixer channel the synth plays on
+    static constexpr int synthChannel = 0;
+    
+    // Fewest playing synth voices worth handing to another thread
+    static constexpr int minVoicesPerRenderThread = 4;
+    
     // UI Components
     juce::TabbedComponent mainTabs;
     
@@ -130,6 +146,10 @@ private:
     void createEffectsTab();
     void createSettingsTab();
     
+    // Audio engine rendering
+    void prepareToRender(double sampleRate, int blockSize) override;
+    void render(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AppComponent)
 };
 
@@ -11,6 +11,7 @@ namespace UndergroundBeats {
 
 MixerView::MixerView()
     : audioEngine(nullptr)
+    , sendReturnBuses(nullptr)
     , numEffectSends(0)
 {
     // Add the channels viewport
@@ -50,6 +51,22 @@ void MixerView::setAudioEngine(AudioEngine* engine)
     // TODO: Connect to audio engine for level monitoring
 }
 
+void MixerView::setSendReturnBuses(SendReturnBuses* buses)
+{
+    sendReturnBuses = buses;
+    
+    if (sendReturnBuses != nullptr)
+    {
+        sendReturnBuses->setNumSends(numEffectSends);
+    }
+    
+    // Start the buses from the channels' current send levels
+    for (size_t i = 0; i < inputChannels.size(); ++i)
+    {
+        connectSends(static_cast<int>(i));
+    }
+}
+
 void MixerView::setNumInputChannels(int numChannels)
 {
     numChannels = juce::jmax(1, numChannels);
@@ -78,17 +95,11 @@ void MixerView::setNumInputChannels(int numChannels)
                 handleSoloChange(channelIndex, soloed);
             });
             
-            // Set up send callbacks
-            for (int sendIndex = 0; sendIndex < numEffectSends; ++sendIndex)
-            {
-                int capturedSendIndex = sendIndex;
-                channel->setSendLevelChangeCallback(sendIndex, [this, channelIndex, capturedSendIndex](float level) {
-                    handleSendLevelChange(channelIndex, capturedSendIndex, level);
-                });
-            }
-            
             channelsContainer.addAndMakeVisible(channel.get());
             inputChannels.push_back(std::move(channel));
+            
+            // Set up send callbacks
+            connectSends(channelIndex);
         }
     }
     else if (numChannels < inputChannels.size())
@@ -115,10 +126,16 @@ void MixerView::setNumEffectSends(int numSends)
     
     numEffectSends = numSends;
     
-    // Update the number of sends on all channels
-    for (auto& channel : inputChannels)
+    if (sendReturnBuses != nullptr)
     {
-        channel->setNumSends(numSends);
+        sendReturnBuses->setNumSends(numSends);
+    }
+    
+    // Update the number of sends on all channels, and route the new ones
+    for (size_t i = 0; i < inputChannels.size(); ++i)
+    {
+        inputChannels[i]->setNumSends(numSends);
+        connectSends(static_cast<int>(i));
     }
     
     // Update the number of effect return channels
@@ -355,10 +372,25 @@ void MixerView::handleSoloChange(int channelIndex, bool soloed)
 
 void MixerView::handleSendLevelChange(int channelIndex, int sendIndex, float level)
 {
-    // Apply the send level change to the audio engine
-    if (audioEngine != nullptr)
+    // Apply the send level change to the send buses
+    if (sendReturnBuses != nullptr)
     {
-        // TODO: Set send level on audio engine
+        sendReturnBuses->setSendLevel(channelIndex, sendIndex, level);
+    }
+}
+
+void MixerView::connectSends(int channelIndex)
+{
+    auto& channel = inputChannels[static_cast<size_t>(channelIndex)];
+    
+    for (int sendIndex = 0; sendIndex < numEffectSends; ++sendIndex)
+    {
+        channel->setSendLevelChangeCallback(sendIndex, [this, channelIndex, sendIndex](float level) {
+            handleSendLevelChange(channelIndex, sendIndex, level);
+        });
+        
+        // Sends added since the level was last set start from their slider
+        handleSendLevelChange(channelIndex, sendIndex, channel->getSendLevel(sendIndex));
     }
 }
 
@@ -10,6 +10,7 @@
 #include <JuceHeader.h>
 #include "../components/MixerChannel.h"
 #include "../../audio-engine/AudioEngine.h"
+#include "../../effects/SendReturnBuses.h"
 #include <vector>
 #include <memory>
 
@@ -35,6 +36,13 @@ public:
      */
     void setAudioEngine(AudioEngine* engine);
     
+    /**
+     * @brief Set the send buses the channel send controls drive
+     * 
+     * @param buses The send buses, or nullptr to drive none
+     */
+    void setSendReturnBuses(SendReturnBuses* buses);
+    
     /**
      * @brief Set the number of input channels
      * 
@@ -70,6 +78,7 @@ public:
     
 private:
     AudioEngine* audioEngine;
+    SendReturnBuses* sendReturnBuses;
     
     // Scrollable view for channels
     juce::Viewport channelsViewport;
@@ -110,6 +119,9 @@ private:
     // Handler for send level changes
     void handleSendLevelChange(int channelIndex, int sendIndex, float level);
     
+    // Route every send of an input channel to the send buses, starting from its current levels
+    void connectSends(int channelIndex);
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MixerView)
 };
 
@@ -0,0 +1,57 @@
+/*
+ * Underground Beats
+ * SettingsView.cpp
+ * 
+ * Implementation of application settings view
+ */
+
+#include "SettingsView.h"
+
+namespace UndergroundBeats {
+
+SettingsView::SettingsView()
+    : synthModule(nullptr)
+{
+    parallelRenderingToggle.setButtonText("Render synth voices on multiple threads");
+    parallelRenderingToggle.addListener(this);
+    addAndMakeVisible(parallelRenderingToggle);
+}
+
+SettingsView::~SettingsView()
+{
+}
+
+void SettingsView::setSynthModule(SynthModule* synth)
+{
+    synthModule = synth;
+    
+    // Show the synth's current setting
+    const bool enabled = synthModule != nullptr && synthModule->isParallelRenderingEnabled();
+    parallelRenderingToggle.setToggleState(enabled, juce::dontSendNotification);
+    parallelRenderingToggle.setEnabled(synthModule != nullptr);
+}
+
+void SettingsView::resized()
+{
+    // Layout components
+    int margin = 10;
+    int rowHeight = 30;
+    
+    parallelRenderingToggle.setBounds(margin, margin, getWidth() - margin * 2, rowHeight);
+}
+
+void SettingsView::paint(juce::Graphics& g)
+{
+    // Fill background
+    g.fillAll(juce::Colours::darkgrey);
+}
+
+void SettingsView::buttonClicked(juce::Button* button)
+{
+    if (button == &parallelRenderingToggle && synthModule != nullptr)
+    {
+        synthModule->setParallelRendering(parallelRenderingToggle.getToggleState(), synthModule->getMinVoicesPerThread());
+    }
+}
+
+} // namespace UndergroundBeats
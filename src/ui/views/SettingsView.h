@@ -0,0 +1,64 @@
+/*
+ * Underground Beats
+ * SettingsView.h
+ * 
+ * Application settings view
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../synthesis/SynthModule.h"
+
+namespace UndergroundBeats {
+
+/**
+ * @class SettingsView
+ * @brief Application settings view
+ * 
+ * The SettingsView class holds settings that apply to the whole application
+ * rather than to one pattern or instrument, such as how the synth spreads its
+ * voices across the engine's worker threads.
+ */
+class SettingsView : public juce::Component,
+                    public juce::Button::Listener {
+public:
+    SettingsView();
+    ~SettingsView() override;
+    
+    /**
+     * @brief Set the synth the rendering settings apply to
+     * 
+     * @param synth The synth module, or nullptr to apply to none
+     */
+    void setSynthModule(SynthModule* synth);
+    
+    /**
+     * @brief Component resized callback
+     */
+    void resized() override;
+    
+    /**
+     * @brief Component paint callback
+     * 
+     * @param g Graphics context to paint to
+     */
+    void paint(juce::Graphics& g) override;
+    
+    /**
+     * @brief Button clicked callback
+     * 
+     * @param button The button that was clicked
+     */
+    void buttonClicked(juce::Button* button) override;
+    
+private:
+    SynthModule* synthModule;
+    
+    // Render synth voices on the engine's worker threads
+    juce::ToggleButton parallelRenderingToggle;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SettingsView)
+};
+
+} // namespace UndergroundBeats